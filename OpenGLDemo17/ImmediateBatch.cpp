@@ -0,0 +1,573 @@
+/*
+ * Immediate-mode batching layer.  See ImmediateBatch.h.
+ */
+#include "SDL.h"
+#include "SDL_opengl.h"
+
+#include <string.h>
+
+#define _USE_MATH_DEFINES
+#include <math.h>
+
+// This file calls the real GL entry points
+#define IMMEDIATE_BATCH_NO_MACROS
+#include "ImmediateBatch.h"
+
+// Longest glBegin/glEnd sequence we can triangulate in one go.  Must be
+// even so that a triangle or quad strip split here keeps its winding and
+// its pairs (see emitChunk).
+#define BATCH_MAX_PRIMITIVE 4096
+
+typedef struct {
+    GLfloat x, y, z;
+    GLubyte red, green, blue, alpha;
+} BatchVertex;
+
+// Everything we capture gets drawn as one of these
+enum BatchClass {
+    BATCH_NONE,
+    BATCH_POINTS,
+    BATCH_LINES,
+    BATCH_TRIANGLES,
+};
+
+static BatchVertex s_Stream[BATCH_MAX_VERTICES];
+static int s_StreamCount = 0;
+static BatchClass s_StreamClass = BATCH_NONE;
+
+// Vertices between glBegin and glEnd, before triangulation
+static BatchVertex s_Primitive[BATCH_MAX_PRIMITIVE];
+static int s_PrimitiveCount = 0;
+static GLenum s_PrimitiveMode = 0;
+static bool s_InBegin = false;
+
+// A line loop split into chunks is closed back to its first vertex at glEnd
+static BatchVertex s_LoopFirst;
+static bool s_LoopSplit = false;
+
+static GLubyte s_Color[4] = { 255, 255, 255, 255 };
+
+// CPU copy of the model/view matrix (column-major, like GL).  The copy in
+// GL is kept at identity while batches are drawn, since the vertices have
+// already been transformed.
+static GLfloat s_ModelView[16] = { 1, 0, 0, 0,  0, 1, 0, 0,  0, 0, 1, 0,  0, 0, 0, 1 };
+static GLenum s_MatrixMode = GL_MODELVIEW;
+static bool s_GLModelViewIsIdentity = false;
+
+// glPushMatrix/glPopMatrix for s_ModelView.  GL only promises 32.
+#define BATCH_MATRIX_STACK 32
+static GLfloat s_ModelViewStack[BATCH_MATRIX_STACK][16];
+static int s_ModelViewDepth = 0;
+
+static BatchStats s_Stats = { 0, 0, 0 };
+
+static BatchClass classForMode(GLenum mode)
+{
+    switch (mode) {
+    case GL_POINTS:
+        return BATCH_POINTS;
+    case GL_LINES:
+    case GL_LINE_STRIP:
+    case GL_LINE_LOOP:
+        return BATCH_LINES;
+    default:
+        return BATCH_TRIANGLES;
+    }
+}
+
+static GLenum glModeForClass(BatchClass batchClass)
+{
+    switch (batchClass) {
+    case BATCH_POINTS:
+        return GL_POINTS;
+    case BATCH_LINES:
+        return GL_LINES;
+    default:
+        return GL_TRIANGLES;
+    }
+}
+
+void batchFlush()
+{
+    if (s_StreamCount == 0) {
+        return;
+    }
+
+    if (!s_GLModelViewIsIdentity) {
+        glMatrixMode(GL_MODELVIEW);
+        glLoadIdentity();
+        glMatrixMode(s_MatrixMode);
+        s_GLModelViewIsIdentity = true;
+    }
+
+    // Don't disturb any vertex arrays the application set up itself
+    glPushClientAttrib(GL_CLIENT_VERTEX_ARRAY_BIT);
+    glEnableClientState(GL_VERTEX_ARRAY);
+    glEnableClientState(GL_COLOR_ARRAY);
+    glVertexPointer(3, GL_FLOAT, sizeof(BatchVertex), &s_Stream[0].x);
+    glColorPointer(4, GL_UNSIGNED_BYTE, sizeof(BatchVertex), &s_Stream[0].red);
+    glDrawArrays(glModeForClass(s_StreamClass), 0, s_StreamCount);
+    glPopClientAttrib();
+
+    s_Stats.drawCount++;
+    s_Stats.vertexCount += s_StreamCount;
+    s_StreamCount = 0;
+    s_StreamClass = BATCH_NONE;
+}
+
+static void emit(const BatchVertex *pVertex)
+{
+    s_Stream[s_StreamCount++] = *pVertex;
+}
+
+// Make sure there is room for 'count' more vertices of the given class
+static void reserve(BatchClass batchClass, int count)
+{
+    if (s_StreamClass != batchClass || s_StreamCount + count > BATCH_MAX_VERTICES) {
+        batchFlush();
+        s_StreamClass = batchClass;
+    }
+}
+
+// Convert the captured primitive into points, lines or triangles and append
+// it to the stream.
+static void emitPrimitive(GLenum mode)
+{
+    const BatchVertex *v = s_Primitive;
+    int n = s_PrimitiveCount;
+    BatchClass batchClass = classForMode(mode);
+
+    switch (mode) {
+    case GL_POINTS:
+        reserve(batchClass, n);
+        for (int i = 0; i < n; i++) {
+            emit(&v[i]);
+        }
+        break;
+    case GL_LINES:
+        reserve(batchClass, n);
+        for (int i = 0; i + 1 < n; i += 2) {
+            emit(&v[i]);
+            emit(&v[i+1]);
+        }
+        break;
+    case GL_LINE_STRIP:
+    case GL_LINE_LOOP:
+        reserve(batchClass, 2 * n);
+        for (int i = 0; i + 1 < n; i++) {
+            emit(&v[i]);
+            emit(&v[i+1]);
+        }
+        if (mode == GL_LINE_LOOP && n > 2) {
+            emit(&v[n-1]);
+            emit(&v[0]);
+        }
+        break;
+    case GL_TRIANGLES:
+        reserve(batchClass, n);
+        for (int i = 0; i + 2 < n; i += 3) {
+            emit(&v[i]);
+            emit(&v[i+1]);
+            emit(&v[i+2]);
+        }
+        break;
+    case GL_TRIANGLE_STRIP:
+    case GL_QUAD_STRIP:
+        reserve(batchClass, 3 * n);
+        for (int i = 0; i + 2 < n; i++) {
+            // Every other triangle is flipped to keep the winding consistent
+            if (i & 1) {
+                emit(&v[i+1]);
+                emit(&v[i]);
+            }
+            else {
+                emit(&v[i]);
+                emit(&v[i+1]);
+            }
+            emit(&v[i+2]);
+        }
+        break;
+    case GL_QUADS:
+        reserve(batchClass, 6 * (n / 4));
+        for (int i = 0; i + 3 < n; i += 4) {
+            emit(&v[i]);
+            emit(&v[i+1]);
+            emit(&v[i+2]);
+            emit(&v[i+2]);
+            emit(&v[i+3]);
+            emit(&v[i]);
+        }
+        break;
+    case GL_TRIANGLE_FAN:
+    case GL_POLYGON:
+        reserve(batchClass, 3 * n);
+        for (int i = 1; i + 1 < n; i++) {
+            emit(&v[0]);
+            emit(&v[i]);
+            emit(&v[i+1]);
+        }
+        break;
+    }
+}
+
+// s_Primitive is full, so draw the whole primitives in it and keep the
+// vertices the rest of the sequence still builds on:  a partial primitive
+// of an independent type, the last two vertices of a strip (an even number
+// of vertices was drawn, so the pairs and winding carry on), the center and
+// last vertex of a fan, or the last vertex of a line strip or loop.
+static void emitChunk()
+{
+    int n = s_PrimitiveCount;
+    int drawn = n, keep = 0;
+    GLenum mode = s_PrimitiveMode;
+
+    switch (mode) {
+    case GL_LINES:
+        keep = n % 2;
+        drawn = n - keep;
+        break;
+    case GL_TRIANGLES:
+        keep = n % 3;
+        drawn = n - keep;
+        break;
+    case GL_QUADS:
+        keep = n % 4;
+        drawn = n - keep;
+        break;
+    case GL_LINE_LOOP:
+        if (!s_LoopSplit) {
+            s_LoopFirst = s_Primitive[0];
+            s_LoopSplit = true;
+        }
+        mode = GL_LINE_STRIP;
+        keep = 1;
+        break;
+    case GL_LINE_STRIP:
+        keep = 1;
+        break;
+    case GL_TRIANGLE_STRIP:
+    case GL_QUAD_STRIP:
+        keep = 2;
+        break;
+    case GL_TRIANGLE_FAN:
+    case GL_POLYGON:
+        emitPrimitive(mode);
+        s_Primitive[1] = s_Primitive[n-1];
+        s_PrimitiveCount = 2;
+        return;
+    }
+
+    s_PrimitiveCount = drawn;
+    emitPrimitive(mode);
+    memmove(s_Primitive, &s_Primitive[n - keep], keep * sizeof(BatchVertex));
+    s_PrimitiveCount = keep;
+}
+
+void batchBegin(GLenum mode)
+{
+    s_PrimitiveMode = mode;
+    s_PrimitiveCount = 0;
+    s_InBegin = true;
+    s_LoopSplit = false;
+}
+
+void batchEnd()
+{
+    if (s_LoopSplit) {
+        emitPrimitive(GL_LINE_STRIP);
+        reserve(BATCH_LINES, 2);
+        emit(&s_Primitive[s_PrimitiveCount-1]);
+        emit(&s_LoopFirst);
+    }
+    else {
+        emitPrimitive(s_PrimitiveMode);
+    }
+    s_InBegin = false;
+    s_Stats.beginCount++;
+}
+
+void batchColor4ub(GLubyte red, GLubyte green, GLubyte blue, GLubyte alpha)
+{
+    s_Color[0] = red;
+    s_Color[1] = green;
+    s_Color[2] = blue;
+    s_Color[3] = alpha;
+}
+
+void batchColor3ub(GLubyte red, GLubyte green, GLubyte blue)
+{
+    batchColor4ub(red, green, blue, 255);
+}
+
+// GL clamps float colors to [0, 1] too, and converting anything outside
+// that range straight to a GLubyte is undefined
+static GLubyte unitToUbyte(GLfloat value)
+{
+    if (!(value > 0.f)) {
+        return 0;       // Also NaN
+    }
+    if (value >= 1.f) {
+        return 255;
+    }
+    return GLubyte(value * 255.f + .5f);
+}
+
+void batchColor3f(GLfloat red, GLfloat green, GLfloat blue)
+{
+    batchColor4ub(unitToUbyte(red), unitToUbyte(green), unitToUbyte(blue), 255);
+}
+
+void batchVertex3f(GLfloat x, GLfloat y, GLfloat z)
+{
+    if (!s_InBegin) {
+        return;     // GL ignores this too (well, it raises an error)
+    }
+    if (s_PrimitiveCount == BATCH_MAX_PRIMITIVE) {
+        // Too long to triangulate in one piece
+        emitChunk();
+    }
+
+    const GLfloat *m = s_ModelView;
+    BatchVertex *pVertex = &s_Primitive[s_PrimitiveCount++];
+    pVertex->x = m[0] * x + m[4] * y + m[8] * z + m[12];
+    pVertex->y = m[1] * x + m[5] * y + m[9] * z + m[13];
+    pVertex->z = m[2] * x + m[6] * y + m[10] * z + m[14];
+    memcpy(&pVertex->red, s_Color, 4);
+}
+
+void batchVertex2f(GLfloat x, GLfloat y)
+{
+    batchVertex3f(x, y, 0.f);
+}
+
+void batchMatrixMode(GLenum mode)
+{
+    s_MatrixMode = mode;
+    if (mode != GL_MODELVIEW) {
+        glMatrixMode(mode);
+    }
+}
+
+// All of the matrix functions end up here.  Model/view changes only touch
+// our CPU copy; anything else changes how the batch is drawn, so flush.
+static void loadMatrix(const GLfloat *m)
+{
+    if (s_MatrixMode == GL_MODELVIEW) {
+        memcpy(s_ModelView, m, sizeof(s_ModelView));
+    }
+    else {
+        batchFlush();
+        glLoadMatrixf(m);
+    }
+}
+
+static void multMatrix(const GLfloat *m)
+{
+    if (s_MatrixMode == GL_MODELVIEW) {
+        GLfloat result[16];
+        for (int col = 0; col < 4; col++) {
+            for (int row = 0; row < 4; row++) {
+                result[col*4 + row] =
+                    s_ModelView[0*4 + row] * m[col*4 + 0] +
+                    s_ModelView[1*4 + row] * m[col*4 + 1] +
+                    s_ModelView[2*4 + row] * m[col*4 + 2] +
+                    s_ModelView[3*4 + row] * m[col*4 + 3];
+            }
+        }
+        memcpy(s_ModelView, result, sizeof(s_ModelView));
+    }
+    else {
+        batchFlush();
+        glMultMatrixf(m);
+    }
+}
+
+void batchLoadIdentity()
+{
+    static const GLfloat identity[16] = { 1, 0, 0, 0,  0, 1, 0, 0,  0, 0, 1, 0,  0, 0, 0, 1 };
+    loadMatrix(identity);
+}
+
+void batchLoadMatrixf(const GLfloat *m)
+{
+    loadMatrix(m);
+}
+
+void batchLoadMatrixd(const GLdouble *m)
+{
+    GLfloat mf[16];
+    for (int i = 0; i < 16; i++) {
+        mf[i] = GLfloat(m[i]);
+    }
+    loadMatrix(mf);
+}
+
+void batchMultMatrixf(const GLfloat *m)
+{
+    multMatrix(m);
+}
+
+void batchMultMatrixd(const GLdouble *m)
+{
+    GLfloat mf[16];
+    for (int i = 0; i < 16; i++) {
+        mf[i] = GLfloat(m[i]);
+    }
+    multMatrix(mf);
+}
+
+void batchTranslated(GLdouble x, GLdouble y, GLdouble z)
+{
+    GLfloat m[16] = { 1, 0, 0, 0,  0, 1, 0, 0,  0, 0, 1, 0,  GLfloat(x), GLfloat(y), GLfloat(z), 1 };
+    multMatrix(m);
+}
+
+void batchScaled(GLdouble x, GLdouble y, GLdouble z)
+{
+    GLfloat m[16] = { GLfloat(x), 0, 0, 0,  0, GLfloat(y), 0, 0,  0, 0, GLfloat(z), 0,  0, 0, 0, 1 };
+    multMatrix(m);
+}
+
+void batchRotated(GLdouble degrees, GLdouble x, GLdouble y, GLdouble z)
+{
+    // Same matrix as the glRotate man page
+    double len = sqrt(x*x + y*y + z*z);
+    if (len == 0.) {
+        return;
+    }
+    x /= len;
+    y /= len;
+    z /= len;
+    double radians = degrees * M_PI / 180.;
+    double c = cos(radians);
+    double s = sin(radians);
+    double t = 1. - c;
+    GLfloat m[16] = {
+        GLfloat(x*x*t + c),   GLfloat(y*x*t + z*s), GLfloat(x*z*t - y*s), 0,
+        GLfloat(x*y*t - z*s), GLfloat(y*y*t + c),   GLfloat(y*z*t + x*s), 0,
+        GLfloat(x*z*t + y*s), GLfloat(y*z*t - x*s), GLfloat(z*z*t + c),   0,
+        0,                    0,                    0,                    1
+    };
+    multMatrix(m);
+}
+
+void batchOrtho(GLdouble left, GLdouble right, GLdouble bottom, GLdouble top, GLdouble zNear, GLdouble zFar)
+{
+    GLfloat m[16] = {
+        GLfloat(2. / (right - left)), 0, 0, 0,
+        0, GLfloat(2. / (top - bottom)), 0, 0,
+        0, 0, GLfloat(-2. / (zFar - zNear)), 0,
+        GLfloat(-(right + left) / (right - left)),
+        GLfloat(-(top + bottom) / (top - bottom)),
+        GLfloat(-(zFar + zNear) / (zFar - zNear)), 1
+    };
+    multMatrix(m);
+}
+
+void batchFrustum(GLdouble left, GLdouble right, GLdouble bottom, GLdouble top, GLdouble zNear, GLdouble zFar)
+{
+    GLfloat m[16] = {
+        GLfloat(2. * zNear / (right - left)), 0, 0, 0,
+        0, GLfloat(2. * zNear / (top - bottom)), 0, 0,
+        GLfloat((right + left) / (right - left)),
+        GLfloat((top + bottom) / (top - bottom)),
+        GLfloat(-(zFar + zNear) / (zFar - zNear)), -1,
+        0, 0, GLfloat(-2. * zFar * zNear / (zFar - zNear)), 0
+    };
+    multMatrix(m);
+}
+
+void batchPushMatrix()
+{
+    if (s_MatrixMode != GL_MODELVIEW) {
+        glPushMatrix();
+    }
+    else if (s_ModelViewDepth < BATCH_MATRIX_STACK) {
+        memcpy(s_ModelViewStack[s_ModelViewDepth++], s_ModelView, sizeof(s_ModelView));
+    }
+    // else overflow, which GL ignores too (with an error)
+}
+
+void batchPopMatrix()
+{
+    if (s_MatrixMode != GL_MODELVIEW) {
+        batchFlush();
+        glPopMatrix();
+    }
+    else if (s_ModelViewDepth > 0) {
+        memcpy(s_ModelView, s_ModelViewStack[--s_ModelViewDepth], sizeof(s_ModelView));
+    }
+}
+
+void batchEnable(GLenum cap)
+{
+    batchFlush();
+    glEnable(cap);
+}
+
+void batchDisable(GLenum cap)
+{
+    batchFlush();
+    glDisable(cap);
+}
+
+void batchClear(GLbitfield mask)
+{
+    batchFlush();
+    glClear(mask);
+}
+
+void batchBindTexture(GLenum target, GLuint texture)
+{
+    batchFlush();
+    glBindTexture(target, texture);
+}
+
+void batchBlendFunc(GLenum sfactor, GLenum dfactor)
+{
+    batchFlush();
+    glBlendFunc(sfactor, dfactor);
+}
+
+void batchDepthFunc(GLenum func)
+{
+    batchFlush();
+    glDepthFunc(func);
+}
+
+void batchShadeModel(GLenum mode)
+{
+    batchFlush();
+    glShadeModel(mode);
+}
+
+void batchLineWidth(GLfloat width)
+{
+    batchFlush();
+    glLineWidth(width);
+}
+
+void batchPointSize(GLfloat size)
+{
+    batchFlush();
+    glPointSize(size);
+}
+
+void batchViewport(GLint x, GLint y, GLsizei width, GLsizei height)
+{
+    batchFlush();
+    glViewport(x, y, width, height);
+}
+
+void batchSwapBuffers()
+{
+    batchFlush();
+    SDL_GL_SwapBuffers();
+}
+
+BatchStats batchTakeStats()
+{
+    BatchStats stats = s_Stats;
+    memset(&s_Stats, 0, sizeof(s_Stats));
+    return stats;
+}
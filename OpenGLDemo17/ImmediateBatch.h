@@ -0,0 +1,112 @@
+/*
+ * Immediate-mode batching layer.
+ *
+ * Captures glBegin/glColor/glVertex/glEnd calls into a CPU-side vertex
+ * stream and draws the whole stream with a single glDrawArrays when some
+ * state changes or at swap time.  Model/view matrix calls, including
+ * glPushMatrix and glPopMatrix, are applied to the vertices on the CPU, so
+ * squares drawn at different locations still end up in the same batch.
+ *
+ * Only position and color are captured.  glTexCoord, glNormal and
+ * glMaterial are not redirected and go straight to GL, where they don't
+ * reach the batched vertices, so textured or lit immediate-mode geometry
+ * has to be drawn with IMMEDIATE_BATCH_NO_MACROS.  The state calls below
+ * flush first; any other state change made between batched primitives
+ * needs a batchFlush() before it.
+ *
+ * Include this header after SDL.h and SDL_opengl.h.  Unless
+ * IMMEDIATE_BATCH_NO_MACROS is defined, the immediate-mode entry points are
+ * redirected to the batch versions, so old glBegin/glEnd code does not need
+ * to be rewritten.
+ */
+#ifndef IMMEDIATE_BATCH_H
+#define IMMEDIATE_BATCH_H
+
+// Maximum number of (triangulated) vertices held before a forced flush
+#define BATCH_MAX_VERTICES 65536
+
+typedef struct {
+    int beginCount;     // glBegin/glEnd pairs captured
+    int drawCount;      // glDrawArrays calls actually issued
+    int vertexCount;    // vertices sent to GL
+} BatchStats;
+
+void batchBegin(GLenum mode);
+void batchEnd();
+
+void batchColor3ub(GLubyte red, GLubyte green, GLubyte blue);
+void batchColor4ub(GLubyte red, GLubyte green, GLubyte blue, GLubyte alpha);
+void batchColor3f(GLfloat red, GLfloat green, GLfloat blue);
+void batchVertex2f(GLfloat x, GLfloat y);
+void batchVertex3f(GLfloat x, GLfloat y, GLfloat z);
+
+void batchMatrixMode(GLenum mode);
+void batchLoadIdentity();
+void batchLoadMatrixd(const GLdouble *m);
+void batchLoadMatrixf(const GLfloat *m);
+void batchMultMatrixd(const GLdouble *m);
+void batchMultMatrixf(const GLfloat *m);
+void batchTranslated(GLdouble x, GLdouble y, GLdouble z);
+void batchScaled(GLdouble x, GLdouble y, GLdouble z);
+void batchRotated(GLdouble degrees, GLdouble x, GLdouble y, GLdouble z);
+void batchOrtho(GLdouble left, GLdouble right, GLdouble bottom, GLdouble top, GLdouble zNear, GLdouble zFar);
+void batchFrustum(GLdouble left, GLdouble right, GLdouble bottom, GLdouble top, GLdouble zNear, GLdouble zFar);
+void batchPushMatrix();
+void batchPopMatrix();
+
+// State that changes how the batch would be drawn.  These flush first.
+void batchEnable(GLenum cap);
+void batchDisable(GLenum cap);
+void batchClear(GLbitfield mask);
+void batchBindTexture(GLenum target, GLuint texture);
+void batchBlendFunc(GLenum sfactor, GLenum dfactor);
+void batchDepthFunc(GLenum func);
+void batchShadeModel(GLenum mode);
+void batchLineWidth(GLfloat width);
+void batchPointSize(GLfloat size);
+void batchViewport(GLint x, GLint y, GLsizei width, GLsizei height);
+
+// Draw everything captured so far
+void batchFlush();
+
+// Flush, then swap
+void batchSwapBuffers();
+
+// Returns counters since the last call, and resets them
+BatchStats batchTakeStats();
+
+#ifndef IMMEDIATE_BATCH_NO_MACROS
+#define glBegin             batchBegin
+#define glEnd               batchEnd
+#define glColor3ub          batchColor3ub
+#define glColor4ub          batchColor4ub
+#define glColor3f           batchColor3f
+#define glVertex2f          batchVertex2f
+#define glVertex3f          batchVertex3f
+#define glMatrixMode        batchMatrixMode
+#define glLoadIdentity      batchLoadIdentity
+#define glLoadMatrixd       batchLoadMatrixd
+#define glLoadMatrixf       batchLoadMatrixf
+#define glMultMatrixd       batchMultMatrixd
+#define glMultMatrixf       batchMultMatrixf
+#define glTranslated        batchTranslated
+#define glScaled            batchScaled
+#define glRotated           batchRotated
+#define glOrtho             batchOrtho
+#define glFrustum           batchFrustum
+#define glPushMatrix        batchPushMatrix
+#define glPopMatrix         batchPopMatrix
+#define glEnable            batchEnable
+#define glDisable           batchDisable
+#define glClear             batchClear
+#define glBindTexture       batchBindTexture
+#define glBlendFunc         batchBlendFunc
+#define glDepthFunc         batchDepthFunc
+#define glShadeModel        batchShadeModel
+#define glLineWidth         batchLineWidth
+#define glPointSize         batchPointSize
+#define glViewport          batchViewport
+#define SDL_GL_SwapBuffers  batchSwapBuffers
+#endif
+
+#endif
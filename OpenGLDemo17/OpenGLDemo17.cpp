@@ -0,0 +1,123 @@
+/*
+ * Demo 17:
+ * Batching glBegin/glEnd code without rewriting it.
+ *
+ * drawSquare and drawSquareAt are the same immediate-mode code as Demo 3,
+ * but ImmediateBatch.h redirects glBegin/glVertex/glEnd into a CPU-side
+ * vertex stream, and the whole grid of squares goes to GL in one
+ * glDrawArrays call.
+ *
+ * See README.txt for prerequisites.
+ */
+#include "SDL.h"
+#include "SDL_opengl.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <assert.h>
+
+// Exercise:  Set this to 0 and compare the frame times and draw counts.
+#define USE_IMMEDIATE_BATCH 1
+
+#if USE_IMMEDIATE_BATCH
+#include "ImmediateBatch.h"
+#endif
+
+#undef main     // This un-does SDL's #define main
+
+// Lots of small shapes is where immediate mode hurts the most
+#define GRID_SIZE 40
+#define FRAME_COUNT 400
+
+bool initializeSdl()
+{
+    if (SDL_Init(SDL_INIT_VIDEO) != 0) {
+        printf("Unable to initialize SDL: %s\n", SDL_GetError());
+        return false;
+    }
+
+    SDL_GL_SetAttribute(SDL_GL_DOUBLEBUFFER, 1);
+
+    // No vsync, so the frame time shows the cost of drawing
+    SDL_GL_SetAttribute(SDL_GL_SWAP_CONTROL, 0);
+
+    SDL_Surface *screen = SDL_SetVideoMode(640, 480, 16, SDL_OPENGL);
+    if (!screen) {
+        printf("Unable to set video mode: %s\n", SDL_GetError());
+        return false;
+    }
+    return true;
+}
+
+void drawSquare()
+{
+    typedef struct {
+        GLfloat x, y;
+        GLubyte red, green, blue;
+    } VertexInfo;
+
+    static const VertexInfo squareVertices[] = {
+        {-.5f,  .5f, 255, 0,   0},
+        { .5f,  .5f, 0,   255, 0},
+        { .5f, -.5f, 0,   0,   255},
+        { .5f, -.5f, 0,   0,   255},
+        {-.5f, -.5f, 255, 255, 255},
+        {-.5f,  .5f, 255, 0,   0}
+    };
+
+    glBegin(GL_TRIANGLES);
+    for (int i = 0; i < 6; i++) {
+        glColor3ub(squareVertices[i].red, squareVertices[i].green, squareVertices[i].blue);
+        glVertex2f(squareVertices[i].x, squareVertices[i].y);
+    }
+    glEnd();
+}
+
+void drawSquareAt(double x, double y, double z, double scale)
+{
+    GLdouble modelViewMatrix[] = {
+        scale, 0.0,   0.0, 0.0,
+        0.0,   scale, 0.0, 0.0,
+        0.0,   0.0,   1.0, 0.0,
+        x,     y,     z,   1.0
+    };
+    glMatrixMode(GL_MODELVIEW);
+    glLoadMatrixd(modelViewMatrix);
+    drawSquare();
+}
+
+int main(int argc, char *argv[])
+{
+    if (initializeSdl()) {
+        glEnable(GL_DEPTH_TEST);
+
+        glMatrixMode(GL_PROJECTION);
+        GLdouble ratio = 640.0f / 480.0f;
+        glOrtho(-ratio, ratio, -1, 1, -1, 1);
+
+        double step = 2.0 / GRID_SIZE;
+        Uint32 start = SDL_GetTicks();
+        for (int frame = 0; frame < FRAME_COUNT; frame++) {
+            glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+            for (int row = 0; row < GRID_SIZE; row++) {
+                for (int col = 0; col < GRID_SIZE; col++) {
+                    // Alternate the depth, so the depth test has some work to do
+                    double z = ((row + col + frame / 20) & 1) ? 0.5 : 0.;
+                    drawSquareAt(-1. + step * (col + .5), -1. + step * (row + .5), z, step * .8);
+                }
+            }
+            SDL_GL_SwapBuffers();
+        }
+        Uint32 elapsed = SDL_GetTicks() - start;
+
+        printf("%d frames, %d squares per frame: %.2f ms per frame\n",
+            FRAME_COUNT, GRID_SIZE * GRID_SIZE, double(elapsed) / FRAME_COUNT);
+#if USE_IMMEDIATE_BATCH
+        BatchStats stats = batchTakeStats();
+        printf("glBegin/glEnd pairs: %d, draw calls: %d (%.1f per frame)\n",
+            stats.beginCount, stats.drawCount, double(stats.drawCount) / FRAME_COUNT);
+#endif
+        SDL_Quit();
+    }
+    return 0;
+}
@@ -0,0 +1,178 @@
+/*
+ * CPU matrix stack.  See MatrixStack.h.
+ */
+#include "MatrixStack.h"
+
+#define _USE_MATH_DEFINES
+#include <math.h>
+
+#define SPLAT(v, i) _mm_shuffle_ps((v), (v), _MM_SHUFFLE(i, i, i, i))
+
+static void setColumns(Matrix4 *pMatrix, const float *m)
+{
+    for (int i = 0; i < 4; i++) {
+        pMatrix->col[i] = _mm_loadu_ps(m + 4*i);
+    }
+}
+
+static Matrix4* topOf(MatrixStack *pStack)
+{
+    return &pStack->matrices[pStack->top];
+}
+
+void matrixMultiply(Matrix4 *pResult, const Matrix4 *pA, const Matrix4 *pB)
+{
+    // Each column of the result is a linear combination of the columns of A,
+    // weighted by the elements of the matching column of B.
+    __m128 a0 = pA->col[0], a1 = pA->col[1], a2 = pA->col[2], a3 = pA->col[3];
+    for (int i = 0; i < 4; i++) {
+        __m128 b = pB->col[i];
+        __m128 sum = _mm_mul_ps(a0, SPLAT(b, 0));
+        sum = _mm_add_ps(sum, _mm_mul_ps(a1, SPLAT(b, 1)));
+        sum = _mm_add_ps(sum, _mm_mul_ps(a2, SPLAT(b, 2)));
+        sum = _mm_add_ps(sum, _mm_mul_ps(a3, SPLAT(b, 3)));
+        pResult->col[i] = sum;
+    }
+}
+
+void matrixStackInit(MatrixStack *pStack)
+{
+    pStack->top = 0;
+    matrixLoadIdentity(pStack);
+}
+
+bool matrixPush(MatrixStack *pStack)
+{
+    if (pStack->top + 1 >= MATRIX_STACK_DEPTH) {
+        return false;
+    }
+    pStack->matrices[pStack->top + 1] = pStack->matrices[pStack->top];
+    pStack->top++;
+    return true;
+}
+
+bool matrixPop(MatrixStack *pStack)
+{
+    if (pStack->top == 0) {
+        return false;
+    }
+    pStack->top--;
+    return true;
+}
+
+void matrixLoadIdentity(MatrixStack *pStack)
+{
+    Matrix4 *pTop = topOf(pStack);
+    pTop->col[0] = _mm_setr_ps(1.f, 0.f, 0.f, 0.f);
+    pTop->col[1] = _mm_setr_ps(0.f, 1.f, 0.f, 0.f);
+    pTop->col[2] = _mm_setr_ps(0.f, 0.f, 1.f, 0.f);
+    pTop->col[3] = _mm_setr_ps(0.f, 0.f, 0.f, 1.f);
+}
+
+void matrixLoad(MatrixStack *pStack, const float *m)
+{
+    setColumns(topOf(pStack), m);
+}
+
+void matrixMult(MatrixStack *pStack, const Matrix4 *pMatrix)
+{
+    matrixMultiply(topOf(pStack), topOf(pStack), pMatrix);
+}
+
+void matrixTranslate(MatrixStack *pStack, float x, float y, float z)
+{
+    // Only the last column changes, so skip the full multiply
+    Matrix4 *pTop = topOf(pStack);
+    __m128 sum = _mm_mul_ps(pTop->col[0], _mm_set1_ps(x));
+    sum = _mm_add_ps(sum, _mm_mul_ps(pTop->col[1], _mm_set1_ps(y)));
+    sum = _mm_add_ps(sum, _mm_mul_ps(pTop->col[2], _mm_set1_ps(z)));
+    pTop->col[3] = _mm_add_ps(sum, pTop->col[3]);
+}
+
+void matrixScale(MatrixStack *pStack, float x, float y, float z)
+{
+    Matrix4 *pTop = topOf(pStack);
+    pTop->col[0] = _mm_mul_ps(pTop->col[0], _mm_set1_ps(x));
+    pTop->col[1] = _mm_mul_ps(pTop->col[1], _mm_set1_ps(y));
+    pTop->col[2] = _mm_mul_ps(pTop->col[2], _mm_set1_ps(z));
+}
+
+void matrixRotate(MatrixStack *pStack, float degrees, float x, float y, float z)
+{
+    float len = sqrtf(x*x + y*y + z*z);
+    if (len == 0.f) {
+        return;
+    }
+    x /= len;
+    y /= len;
+    z /= len;
+
+    // Same matrix as the glRotate man page
+    float radians = degrees * float(M_PI) / 180.f;
+    float c = cosf(radians);
+    float s = sinf(radians);
+    float t = 1.f - c;
+    Matrix4 rotation;
+    rotation.col[0] = _mm_setr_ps(x*x*t + c,   y*x*t + z*s, x*z*t - y*s, 0.f);
+    rotation.col[1] = _mm_setr_ps(x*y*t - z*s, y*y*t + c,   y*z*t + x*s, 0.f);
+    rotation.col[2] = _mm_setr_ps(x*z*t + y*s, y*z*t - x*s, z*z*t + c,   0.f);
+    rotation.col[3] = _mm_setr_ps(0.f, 0.f, 0.f, 1.f);
+    matrixMult(pStack, &rotation);
+}
+
+void matrixFrustum(MatrixStack *pStack, float left, float right, float bottom, float top, float zNear, float zFar)
+{
+    Matrix4 frustum;
+    frustum.col[0] = _mm_setr_ps(2.f * zNear / (right - left), 0.f, 0.f, 0.f);
+    frustum.col[1] = _mm_setr_ps(0.f, 2.f * zNear / (top - bottom), 0.f, 0.f);
+    frustum.col[2] = _mm_setr_ps(
+        (right + left) / (right - left),
+        (top + bottom) / (top - bottom),
+        -(zFar + zNear) / (zFar - zNear),
+        -1.f);
+    frustum.col[3] = _mm_setr_ps(0.f, 0.f, -2.f * zFar * zNear / (zFar - zNear), 0.f);
+    matrixMult(pStack, &frustum);
+}
+
+void matrixOrtho(MatrixStack *pStack, float left, float right, float bottom, float top, float zNear, float zFar)
+{
+    Matrix4 ortho;
+    ortho.col[0] = _mm_setr_ps(2.f / (right - left), 0.f, 0.f, 0.f);
+    ortho.col[1] = _mm_setr_ps(0.f, 2.f / (top - bottom), 0.f, 0.f);
+    ortho.col[2] = _mm_setr_ps(0.f, 0.f, -2.f / (zFar - zNear), 0.f);
+    ortho.col[3] = _mm_setr_ps(
+        -(right + left) / (right - left),
+        -(top + bottom) / (top - bottom),
+        -(zFar + zNear) / (zFar - zNear),
+        1.f);
+    matrixMult(pStack, &ortho);
+}
+
+void matrixLookAt(MatrixStack *pStack,
+    float eyeX, float eyeY, float eyeZ,
+    float centerX, float centerY, float centerZ,
+    float upX, float upY, float upZ)
+{
+    // Same as gluLookAt:  f is the view direction, s points right, u points up
+    float fx = centerX - eyeX, fy = centerY - eyeY, fz = centerZ - eyeZ;
+    float len = sqrtf(fx*fx + fy*fy + fz*fz);
+    fx /= len; fy /= len; fz /= len;
+
+    float sx = fy * upZ - fz * upY;
+    float sy = fz * upX - fx * upZ;
+    float sz = fx * upY - fy * upX;
+    len = sqrtf(sx*sx + sy*sy + sz*sz);
+    sx /= len; sy /= len; sz /= len;
+
+    float ux = sy * fz - sz * fy;
+    float uy = sz * fx - sx * fz;
+    float uz = sx * fy - sy * fx;
+
+    Matrix4 view;
+    view.col[0] = _mm_setr_ps(sx, ux, -fx, 0.f);
+    view.col[1] = _mm_setr_ps(sy, uy, -fy, 0.f);
+    view.col[2] = _mm_setr_ps(sz, uz, -fz, 0.f);
+    view.col[3] = _mm_setr_ps(0.f, 0.f, 0.f, 1.f);
+    matrixMult(pStack, &view);
+    matrixTranslate(pStack, -eyeX, -eyeY, -eyeZ);
+}
@@ -0,0 +1,56 @@
+/*
+ * CPU matrix stack.
+ *
+ * Mirrors the fixed-function matrix calls (glPushMatrix, glTranslatef,
+ * glRotatef, glFrustum, gluLookAt, ...), but does the math on the CPU in
+ * single precision with SSE.  The result goes to GL with one glLoadMatrixf,
+ * or one glUniformMatrix4fv when using shaders.
+ *
+ * Matrices are column-major, the same as GL.
+ */
+#ifndef MATRIX_STACK_H
+#define MATRIX_STACK_H
+
+#include <xmmintrin.h>
+
+#define MATRIX_STACK_DEPTH 32
+
+typedef struct {
+    __m128 col[4];
+} Matrix4;
+
+typedef struct {
+    Matrix4 matrices[MATRIX_STACK_DEPTH];
+    int top;
+} MatrixStack;
+
+void matrixStackInit(MatrixStack *pStack);
+
+// Same as glPushMatrix / glPopMatrix.  Both return false on overflow or
+// underflow and leave the stack alone.
+bool matrixPush(MatrixStack *pStack);
+bool matrixPop(MatrixStack *pStack);
+
+void matrixLoadIdentity(MatrixStack *pStack);
+void matrixLoad(MatrixStack *pStack, const float *m);
+void matrixMult(MatrixStack *pStack, const Matrix4 *pMatrix);
+void matrixTranslate(MatrixStack *pStack, float x, float y, float z);
+void matrixRotate(MatrixStack *pStack, float degrees, float x, float y, float z);
+void matrixScale(MatrixStack *pStack, float x, float y, float z);
+void matrixFrustum(MatrixStack *pStack, float left, float right, float bottom, float top, float zNear, float zFar);
+void matrixOrtho(MatrixStack *pStack, float left, float right, float bottom, float top, float zNear, float zFar);
+void matrixLookAt(MatrixStack *pStack,
+    float eyeX, float eyeY, float eyeZ,
+    float centerX, float centerY, float centerZ,
+    float upX, float upY, float upZ);
+
+// The current matrix, suitable for glLoadMatrixf or glUniformMatrix4fv
+inline const float* matrixTop(const MatrixStack *pStack)
+{
+    return (const float *)&pStack->matrices[pStack->top];
+}
+
+// *pResult = (*pA) * (*pB).  pResult may be the same as pA or pB.
+void matrixMultiply(Matrix4 *pResult, const Matrix4 *pA, const Matrix4 *pB);
+
+#endif
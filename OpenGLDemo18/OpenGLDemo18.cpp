@@ -0,0 +1,181 @@
+/*
+ * Demo 18:
+ * Replaced glLoadIdentity/glTranslated/glRotated/glScaled with a CPU
+ * matrix stack.
+ *
+ * See README.txt for prerequisites.
+ */
+#include <windows.h>
+#include <WinGDI.h>
+
+#include <GL/glew.h>
+#include <GL/wglew.h>
+#include <GL/GL.h>
+#include <GL/glut.h>
+
+#include <stdio.h>
+#include <stddef.h>
+
+#define _USE_MATH_DEFINES
+#include <math.h>
+
+#include "MatrixStack.h"
+
+// windows.h strikes again
+#undef near
+#undef far
+
+#define CENTER_Z        6.0f     // Distance from camera
+#define DEPTH_OF_FIELD  5.0f
+
+typedef struct {
+  GLfloat x, y, z;
+  GLubyte red, green, blue;
+} VertexInfo;
+
+typedef struct {
+    GLsizei count;
+    GLuint vboId;
+} ShapeInfo;
+
+// Each of the fixed-function matrix calls in Demo 12 is a trip into the
+// driver, which then does the math in whatever precision it likes.  Keeping
+// our own stack means one glLoadMatrixf per draw.  For the shader demos, the
+// same matrix (multiplied by the projection) would go to the
+// ModelViewProject uniform instead.
+MatrixStack g_ModelView;
+
+void setupPyramid(ShapeInfo *pInfo)
+{
+    GLuint vboId(0);
+
+    static const VertexInfo pyramidData[] = {
+        // Bottom
+        { 0.0f, 0.f, .5f, 255, 0, 0},
+        { 0.433f, 0.f, -.25f, 255, 0, 0},
+        { -0.433f, 0.f, -.25f, 255, 0, 0},
+        // Side 1
+        { -0.433f, 0.f, -.25f, 0, 0, 255},
+        { 0.433f, 0.f, -.25f, 0, 0, 255},
+        { 0.0f, 0.75f, 0.f, 0, 0, 255},
+        // Side 2
+        { -0.433f, 0.f, -.25f, 255, 255, 0},
+        { 0.0f, 0.f, .5f, 255, 255, 0},
+        { 0.0f, 0.75f, 0.f, 255, 255, 0},
+        // Side 3
+        { 0.0f, 0.f, .5f, 0, 255, 0},
+        { 0.433f, 0.f, -.25f, 0, 255, 0},
+        { 0.0f, 0.75f, 0.f, 0, 255, 0},
+    };
+
+    glGenBuffers(1, &vboId);
+    glBindBuffer(GL_ARRAY_BUFFER, vboId);
+    glBufferData(GL_ARRAY_BUFFER, sizeof(pyramidData), pyramidData, GL_STATIC_DRAW);
+
+    pInfo->count = 12;
+    pInfo->vboId = vboId;
+}
+
+void setupFins(ShapeInfo *pInfo)
+{
+  GLuint vboId(0);
+
+  static const VertexInfo finData[] = {
+    // Triangle 1
+    { -.5f, -.5f, 0.f, 255, 0, 0 },
+    { .5f, -.5f, 0.f, 255, 0, 0 },
+    { 0.f, .5f, 0.f, 255, 0, 0 },
+    // Triangle 2
+    { 0.f, -.5f, -.5f, 0, 255, 0 },
+    { 0.f, -.5f, .5f, 0, 255, 0 },
+    { 0.f, .5f, 0.f, 0, 255, 0 },
+  };
+
+  glGenBuffers(1, &vboId);
+  glBindBuffer(GL_ARRAY_BUFFER, vboId);
+  glBufferData(GL_ARRAY_BUFFER, sizeof(finData), finData, GL_STATIC_DRAW);
+
+  pInfo->count = 6;
+  pInfo->vboId = vboId;
+}
+
+void drawTrianglesAt(float x, float y, float z, float rotyDegrees, float scale, ShapeInfo *pInfo)
+{
+    // Same transformations as Demo 12, on our own stack.  The push/pop
+    // leaves the camera (if we had one) on the stack for the next object.
+    matrixPush(&g_ModelView);
+    matrixTranslate(&g_ModelView, x, y, z - CENTER_Z);
+    matrixRotate(&g_ModelView, rotyDegrees, 0.f, 1.f, 0.f);
+    matrixScale(&g_ModelView, scale, scale, scale);
+
+    // glMatrixMode(GL_MODELVIEW) was set once in main
+    glLoadMatrixf(matrixTop(&g_ModelView));
+    matrixPop(&g_ModelView);
+
+    glBindBuffer(GL_ARRAY_BUFFER, pInfo->vboId);
+    glVertexPointer(3, GL_FLOAT, sizeof(VertexInfo), (GLvoid*)offsetof(VertexInfo, x));
+    glColorPointer(3, GL_UNSIGNED_BYTE, sizeof(VertexInfo), (GLvoid*)offsetof(VertexInfo, red));
+
+    glDrawArrays(GL_TRIANGLES, 0, pInfo->count);
+}
+
+ShapeInfo g_Pyramid;
+ShapeInfo g_Fins;
+
+void onDisplay()
+{
+    static int i = 0;
+    if (i < 400) {
+        i++;
+    }
+    float z = -i/200.f;
+    float angle = i/30.f;
+    float angle2 = angle + 2 * float(M_PI) / 3.f;
+    float angle3 = angle + 4 * float(M_PI) / 3.f;
+    glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+    drawTrianglesAt(cosf(angle), sinf(angle), z, i*3.f, 2.f, &g_Pyramid);
+    drawTrianglesAt(cosf(angle2), sinf(angle2), z, i*1.f, 1.5f, &g_Fins);
+    drawTrianglesAt(cosf(angle3), sinf(angle3), z, i*10.f, 1.2f, &g_Pyramid);
+    glutSwapBuffers();
+}
+
+void onKey(unsigned char key, int x, int y)
+{
+    exit(0);
+}
+
+int main(int argc, char *argv[])
+{
+    glutInit(&argc, argv);
+    glutInitDisplayMode(GLUT_RGBA | GLUT_DOUBLE | GLUT_DEPTH);
+    glutInitWindowSize(640, 480);
+    glutCreateWindow(argv[0]);
+
+    glewInit();
+    wglSwapIntervalEXT(1);
+
+    glEnable(GL_DEPTH_TEST);
+    glEnableClientState(GL_VERTEX_ARRAY);
+    glEnableClientState(GL_COLOR_ARRAY);
+
+    // The projection matrix is built on the CPU too, and loaded once
+    MatrixStack projection;
+    matrixStackInit(&projection);
+    float ratio = 640.0f / 480.0f;
+    matrixFrustum(&projection, -ratio, ratio, -1.f, 1.f, CENTER_Z - DEPTH_OF_FIELD/2, CENTER_Z + DEPTH_OF_FIELD/2);
+    glMatrixMode(GL_PROJECTION);
+    glLoadMatrixf(matrixTop(&projection));
+
+    // From here on, every glLoadMatrixf goes to the model/view matrix
+    glMatrixMode(GL_MODELVIEW);
+    matrixStackInit(&g_ModelView);
+
+    setupPyramid(&g_Pyramid);
+    setupFins(&g_Fins);
+    glutDisplayFunc(onDisplay);
+    glutIdleFunc(onDisplay);
+    glutKeyboardFunc(onKey);
+    glutMainLoop();
+
+    return 0;
+}
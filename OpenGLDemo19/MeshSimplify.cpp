@@ -0,0 +1,282 @@
+/*
+ * Mesh simplification with quadric error metrics.  See MeshSimplify.h.
+ */
+#include "MeshSimplify.h"
+
+#include <math.h>
+#include <queue>
+#include <functional>
+
+typedef struct {
+    double x, y, z;
+} Vec3;
+
+// Symmetric 4x4 matrix:  a2 ab ac ad / b2 bc bd / c2 cd / d2
+typedef struct {
+    double q[10];
+} Quadric;
+
+typedef struct {
+    unsigned int v[3];
+    bool removed;
+} Triangle;
+
+// One possible edge collapse.  The versions let us recognize entries that
+// went stale when one of the vertices was moved by an earlier collapse.
+struct Candidate {
+    double cost;
+    unsigned int v0, v1;
+    unsigned int version0, version1;
+    Vec3 target;
+
+    bool operator>(const Candidate &other) const { return cost > other.cost; }
+};
+
+typedef std::priority_queue<Candidate, std::vector<Candidate>, std::greater<Candidate> > CandidateQueue;
+
+static Vec3 sub(const Vec3 &a, const Vec3 &b)
+{
+    Vec3 r = { a.x - b.x, a.y - b.y, a.z - b.z };
+    return r;
+}
+
+static Vec3 cross(const Vec3 &a, const Vec3 &b)
+{
+    Vec3 r = { a.y * b.z - a.z * b.y, a.z * b.x - a.x * b.z, a.x * b.y - a.y * b.x };
+    return r;
+}
+
+static double dot(const Vec3 &a, const Vec3 &b)
+{
+    return a.x * b.x + a.y * b.y + a.z * b.z;
+}
+
+static void addPlane(Quadric *pQ, double a, double b, double c, double d)
+{
+    double *q = pQ->q;
+    q[0] += a*a; q[1] += a*b; q[2] += a*c; q[3] += a*d;
+    q[4] += b*b; q[5] += b*c; q[6] += b*d;
+    q[7] += c*c; q[8] += c*d;
+    q[9] += d*d;
+}
+
+static double quadricError(const Quadric &Q, const Vec3 &v)
+{
+    const double *q = Q.q;
+    return q[0]*v.x*v.x + 2*q[1]*v.x*v.y + 2*q[2]*v.x*v.z + 2*q[3]*v.x
+         + q[4]*v.y*v.y + 2*q[5]*v.y*v.z + 2*q[6]*v.y
+         + q[7]*v.z*v.z + 2*q[8]*v.z
+         + q[9];
+}
+
+// Pick the position for the merged vertex:  the minimum of the combined
+// quadric if it is well defined, otherwise the best of the endpoints and
+// the midpoint.
+static Candidate makeCandidate(const std::vector<Vec3> &positions, const std::vector<Quadric> &quadrics,
+    const std::vector<unsigned int> &versions, unsigned int v0, unsigned int v1)
+{
+    Quadric Q;
+    for (int i = 0; i < 10; i++) {
+        Q.q[i] = quadrics[v0].q[i] + quadrics[v1].q[i];
+    }
+    const double *q = Q.q;
+
+    Candidate c;
+    c.v0 = v0;
+    c.v1 = v1;
+    c.version0 = versions[v0];
+    c.version1 = versions[v1];
+
+    double det = q[0] * (q[4]*q[7] - q[5]*q[5])
+               - q[1] * (q[1]*q[7] - q[5]*q[2])
+               + q[2] * (q[1]*q[5] - q[4]*q[2]);
+    if (fabs(det) > 1e-12) {
+        // Cramer's rule on the upper 3x3 block
+        double bx = -q[3], by = -q[6], bz = -q[8];
+        c.target.x = (bx * (q[4]*q[7] - q[5]*q[5]) - q[1] * (by*q[7] - q[5]*bz) + q[2] * (by*q[5] - q[4]*bz)) / det;
+        c.target.y = (q[0] * (by*q[7] - bz*q[5]) - bx * (q[1]*q[7] - q[5]*q[2]) + q[2] * (q[1]*bz - by*q[2])) / det;
+        c.target.z = (q[0] * (q[4]*bz - q[5]*by) - q[1] * (q[1]*bz - by*q[2]) + bx * (q[1]*q[5] - q[4]*q[2])) / det;
+        c.cost = quadricError(Q, c.target);
+    }
+    else {
+        const Vec3 &p0 = positions[v0];
+        const Vec3 &p1 = positions[v1];
+        Vec3 mid = { (p0.x + p1.x) / 2, (p0.y + p1.y) / 2, (p0.z + p1.z) / 2 };
+        const Vec3 *choices[3] = { &p0, &p1, &mid };
+        c.cost = -1.;
+        for (int i = 0; i < 3; i++) {
+            double cost = quadricError(Q, *choices[i]);
+            if (c.cost < 0. || cost < c.cost) {
+                c.cost = cost;
+                c.target = *choices[i];
+            }
+        }
+    }
+    return c;
+}
+
+// Would moving 'moved' to 'target' flip any of the triangles around it?
+// Triangles that contain 'other' disappear in the collapse, so skip them.
+static bool collapseFlips(const std::vector<Vec3> &positions, const std::vector<Triangle> &triangles,
+    const std::vector<unsigned int> &vertexTriangles, unsigned int moved, unsigned int other, const Vec3 &target)
+{
+    for (size_t i = 0; i < vertexTriangles.size(); i++) {
+        const Triangle &t = triangles[vertexTriangles[i]];
+        if (t.removed || t.v[0] == other || t.v[1] == other || t.v[2] == other) {
+            continue;
+        }
+        Vec3 before[3], after[3];
+        for (int k = 0; k < 3; k++) {
+            before[k] = positions[t.v[k]];
+            after[k] = (t.v[k] == moved) ? target : before[k];
+        }
+        Vec3 n0 = cross(sub(before[1], before[0]), sub(before[2], before[0]));
+        Vec3 n1 = cross(sub(after[1], after[0]), sub(after[2], after[0]));
+        if (dot(n0, n1) <= 0.) {
+            return true;
+        }
+    }
+    return false;
+}
+
+size_t simplifyMesh(const SimplifyMesh &in, size_t targetTriangles, SimplifyMesh *pOut)
+{
+    size_t vertexCount = in.vertices.size();
+    size_t triangleCount = in.indices.size() / 3;
+
+    std::vector<Vec3> positions(vertexCount);
+    for (size_t i = 0; i < vertexCount; i++) {
+        positions[i].x = in.vertices[i].x;
+        positions[i].y = in.vertices[i].y;
+        positions[i].z = in.vertices[i].z;
+    }
+
+    std::vector<Triangle> triangles(triangleCount);
+    std::vector<std::vector<unsigned int> > vertexTriangles(vertexCount);
+    std::vector<Quadric> quadrics(vertexCount);
+    for (size_t i = 0; i < vertexCount; i++) {
+        for (int k = 0; k < 10; k++) {
+            quadrics[i].q[k] = 0.;
+        }
+    }
+
+    // Each vertex starts with the sum of the planes of its triangles
+    for (size_t i = 0; i < triangleCount; i++) {
+        Triangle &t = triangles[i];
+        t.removed = false;
+        for (int k = 0; k < 3; k++) {
+            t.v[k] = in.indices[3*i + k];
+            vertexTriangles[t.v[k]].push_back((unsigned int)i);
+        }
+        Vec3 n = cross(sub(positions[t.v[1]], positions[t.v[0]]), sub(positions[t.v[2]], positions[t.v[0]]));
+        double len = sqrt(dot(n, n));
+        if (len > 0.) {
+            n.x /= len; n.y /= len; n.z /= len;
+            double d = -dot(n, positions[t.v[0]]);
+            for (int k = 0; k < 3; k++) {
+                addPlane(&quadrics[t.v[k]], n.x, n.y, n.z, d);
+            }
+        }
+    }
+
+    std::vector<unsigned int> versions(vertexCount, 0);
+    std::vector<bool> merged(vertexCount, false);
+    std::vector<SimplifyVertex> attributes(in.vertices);
+
+    CandidateQueue queue;
+    for (size_t i = 0; i < triangleCount; i++) {
+        const Triangle &t = triangles[i];
+        for (int k = 0; k < 3; k++) {
+            unsigned int a = t.v[k], b = t.v[(k + 1) % 3];
+            if (a < b) {
+                queue.push(makeCandidate(positions, quadrics, versions, a, b));
+            }
+        }
+    }
+
+    size_t liveTriangles = triangleCount;
+    while (liveTriangles > targetTriangles && !queue.empty()) {
+        Candidate c = queue.top();
+        queue.pop();
+        if (merged[c.v0] || merged[c.v1] ||
+            c.version0 != versions[c.v0] || c.version1 != versions[c.v1]) {
+            continue;   // Stale
+        }
+        if (collapseFlips(positions, triangles, vertexTriangles[c.v0], c.v0, c.v1, c.target) ||
+            collapseFlips(positions, triangles, vertexTriangles[c.v1], c.v1, c.v0, c.target)) {
+            continue;
+        }
+
+        // Merge v1 into v0
+        unsigned int v0 = c.v0, v1 = c.v1;
+        positions[v0] = c.target;
+        for (int k = 0; k < 10; k++) {
+            quadrics[v0].q[k] += quadrics[v1].q[k];
+        }
+        merged[v1] = true;
+        versions[v0]++;
+        versions[v1]++;
+
+        std::vector<unsigned int> &list0 = vertexTriangles[v0];
+        const std::vector<unsigned int> &list1 = vertexTriangles[v1];
+        for (size_t i = 0; i < list1.size(); i++) {
+            Triangle &t = triangles[list1[i]];
+            if (t.removed) {
+                continue;
+            }
+            if (t.v[0] == v0 || t.v[1] == v0 || t.v[2] == v0) {
+                t.removed = true;
+                liveTriangles--;
+            }
+            else {
+                for (int k = 0; k < 3; k++) {
+                    if (t.v[k] == v1) {
+                        t.v[k] = v0;
+                    }
+                }
+                list0.push_back(list1[i]);
+            }
+        }
+        vertexTriangles[v1].clear();
+
+        // Drop dead triangles from v0's list, and queue up its new edges
+        size_t live = 0;
+        for (size_t i = 0; i < list0.size(); i++) {
+            const Triangle &t = triangles[list0[i]];
+            if (t.removed) {
+                continue;
+            }
+            list0[live++] = list0[i];
+            for (int k = 0; k < 3; k++) {
+                if (t.v[k] != v0) {
+                    queue.push(makeCandidate(positions, quadrics, versions, v0, t.v[k]));
+                }
+            }
+        }
+        list0.resize(live);
+    }
+
+    // Compact the surviving vertices and triangles into the output
+    std::vector<unsigned int> remap(vertexCount, ~0u);
+    pOut->vertices.clear();
+    pOut->indices.clear();
+    for (size_t i = 0; i < triangleCount; i++) {
+        const Triangle &t = triangles[i];
+        if (t.removed) {
+            continue;
+        }
+        for (int k = 0; k < 3; k++) {
+            unsigned int v = t.v[k];
+            if (remap[v] == ~0u) {
+                remap[v] = (unsigned int)pOut->vertices.size();
+                SimplifyVertex out = attributes[v];
+                out.x = float(positions[v].x);
+                out.y = float(positions[v].y);
+                out.z = float(positions[v].z);
+                pOut->vertices.push_back(out);
+            }
+            pOut->indices.push_back(remap[v]);
+        }
+    }
+    return liveTriangles;
+}
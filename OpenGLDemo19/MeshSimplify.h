@@ -0,0 +1,32 @@
+/*
+ * Mesh simplification with quadric error metrics
+ * (Garland and Heckbert, "Surface Simplification Using Quadric Error
+ * Metrics", SIGGRAPH 97).
+ *
+ * Repeatedly collapses the edge whose removal adds the least squared
+ * distance to the planes of the original surface, until the triangle count
+ * drops to the target.
+ */
+#ifndef MESH_SIMPLIFY_H
+#define MESH_SIMPLIFY_H
+
+#include <stddef.h>
+#include <vector>
+
+typedef struct {
+    float x, y, z;
+    unsigned char red, green, blue;
+} SimplifyVertex;
+
+typedef struct {
+    std::vector<SimplifyVertex> vertices;
+    std::vector<unsigned int> indices;      // Three per triangle
+} SimplifyMesh;
+
+// Simplify 'in' down to about 'targetTriangles' triangles.  The output only
+// contains vertices that are still referenced.  Returns the number of
+// triangles in the output, which can be more than the target if collapsing
+// any further would fold the surface over.
+size_t simplifyMesh(const SimplifyMesh &in, size_t targetTriangles, SimplifyMesh *pOut);
+
+#endif
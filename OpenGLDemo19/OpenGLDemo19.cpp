@@ -0,0 +1,384 @@
+/*
+ * Demo 19:
+ * Level of detail.  Builds a chain of simplified meshes at load time with
+ * quadric error metrics, and picks one per object from its size on screen.
+ *
+ * Press L to turn LOD selection on and off, any other key to exit.
+ *
+ * See README.txt for prerequisites.
+ */
+#include <windows.h>
+#include <WinGDI.h>
+
+#include <GL/glew.h>
+#include <GL/wglew.h>
+#include <GL/GL.h>
+#include <GL/glut.h>
+
+#include <stdio.h>
+#include <stddef.h>
+#include <map>
+
+#include <vmath.h>
+using vmath::mat4;
+
+#include "MeshSimplify.h"
+
+// Apparently someone is still using segmented memory qualifiers,
+// and windows.h is letting them.
+#undef near
+#undef far
+
+#define WINDOW_WIDTH    640
+#define WINDOW_HEIGHT   480
+
+#define NEAR_Z          1.0f
+#define FAR_Z           100.0f
+
+// 20 * 4^5 = 20480 triangles at full detail
+#define SPHERE_SUBDIVISIONS 5
+
+// Each level has a quarter of the triangles of the one before it
+#define LOD_COUNT       5
+
+// Switch to the next coarser level when the bounding sphere is smaller than
+// this many pixels (in radius).  HYSTERESIS keeps objects sitting right on a
+// threshold from popping back and forth every frame.
+const float LOD_THRESHOLDS[LOD_COUNT - 1] = { 80.f, 40.f, 20.f, 10.f };
+#define HYSTERESIS      0.15f
+
+#define OBJECT_ROWS     20
+#define OBJECT_COLUMNS  20
+#define OBJECT_COUNT    (OBJECT_ROWS * OBJECT_COLUMNS)
+#define FIELD_DEPTH     80.f
+
+typedef struct {
+    GLsizei count;      // Number of indices
+    GLuint vaoId;
+} LodInfo;
+
+typedef struct {
+    LodInfo lods[LOD_COUNT];
+    float radius;       // Bounding sphere, centered on the origin
+} ShapeInfo;
+
+typedef struct {
+    float x, y, z;
+    int lod;
+} ObjectInfo;
+
+ShapeInfo g_Sphere;
+ObjectInfo g_Objects[OBJECT_COUNT];
+GLint g_MatrixUniform;
+mat4 g_ProjectionMatrix(mat4::identity());
+bool g_UseLod = true;
+
+// Must match hard-coded vPosition location in vertShaderSource
+#define V_POSITION 0
+
+// Must match hard-coded location in vertShaderSource
+#define C_POSITION 1
+
+void setupShaders()
+{
+    GLchar infoLog[4096];
+    GLsizei length;
+
+    const GLchar *vertShaderSource[] = {
+        "#version 430 core\n"
+        "uniform mat4 ModelViewProject;\n"
+        "layout(location = 0) in vec4 vPosition;\n"
+        "layout(location = 1) in vec3 vColor;\n"
+        "out vec3 color;\n"
+        "void main() {\n"
+        "    gl_Position = ModelViewProject * vPosition;\n"
+        "    color = vColor;\n"
+        "}\n"
+    };
+    GLuint vertShader = glCreateShader(GL_VERTEX_SHADER);
+    glShaderSource(vertShader, 1, vertShaderSource, NULL);
+
+    const GLchar *fragShaderSource[] = {
+        "#version 430 core\n"
+        "in vec3 color;\n"
+        "out vec4 fColor;\n"
+        "void main() {\n"
+        "    fColor = vec4(color, 1);\n"
+        "}\n"
+    };
+    GLuint fragShader = glCreateShader(GL_FRAGMENT_SHADER);
+    glShaderSource(fragShader, 1, fragShaderSource, NULL);
+
+    GLuint program = glCreateProgram();
+    glAttachShader(program, vertShader);
+    glCompileShader(vertShader);
+    glGetShaderInfoLog(vertShader, 4096, &length, infoLog);
+
+    glAttachShader(program, fragShader);
+    glCompileShader(fragShader);
+    glGetShaderInfoLog(fragShader, 4096, &length, infoLog);
+
+    glLinkProgram(program);
+    glUseProgram(program);
+    g_MatrixUniform = glGetUniformLocation(program, "ModelViewProject");
+}
+
+// Push a vertex out onto the bumpy sphere, and color it by direction
+static SimplifyVertex makeSphereVertex(float x, float y, float z)
+{
+    float len = sqrtf(x*x + y*y + z*z);
+    x /= len;
+    y /= len;
+    z /= len;
+    float r = 1.f + .08f * sinf(7.f * x) * sinf(7.f * y) * sinf(7.f * z);
+    SimplifyVertex v = {
+        x * r, y * r, z * r,
+        GLubyte(127.f + 127.f * x), GLubyte(127.f + 127.f * y), GLubyte(127.f + 127.f * z)
+    };
+    return v;
+}
+
+// Subdivided icosahedron, so there is some detail to take away
+void buildSphere(int subdivisions, SimplifyMesh *pMesh)
+{
+    const float t = (1.f + sqrtf(5.f)) / 2.f;
+    const float corners[12][3] = {
+        { -1, t, 0 }, { 1, t, 0 }, { -1, -t, 0 }, { 1, -t, 0 },
+        { 0, -1, t }, { 0, 1, t }, { 0, -1, -t }, { 0, 1, -t },
+        { t, 0, -1 }, { t, 0, 1 }, { -t, 0, -1 }, { -t, 0, 1 },
+    };
+    static const unsigned int faces[20][3] = {
+        { 0, 11, 5 }, { 0, 5, 1 }, { 0, 1, 7 }, { 0, 7, 10 }, { 0, 10, 11 },
+        { 1, 5, 9 }, { 5, 11, 4 }, { 11, 10, 2 }, { 10, 7, 6 }, { 7, 1, 8 },
+        { 3, 9, 4 }, { 3, 4, 2 }, { 3, 2, 6 }, { 3, 6, 8 }, { 3, 8, 9 },
+        { 4, 9, 5 }, { 2, 4, 11 }, { 6, 2, 10 }, { 8, 6, 7 }, { 9, 8, 1 },
+    };
+
+    pMesh->vertices.clear();
+    pMesh->indices.clear();
+    for (int i = 0; i < 12; i++) {
+        pMesh->vertices.push_back(makeSphereVertex(corners[i][0], corners[i][1], corners[i][2]));
+    }
+    pMesh->indices.assign(&faces[0][0], &faces[0][0] + 60);
+
+    for (int level = 0; level < subdivisions; level++) {
+        // Neighboring triangles share their midpoints
+        std::map<unsigned long long, unsigned int> midpoints;
+        std::vector<unsigned int> indices;
+        for (size_t i = 0; i < pMesh->indices.size(); i += 3) {
+            unsigned int mid[3];
+            for (int k = 0; k < 3; k++) {
+                unsigned int a = pMesh->indices[i + k];
+                unsigned int b = pMesh->indices[i + (k + 1) % 3];
+                unsigned long long key = (a < b) ? ((unsigned long long)a << 32 | b) : ((unsigned long long)b << 32 | a);
+                std::map<unsigned long long, unsigned int>::iterator it = midpoints.find(key);
+                if (it != midpoints.end()) {
+                    mid[k] = it->second;
+                }
+                else {
+                    const SimplifyVertex &va = pMesh->vertices[a];
+                    const SimplifyVertex &vb = pMesh->vertices[b];
+                    mid[k] = (unsigned int)pMesh->vertices.size();
+                    pMesh->vertices.push_back(makeSphereVertex(va.x + vb.x, va.y + vb.y, va.z + vb.z));
+                    midpoints[key] = mid[k];
+                }
+            }
+            unsigned int v0 = pMesh->indices[i], v1 = pMesh->indices[i + 1], v2 = pMesh->indices[i + 2];
+            unsigned int split[12] = {
+                v0, mid[0], mid[2],
+                v1, mid[1], mid[0],
+                v2, mid[2], mid[1],
+                mid[0], mid[1], mid[2],
+            };
+            indices.insert(indices.end(), split, split + 12);
+        }
+        pMesh->indices.swap(indices);
+    }
+}
+
+void uploadLod(const SimplifyMesh &mesh, LodInfo *pLod)
+{
+    GLuint buffers[2];
+    glGenVertexArrays(1, &pLod->vaoId);
+    glBindVertexArray(pLod->vaoId);
+    glGenBuffers(2, buffers);
+
+    glBindBuffer(GL_ARRAY_BUFFER, buffers[0]);
+    glBufferData(GL_ARRAY_BUFFER, mesh.vertices.size() * sizeof(SimplifyVertex), &mesh.vertices[0], GL_STATIC_DRAW);
+    glVertexAttribPointer(V_POSITION, 3, GL_FLOAT, GL_FALSE, sizeof(SimplifyVertex), (GLvoid*)offsetof(SimplifyVertex, x));
+    glEnableVertexAttribArray(V_POSITION);
+    glVertexAttribPointer(C_POSITION, 3, GL_UNSIGNED_BYTE, GL_TRUE, sizeof(SimplifyVertex), (GLvoid*)offsetof(SimplifyVertex, red));
+    glEnableVertexAttribArray(C_POSITION);
+
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, buffers[1]);
+    glBufferData(GL_ELEMENT_ARRAY_BUFFER, mesh.indices.size() * sizeof(GLuint), &mesh.indices[0], GL_STATIC_DRAW);
+
+    pLod->count = (GLsizei)mesh.indices.size();
+    glBindVertexArray(0);
+}
+
+void setupLods(ShapeInfo *pInfo)
+{
+    SimplifyMesh mesh, simplified;
+    buildSphere(SPHERE_SUBDIVISIONS, &mesh);
+
+    pInfo->radius = 0.f;
+    for (size_t i = 0; i < mesh.vertices.size(); i++) {
+        const SimplifyVertex &v = mesh.vertices[i];
+        float len = sqrtf(v.x*v.x + v.y*v.y + v.z*v.z);
+        if (len > pInfo->radius) {
+            pInfo->radius = len;
+        }
+    }
+
+    // Simplify each level from the one before it.  Simplifying from the
+    // original every time gives slightly better results, but takes longer.
+    int start = glutGet(GLUT_ELAPSED_TIME);
+    for (int lod = 0; lod < LOD_COUNT; lod++) {
+        if (lod > 0) {
+            simplifyMesh(mesh, mesh.indices.size() / 3 / 4, &simplified);
+            mesh.vertices.swap(simplified.vertices);
+            mesh.indices.swap(simplified.indices);
+        }
+        printf("LOD %d: %u triangles, %u vertices\n", lod,
+            unsigned(mesh.indices.size() / 3), unsigned(mesh.vertices.size()));
+        uploadLod(mesh, &pInfo->lods[lod]);
+    }
+    printf("Built %d levels in %d ms\n", LOD_COUNT, glutGet(GLUT_ELAPSED_TIME) - start);
+}
+
+void setupObjects()
+{
+    for (int row = 0; row < OBJECT_ROWS; row++) {
+        for (int col = 0; col < OBJECT_COLUMNS; col++) {
+            ObjectInfo *pObject = &g_Objects[row * OBJECT_COLUMNS + col];
+            pObject->x = -6.f + 12.f * col / (OBJECT_COLUMNS - 1);
+            pObject->y = 2.f * sinf(float(row * 7 + col));
+            pObject->z = -FIELD_DEPTH * row / OBJECT_ROWS;
+            pObject->lod = 0;
+        }
+    }
+}
+
+void setupFrustum(float left, float right, float bottom, float top, float near, float far)
+{
+    g_ProjectionMatrix = vmath::frustum(left, right, bottom, top, near, far);
+}
+
+// Radius of the bounding sphere on screen, in pixels.  For a perspective
+// projection, that is the radius scaled by the projection's y factor,
+// divided by the distance, and converted from NDC (-1..1) to pixels.
+float projectedRadius(float radius, float viewZ)
+{
+    float distance = -viewZ;
+    if (distance <= NEAR_Z) {
+        return 1e9f;    // Close enough to fill the screen
+    }
+    return radius * g_ProjectionMatrix[1][1] / distance * (WINDOW_HEIGHT / 2.f);
+}
+
+int selectLod(int currentLod, float pixelRadius)
+{
+    // Coarsen only once we are comfortably below the threshold, and refine
+    // only once we are comfortably above it.
+    int lod = currentLod;
+    while (lod < LOD_COUNT - 1 && pixelRadius < LOD_THRESHOLDS[lod] * (1.f - HYSTERESIS)) {
+        lod++;
+    }
+    while (lod > 0 && pixelRadius > LOD_THRESHOLDS[lod - 1] * (1.f + HYSTERESIS)) {
+        lod--;
+    }
+    return lod;
+}
+
+// Returns the number of triangles drawn
+int drawObject(ObjectInfo *pObject, float z, float rotyDegrees, float scale, ShapeInfo *pInfo)
+{
+    int lod = 0;
+    if (g_UseLod) {
+        pObject->lod = selectLod(pObject->lod, projectedRadius(pInfo->radius * scale, z));
+        lod = pObject->lod;
+    }
+
+    mat4 modelViewMatrix(vmath::translate(pObject->x, pObject->y, z));
+    modelViewMatrix *= vmath::rotate(rotyDegrees, 0.f, 1.f, 0.f);
+    modelViewMatrix *= vmath::scale(scale, scale, scale);
+
+    const LodInfo *pLod = &pInfo->lods[lod];
+    glUniformMatrix4fv(g_MatrixUniform, 1, GL_FALSE, g_ProjectionMatrix * modelViewMatrix);
+    glBindVertexArray(pLod->vaoId);
+    glDrawElements(GL_TRIANGLES, pLod->count, GL_UNSIGNED_INT, 0);
+    return pLod->count / 3;
+}
+
+void onDisplay()
+{
+    static int i = 0;
+    static int frames = 0;
+    static double triangles = 0.;
+    static int lastReport = glutGet(GLUT_ELAPSED_TIME);
+    i++;
+
+    glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+
+    // The whole field drifts towards the camera, and wraps around at the back
+    float drift = fmodf(i / 20.f, FIELD_DEPTH);
+    for (int n = 0; n < OBJECT_COUNT; n++) {
+        ObjectInfo *pObject = &g_Objects[n];
+        float z = pObject->z + drift;
+        if (z > -NEAR_Z) {
+            z -= FIELD_DEPTH;
+        }
+        z -= 2.f;
+        triangles += drawObject(pObject, z, i * 3.f + n * 17.f, .6f, &g_Sphere);
+    }
+    glutSwapBuffers();
+
+    frames++;
+    int now = glutGet(GLUT_ELAPSED_TIME);
+    if (now - lastReport >= 2000) {
+        printf("LOD %s: %.0f triangles per frame, %.2f ms per frame\n",
+            g_UseLod ? "on " : "off", triangles / frames, double(now - lastReport) / frames);
+        frames = 0;
+        triangles = 0.;
+        lastReport = now;
+    }
+}
+
+void onKey(unsigned char key, int x, int y)
+{
+    if (key == 'l' || key == 'L') {
+        g_UseLod = !g_UseLod;
+        return;
+    }
+    exit(0);
+}
+
+int main(int argc, char *argv[])
+{
+    glutInit(&argc, argv);
+    glutInitDisplayMode(GLUT_RGBA | GLUT_DOUBLE | GLUT_DEPTH);
+    glutInitWindowSize(WINDOW_WIDTH, WINDOW_HEIGHT);
+    glutCreateWindow(argv[0]);
+
+    glewInit();
+
+    // No vsync, so the frame times mean something
+    wglSwapIntervalEXT(0);
+
+    glEnable(GL_DEPTH_TEST);
+    glEnable(GL_CULL_FACE);
+
+    GLfloat ratio = float(WINDOW_WIDTH) / WINDOW_HEIGHT;
+    setupFrustum(-ratio * NEAR_Z, ratio * NEAR_Z, -NEAR_Z, NEAR_Z, NEAR_Z, FAR_Z);
+
+    setupShaders();
+    setupLods(&g_Sphere);
+    setupObjects();
+    glutDisplayFunc(onDisplay);
+    glutIdleFunc(onDisplay);
+    glutKeyboardFunc(onKey);
+    glutMainLoop();
+
+    return 0;
+}
@@ -0,0 +1,340 @@
+/*
+ * Procedural mesh generators.  See MeshGen.h.
+ */
+#include "MeshGen.h"
+
+#include <math.h>
+#include <vector>
+#include <thread>
+
+#include <xmmintrin.h>
+
+#define PI_F        3.14159265f
+#define TWO_PI_F    6.28318531f
+
+// One row of positions, in SoA layout so the differences vectorize
+typedef struct {
+    std::vector<float> x, y, z;
+} PositionRow;
+
+// Derivatives, normals and tangents for one row
+typedef struct {
+    std::vector<float> dux, duy, duz;
+    std::vector<float> nx, ny, nz;
+    std::vector<float> tx, ty, tz;
+} FrameRow;
+
+static bool wrapsU(const MeshDesc *pDesc)
+{
+    return pDesc->shape == MESH_SPHERE || pDesc->shape == MESH_TORUS;
+}
+
+static bool wrapsV(const MeshDesc *pDesc)
+{
+    return pDesc->shape == MESH_TORUS;
+}
+
+// The first and last rows of the sphere are a single point each
+static bool hasPoles(const MeshDesc *pDesc)
+{
+    return pDesc->shape == MESH_SPHERE;
+}
+
+size_t meshVertexCount(const MeshDesc *pDesc)
+{
+    return size_t(pDesc->columns + 1) * size_t(pDesc->rows + 1);
+}
+
+size_t meshIndexCount(const MeshDesc *pDesc)
+{
+    return size_t(pDesc->columns) * size_t(pDesc->rows) * 6;
+}
+
+// Shapes are set up so that dP/du x dP/dv points out of the surface
+static void shapePosition(const MeshDesc *pDesc, float u, float v, float *pX, float *pY, float *pZ)
+{
+    switch (pDesc->shape) {
+    case MESH_GRID:
+        *pX = (u - .5f) * pDesc->size;
+        *pY = 0.f;
+        *pZ = (.5f - v) * pDesc->size;
+        break;
+    case MESH_SPHERE: {
+        float theta = PI_F * v;         // 0 at the top
+        float phi = TWO_PI_F * u;
+        *pX = pDesc->radius * sinf(theta) * cosf(phi);
+        *pY = pDesc->radius * cosf(theta);
+        *pZ = pDesc->radius * sinf(theta) * sinf(phi);
+        break;
+    }
+    case MESH_TORUS: {
+        float phi = TWO_PI_F * u;       // Around the y axis
+        float theta = TWO_PI_F * v;     // Around the tube
+        float ring = pDesc->radius + pDesc->tubeRadius * cosf(theta);
+        *pX = ring * cosf(phi);
+        *pY = -pDesc->tubeRadius * sinf(theta);
+        *pZ = ring * sinf(phi);
+        break;
+    }
+    case MESH_HEIGHTFIELD:
+        *pX = (u - .5f) * pDesc->size;
+        *pZ = (.5f - v) * pDesc->size;
+        *pY = pDesc->height * (
+            .5f * sinf(u * 3.f * TWO_PI_F) * cosf(v * 2.f * TWO_PI_F) +
+            .3f * sinf(u * 11.f + v * 17.f) +
+            .2f * cosf(u * 37.f - v * 29.f));
+        break;
+    }
+}
+
+static void fillRow(const MeshDesc *pDesc, int row, PositionRow *pRow)
+{
+    float v = float(row) / pDesc->rows;
+    for (int c = 0; c <= pDesc->columns; c++) {
+        shapePosition(pDesc, float(c) / pDesc->columns, v, &pRow->x[c], &pRow->y[c], &pRow->z[c]);
+    }
+}
+
+// Row 'delta' away from 'row', wrapping or clamping at the edges.  Row
+// 'rows' is the same as row 0 on a shape that wraps.
+static int neighborRow(const MeshDesc *pDesc, int row, int delta)
+{
+    int r = row + delta;
+    if (wrapsV(pDesc)) {
+        if (r < 0) {
+            r = pDesc->rows - 1;
+        }
+        else if (r > pDesc->rows) {
+            r = 1;
+        }
+    }
+    else if (r < 0 || r > pDesc->rows) {
+        r = row;
+    }
+    return r;
+}
+
+static void normalizeScalar(float *pX, float *pY, float *pZ)
+{
+    float len2 = *pX * *pX + *pY * *pY + *pZ * *pZ;
+    float inv = 1.f / sqrtf(len2 > 1e-30f ? len2 : 1e-30f);
+    *pX *= inv;
+    *pY *= inv;
+    *pZ *= inv;
+}
+
+static void normalizeSimd(__m128 *pX, __m128 *pY, __m128 *pZ)
+{
+    __m128 len2 = _mm_add_ps(_mm_add_ps(_mm_mul_ps(*pX, *pX), _mm_mul_ps(*pY, *pY)), _mm_mul_ps(*pZ, *pZ));
+    __m128 inv = _mm_div_ps(_mm_set1_ps(1.f), _mm_sqrt_ps(_mm_max_ps(len2, _mm_set1_ps(1e-30f))));
+    *pX = _mm_mul_ps(*pX, inv);
+    *pY = _mm_mul_ps(*pY, inv);
+    *pZ = _mm_mul_ps(*pZ, inv);
+}
+
+// Smooth normals and tangents from central differences.  'pAlong' supplies
+// the u derivative; it is normally the current row, but a pole has no
+// extent in u, so it borrows the next row in.
+static void computeFrames(const MeshDesc *pDesc, const PositionRow *pPrev, const PositionRow *pNext,
+    const PositionRow *pAlong, FrameRow *pOut)
+{
+    const int cols = pDesc->columns;
+    const float *ax = &pAlong->x[0], *ay = &pAlong->y[0], *az = &pAlong->z[0];
+    int c;
+
+    // d/du, interior columns four at a time
+    for (c = 1; c + 4 <= cols; c += 4) {
+        _mm_storeu_ps(&pOut->dux[c], _mm_sub_ps(_mm_loadu_ps(ax + c + 1), _mm_loadu_ps(ax + c - 1)));
+        _mm_storeu_ps(&pOut->duy[c], _mm_sub_ps(_mm_loadu_ps(ay + c + 1), _mm_loadu_ps(ay + c - 1)));
+        _mm_storeu_ps(&pOut->duz[c], _mm_sub_ps(_mm_loadu_ps(az + c + 1), _mm_loadu_ps(az + c - 1)));
+    }
+    for (; c < cols; c++) {
+        pOut->dux[c] = ax[c + 1] - ax[c - 1];
+        pOut->duy[c] = ay[c + 1] - ay[c - 1];
+        pOut->duz[c] = az[c + 1] - az[c - 1];
+    }
+
+    // d/du at the edges
+    if (wrapsU(pDesc)) {
+        pOut->dux[0] = pOut->dux[cols] = ax[1] - ax[cols - 1];
+        pOut->duy[0] = pOut->duy[cols] = ay[1] - ay[cols - 1];
+        pOut->duz[0] = pOut->duz[cols] = az[1] - az[cols - 1];
+    }
+    else {
+        pOut->dux[0] = ax[1] - ax[0];
+        pOut->duy[0] = ay[1] - ay[0];
+        pOut->duz[0] = az[1] - az[0];
+        pOut->dux[cols] = ax[cols] - ax[cols - 1];
+        pOut->duy[cols] = ay[cols] - ay[cols - 1];
+        pOut->duz[cols] = az[cols] - az[cols - 1];
+    }
+
+    // Normal = normalize(du x dv), tangent = normalize(du)
+    const int count = cols + 1;
+    for (c = 0; c + 4 <= count; c += 4) {
+        __m128 dux = _mm_loadu_ps(&pOut->dux[c]);
+        __m128 duy = _mm_loadu_ps(&pOut->duy[c]);
+        __m128 duz = _mm_loadu_ps(&pOut->duz[c]);
+        __m128 dvx = _mm_sub_ps(_mm_loadu_ps(&pNext->x[c]), _mm_loadu_ps(&pPrev->x[c]));
+        __m128 dvy = _mm_sub_ps(_mm_loadu_ps(&pNext->y[c]), _mm_loadu_ps(&pPrev->y[c]));
+        __m128 dvz = _mm_sub_ps(_mm_loadu_ps(&pNext->z[c]), _mm_loadu_ps(&pPrev->z[c]));
+
+        __m128 nx = _mm_sub_ps(_mm_mul_ps(duy, dvz), _mm_mul_ps(duz, dvy));
+        __m128 ny = _mm_sub_ps(_mm_mul_ps(duz, dvx), _mm_mul_ps(dux, dvz));
+        __m128 nz = _mm_sub_ps(_mm_mul_ps(dux, dvy), _mm_mul_ps(duy, dvx));
+        normalizeSimd(&nx, &ny, &nz);
+        normalizeSimd(&dux, &duy, &duz);
+
+        _mm_storeu_ps(&pOut->nx[c], nx);
+        _mm_storeu_ps(&pOut->ny[c], ny);
+        _mm_storeu_ps(&pOut->nz[c], nz);
+        _mm_storeu_ps(&pOut->tx[c], dux);
+        _mm_storeu_ps(&pOut->ty[c], duy);
+        _mm_storeu_ps(&pOut->tz[c], duz);
+    }
+    for (; c < count; c++) {
+        float dux = pOut->dux[c], duy = pOut->duy[c], duz = pOut->duz[c];
+        float dvx = pNext->x[c] - pPrev->x[c];
+        float dvy = pNext->y[c] - pPrev->y[c];
+        float dvz = pNext->z[c] - pPrev->z[c];
+        pOut->nx[c] = duy * dvz - duz * dvy;
+        pOut->ny[c] = duz * dvx - dux * dvz;
+        pOut->nz[c] = dux * dvy - duy * dvx;
+        normalizeScalar(&pOut->nx[c], &pOut->ny[c], &pOut->nz[c]);
+        pOut->tx[c] = dux;
+        pOut->ty[c] = duy;
+        pOut->tz[c] = duz;
+        normalizeScalar(&pOut->tx[c], &pOut->ty[c], &pOut->tz[c]);
+    }
+}
+
+static void resizeRow(PositionRow *pRow, int count)
+{
+    pRow->x.resize(count);
+    pRow->y.resize(count);
+    pRow->z.resize(count);
+}
+
+// Generate vertex rows [firstRow, lastRow), plus the quads below them
+static void generateBand(const MeshDesc *pDesc, int firstRow, int lastRow,
+    VertexInfo *pVertices, unsigned int *pIndices)
+{
+    const int cols = pDesc->columns;
+    const int count = cols + 1;
+
+    PositionRow rows[3];
+    for (int i = 0; i < 3; i++) {
+        resizeRow(&rows[i], count);
+    }
+    FrameRow frames;
+    std::vector<float> *frameArrays[] = {
+        &frames.dux, &frames.duy, &frames.duz,
+        &frames.nx, &frames.ny, &frames.nz,
+        &frames.tx, &frames.ty, &frames.tz,
+    };
+    for (int i = 0; i < 9; i++) {
+        frameArrays[i]->resize(count);
+    }
+
+    // Rolling window of three rows:  previous, current, next
+    PositionRow *pPrev = &rows[0], *pCur = &rows[1], *pNext = &rows[2];
+    if (firstRow < lastRow) {
+        fillRow(pDesc, neighborRow(pDesc, firstRow, -1), pPrev);
+        fillRow(pDesc, firstRow, pCur);
+        fillRow(pDesc, neighborRow(pDesc, firstRow, 1), pNext);
+    }
+
+    for (int r = firstRow; r < lastRow; r++) {
+        const PositionRow *pAlong = pCur;
+        if (hasPoles(pDesc)) {
+            if (r == 0) {
+                pAlong = pNext;
+            }
+            else if (r == pDesc->rows) {
+                pAlong = pPrev;
+            }
+        }
+        computeFrames(pDesc, pPrev, pNext, pAlong, &frames);
+
+        // Written strictly in order, which is what write-combined memory
+        // (like a mapped buffer) wants
+        float v = float(r) / pDesc->rows;
+        VertexInfo *pOut = pVertices + size_t(r) * count;
+        for (int c = 0; c < count; c++) {
+            VertexInfo vertex;
+            vertex.x = pCur->x[c];
+            vertex.y = pCur->y[c];
+            vertex.z = pCur->z[c];
+            vertex.nx = frames.nx[c];
+            vertex.ny = frames.ny[c];
+            vertex.nz = frames.nz[c];
+            vertex.tx = frames.tx[c];
+            vertex.ty = frames.ty[c];
+            vertex.tz = frames.tz[c];
+            vertex.red = (unsigned char)(127.f + 127.f * vertex.nx);
+            vertex.green = (unsigned char)(127.f + 127.f * vertex.ny);
+            vertex.blue = (unsigned char)(127.f + 127.f * vertex.nz);
+            vertex.texU = float(c) / cols;
+            vertex.texV = v;
+            pOut[c] = vertex;
+        }
+
+        if (r < pDesc->rows) {
+            unsigned int *pIndex = pIndices + size_t(r) * cols * 6;
+            unsigned int base = unsigned(r) * count;
+            for (int c = 0; c < cols; c++) {
+                unsigned int i00 = base + c;
+                unsigned int i10 = i00 + 1;         // Next in u
+                unsigned int i01 = i00 + count;     // Next in v
+                unsigned int i11 = i01 + 1;
+                pIndex[0] = i00; pIndex[1] = i10; pIndex[2] = i01;
+                pIndex[3] = i10; pIndex[4] = i11; pIndex[5] = i01;
+                pIndex += 6;
+            }
+        }
+
+        PositionRow *pRecycle = pPrev;
+        pPrev = pCur;
+        pCur = pNext;
+        pNext = pRecycle;
+        if (r + 1 < lastRow) {
+            int nextRow = neighborRow(pDesc, r + 1, 1);
+            if (nextRow == r + 1) {
+                *pNext = *pCur;     // Clamped at the bottom edge
+            }
+            else {
+                fillRow(pDesc, nextRow, pNext);
+            }
+        }
+    }
+}
+
+void generateMesh(const MeshDesc *pDesc, VertexInfo *pVertices, unsigned int *pIndices, int threadCount)
+{
+    if (threadCount <= 0) {
+        threadCount = int(std::thread::hardware_concurrency());
+        if (threadCount <= 0) {
+            threadCount = 1;
+        }
+    }
+
+    int vertexRows = pDesc->rows + 1;
+    if (threadCount > vertexRows) {
+        threadCount = vertexRows;
+    }
+    int band = (vertexRows + threadCount - 1) / threadCount;
+
+    // The calling thread takes the first band itself
+    std::vector<std::thread> workers;
+    for (int t = 1; t < threadCount; t++) {
+        int firstRow = t * band;
+        int lastRow = firstRow + band < vertexRows ? firstRow + band : vertexRows;
+        if (firstRow < lastRow) {
+            workers.push_back(std::thread(generateBand, pDesc, firstRow, lastRow, pVertices, pIndices));
+        }
+    }
+    generateBand(pDesc, 0, band < vertexRows ? band : vertexRows, pVertices, pIndices);
+    for (size_t t = 0; t < workers.size(); t++) {
+        workers[t].join();
+    }
+}
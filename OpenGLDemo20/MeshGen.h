@@ -0,0 +1,51 @@
+/*
+ * Procedural mesh generators.
+ *
+ * Every shape is a regular grid of (columns + 1) x (rows + 1) vertices over
+ * a (u, v) parameter space, so they all share one generator:  positions
+ * come from a per-shape function, and smooth normals and tangents come from
+ * central differences across the grid, four vertices at a time with SSE.
+ *
+ * Generation is split across threads by bands of rows.  Each thread works
+ * in its own scratch memory and writes finished vertices and indices out in
+ * order, so the destination can be a write-only mapped GL buffer.
+ */
+#ifndef MESH_GEN_H
+#define MESH_GEN_H
+
+#include <stddef.h>
+
+// Same leading fields as the Demo 16 VertexInfo, plus a normal and tangent
+typedef struct {
+    float x, y, z;
+    unsigned char red, green, blue;
+    float texU, texV;
+    float nx, ny, nz;
+    float tx, ty, tz;
+} VertexInfo;
+
+typedef enum {
+    MESH_GRID,          // Flat square in the xz plane, facing +y
+    MESH_SPHERE,        // Latitude/longitude sphere
+    MESH_TORUS,         // Around the y axis
+    MESH_HEIGHTFIELD,   // Grid with bumps
+} MeshShape;
+
+typedef struct {
+    MeshShape shape;
+    int columns, rows;
+    float size;         // Grid and heightfield edge length
+    float radius;       // Sphere radius, or torus center-of-tube radius
+    float tubeRadius;   // Torus only
+    float height;       // Heightfield bump height
+} MeshDesc;
+
+size_t meshVertexCount(const MeshDesc *pDesc);
+size_t meshIndexCount(const MeshDesc *pDesc);
+
+// Fill pVertices and pIndices (32-bit, triangles) with the mesh.  They must
+// have room for meshVertexCount and meshIndexCount entries.  threadCount <= 0
+// means one thread per core.
+void generateMesh(const MeshDesc *pDesc, VertexInfo *pVertices, unsigned int *pIndices, int threadCount);
+
+#endif
@@ -0,0 +1,254 @@
+/*
+ * Demo 20:
+ * Procedural meshes (grid, sphere, torus, heightfield) generated on all
+ * cores, straight into mapped buffer objects.
+ *
+ * See README.txt for prerequisites.
+ */
+#include <windows.h>
+#include <WinGDI.h>
+
+#include <GL/glew.h>
+#include <GL/wglew.h>
+#include <GL/GL.h>
+#include <GL/glut.h>
+
+#include <stdio.h>
+#include <stddef.h>
+
+#include <vmath.h>
+using vmath::mat4;
+
+#include "MeshGen.h"
+
+// Apparently someone is still using segmented memory qualifiers,
+// and windows.h is letting them.
+#undef near
+#undef far
+
+#define CENTER_Z        6.0f     // Distance from camera
+#define DEPTH_OF_FIELD  5.0f
+
+// Exercise:  Set this to 1 and compare the generation times
+#define GENERATOR_THREADS 0     // 0 = one per core
+
+typedef struct {
+    GLsizei count;      // Number of indices
+    GLuint vaoId;
+} ShapeInfo;
+
+#define SHAPE_COUNT 4
+ShapeInfo g_Shapes[SHAPE_COUNT];
+GLint g_MatrixUniform, g_ModelViewUniform;
+mat4 g_ProjectionMatrix(mat4::identity());
+
+// Must match hard-coded vPosition location in vertShaderSource
+#define V_POSITION 0
+
+// Must match hard-coded location in vertShaderSource
+#define C_POSITION 1
+
+// Must match hard-coded vTexture location in vertShaderSource
+#define T_POSITION 2
+
+// Must match hard-coded vNormal location in vertShaderSource
+#define N_POSITION 3
+
+// Must match hard-coded vTangent location in vertShaderSource
+#define TAN_POSITION 4
+
+void setupShaders()
+{
+    GLchar infoLog[4096];
+    GLsizei length;
+
+    // The color is already derived from the normal, so use the normal for
+    // some simple lighting as well, and the tangent to bend it into ridges
+    // running across u, as a normal map would.
+    const GLchar *vertShaderSource[] = {
+        "#version 430 core\n"
+        "uniform mat4 ModelViewProject;\n"
+        "uniform mat4 ModelView;\n"
+        "layout(location = 0) in vec4 vPosition;\n"
+        "layout(location = 1) in vec3 vColor;\n"
+        "layout(location = 2) in vec2 vTexture;\n"
+        "layout(location = 3) in vec3 vNormal;\n"
+        "layout(location = 4) in vec3 vTangent;\n"
+        "out vec3 color;\n"
+        "out vec3 normal;\n"
+        "out vec3 tangent;\n"
+        "out vec2 vs_tex_coord;\n"
+        "void main() {\n"
+        "    gl_Position = ModelViewProject * vPosition;\n"
+        "    normal = mat3(ModelView) * vNormal;\n"
+        "    tangent = mat3(ModelView) * vTangent;\n"
+        "    vs_tex_coord = vTexture;\n"
+        "    color = vColor;\n"
+        "}\n"
+    };
+    GLuint vertShader = glCreateShader(GL_VERTEX_SHADER);
+    glShaderSource(vertShader, 1, vertShaderSource, NULL);
+
+    const GLchar *fragShaderSource[] = {
+        "#version 430 core\n"
+        "in vec3 color;\n"
+        "in vec3 normal;\n"
+        "in vec3 tangent;\n"
+        "in vec2 vs_tex_coord;\n"
+        "out vec4 fColor;\n"
+        "void main() {\n"
+        "    vec3 n = normalize(normal);\n"
+        "    vec3 t = normalize(tangent - n * dot(n, tangent));\n"
+        "    float slope = .5 * cos(vs_tex_coord.x * 100.53);\n"    // 16 ridges
+        "    vec3 bumped = normalize(n - t * slope);\n"
+        "    float light = max(dot(bumped, normalize(vec3(.5, .7, 1))), .2);\n"
+        "    fColor = vec4(color * light, 1);\n"
+        "}\n"
+    };
+    GLuint fragShader = glCreateShader(GL_FRAGMENT_SHADER);
+    glShaderSource(fragShader, 1, fragShaderSource, NULL);
+
+    GLuint program = glCreateProgram();
+    glAttachShader(program, vertShader);
+    glCompileShader(vertShader);
+    glGetShaderInfoLog(vertShader, 4096, &length, infoLog);
+
+    glAttachShader(program, fragShader);
+    glCompileShader(fragShader);
+    glGetShaderInfoLog(fragShader, 4096, &length, infoLog);
+
+    glLinkProgram(program);
+    glUseProgram(program);
+    g_MatrixUniform = glGetUniformLocation(program, "ModelViewProject");
+    g_ModelViewUniform = glGetUniformLocation(program, "ModelView");
+}
+
+void setupShape(const MeshDesc *pDesc, ShapeInfo *pInfo)
+{
+    size_t vertexBytes = meshVertexCount(pDesc) * sizeof(VertexInfo);
+    size_t indexBytes = meshIndexCount(pDesc) * sizeof(GLuint);
+
+    GLuint buffers[2];
+    glGenVertexArrays(1, &pInfo->vaoId);
+    glBindVertexArray(pInfo->vaoId);
+    glGenBuffers(2, buffers);
+
+    // Allocate the buffers without data, then map them.  The generator
+    // threads write directly into the mapped memory, which saves building
+    // the mesh in our own memory and having glBufferData copy it.
+    glBindBuffer(GL_ARRAY_BUFFER, buffers[0]);
+    glBufferData(GL_ARRAY_BUFFER, vertexBytes, NULL, GL_STATIC_DRAW);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, buffers[1]);
+    glBufferData(GL_ELEMENT_ARRAY_BUFFER, indexBytes, NULL, GL_STATIC_DRAW);
+
+    VertexInfo *pVertices = (VertexInfo *)glMapBufferRange(GL_ARRAY_BUFFER, 0, vertexBytes,
+        GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT);
+    GLuint *pIndices = (GLuint *)glMapBufferRange(GL_ELEMENT_ARRAY_BUFFER, 0, indexBytes,
+        GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT);
+
+    pInfo->count = 0;
+    if (pVertices && pIndices) {
+        int start = glutGet(GLUT_ELAPSED_TIME);
+        generateMesh(pDesc, pVertices, pIndices, GENERATOR_THREADS);
+        printf("Shape %d: %u vertices, %u triangles in %d ms\n", int(pDesc->shape),
+            unsigned(meshVertexCount(pDesc)), unsigned(meshIndexCount(pDesc) / 3),
+            glutGet(GLUT_ELAPSED_TIME) - start);
+        pInfo->count = (GLsizei)meshIndexCount(pDesc);
+    }
+
+    // Unmapping can fail if the driver lost the memory (mode switch, etc.).
+    // Both buffers must be unmapped either way, since drawing from a mapped
+    // buffer is an error.
+    bool vertexOk = pVertices ? glUnmapBuffer(GL_ARRAY_BUFFER) != GL_FALSE : false;
+    bool indexOk = pIndices ? glUnmapBuffer(GL_ELEMENT_ARRAY_BUFFER) != GL_FALSE : false;
+    if (!vertexOk || !indexOk) {
+        printf("Lost buffer contents for shape %d\n", int(pDesc->shape));
+        pInfo->count = 0;
+    }
+
+    glVertexAttribPointer(V_POSITION, 3, GL_FLOAT, GL_FALSE, sizeof(VertexInfo), (GLvoid*)offsetof(VertexInfo, x));
+    glEnableVertexAttribArray(V_POSITION);
+    glVertexAttribPointer(C_POSITION, 3, GL_UNSIGNED_BYTE, GL_TRUE, sizeof(VertexInfo), (GLvoid*)offsetof(VertexInfo, red));
+    glEnableVertexAttribArray(C_POSITION);
+    glVertexAttribPointer(T_POSITION, 2, GL_FLOAT, GL_FALSE, sizeof(VertexInfo), (GLvoid*)offsetof(VertexInfo, texU));
+    glEnableVertexAttribArray(T_POSITION);
+    glVertexAttribPointer(N_POSITION, 3, GL_FLOAT, GL_FALSE, sizeof(VertexInfo), (GLvoid*)offsetof(VertexInfo, nx));
+    glEnableVertexAttribArray(N_POSITION);
+    glVertexAttribPointer(TAN_POSITION, 3, GL_FLOAT, GL_FALSE, sizeof(VertexInfo), (GLvoid*)offsetof(VertexInfo, tx));
+    glEnableVertexAttribArray(TAN_POSITION);
+    glBindVertexArray(0);
+}
+
+void setupShapes()
+{
+    // The heightfield alone is a million vertices
+    MeshDesc descs[SHAPE_COUNT] = {
+        { MESH_GRID,        256,  256,  1.5f, 0.f,  0.f,  0.f },
+        { MESH_SPHERE,      512,  256,  0.f,  .6f,  0.f,  0.f },
+        { MESH_TORUS,       512,  256,  0.f,  .55f, .2f,  0.f },
+        { MESH_HEIGHTFIELD, 1023, 1023, 1.5f, 0.f,  0.f,  .15f },
+    };
+    for (int i = 0; i < SHAPE_COUNT; i++) {
+        setupShape(&descs[i], &g_Shapes[i]);
+    }
+}
+
+void setupFrustum(float left, float right, float bottom, float top, float near, float far)
+{
+    g_ProjectionMatrix = vmath::frustum(left, right, bottom, top, near, far);
+}
+
+void drawTrianglesAt(float x, float y, float z, float rotyDegrees, float scale, ShapeInfo *pInfo)
+{
+    mat4 modelViewMatrix(vmath::translate(x, y, z - CENTER_Z));
+    modelViewMatrix *= vmath::rotate(30.f, 1.f, 0.f, 0.f);
+    modelViewMatrix *= vmath::rotate(rotyDegrees, 0.f, 1.f, 0.f);
+    modelViewMatrix *= vmath::scale(scale, scale, scale);
+
+    glUniformMatrix4fv(g_MatrixUniform, 1, GL_FALSE, g_ProjectionMatrix * modelViewMatrix);
+    glUniformMatrix4fv(g_ModelViewUniform, 1, GL_FALSE, modelViewMatrix);
+    glBindVertexArray(pInfo->vaoId);
+    glDrawElements(GL_TRIANGLES, pInfo->count, GL_UNSIGNED_INT, 0);
+}
+
+void onDisplay()
+{
+    static int i = 0;
+    i++;
+    glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+    drawTrianglesAt(-1.f, .75f, 0.f, i * .5f, 1.f, &g_Shapes[0]);
+    drawTrianglesAt(1.f, .75f, 0.f, i * .5f, 1.f, &g_Shapes[1]);
+    drawTrianglesAt(-1.f, -.75f, 0.f, i * .5f, 1.f, &g_Shapes[2]);
+    drawTrianglesAt(1.f, -.75f, 0.f, i * .5f, 1.f, &g_Shapes[3]);
+    glutSwapBuffers();
+}
+
+void onKey(unsigned char key, int x, int y)
+{
+    exit(0);
+}
+
+int main(int argc, char *argv[])
+{
+    glutInit(&argc, argv);
+    glutInitDisplayMode(GLUT_RGBA | GLUT_DOUBLE | GLUT_DEPTH);
+    glutInitWindowSize(640, 480);
+    glutCreateWindow(argv[0]);
+
+    glewInit();
+    wglSwapIntervalEXT(1);	// vsync
+
+    glEnable(GL_DEPTH_TEST);
+
+    GLfloat ratio = 640.0f / 480.0f;
+    setupFrustum(-ratio, ratio, -1., 1., CENTER_Z - DEPTH_OF_FIELD/2, CENTER_Z + DEPTH_OF_FIELD/2);
+
+    setupShaders();
+    setupShapes();
+    glutDisplayFunc(onDisplay);
+    glutIdleFunc(onDisplay);
+    glutKeyboardFunc(onKey);
+    glutMainLoop();
+
+    return 0;
+}
@@ -0,0 +1,510 @@
+/*
+ * Demo 21:
+ * Overdraw analysis.  Renders the Demo 9 scene with additive blending into
+ * a floating point counter texture, shows the counts as a heatmap, and
+ * prints depth complexity, shaded fragments per pixel and triangles per
+ * frame.
+ *
+ * Keys:
+ *   V - cycle view:  normal, depth complexity, shaded fragments
+ *   S - cycle draw order:  as submitted, front to back, back to front
+ *   Anything else exits.
+ *
+ * See README.txt for prerequisites.
+ */
+#include <windows.h>
+#include <WinGDI.h>
+
+#include <GL/glew.h>
+#include <GL/wglew.h>
+#include <GL/GL.h>
+#include <GL/glut.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stddef.h>
+
+#include <vector>
+
+#include <vmath.h>
+using vmath::mat4;
+
+// Apparently someone is still using segmented memory qualifiers,
+// and windows.h is letting them.
+#undef near
+#undef far
+
+#define WINDOW_WIDTH    640
+#define WINDOW_HEIGHT   480
+
+#define CENTER_Z        6.0f     // Distance from camera
+#define DEPTH_OF_FIELD  5.0f
+
+// Counts at or above this show up as solid red in the heatmap
+#define HEATMAP_MAX     6.0f
+
+// How often (in frames) to read the counters back and print a report
+#define REPORT_INTERVAL 120
+
+typedef struct {
+    GLfloat x, y, z;
+    GLubyte red, green, blue;
+} VertexInfo;
+
+typedef struct {
+    GLsizei count;
+    GLuint vaoId;
+} ShapeInfo;
+
+typedef struct {
+    float x, y, z;
+    float rotyDegrees;
+    float scale;
+    ShapeInfo *pShape;
+} DrawItem;
+
+enum ViewMode {
+    VIEW_NORMAL,
+    VIEW_DEPTH_COMPLEXITY,
+    VIEW_SHADED,
+    VIEW_COUNT
+};
+
+enum SortMode {
+    SORT_NONE,
+    SORT_FRONT_TO_BACK,
+    SORT_BACK_TO_FRONT,
+    SORT_COUNT
+};
+
+static const char *VIEW_NAMES[VIEW_COUNT] = { "normal", "depth complexity", "shaded fragments" };
+static const char *SORT_NAMES[SORT_COUNT] = { "as submitted", "front to back", "back to front" };
+
+ShapeInfo g_Pyramid;
+ShapeInfo g_Fins;
+mat4 g_ProjectionMatrix(mat4::identity());
+
+GLuint g_SceneProgram, g_CountProgram, g_HeatmapProgram;
+GLint g_SceneMatrixUniform, g_CountMatrixUniform, g_HeatmapMaxUniform;
+
+// Counter targets:  one for every fragment rasterized (depth test off), one
+// for every fragment that survives the depth test at the time it is drawn
+GLuint g_CountFbo[2], g_CountTexture[2], g_CountDepth;
+GLsizei g_CountWidth, g_CountHeight;
+GLuint g_EmptyVao;
+GLuint g_PrimitiveQuery;
+
+ViewMode g_ViewMode = VIEW_DEPTH_COMPLEXITY;
+SortMode g_SortMode = SORT_NONE;
+
+// Must match hard-coded vPosition location in vertShaderSource
+#define V_POSITION 0
+
+// Must match hard-coded location in vertShaderSource
+#define C_POSITION 1
+
+GLuint buildProgram(GLuint vertShader, const GLchar *fragSource)
+{
+    GLchar infoLog[4096];
+    GLsizei length;
+
+    GLuint fragShader = glCreateShader(GL_FRAGMENT_SHADER);
+    glShaderSource(fragShader, 1, &fragSource, NULL);
+    glCompileShader(fragShader);
+    glGetShaderInfoLog(fragShader, 4096, &length, infoLog);
+
+    GLuint program = glCreateProgram();
+    glAttachShader(program, vertShader);
+    glAttachShader(program, fragShader);
+    glLinkProgram(program);
+    glGetProgramInfoLog(program, 4096, &length, infoLog);
+    return program;
+}
+
+void setupShaders()
+{
+    GLchar infoLog[4096];
+    GLsizei length;
+
+    const GLchar *vertShaderSource[] = {
+        "#version 430 core\n"
+        "uniform mat4 ModelViewProject;\n"
+        "layout(location = 0) in vec4 vPosition;\n"
+        "layout(location = 1) in vec3 vColor;\n"
+        "out vec3 color;\n"
+        "void main() {\n"
+        "    gl_Position = ModelViewProject * vPosition;\n"
+        "    color = vColor;\n"
+        "}\n"
+    };
+    GLuint vertShader = glCreateShader(GL_VERTEX_SHADER);
+    glShaderSource(vertShader, 1, vertShaderSource, NULL);
+    glCompileShader(vertShader);
+    glGetShaderInfoLog(vertShader, 4096, &length, infoLog);
+
+    g_SceneProgram = buildProgram(vertShader,
+        "#version 430 core\n"
+        "in vec3 color;\n"
+        "out vec4 fColor;\n"
+        "void main() {\n"
+        "    fColor = vec4(color, 1);\n"
+        "}\n");
+    g_SceneMatrixUniform = glGetUniformLocation(g_SceneProgram, "ModelViewProject");
+
+    // Every fragment adds one to the counter (the blend function does the
+    // adding)
+    g_CountProgram = buildProgram(vertShader,
+        "#version 430 core\n"
+        "out float count;\n"
+        "void main() {\n"
+        "    count = 1.0;\n"
+        "}\n");
+    g_CountMatrixUniform = glGetUniformLocation(g_CountProgram, "ModelViewProject");
+
+    // Full-screen triangle from gl_VertexID, no vertex data needed
+    const GLchar *heatmapVertSource[] = {
+        "#version 430 core\n"
+        "void main() {\n"
+        "    vec2 pos = vec2((gl_VertexID & 1) * 4 - 1, (gl_VertexID & 2) * 2 - 1);\n"
+        "    gl_Position = vec4(pos, 0, 1);\n"
+        "}\n"
+    };
+    GLuint heatmapVert = glCreateShader(GL_VERTEX_SHADER);
+    glShaderSource(heatmapVert, 1, heatmapVertSource, NULL);
+    glCompileShader(heatmapVert);
+    glGetShaderInfoLog(heatmapVert, 4096, &length, infoLog);
+
+    // Black for nothing, then blue, green, yellow, red as the count goes up
+    g_HeatmapProgram = buildProgram(heatmapVert,
+        "#version 430 core\n"
+        "uniform sampler2D counts;\n"
+        "uniform float MaxCount;\n"
+        "out vec4 fColor;\n"
+        "void main() {\n"
+        "    float count = texelFetch(counts, ivec2(gl_FragCoord.xy), 0).r;\n"
+        "    if (count < 0.5) {\n"
+        "        fColor = vec4(0, 0, 0, 1);\n"
+        "        return;\n"
+        "    }\n"
+        "    float t = clamp((count - 1.0) / (MaxCount - 1.0), 0.0, 1.0) * 3.0;\n"
+        "    vec3 ramp[4] = vec3[4](vec3(0, 0, 1), vec3(0, 1, 0), vec3(1, 1, 0), vec3(1, 0, 0));\n"
+        "    int i = min(int(t), 2);\n"
+        "    fColor = vec4(mix(ramp[i], ramp[i + 1], t - float(i)), 1);\n"
+        "}\n");
+    g_HeatmapMaxUniform = glGetUniformLocation(g_HeatmapProgram, "MaxCount");
+    glUseProgram(g_HeatmapProgram);
+    glUniform1i(glGetUniformLocation(g_HeatmapProgram, "counts"), 0);
+}
+
+// The counters have to match the window pixel for pixel, so this runs
+// again whenever it is resized.  Storage from glTexStorage2D can't be
+// resized, so the textures are replaced.
+void allocateCounters(GLsizei width, GLsizei height)
+{
+    g_CountWidth = width;
+    g_CountHeight = height;
+
+    // R32F holds exact integers up to 2^24, and unlike an integer format it
+    // can be blended.
+    glDeleteTextures(2, g_CountTexture);
+    glGenTextures(2, g_CountTexture);
+
+    glBindRenderbuffer(GL_RENDERBUFFER, g_CountDepth);
+    glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT24, width, height);
+
+    for (int i = 0; i < 2; i++) {
+        glBindTexture(GL_TEXTURE_2D, g_CountTexture[i]);
+        glTexStorage2D(GL_TEXTURE_2D, 1, GL_R32F, width, height);
+
+        glBindFramebuffer(GL_FRAMEBUFFER, g_CountFbo[i]);
+        glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, g_CountTexture[i], 0);
+        glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, g_CountDepth);
+        if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE) {
+            printf("Counter framebuffer %d is incomplete\n", i);
+        }
+    }
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+}
+
+void setupCounters()
+{
+    glGenFramebuffers(2, g_CountFbo);
+    glGenRenderbuffers(1, &g_CountDepth);
+    allocateCounters(WINDOW_WIDTH, WINDOW_HEIGHT);
+
+    glGenVertexArrays(1, &g_EmptyVao);
+    glGenQueries(1, &g_PrimitiveQuery);
+}
+
+void setupShape(const VertexInfo *pData, GLsizei count, ShapeInfo *pInfo)
+{
+    GLuint vboId(0);
+
+    glGenVertexArrays(1, &pInfo->vaoId);
+    glBindVertexArray(pInfo->vaoId);
+    glGenBuffers(1, &vboId);
+    glBindBuffer(GL_ARRAY_BUFFER, vboId);
+    glBufferData(GL_ARRAY_BUFFER, count * sizeof(VertexInfo), pData, GL_STATIC_DRAW);
+
+    glVertexAttribPointer(V_POSITION, 3, GL_FLOAT, GL_FALSE, sizeof(VertexInfo), (GLvoid*)offsetof(VertexInfo, x));
+    glEnableVertexAttribArray(V_POSITION);
+    glVertexAttribPointer(C_POSITION, 3, GL_UNSIGNED_BYTE, GL_TRUE, sizeof(VertexInfo), (GLvoid*)offsetof(VertexInfo, red));
+    glEnableVertexAttribArray(C_POSITION);
+    glBindVertexArray(0);
+
+    pInfo->count = count;
+}
+
+void setupShapes()
+{
+    static const VertexInfo pyramidData[] = {
+        // Bottom
+        { 0.0f, 0.f, .5f, 255, 0, 0},
+        { 0.433f, 0.f, -.25f, 255, 0, 0},
+        { -0.433f, 0.f, -.25f, 255, 0, 0},
+        // Side 1
+        { -0.433f, 0.f, -.25f, 0, 0, 255},
+        { 0.433f, 0.f, -.25f, 0, 0, 255},
+        { 0.0f, 0.75f, 0.f, 0, 0, 255},
+        // Side 2
+        { -0.433f, 0.f, -.25f, 255, 255, 0},
+        { 0.0f, 0.f, .5f, 255, 255, 0},
+        { 0.0f, 0.75f, 0.f, 255, 255, 0},
+        // Side 3
+        { 0.0f, 0.f, .5f, 0, 255, 0},
+        { 0.433f, 0.f, -.25f, 0, 255, 0},
+        { 0.0f, 0.75f, 0.f, 0, 255, 0},
+    };
+    static const VertexInfo finData[] = {
+        // Triangle 1
+        { -.5f, -.5f, 0.f, 255, 0, 0 },
+        { .5f, -.5f, 0.f, 255, 0, 0 },
+        { 0.f, .5f, 0.f, 255, 0, 0 },
+        // Triangle 2
+        { 0.f, -.5f, -.5f, 0, 255, 0 },
+        { 0.f, -.5f, .5f, 0, 255, 0 },
+        { 0.f, .5f, 0.f, 0, 255, 0 },
+    };
+    setupShape(pyramidData, 12, &g_Pyramid);
+    setupShape(finData, 6, &g_Fins);
+}
+
+void setupFrustum(float left, float right, float bottom, float top, float near, float far)
+{
+    g_ProjectionMatrix = vmath::frustum(left, right, bottom, top, near, far);
+}
+
+void drawItem(const DrawItem *pItem, GLint matrixUniform)
+{
+    mat4 modelViewMatrix(vmath::translate(pItem->x, pItem->y, pItem->z - CENTER_Z));
+    modelViewMatrix *= vmath::rotate(pItem->rotyDegrees, 0.f, 1.f, 0.f);
+    modelViewMatrix *= vmath::scale(pItem->scale, pItem->scale, pItem->scale);
+
+    glUniformMatrix4fv(matrixUniform, 1, GL_FALSE, g_ProjectionMatrix * modelViewMatrix);
+    glBindVertexArray(pItem->pShape->vaoId);
+    glDrawArrays(GL_TRIANGLES, 0, pItem->pShape->count);
+}
+
+int compareFrontToBack(const void *a, const void *b)
+{
+    // Larger z is closer to the camera
+    float za = ((const DrawItem *)a)->z, zb = ((const DrawItem *)b)->z;
+    return (za > zb) ? -1 : (za < zb) ? 1 : 0;
+}
+
+int compareBackToFront(const void *a, const void *b)
+{
+    return compareFrontToBack(b, a);
+}
+
+// Same motion as Demo 9, squeezed together so the objects overlap
+int buildScene(int i, DrawItem *pItems)
+{
+    float angle = i / 30.f;
+    float z = -i / 400.f;
+    DrawItem items[] = {
+        { .5f * cosf(angle), .5f * sinf(angle), z, i * 3.f, 2.f, &g_Pyramid },
+        { .5f * cosf(angle + 2.094f), .5f * sinf(angle + 2.094f), z + .4f, i * 1.f, 1.5f, &g_Fins },
+        { .5f * cosf(angle + 4.189f), .5f * sinf(angle + 4.189f), z - .4f, i * 10.f, 1.2f, &g_Pyramid },
+    };
+    int count = sizeof(items) / sizeof(items[0]);
+    memcpy(pItems, items, sizeof(items));
+    if (g_SortMode == SORT_FRONT_TO_BACK) {
+        qsort(pItems, count, sizeof(DrawItem), compareFrontToBack);
+    }
+    else if (g_SortMode == SORT_BACK_TO_FRONT) {
+        qsort(pItems, count, sizeof(DrawItem), compareBackToFront);
+    }
+    return count;
+}
+
+void drawCounts(const DrawItem *pItems, int count, bool depthTest)
+{
+    glBindFramebuffer(GL_FRAMEBUFFER, g_CountFbo[depthTest ? 1 : 0]);
+    glClearColor(0.f, 0.f, 0.f, 0.f);
+    glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+    if (depthTest) {
+        glEnable(GL_DEPTH_TEST);
+    }
+    else {
+        glDisable(GL_DEPTH_TEST);
+    }
+    glEnable(GL_BLEND);
+    glBlendFunc(GL_ONE, GL_ONE);
+    glUseProgram(g_CountProgram);
+    for (int n = 0; n < count; n++) {
+        drawItem(&pItems[n], g_CountMatrixUniform);
+    }
+    glDisable(GL_BLEND);
+    glEnable(GL_DEPTH_TEST);
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+}
+
+void drawHeatmap(GLuint texture)
+{
+    glDisable(GL_DEPTH_TEST);
+    glUseProgram(g_HeatmapProgram);
+    glUniform1f(g_HeatmapMaxUniform, HEATMAP_MAX);
+    glActiveTexture(GL_TEXTURE0);
+    glBindTexture(GL_TEXTURE_2D, texture);
+    glBindVertexArray(g_EmptyVao);
+    glDrawArrays(GL_TRIANGLES, 0, 3);
+    glEnable(GL_DEPTH_TEST);
+}
+
+// Read a counter texture back and add up the counts.  This stalls the
+// pipeline, which is fine for an analysis mode but is why it only happens
+// every REPORT_INTERVAL frames.
+void sumCounts(GLuint texture, double *pTotal, int *pCovered, int *pMax)
+{
+    static std::vector<float> counts;
+    counts.resize(size_t(g_CountWidth) * g_CountHeight);
+    glBindTexture(GL_TEXTURE_2D, texture);
+    glGetTexImage(GL_TEXTURE_2D, 0, GL_RED, GL_FLOAT, &counts[0]);
+
+    *pTotal = 0.;
+    *pCovered = 0;
+    *pMax = 0;
+    for (size_t i = 0; i < counts.size(); i++) {
+        int count = int(counts[i] + .5f);
+        if (count > 0) {
+            *pTotal += count;
+            (*pCovered)++;
+            if (count > *pMax) {
+                *pMax = count;
+            }
+        }
+    }
+}
+
+void report(GLuint triangles)
+{
+    double rasterized, shaded;
+    int covered, shadedCovered, maxDepth, maxShaded;
+    sumCounts(g_CountTexture[0], &rasterized, &covered, &maxDepth);
+    sumCounts(g_CountTexture[1], &shaded, &shadedCovered, &maxShaded);
+    if (covered == 0) {
+        return;
+    }
+    printf("[%s] %u triangles, %d pixels covered\n", SORT_NAMES[g_SortMode], triangles, covered);
+    printf("    depth complexity: %.2f average, %d max\n", rasterized / covered, maxDepth);
+    printf("    shaded fragments: %.2f per pixel, %d max (%.0f%% of rasterized fragments)\n",
+        shaded / covered, maxShaded, 100. * shaded / rasterized);
+}
+
+void onDisplay()
+{
+    static int i = 0;
+    if (i < 400) {
+        i++;
+    }
+
+    DrawItem items[8];
+    int count = buildScene(i, items);
+
+    // Both counter passes run every frame, so the report always matches
+    // what is on screen.
+    glBeginQuery(GL_PRIMITIVES_GENERATED, g_PrimitiveQuery);
+    drawCounts(items, count, false);
+    glEndQuery(GL_PRIMITIVES_GENERATED);
+    drawCounts(items, count, true);
+
+    glClearColor(0.f, 0.f, 0.f, 1.f);
+    glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+    if (g_ViewMode == VIEW_NORMAL) {
+        glUseProgram(g_SceneProgram);
+        for (int n = 0; n < count; n++) {
+            drawItem(&items[n], g_SceneMatrixUniform);
+        }
+    }
+    else {
+        drawHeatmap(g_CountTexture[g_ViewMode == VIEW_SHADED ? 1 : 0]);
+    }
+    glutSwapBuffers();
+
+    static int frames = 0;
+    if (++frames % REPORT_INTERVAL == 0) {
+        GLuint triangles = 0;
+        glGetQueryObjectuiv(g_PrimitiveQuery, GL_QUERY_RESULT, &triangles);
+        report(triangles);
+    }
+}
+
+void onReshape(int width, int height)
+{
+    // A minimized window reports 0 x 0, which no texture can have
+    width = width > 0 ? width : 1;
+    height = height > 0 ? height : 1;
+    glViewport(0, 0, width, height);
+    GLfloat ratio = GLfloat(width) / GLfloat(height);
+    setupFrustum(-ratio, ratio, -1., 1., CENTER_Z - DEPTH_OF_FIELD/2, CENTER_Z + DEPTH_OF_FIELD/2);
+    if (width != g_CountWidth || height != g_CountHeight) {
+        allocateCounters(width, height);
+    }
+}
+
+void onKey(unsigned char key, int x, int y)
+{
+    switch (key) {
+    case 'v':
+    case 'V':
+        g_ViewMode = ViewMode((g_ViewMode + 1) % VIEW_COUNT);
+        printf("View: %s\n", VIEW_NAMES[g_ViewMode]);
+        break;
+    case 's':
+    case 'S':
+        g_SortMode = SortMode((g_SortMode + 1) % SORT_COUNT);
+        printf("Draw order: %s\n", SORT_NAMES[g_SortMode]);
+        break;
+    default:
+        exit(0);
+    }
+}
+
+int main(int argc, char *argv[])
+{
+    glutInit(&argc, argv);
+    glutInitDisplayMode(GLUT_RGBA | GLUT_DOUBLE | GLUT_DEPTH);
+    glutInitWindowSize(WINDOW_WIDTH, WINDOW_HEIGHT);
+    glutCreateWindow(argv[0]);
+
+    glewInit();
+    wglSwapIntervalEXT(1);	// vsync
+
+    glEnable(GL_DEPTH_TEST);
+
+    GLfloat ratio = float(WINDOW_WIDTH) / WINDOW_HEIGHT;
+    setupFrustum(-ratio, ratio, -1., 1., CENTER_Z - DEPTH_OF_FIELD/2, CENTER_Z + DEPTH_OF_FIELD/2);
+
+    setupShaders();
+    setupCounters();
+    setupShapes();
+    glutDisplayFunc(onDisplay);
+    glutIdleFunc(onDisplay);
+    glutReshapeFunc(onReshape);
+    glutKeyboardFunc(onKey);
+    glutMainLoop();
+
+    return 0;
+}
@@ -0,0 +1,405 @@
+/*
+ * Software occlusion culling.  See OcclusionCuller.h.
+ */
+#include "OcclusionCuller.h"
+
+#include <math.h>
+#include <condition_variable>
+#include <mutex>
+#include <vector>
+#include <thread>
+
+#include <xmmintrin.h>
+
+#define TILES_X     (OCCLUSION_WIDTH / OCCLUSION_TILE)
+#define TILES_Y     (OCCLUSION_HEIGHT / OCCLUSION_TILE)
+
+// Vertices closer to the eye plane than this can't be projected safely
+#define MIN_W       1e-4f
+
+// Below this many boxes, waking a thread costs more than it saves
+#define MIN_BOXES_PER_THREAD 2048
+
+// Row 0 is the bottom of the screen, as in GL.  Declared as __m128 so every
+// row of four pixels is aligned.
+static __m128 g_Depth[OCCLUSION_WIDTH * OCCLUSION_HEIGHT / 4];
+static float g_TileMax[TILES_X * TILES_Y];
+static __m128 g_ViewProjection[4];
+static __m128 g_ViewProjectionSplat[16];     // Each element in all four lanes
+
+static float *depthRow(int y)
+{
+    return (float *)g_Depth + y * OCCLUSION_WIDTH;
+}
+
+static void loadColumns(const float *m, __m128 *pColumns)
+{
+    for (int i = 0; i < 4; i++) {
+        pColumns[i] = _mm_loadu_ps(m + 4 * i);
+    }
+}
+
+static __m128 transformPoint(const __m128 *pColumns, float x, float y, float z)
+{
+    __m128 result = _mm_add_ps(_mm_mul_ps(pColumns[0], _mm_set1_ps(x)), pColumns[3]);
+    result = _mm_add_ps(result, _mm_mul_ps(pColumns[1], _mm_set1_ps(y)));
+    return _mm_add_ps(result, _mm_mul_ps(pColumns[2], _mm_set1_ps(z)));
+}
+
+void occlusionBegin(const float *viewProjection)
+{
+    loadColumns(viewProjection, g_ViewProjection);
+    for (int i = 0; i < 16; i++) {
+        g_ViewProjectionSplat[i] = _mm_set1_ps(viewProjection[i]);
+    }
+
+    __m128 far4 = _mm_set1_ps(1.f);
+    for (int i = 0; i < OCCLUSION_WIDTH * OCCLUSION_HEIGHT / 4; i++) {
+        g_Depth[i] = far4;
+    }
+}
+
+// Edge function for the edge a->b, as A * x + B * y + C.  It is positive
+// on the inside of a counter-clockwise triangle.
+typedef struct {
+    float a, b, c;
+} Edge;
+
+static Edge makeEdge(const float *pA, const float *pB)
+{
+    Edge edge;
+    edge.a = pA[1] - pB[1];
+    edge.b = pB[0] - pA[0];
+    edge.c = -(edge.a * pA[0] + edge.b * pA[1]);
+    return edge;
+}
+
+// Each vertex is screen x, screen y, NDC z
+static void rasterizeTriangle(const float *pV0, const float *pV1, const float *pV2)
+{
+    float area = (pV1[0] - pV0[0]) * (pV2[1] - pV0[1]) - (pV2[0] - pV0[0]) * (pV1[1] - pV0[1]);
+    if (area == 0.f) {
+        return;
+    }
+    // Occluders are treated as double sided, so just fix the winding
+    if (area < 0.f) {
+        const float *pSwap = pV1;
+        pV1 = pV2;
+        pV2 = pSwap;
+        area = -area;
+    }
+
+    float minX = pV0[0] < pV1[0] ? pV0[0] : pV1[0];
+    minX = pV2[0] < minX ? pV2[0] : minX;
+    float maxX = pV0[0] > pV1[0] ? pV0[0] : pV1[0];
+    maxX = pV2[0] > maxX ? pV2[0] : maxX;
+    float minY = pV0[1] < pV1[1] ? pV0[1] : pV1[1];
+    minY = pV2[1] < minY ? pV2[1] : minY;
+    float maxY = pV0[1] > pV1[1] ? pV0[1] : pV1[1];
+    maxY = pV2[1] > maxY ? pV2[1] : maxY;
+
+    int x0 = minX < 0.f ? 0 : int(minX);
+    int x1 = maxX >= OCCLUSION_WIDTH ? OCCLUSION_WIDTH - 1 : int(maxX);
+    int y0 = minY < 0.f ? 0 : int(minY);
+    int y1 = maxY >= OCCLUSION_HEIGHT ? OCCLUSION_HEIGHT - 1 : int(maxY);
+    if (x0 > x1 || y0 > y1) {
+        return;
+    }
+    // Start on an aligned group of four; the edge test masks off the extras
+    x0 &= ~3;
+
+    // Each edge's function is zero at the opposite vertex and 'area' at its
+    // own vertex, so they double as barycentric weights for the depth plane.
+    Edge e0 = makeEdge(pV1, pV2);
+    Edge e1 = makeEdge(pV2, pV0);
+    Edge e2 = makeEdge(pV0, pV1);
+    float zA = (e0.a * pV0[2] + e1.a * pV1[2] + e2.a * pV2[2]) / area;
+    float zB = (e0.b * pV0[2] + e1.b * pV1[2] + e2.b * pV2[2]) / area;
+    float zC = (e0.c * pV0[2] + e1.c * pV1[2] + e2.c * pV2[2]) / area;
+
+    // Pixel centers of the first group of four
+    __m128 xs = _mm_add_ps(_mm_set1_ps(float(x0)), _mm_setr_ps(.5f, 1.5f, 2.5f, 3.5f));
+    __m128 zero = _mm_setzero_ps();
+    __m128 step0 = _mm_set1_ps(4.f * e0.a), step1 = _mm_set1_ps(4.f * e1.a);
+    __m128 step2 = _mm_set1_ps(4.f * e2.a), stepZ = _mm_set1_ps(4.f * zA);
+
+    for (int y = y0; y <= y1; y++) {
+        float fy = y + .5f;
+        __m128 w0 = _mm_add_ps(_mm_mul_ps(_mm_set1_ps(e0.a), xs), _mm_set1_ps(e0.b * fy + e0.c));
+        __m128 w1 = _mm_add_ps(_mm_mul_ps(_mm_set1_ps(e1.a), xs), _mm_set1_ps(e1.b * fy + e1.c));
+        __m128 w2 = _mm_add_ps(_mm_mul_ps(_mm_set1_ps(e2.a), xs), _mm_set1_ps(e2.b * fy + e2.c));
+        __m128 z = _mm_add_ps(_mm_mul_ps(_mm_set1_ps(zA), xs), _mm_set1_ps(zB * fy + zC));
+        float *pRow = depthRow(y);
+
+        for (int x = x0; x <= x1; x += 4) {
+            __m128 inside = _mm_and_ps(_mm_and_ps(_mm_cmpge_ps(w0, zero), _mm_cmpge_ps(w1, zero)),
+                _mm_cmpge_ps(w2, zero));
+            if (_mm_movemask_ps(inside)) {
+                __m128 depth = _mm_load_ps(pRow + x);
+                __m128 nearer = _mm_min_ps(depth, z);
+                _mm_store_ps(pRow + x, _mm_or_ps(_mm_and_ps(inside, nearer), _mm_andnot_ps(inside, depth)));
+            }
+            w0 = _mm_add_ps(w0, step0);
+            w1 = _mm_add_ps(w1, step1);
+            w2 = _mm_add_ps(w2, step2);
+            z = _mm_add_ps(z, stepZ);
+        }
+    }
+}
+
+void occlusionAddOccluder(const float *model, const void *positions, int stride,
+    const unsigned short *indices, int indexCount)
+{
+    // Combine the model matrix into the view-projection once, column by column
+    __m128 modelColumns[4], columns[4];
+    loadColumns(model, modelColumns);
+    for (int i = 0; i < 4; i++) {
+        float c[4];
+        _mm_storeu_ps(c, modelColumns[i]);
+        columns[i] = _mm_add_ps(
+            _mm_add_ps(_mm_mul_ps(g_ViewProjection[0], _mm_set1_ps(c[0])), _mm_mul_ps(g_ViewProjection[1], _mm_set1_ps(c[1]))),
+            _mm_add_ps(_mm_mul_ps(g_ViewProjection[2], _mm_set1_ps(c[2])), _mm_mul_ps(g_ViewProjection[3], _mm_set1_ps(c[3]))));
+    }
+
+    __m128 toScreen = _mm_setr_ps(.5f * OCCLUSION_WIDTH, .5f * OCCLUSION_HEIGHT, 1.f, 0.f);
+    __m128 screenOffset = _mm_setr_ps(.5f * OCCLUSION_WIDTH, .5f * OCCLUSION_HEIGHT, 0.f, 0.f);
+    const char *pBytes = (const char *)positions;
+
+    for (int i = 0; i + 2 < indexCount; i += 3) {
+        float screen[3][4];
+        bool visible = true;
+        for (int v = 0; v < 3 && visible; v++) {
+            const float *p = (const float *)(pBytes + indices[i + v] * stride);
+            __m128 clip = transformPoint(columns, p[0], p[1], p[2]);
+            __m128 w = _mm_shuffle_ps(clip, clip, _MM_SHUFFLE(3, 3, 3, 3));
+            if (_mm_cvtss_f32(w) < MIN_W) {
+                visible = false;
+            }
+            else {
+                __m128 ndc = _mm_div_ps(clip, w);
+                _mm_storeu_ps(screen[v], _mm_add_ps(_mm_mul_ps(ndc, toScreen), screenOffset));
+            }
+        }
+        if (visible) {
+            rasterizeTriangle(screen[0], screen[1], screen[2]);
+        }
+    }
+}
+
+void occlusionFinish()
+{
+    for (int ty = 0; ty < TILES_Y; ty++) {
+        for (int tx = 0; tx < TILES_X; tx++) {
+            __m128 tileMax = _mm_set1_ps(-INFINITY);
+            for (int y = ty * OCCLUSION_TILE; y < (ty + 1) * OCCLUSION_TILE; y++) {
+                const float *pRow = depthRow(y) + tx * OCCLUSION_TILE;
+                for (int x = 0; x < OCCLUSION_TILE; x += 4) {
+                    tileMax = _mm_max_ps(tileMax, _mm_load_ps(pRow + x));
+                }
+            }
+            tileMax = _mm_max_ps(tileMax, _mm_shuffle_ps(tileMax, tileMax, _MM_SHUFFLE(1, 0, 3, 2)));
+            tileMax = _mm_max_ps(tileMax, _mm_shuffle_ps(tileMax, tileMax, _MM_SHUFFLE(2, 3, 0, 1)));
+            g_TileMax[ty * TILES_X + tx] = _mm_cvtss_f32(tileMax);
+        }
+    }
+}
+
+// Any pixel in the rectangle at or behind z?  The rectangle is widened to
+// groups of four, which only makes the answer more conservative.
+static bool anyDepthBehind(int x0, int y0, int x1, int y1, float z)
+{
+    __m128 z4 = _mm_set1_ps(z);
+    for (int y = y0; y <= y1; y++) {
+        const float *pRow = depthRow(y);
+        for (int x = x0 & ~3; x <= x1; x += 4) {
+            if (_mm_movemask_ps(_mm_cmpge_ps(_mm_load_ps(pRow + x), z4))) {
+                return true;
+            }
+        }
+    }
+    return false;
+}
+
+bool occlusionTestAabb(const Aabb *pBox)
+{
+    // Transform the eight corners as two groups of four in SoA form, so
+    // every operation works on four corners and there are only two divides.
+    const __m128 *m = g_ViewProjectionSplat;
+    __m128 xs = _mm_setr_ps(pBox->minX, pBox->maxX, pBox->minX, pBox->maxX);
+    __m128 ys = _mm_setr_ps(pBox->minY, pBox->minY, pBox->maxY, pBox->maxY);
+    __m128 partial[4];
+    for (int row = 0; row < 4; row++) {
+        partial[row] = _mm_add_ps(_mm_add_ps(_mm_mul_ps(m[row], xs), _mm_mul_ps(m[4 + row], ys)), m[12 + row]);
+    }
+
+    __m128 lo[3], hi[3], minW;
+    for (int group = 0; group < 2; group++) {
+        __m128 zs = _mm_set1_ps(group ? pBox->maxZ : pBox->minZ);
+        __m128 w = _mm_add_ps(partial[3], _mm_mul_ps(m[11], zs));
+        __m128 invW = _mm_div_ps(_mm_set1_ps(1.f), w);
+        minW = group ? _mm_min_ps(minW, w) : w;
+        for (int row = 0; row < 3; row++) {
+            __m128 ndc = _mm_mul_ps(_mm_add_ps(partial[row], _mm_mul_ps(m[8 + row], zs)), invW);
+            lo[row] = group ? _mm_min_ps(lo[row], ndc) : ndc;
+            hi[row] = group ? _mm_max_ps(hi[row], ndc) : ndc;
+        }
+    }
+    // Reaches behind the eye, so it can't be projected
+    if (_mm_movemask_ps(_mm_cmplt_ps(minW, _mm_set1_ps(MIN_W)))) {
+        return true;
+    }
+
+    // Reduce each coordinate across the four lanes
+    float l[3], h[3];
+    for (int row = 0; row < 3; row++) {
+        __m128 a = _mm_min_ps(lo[row], _mm_shuffle_ps(lo[row], lo[row], _MM_SHUFFLE(1, 0, 3, 2)));
+        l[row] = _mm_cvtss_f32(_mm_min_ss(a, _mm_shuffle_ps(a, a, _MM_SHUFFLE(2, 3, 0, 1))));
+        __m128 b = _mm_max_ps(hi[row], _mm_shuffle_ps(hi[row], hi[row], _MM_SHUFFLE(1, 0, 3, 2)));
+        h[row] = _mm_cvtss_f32(_mm_max_ss(b, _mm_shuffle_ps(b, b, _MM_SHUFFLE(2, 3, 0, 1))));
+    }
+    // Outside the frustum
+    if (h[0] < -1.f || l[0] > 1.f || h[1] < -1.f || l[1] > 1.f || l[2] > 1.f) {
+        return false;
+    }
+
+    int x0 = int((l[0] * .5f + .5f) * OCCLUSION_WIDTH);
+    int x1 = int((h[0] * .5f + .5f) * OCCLUSION_WIDTH);
+    int y0 = int((l[1] * .5f + .5f) * OCCLUSION_HEIGHT);
+    int y1 = int((h[1] * .5f + .5f) * OCCLUSION_HEIGHT);
+    x0 = x0 < 0 ? 0 : x0;
+    y0 = y0 < 0 ? 0 : y0;
+    x1 = x1 >= OCCLUSION_WIDTH ? OCCLUSION_WIDTH - 1 : x1;
+    y1 = y1 >= OCCLUSION_HEIGHT ? OCCLUSION_HEIGHT - 1 : y1;
+    float nearest = l[2];
+
+    // A tile whose farthest pixel is still in front of the box hides the
+    // box over the whole tile.  Otherwise look at the pixels.
+    for (int ty = y0 / OCCLUSION_TILE; ty <= y1 / OCCLUSION_TILE; ty++) {
+        for (int tx = x0 / OCCLUSION_TILE; tx <= x1 / OCCLUSION_TILE; tx++) {
+            if (nearest <= g_TileMax[ty * TILES_X + tx]) {
+                int px0 = tx * OCCLUSION_TILE, py0 = ty * OCCLUSION_TILE;
+                int px1 = px0 + OCCLUSION_TILE - 1, py1 = py0 + OCCLUSION_TILE - 1;
+                if (anyDepthBehind(px0 > x0 ? px0 : x0, py0 > y0 ? py0 : y0,
+                    px1 < x1 ? px1 : x1, py1 < y1 ? py1 : y1, nearest)) {
+                    return true;
+                }
+            }
+        }
+    }
+    return false;
+}
+
+static void testRange(const Aabb *pBoxes, int first, int last, unsigned char *pVisible, int *pCount)
+{
+    int count = 0;
+    for (int i = first; i < last; i++) {
+        pVisible[i] = occlusionTestAabb(&pBoxes[i]) ? 1 : 0;
+        count += pVisible[i];
+    }
+    *pCount = count;
+}
+
+typedef struct {
+    const Aabb *pBoxes;
+    int count, chunk;
+    unsigned char *pVisible;
+    int *pCounts;
+} TestBatch;
+
+// Workers are started the first time they're needed and then kept, so a
+// frame pays for waking them rather than for creating them.  A batch goes
+// to threads 1 to active - 1; the caller is thread 0.  The pool is never
+// freed, since workers are still waiting on it when the program exits.
+typedef struct {
+    std::mutex mutex;
+    std::condition_variable wake, done;
+    int workers;
+    long long generation;       // Batches ever started
+    int active;
+    int remaining;              // Workers still on the current batch
+    TestBatch batch;
+} WorkerPool;
+
+static WorkerPool *g_pPool;
+
+static void testChunk(const TestBatch *pBatch, int t)
+{
+    int first = t * pBatch->chunk;
+    int last = first + pBatch->chunk < pBatch->count ? first + pBatch->chunk : pBatch->count;
+    pBatch->pCounts[t] = 0;
+    if (first < last) {
+        testRange(pBatch->pBoxes, first, last, pBatch->pVisible, &pBatch->pCounts[t]);
+    }
+}
+
+static void workerMain(int t)
+{
+    WorkerPool *pPool = g_pPool;
+    long long seen = 0;
+    for (;;) {
+        TestBatch batch;
+        {
+            std::unique_lock<std::mutex> lock(pPool->mutex);
+            while (pPool->generation == seen) {
+                pPool->wake.wait(lock);
+            }
+            seen = pPool->generation;
+            if (t >= pPool->active) {
+                continue;
+            }
+            batch = pPool->batch;
+        }
+        testChunk(&batch, t);
+
+        std::lock_guard<std::mutex> lock(pPool->mutex);
+        if (--pPool->remaining == 0) {
+            pPool->done.notify_one();
+        }
+    }
+}
+
+int occlusionTestAabbs(const Aabb *pBoxes, int count, unsigned char *pVisible, int threadCount)
+{
+    if (threadCount <= 0) {
+        threadCount = int(std::thread::hardware_concurrency());
+        if (threadCount <= 0) {
+            threadCount = 1;
+        }
+    }
+    if (threadCount > count / MIN_BOXES_PER_THREAD) {
+        threadCount = count / MIN_BOXES_PER_THREAD > 0 ? count / MIN_BOXES_PER_THREAD : 1;
+    }
+    int chunk = (count + threadCount - 1) / threadCount;
+
+    // The buffers are only read from here on, so the threads share them freely.
+    // The calling thread takes the first chunk itself.
+    std::vector<int> visibleCounts(threadCount, 0);
+    TestBatch batch = { pBoxes, count, chunk, pVisible, &visibleCounts[0] };
+    if (threadCount > 1) {
+        if (!g_pPool) {
+            g_pPool = new WorkerPool();
+        }
+        std::lock_guard<std::mutex> lock(g_pPool->mutex);
+        while (g_pPool->workers < threadCount - 1) {
+            std::thread(workerMain, ++g_pPool->workers).detach();
+        }
+        g_pPool->batch = batch;
+        g_pPool->active = threadCount;
+        g_pPool->remaining = threadCount - 1;
+        g_pPool->generation++;
+        g_pPool->wake.notify_all();
+    }
+    testChunk(&batch, 0);
+    if (threadCount > 1) {
+        std::unique_lock<std::mutex> lock(g_pPool->mutex);
+        while (g_pPool->remaining > 0) {
+            g_pPool->done.wait(lock);
+        }
+    }
+
+    int visible = 0;
+    for (int t = 0; t < threadCount; t++) {
+        visible += visibleCounts[t];
+    }
+    return visible;
+}
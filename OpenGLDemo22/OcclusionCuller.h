@@ -0,0 +1,48 @@
+/*
+ * Software occlusion culling with a hierarchical depth buffer.
+ *
+ * A handful of big occluder meshes are rasterized on the CPU into a small
+ * depth buffer, four pixels at a time with SSE.  Each 8x8 tile then records
+ * the farthest depth in it.  Object bounding boxes are tested against the
+ * tiles first, and only against individual pixels where the tile test is
+ * not conclusive.
+ *
+ * Depths are NDC z (-1 near, 1 far).  Matrices are column-major, the same
+ * as GL and vmath.
+ */
+#ifndef OCCLUSION_CULLER_H
+#define OCCLUSION_CULLER_H
+
+// Must be multiples of OCCLUSION_TILE
+#define OCCLUSION_WIDTH     320
+#define OCCLUSION_HEIGHT    192
+#define OCCLUSION_TILE      8
+
+typedef struct {
+    float minX, minY, minZ;
+    float maxX, maxY, maxZ;
+} Aabb;
+
+// Clear the depth buffer and set the view-projection matrix used by
+// everything until the next call.
+void occlusionBegin(const float *viewProjection);
+
+// Rasterize an occluder.  'positions' points at the x, y, z of the first
+// vertex, 'stride' is the distance between vertices in bytes, and every three
+// indices make a triangle.  'model' is the occluder's model matrix.
+// Triangles that cross the near plane are skipped, which can only make the
+// culling less aggressive, never wrong.
+void occlusionAddOccluder(const float *model, const void *positions, int stride,
+    const unsigned short *indices, int indexCount);
+
+// Build the tile level.  Call after the last occluder.
+void occlusionFinish();
+
+// True if any part of the (world space) box might be visible
+bool occlusionTestAabb(const Aabb *pBox);
+
+// Test many boxes, split over 'threadCount' threads (0 = one per core).
+// pVisible[i] is set to 1 or 0.  Returns the number of visible boxes.
+int occlusionTestAabbs(const Aabb *pBoxes, int count, unsigned char *pVisible, int threadCount);
+
+#endif
@@ -0,0 +1,416 @@
+/*
+ * Demo 22:
+ * Occlusion culling on the CPU.  A few walls are rasterized in software
+ * into a small depth buffer every frame, and each of the 10,000 pyramids
+ * behind them is tested against it before it is drawn.
+ *
+ * Press C to turn culling on and off, any other key to exit.
+ *
+ * See README.txt for prerequisites.
+ */
+#include <windows.h>
+#include <WinGDI.h>
+
+#include <GL/glew.h>
+#include <GL/wglew.h>
+#include <GL/GL.h>
+#include <GL/glut.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stddef.h>
+#include <math.h>
+
+#include <vmath.h>
+using vmath::mat4;
+using vmath::vec3;
+
+#include "OcclusionCuller.h"
+
+// Apparently someone is still using segmented memory qualifiers,
+// and windows.h is letting them.
+#undef near
+#undef far
+
+#define WINDOW_WIDTH    640
+#define WINDOW_HEIGHT   480
+
+#define NEAR_Z          .5f
+#define FAR_Z           300.0f
+
+#define GRID_SIZE       100
+#define OBJECT_COUNT    (GRID_SIZE * GRID_SIZE)
+#define GRID_SPACING    2.f
+
+#define WALL_COUNT      40
+#define WALL_LENGTH     16.f
+#define WALL_HEIGHT     5.f
+#define WALL_THICKNESS  1.f
+
+// The camera walks around this circle, at eye height
+#define PATH_RADIUS     40.f
+#define EYE_HEIGHT      1.7f
+
+// Size of the startup benchmark
+#define BENCHMARK_BOXES 100000
+
+// Exercise:  Set this to 1 and compare the cull times
+#define CULL_THREADS    0       // 0 = one per core
+
+typedef struct {
+    GLsizei count;      // Number of vertices or indices
+    GLuint vaoId;
+} ShapeInfo;
+
+typedef struct {
+    float x, z;
+    float rotyDegrees;
+} ObjectInfo;
+
+typedef struct {
+    float x, z;
+    float rotyDegrees;
+    mat4 model;
+} WallInfo;
+
+typedef struct {
+    GLfloat x, y, z;
+    GLubyte red, green, blue;
+} VertexInfo;
+
+// A unit cube from (-.5, 0, -.5) to (.5, 1, .5), shared by the GL walls and
+// the software rasterizer
+static const VertexInfo cubeData[] = {
+    { -.5f, 0.f, -.5f, 90, 90, 100 }, { .5f, 0.f, -.5f, 90, 90, 100 },
+    { .5f, 1.f, -.5f, 160, 160, 170 }, { -.5f, 1.f, -.5f, 160, 160, 170 },
+    { -.5f, 0.f, .5f, 90, 90, 100 }, { .5f, 0.f, .5f, 90, 90, 100 },
+    { .5f, 1.f, .5f, 160, 160, 170 }, { -.5f, 1.f, .5f, 160, 160, 170 },
+};
+static const GLushort cubeIndices[] = {
+    0, 2, 1, 0, 3, 2,   // Back
+    4, 5, 6, 4, 6, 7,   // Front
+    0, 4, 7, 0, 7, 3,   // Left
+    1, 2, 6, 1, 6, 5,   // Right
+    3, 7, 6, 3, 6, 2,   // Top
+    0, 1, 5, 0, 5, 4,   // Bottom
+};
+
+ShapeInfo g_Pyramid, g_Cube;
+ObjectInfo g_Objects[OBJECT_COUNT];
+Aabb g_Bounds[OBJECT_COUNT];
+unsigned char g_Visible[OBJECT_COUNT];
+WallInfo g_Walls[WALL_COUNT];
+GLint g_MatrixUniform;
+mat4 g_ProjectionMatrix(mat4::identity());
+bool g_Culling = true;
+
+// Must match hard-coded vPosition location in vertShaderSource
+#define V_POSITION 0
+
+// Must match hard-coded location in vertShaderSource
+#define C_POSITION 1
+
+// glutGet(GLUT_ELAPSED_TIME) only counts whole milliseconds, and the
+// culling takes less than one.
+double timeMs()
+{
+    static LARGE_INTEGER frequency = { 0 };
+    if (frequency.QuadPart == 0) {
+        QueryPerformanceFrequency(&frequency);
+    }
+    LARGE_INTEGER now;
+    QueryPerformanceCounter(&now);
+    return 1000. * double(now.QuadPart) / double(frequency.QuadPart);
+}
+
+float randomFloat(float low, float high)
+{
+    return low + (high - low) * float(rand()) / float(RAND_MAX);
+}
+
+void setupShaders()
+{
+    GLchar infoLog[4096];
+    GLsizei length;
+
+    const GLchar *vertShaderSource[] = {
+        "#version 430 core\n"
+        "uniform mat4 ModelViewProject;\n"
+        "layout(location = 0) in vec4 vPosition;\n"
+        "layout(location = 1) in vec3 vColor;\n"
+        "out vec3 color;\n"
+        "void main() {\n"
+        "    gl_Position = ModelViewProject * vPosition;\n"
+        "    color = vColor;\n"
+        "}\n"
+    };
+    GLuint vertShader = glCreateShader(GL_VERTEX_SHADER);
+    glShaderSource(vertShader, 1, vertShaderSource, NULL);
+
+    const GLchar *fragShaderSource[] = {
+        "#version 430 core\n"
+        "in vec3 color;\n"
+        "out vec4 fColor;\n"
+        "void main() {\n"
+        "    fColor = vec4(color, 1);\n"
+        "}\n"
+    };
+    GLuint fragShader = glCreateShader(GL_FRAGMENT_SHADER);
+    glShaderSource(fragShader, 1, fragShaderSource, NULL);
+
+    GLuint program = glCreateProgram();
+    glAttachShader(program, vertShader);
+    glCompileShader(vertShader);
+    glGetShaderInfoLog(vertShader, 4096, &length, infoLog);
+
+    glAttachShader(program, fragShader);
+    glCompileShader(fragShader);
+    glGetShaderInfoLog(fragShader, 4096, &length, infoLog);
+
+    glLinkProgram(program);
+    glUseProgram(program);
+    g_MatrixUniform = glGetUniformLocation(program, "ModelViewProject");
+}
+
+void setupPyramid(ShapeInfo *pInfo)
+{
+    static const VertexInfo pyramidData[] = {
+        // Bottom
+        { 0.0f, 0.f, .5f, 255, 0, 0},
+        { 0.433f, 0.f, -.25f, 255, 0, 0},
+        { -0.433f, 0.f, -.25f, 255, 0, 0},
+        // Side 1
+        { -0.433f, 0.f, -.25f, 0, 0, 255},
+        { 0.433f, 0.f, -.25f, 0, 255, 255},
+        { 0.0f, 0.75f, 0.f, 255, 0, 255},
+        // Side 2
+        { -0.433f, 0.f, -.25f, 255, 255, 0},
+        { 0.0f, 0.f, .5f, 255, 255, 0},
+        { 0.0f, 0.75f, 0.f, 255, 255, 0},
+        // Side 3
+        { 0.0f, 0.f, .5f, 0, 255, 0},
+        { 0.433f, 0.f, -.25f, 0, 255, 0},
+        { 0.0f, 0.75f, 0.f, 0, 255, 0},
+    };
+
+    GLuint vboId;
+    glGenVertexArrays(1, &pInfo->vaoId);
+    glBindVertexArray(pInfo->vaoId);
+    glGenBuffers(1, &vboId);
+    glBindBuffer(GL_ARRAY_BUFFER, vboId);
+    glBufferData(GL_ARRAY_BUFFER, sizeof(pyramidData), pyramidData, GL_STATIC_DRAW);
+    glVertexAttribPointer(V_POSITION, 3, GL_FLOAT, GL_FALSE, sizeof(VertexInfo), (GLvoid*)offsetof(VertexInfo, x));
+    glEnableVertexAttribArray(V_POSITION);
+    glVertexAttribPointer(C_POSITION, 3, GL_UNSIGNED_BYTE, GL_TRUE, sizeof(VertexInfo), (GLvoid*)offsetof(VertexInfo, red));
+    glEnableVertexAttribArray(C_POSITION);
+    pInfo->count = 12;
+    glBindVertexArray(0);
+}
+
+void setupCube(ShapeInfo *pInfo)
+{
+    GLuint buffers[2];
+    glGenVertexArrays(1, &pInfo->vaoId);
+    glBindVertexArray(pInfo->vaoId);
+    glGenBuffers(2, buffers);
+    glBindBuffer(GL_ARRAY_BUFFER, buffers[0]);
+    glBufferData(GL_ARRAY_BUFFER, sizeof(cubeData), cubeData, GL_STATIC_DRAW);
+    glVertexAttribPointer(V_POSITION, 3, GL_FLOAT, GL_FALSE, sizeof(VertexInfo), (GLvoid*)offsetof(VertexInfo, x));
+    glEnableVertexAttribArray(V_POSITION);
+    glVertexAttribPointer(C_POSITION, 3, GL_UNSIGNED_BYTE, GL_TRUE, sizeof(VertexInfo), (GLvoid*)offsetof(VertexInfo, red));
+    glEnableVertexAttribArray(C_POSITION);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, buffers[1]);
+    glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(cubeIndices), cubeIndices, GL_STATIC_DRAW);
+    pInfo->count = sizeof(cubeIndices) / sizeof(cubeIndices[0]);
+    glBindVertexArray(0);
+}
+
+// Pyramid bounds for any rotation about y:  the base fits in a circle of
+// radius .5, and the apex is .75 up.
+void pyramidBounds(float x, float z, Aabb *pBox)
+{
+    pBox->minX = x - .5f;
+    pBox->maxX = x + .5f;
+    pBox->minY = 0.f;
+    pBox->maxY = .75f;
+    pBox->minZ = z - .5f;
+    pBox->maxZ = z + .5f;
+}
+
+void setupScene()
+{
+    srand(22);
+    for (int row = 0; row < GRID_SIZE; row++) {
+        for (int col = 0; col < GRID_SIZE; col++) {
+            int n = row * GRID_SIZE + col;
+            ObjectInfo *pObject = &g_Objects[n];
+            pObject->x = (col - GRID_SIZE / 2) * GRID_SPACING;
+            pObject->z = (row - GRID_SIZE / 2) * GRID_SPACING;
+            pObject->rotyDegrees = randomFloat(0.f, 360.f);
+            pyramidBounds(pObject->x, pObject->z, &g_Bounds[n]);
+        }
+    }
+
+    // Keep the walls off the camera's path, so it doesn't walk through them
+    for (int i = 0; i < WALL_COUNT; i++) {
+        WallInfo *pWall = &g_Walls[i];
+        float distance;
+        do {
+            pWall->x = randomFloat(-70.f, 70.f);
+            pWall->z = randomFloat(-70.f, 70.f);
+            distance = sqrtf(pWall->x * pWall->x + pWall->z * pWall->z);
+        } while (fabsf(distance - PATH_RADIUS) < WALL_LENGTH / 2 + 2.f);
+        pWall->rotyDegrees = randomFloat(0.f, 180.f);
+        pWall->model = vmath::translate(pWall->x, 0.f, pWall->z);
+        pWall->model *= vmath::rotate(pWall->rotyDegrees, 0.f, 1.f, 0.f);
+        pWall->model *= vmath::scale(WALL_LENGTH, WALL_HEIGHT, WALL_THICKNESS);
+    }
+}
+
+void setupFrustum(float left, float right, float bottom, float top, float zNear, float zFar)
+{
+    g_ProjectionMatrix = vmath::frustum(left, right, bottom, top, zNear, zFar);
+}
+
+mat4 cameraAt(float angle)
+{
+    // Walk counter-clockwise, looking along the path
+    vec3 eye(PATH_RADIUS * cosf(angle), EYE_HEIGHT, PATH_RADIUS * sinf(angle));
+    vec3 target(eye[0] - sinf(angle), EYE_HEIGHT, eye[2] + cosf(angle));
+    return vmath::lookat(eye, target, vec3(0.f, 1.f, 0.f));
+}
+
+// Rasterize the walls, then test every pyramid.  Returns the number visible.
+int cullObjects(const mat4 &viewProjection, const Aabb *pBounds, int count, unsigned char *pVisible)
+{
+    occlusionBegin(viewProjection);
+    for (int i = 0; i < WALL_COUNT; i++) {
+        occlusionAddOccluder(g_Walls[i].model, &cubeData[0].x, sizeof(VertexInfo),
+            cubeIndices, sizeof(cubeIndices) / sizeof(cubeIndices[0]));
+    }
+    occlusionFinish();
+    return occlusionTestAabbs(pBounds, count, pVisible, CULL_THREADS);
+}
+
+// The per-frame test only has 10,000 objects; see how long ten times that
+// many takes, from a few places on the path.
+void runBenchmark()
+{
+    Aabb *pBoxes = new Aabb[BENCHMARK_BOXES];
+    unsigned char *pVisible = new unsigned char[BENCHMARK_BOXES];
+    for (int i = 0; i < BENCHMARK_BOXES; i++) {
+        pyramidBounds(randomFloat(-100.f, 100.f), randomFloat(-100.f, 100.f), &pBoxes[i]);
+    }
+
+    for (int view = 0; view < 4; view++) {
+        mat4 viewProjection = g_ProjectionMatrix * cameraAt(view * 1.57f);
+        double best = 1e9;
+        int visible = 0;
+        for (int run = 0; run < 20; run++) {
+            double start = timeMs();
+            visible = cullObjects(viewProjection, pBoxes, BENCHMARK_BOXES, pVisible);
+            double elapsed = timeMs() - start;
+            best = elapsed < best ? elapsed : best;
+        }
+        printf("Benchmark view %d: %d of %d boxes visible, culled in %.3f ms\n",
+            view, visible, BENCHMARK_BOXES, best);
+    }
+    delete[] pBoxes;
+    delete[] pVisible;
+}
+
+void drawShapeAt(const mat4 &viewProjection, const mat4 &model, ShapeInfo *pInfo, bool indexed)
+{
+    glUniformMatrix4fv(g_MatrixUniform, 1, GL_FALSE, viewProjection * model);
+    glBindVertexArray(pInfo->vaoId);
+    if (indexed) {
+        glDrawElements(GL_TRIANGLES, pInfo->count, GL_UNSIGNED_SHORT, 0);
+    }
+    else {
+        glDrawArrays(GL_TRIANGLES, 0, pInfo->count);
+    }
+}
+
+void onDisplay()
+{
+    static int i = 0;
+    static int frames = 0;
+    static double cullTime = 0., drawn = 0.;
+    static double lastReport = timeMs();
+    i++;
+
+    mat4 viewProjection = g_ProjectionMatrix * cameraAt(i * .002f);
+
+    double start = timeMs();
+    int visible = OBJECT_COUNT;
+    if (g_Culling) {
+        visible = cullObjects(viewProjection, g_Bounds, OBJECT_COUNT, g_Visible);
+    }
+    cullTime += timeMs() - start;
+    drawn += visible;
+
+    glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+    for (int n = 0; n < WALL_COUNT; n++) {
+        drawShapeAt(viewProjection, g_Walls[n].model, &g_Cube, true);
+    }
+    for (int n = 0; n < OBJECT_COUNT; n++) {
+        if (g_Culling && !g_Visible[n]) {
+            continue;
+        }
+        const ObjectInfo *pObject = &g_Objects[n];
+        mat4 model(vmath::translate(pObject->x, 0.f, pObject->z));
+        model *= vmath::rotate(pObject->rotyDegrees, 0.f, 1.f, 0.f);
+        drawShapeAt(viewProjection, model, &g_Pyramid, false);
+    }
+    glutSwapBuffers();
+
+    frames++;
+    double now = timeMs();
+    if (now - lastReport >= 2000.) {
+        printf("Culling %s: %.0f of %d drawn, %.3f ms culling, %.2f ms per frame\n",
+            g_Culling ? "on " : "off", drawn / frames, OBJECT_COUNT, cullTime / frames,
+            (now - lastReport) / frames);
+        frames = 0;
+        cullTime = drawn = 0.;
+        lastReport = now;
+    }
+}
+
+void onKey(unsigned char key, int x, int y)
+{
+    if (key == 'c' || key == 'C') {
+        g_Culling = !g_Culling;
+        return;
+    }
+    exit(0);
+}
+
+int main(int argc, char *argv[])
+{
+    glutInit(&argc, argv);
+    glutInitDisplayMode(GLUT_RGBA | GLUT_DOUBLE | GLUT_DEPTH);
+    glutInitWindowSize(WINDOW_WIDTH, WINDOW_HEIGHT);
+    glutCreateWindow(argv[0]);
+
+    glewInit();
+
+    // No vsync, so the frame times mean something
+    wglSwapIntervalEXT(0);
+
+    glEnable(GL_DEPTH_TEST);
+
+    GLfloat ratio = float(WINDOW_WIDTH) / WINDOW_HEIGHT;
+    setupFrustum(-ratio * NEAR_Z, ratio * NEAR_Z, -NEAR_Z, NEAR_Z, NEAR_Z, FAR_Z);
+
+    setupShaders();
+    setupPyramid(&g_Pyramid);
+    setupCube(&g_Cube);
+    setupScene();
+    runBenchmark();
+    glutDisplayFunc(onDisplay);
+    glutIdleFunc(onDisplay);
+    glutKeyboardFunc(onKey);
+    glutMainLoop();
+
+    return 0;
+}
@@ -0,0 +1,304 @@
+/*
+ * Demo 23:
+ * Shaders loaded from files, and rebuilt on a background thread whenever
+ * the files change (see ShaderReload.h).  Edit shaders/pyramid.frag while
+ * the demo runs; the old program keeps drawing until the new one is ready.
+ *
+ * Run from the project directory, so shaders/ can be found.
+ *
+ * See README.txt for prerequisites.
+ */
+#include <windows.h>
+#include <WinGDI.h>
+
+#include <GL/glew.h>
+#include <GL/wglew.h>
+#include <GL/GL.h>
+#include <GL/glut.h>
+
+#include <stdio.h>
+#include <stddef.h>
+
+#include <vmath.h>
+using vmath::mat4;
+
+#include "ShaderReload.h"
+
+// Apparently someone is still using segmented memory qualifiers,
+// and windows.h is letting them.
+#undef near
+#undef far
+
+#define CENTER_Z        6.0f     // Distance from camera
+#define DEPTH_OF_FIELD  5.0f
+
+typedef struct {
+    GLsizei count;
+    GLuint vaoId;
+} ShapeInfo;
+
+ShapeInfo g_Pyramid;
+int g_PyramidShader;
+GLint g_MatrixUniform, g_SamplerUniform;
+mat4 g_ProjectionMatrix(mat4::identity());
+
+#define BLOCKY_SAMPLER 1
+
+// Must match hard-coded vPosition location in shaders/pyramid.vert
+#define V_POSITION 0
+
+// Must match hard-coded location in shaders/pyramid.vert
+#define C_POSITION 1
+
+// Must match hard-coded vTexture location in shaders/pyramid.vert
+#define T_POSITION 2
+
+// glutGet(GLUT_ELAPSED_TIME) only counts whole milliseconds
+double timeMs()
+{
+    static LARGE_INTEGER frequency = { 0 };
+    if (frequency.QuadPart == 0) {
+        QueryPerformanceFrequency(&frequency);
+    }
+    LARGE_INTEGER now;
+    QueryPerformanceCounter(&now);
+    return 1000. * double(now.QuadPart) / double(frequency.QuadPart);
+}
+
+void setupShaders()
+{
+    // Nothing is compiled here; the first build happens in the background
+    // like any later one.
+    if (!shaderReloadInit("shaders")) {
+        exit(1);
+    }
+    g_PyramidShader = shaderReloadAdd("pyramid.vert", "pyramid.frag");
+}
+
+// Called whenever the pyramid program is replaced.  Uniform locations and
+// values belong to the program, so they have to be set up again.
+void useNewProgram(GLuint program)
+{
+    glUseProgram(program);
+    g_MatrixUniform = glGetUniformLocation(program, "ModelViewProject");
+    g_SamplerUniform = glGetUniformLocation(program, "tex");
+    glUniform1i(g_SamplerUniform, BLOCKY_SAMPLER);
+}
+
+// Convert a simple bitmap (one bit per pixel) into an RGBA bitmap (four bytes per pixel)
+GLubyte* BuildMonochromeBitmap(const GLubyte* bits, int width, int height, GLubyte red, GLubyte green, GLubyte blue)
+{
+    GLubyte* retval = (GLubyte *)malloc(width * height * 4);
+    if (retval) {
+        GLubyte* ptr = retval;
+        for (int y = 0; y < height; y++) {
+            for (int x = 0; x < width/8; x++) {
+                GLubyte next8 = *bits++;
+                for (int mask = 128; mask > 0; mask >>= 1) {
+                    if (next8 & mask) {
+                        *ptr++ = red;
+                        *ptr++ = green;
+                        *ptr++ = blue;
+                        *ptr++ = 255;
+                    }
+                    else {
+                        *ptr++ = 0;
+                        *ptr++ = 0;
+                        *ptr++ = 0;
+                        *ptr++ = 0;
+                    }
+                }
+            }
+        }
+    }
+    return retval;
+}
+
+#define BITMAP_WIDTH 16
+#define BITMAP_HEIGHT 16
+#define BIT_BYTES ((BITMAP_WIDTH / 8) * BITMAP_HEIGHT)
+
+void setupTextures()
+{
+    // smiley face
+    GLubyte bits[BIT_BYTES] = {
+        0x00, 0x00,
+        0x00, 0x00,
+        0x07, 0xE0,
+        0x08, 0x10,
+        0x10, 0x08,
+        0x20, 0x04,
+        0x44, 0x22,
+        0x40, 0x02,
+        0x40, 0x02,
+        0x40, 0x02,
+        0x42, 0x42,
+        0x23, 0xc4,
+        0x10, 0x08,
+        0x0c, 0x30,
+        0x03, 0xc0,
+        0x00, 0x00,
+    };
+
+    GLubyte* data = BuildMonochromeBitmap(bits, BITMAP_WIDTH, BITMAP_HEIGHT, 255, 0, 0);
+    GLuint texture = 0;
+    if (data) {
+        glGenTextures(1, &texture);
+        if (texture) {
+            glBindTexture(GL_TEXTURE_2D, texture);
+            // Only need one mipmap level for nearest sampling
+            glTexStorage2D(GL_TEXTURE_2D, 1, GL_RGBA8, BITMAP_WIDTH, BITMAP_HEIGHT);
+            glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, BITMAP_WIDTH, BITMAP_HEIGHT, GL_RGBA, GL_UNSIGNED_BYTE, data);
+        }
+        free(data);
+    }
+
+    if (texture) {
+        GLuint sampler;
+        glGenSamplers(1, &sampler);
+        if (sampler) {
+            glActiveTexture(GL_TEXTURE1);
+            glBindTexture(GL_TEXTURE_2D, texture);
+            glBindSampler(BLOCKY_SAMPLER, sampler);
+            glSamplerParameteri(sampler, GL_TEXTURE_WRAP_S, GL_REPEAT);
+            glSamplerParameteri(sampler, GL_TEXTURE_WRAP_T, GL_REPEAT);
+            glSamplerParameteri(sampler, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+            glSamplerParameteri(sampler, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+        }
+    }
+}
+
+void setupPyramid(ShapeInfo *pInfo)
+{
+    typedef struct {
+        GLfloat x, y, z;
+        GLubyte red, green, blue;
+        GLfloat texU, texV;
+    } VertexInfo;
+
+    GLuint vaoId(0);
+
+    static const VertexInfo pyramidData[] = {
+        // Bottom
+        { 0.0f, 0.f, .5f, 255, 0, 0, 0.f, 0.f},
+        { 0.433f, 0.f, -.25f, 255, 0, 0, 0.f, 1.f},
+        { -0.433f, 0.f, -.25f, 255, 0, 0, 1.f, 1.f},
+        // Side 1
+        { -0.433f, 0.f, -.25f, 0, 0, 255, 0.f, 0.f},
+        { 0.433f, 0.f, -.25f, 0, 255, 255, 1.f, 0.f},
+        { 0.0f, 0.75f, 0.f, 255, 0, 255, 1.f, 1.f},
+        // Side 2
+        { -0.433f, 0.f, -.25f, 255, 255, 0, 0.f, 0.f},
+        { 0.0f, 0.f, .5f, 255, 255, 0, 0.f, 1.f},
+        { 0.0f, 0.75f, 0.f, 255, 255, 0, 1.f, 1.f},
+        // Side 3
+        { 0.0f, 0.f, .5f, 0, 255, 0, 4.f, 4.f},
+        { 0.0f, 0.75f, 0.f, 0, 255, 0, 2.f, 0.f},
+        { 0.433f, 0.f, -.25f, 0, 255, 0, 0.f, 4.f},
+    };
+
+    glGenVertexArrays(1, &vaoId);
+    glBindVertexArray(vaoId);
+    GLuint bufferId;
+    glGenBuffers(1, &bufferId);
+    glBindBuffer(GL_ARRAY_BUFFER, bufferId);
+    glBufferData(GL_ARRAY_BUFFER, sizeof(pyramidData), pyramidData, GL_STATIC_DRAW);
+
+    glVertexAttribPointer(V_POSITION, 3, GL_FLOAT, GL_FALSE, sizeof(VertexInfo), (GLvoid*)offsetof(VertexInfo, x));
+    glEnableVertexAttribArray(V_POSITION);
+    glVertexAttribPointer(C_POSITION, 3, GL_UNSIGNED_BYTE, GL_TRUE, sizeof(VertexInfo), (GLvoid*)offsetof(VertexInfo, red));
+    glEnableVertexAttribArray(C_POSITION);
+    glVertexAttribPointer(T_POSITION, 2, GL_FLOAT, GL_FALSE, sizeof(VertexInfo), (GLvoid*)offsetof(VertexInfo, texU));
+    glEnableVertexAttribArray(T_POSITION);
+
+    pInfo->count = 12;
+    pInfo->vaoId = vaoId;
+}
+
+void setupFrustum(float left, float right, float bottom, float top, float zNear, float zFar)
+{
+    g_ProjectionMatrix = vmath::frustum(left, right, bottom, top, zNear, zFar);
+}
+
+void drawTrianglesAt(float x, float y, float z, float rotyDegrees, float scale, ShapeInfo *pInfo)
+{
+    mat4 modelViewMatrix(vmath::translate(x, y, z - CENTER_Z));
+    modelViewMatrix *= vmath::rotate(rotyDegrees, 0.f, 1.f, 0.f);
+    modelViewMatrix *= vmath::scale(scale, scale, scale);
+
+    glUniformMatrix4fv(g_MatrixUniform, 1, GL_FALSE, g_ProjectionMatrix * modelViewMatrix);
+    glBindVertexArray(pInfo->vaoId);
+    glDrawArrays(GL_TRIANGLES, 0, pInfo->count);
+}
+
+void onDisplay()
+{
+    static int i = 0;
+    static int frames = 0;
+    static double worstFrame = 0.;
+    static double lastFrame = timeMs(), lastReport = lastFrame;
+    i++;
+
+    if (shaderReloadUpdate()) {
+        useNewProgram(shaderReloadProgram(g_PyramidShader));
+    }
+
+    glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+    // Nothing to draw with until the first build finishes
+    if (shaderReloadProgram(g_PyramidShader)) {
+        float angle = i/100.f;
+        drawTrianglesAt(cosf(angle), sinf(angle), 0.f, i*1.f, 2.f, &g_Pyramid);
+
+        float angle2 = angle + 2 * float(M_PI) / 3.f;
+        drawTrianglesAt(cosf(angle2), sinf(angle2), 0.f, i*.3f, 1.5f, &g_Pyramid);
+
+        float angle3 = angle + 4 * float(M_PI) / 3.f;
+        drawTrianglesAt(cosf(angle3), sinf(angle3), 0.f, i*3.f, 1.2f, &g_Pyramid);
+    }
+    glutSwapBuffers();
+
+    // Report the worst frame as well as the average, since a stall from
+    // compiling on this thread would only show up in one frame.
+    frames++;
+    double now = timeMs();
+    worstFrame = (now - lastFrame > worstFrame) ? now - lastFrame : worstFrame;
+    lastFrame = now;
+    if (now - lastReport >= 2000.) {
+        printf("%.2f ms per frame, worst %.2f ms\n", (now - lastReport) / frames, worstFrame);
+        frames = 0;
+        worstFrame = 0.;
+        lastReport = now;
+    }
+}
+
+void onKey(unsigned char key, int x, int y)
+{
+    shaderReloadShutdown();
+    exit(0);
+}
+
+int main(int argc, char *argv[])
+{
+    glutInit(&argc, argv);
+    glutInitDisplayMode(GLUT_RGBA | GLUT_DOUBLE | GLUT_DEPTH);
+    glutInitWindowSize(640, 480);
+    glutCreateWindow(argv[0]);
+
+    glewInit();
+    wglSwapIntervalEXT(1);	// vsync
+
+    glEnable(GL_DEPTH_TEST);
+
+    GLfloat ratio = 640.0f / 480.0f;
+    setupFrustum(-ratio, ratio, -1., 1., CENTER_Z - DEPTH_OF_FIELD/2, CENTER_Z + DEPTH_OF_FIELD/2);
+
+    setupShaders();
+    setupPyramid(&g_Pyramid);
+    setupTextures();
+    glutDisplayFunc(onDisplay);
+    glutIdleFunc(onDisplay);
+    glutKeyboardFunc(onKey);
+    glutMainLoop();
+
+    return 0;
+}
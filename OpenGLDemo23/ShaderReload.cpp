@@ -0,0 +1,308 @@
+/*
+ * Background shader rebuilding.  See ShaderReload.h.
+ */
+#include <windows.h>
+
+#include "ShaderReload.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <string>
+#include <vector>
+#include <thread>
+#include <mutex>
+
+// Check the file times this often even without a change notification
+#define POLL_MS     500
+
+// Editors often write a file in several steps; give them time to finish
+#define SETTLE_MS   50
+
+typedef struct {
+    std::string vertPath, fragPath;
+    FILETIME vertTime, fragTime;    // Watcher thread only:  as of the last build
+    GLuint program;                 // Render thread only
+} ReloadEntry;
+
+typedef struct {
+    int handle;
+    GLuint program;
+    GLsync fence;
+} ReloadPending;
+
+static std::string g_Directory;
+static HDC g_Hdc;
+static HGLRC g_WatcherContext;
+static HANDLE g_StopEvent, g_WakeEvent;
+static std::thread g_Watcher;
+
+// g_Mutex guards g_Entries being added to (not the fields noted above) and
+// everything in g_Pending.
+static std::mutex g_Mutex;
+static std::vector<ReloadEntry> g_Entries;
+static std::vector<ReloadPending> g_Pending;
+
+static bool readFile(const std::string &path, std::string *pText)
+{
+    FILE *pFile = fopen(path.c_str(), "rb");
+    if (!pFile) {
+        return false;
+    }
+    pText->clear();
+    char buffer[4096];
+    size_t count;
+    while ((count = fread(buffer, 1, sizeof(buffer), pFile)) > 0) {
+        pText->append(buffer, count);
+    }
+    fclose(pFile);
+    return true;
+}
+
+// Zero if the file is missing
+static FILETIME lastWriteTime(const std::string &path)
+{
+    WIN32_FILE_ATTRIBUTE_DATA data;
+    if (!GetFileAttributesExA(path.c_str(), GetFileExInfoStandard, &data)) {
+        FILETIME none = { 0, 0 };
+        return none;
+    }
+    return data.ftLastWriteTime;
+}
+
+static GLuint compileShader(GLenum type, const std::string &path)
+{
+    std::string source;
+    if (!readFile(path, &source)) {
+        printf("Can't read %s\n", path.c_str());
+        return 0;
+    }
+
+    GLuint shader = glCreateShader(type);
+    const GLchar *pSource = source.c_str();
+    glShaderSource(shader, 1, &pSource, NULL);
+    glCompileShader(shader);
+
+    GLint compiled;
+    glGetShaderiv(shader, GL_COMPILE_STATUS, &compiled);
+    if (!compiled) {
+        GLchar infoLog[4096];
+        GLsizei length;
+        glGetShaderInfoLog(shader, 4096, &length, infoLog);
+        printf("%s failed to compile:\n%s\n", path.c_str(), infoLog);
+        glDeleteShader(shader);
+        return 0;
+    }
+    return shader;
+}
+
+// Watcher thread.  Returns 0 if anything failed.
+static GLuint buildProgram(const std::string &vertPath, const std::string &fragPath)
+{
+    GLuint vertShader = compileShader(GL_VERTEX_SHADER, vertPath);
+    GLuint fragShader = compileShader(GL_FRAGMENT_SHADER, fragPath);
+    if (!vertShader || !fragShader) {
+        glDeleteShader(vertShader);
+        glDeleteShader(fragShader);
+        return 0;
+    }
+
+    GLuint program = glCreateProgram();
+    glAttachShader(program, vertShader);
+    glAttachShader(program, fragShader);
+    glLinkProgram(program);
+
+    // Asking for the status makes the driver finish linking here, rather
+    // than on the render thread at the first draw.
+    GLint linked;
+    glGetProgramiv(program, GL_LINK_STATUS, &linked);
+    glDetachShader(program, vertShader);
+    glDetachShader(program, fragShader);
+    glDeleteShader(vertShader);
+    glDeleteShader(fragShader);
+    if (!linked) {
+        GLchar infoLog[4096];
+        GLsizei length;
+        glGetProgramInfoLog(program, 4096, &length, infoLog);
+        printf("%s + %s failed to link:\n%s\n", vertPath.c_str(), fragPath.c_str(), infoLog);
+        glDeleteProgram(program);
+        return 0;
+    }
+    return program;
+}
+
+// Watcher thread
+static void rebuildChanged()
+{
+    size_t count;
+    {
+        std::lock_guard<std::mutex> lock(g_Mutex);
+        count = g_Entries.size();
+    }
+
+    for (size_t i = 0; i < count; i++) {
+        std::string vertPath, fragPath;
+        FILETIME vertTime, fragTime;
+        {
+            // The vector may grow (and move) while we build, so copy out
+            std::lock_guard<std::mutex> lock(g_Mutex);
+            vertPath = g_Entries[i].vertPath;
+            fragPath = g_Entries[i].fragPath;
+            vertTime = g_Entries[i].vertTime;
+            fragTime = g_Entries[i].fragTime;
+        }
+        FILETIME newVertTime = lastWriteTime(vertPath);
+        FILETIME newFragTime = lastWriteTime(fragPath);
+        if (CompareFileTime(&newVertTime, &vertTime) == 0 && CompareFileTime(&newFragTime, &fragTime) == 0) {
+            continue;
+        }
+
+        // Remember the times even if the build fails, so a broken file is
+        // only reported once per save.
+        GLuint program = buildProgram(vertPath, fragPath);
+        std::lock_guard<std::mutex> lock(g_Mutex);
+        g_Entries[i].vertTime = newVertTime;
+        g_Entries[i].fragTime = newFragTime;
+        if (program) {
+            // The render thread can't use the program until this context's
+            // commands have reached the GPU.
+            ReloadPending pending = { int(i), program, glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0) };
+            glFlush();
+            g_Pending.push_back(pending);
+            printf("Rebuilt %s + %s\n", vertPath.c_str(), fragPath.c_str());
+        }
+    }
+}
+
+static void watch()
+{
+    wglMakeCurrent(g_Hdc, g_WatcherContext);
+
+    HANDLE change = FindFirstChangeNotificationA(g_Directory.c_str(), FALSE,
+        FILE_NOTIFY_CHANGE_LAST_WRITE | FILE_NOTIFY_CHANGE_FILE_NAME);
+    HANDLE handles[3] = { g_StopEvent, g_WakeEvent, change };
+    DWORD handleCount = (change == INVALID_HANDLE_VALUE) ? 2 : 3;
+    if (change == INVALID_HANDLE_VALUE) {
+        printf("Can't watch %s, polling instead\n", g_Directory.c_str());
+    }
+
+    for (;;) {
+        DWORD result = WaitForMultipleObjects(handleCount, handles, FALSE, POLL_MS);
+        if (result == WAIT_OBJECT_0) {
+            break;
+        }
+        if (result == WAIT_OBJECT_0 + 2) {
+            Sleep(SETTLE_MS);
+            FindNextChangeNotification(change);
+        }
+        rebuildChanged();
+    }
+
+    if (change != INVALID_HANDLE_VALUE) {
+        FindCloseChangeNotification(change);
+    }
+    wglMakeCurrent(NULL, NULL);
+}
+
+bool shaderReloadInit(const char *directory)
+{
+    g_Directory = directory;
+    g_Hdc = wglGetCurrentDC();
+
+    // The new context must not have any objects of its own when it starts
+    // sharing, so share before handing it to the thread.
+    g_WatcherContext = wglCreateContext(g_Hdc);
+    if (!g_WatcherContext || !wglShareLists(wglGetCurrentContext(), g_WatcherContext)) {
+        printf("Can't create a shared context for shader building\n");
+        if (g_WatcherContext) {
+            wglDeleteContext(g_WatcherContext);
+            g_WatcherContext = NULL;
+        }
+        return false;
+    }
+
+    g_StopEvent = CreateEventA(NULL, TRUE, FALSE, NULL);
+    g_WakeEvent = CreateEventA(NULL, FALSE, FALSE, NULL);
+    g_Watcher = std::thread(watch);
+    return true;
+}
+
+int shaderReloadAdd(const char *vertFile, const char *fragFile)
+{
+    ReloadEntry entry;
+    entry.vertPath = g_Directory + "/" + vertFile;
+    entry.fragPath = g_Directory + "/" + fragFile;
+    memset(&entry.vertTime, 0, sizeof(entry.vertTime));
+    memset(&entry.fragTime, 0, sizeof(entry.fragTime));
+    entry.program = 0;
+
+    int handle;
+    {
+        std::lock_guard<std::mutex> lock(g_Mutex);
+        handle = int(g_Entries.size());
+        g_Entries.push_back(entry);
+    }
+    SetEvent(g_WakeEvent);
+    return handle;
+}
+
+bool shaderReloadUpdate()
+{
+    bool changed = false;
+    std::lock_guard<std::mutex> lock(g_Mutex);
+    for (size_t i = 0; i < g_Pending.size(); ) {
+        ReloadPending *pPending = &g_Pending[i];
+        GLenum status = glClientWaitSync(pPending->fence, 0, 0);
+        if (status == GL_TIMEOUT_EXPIRED) {
+            i++;
+            continue;
+        }
+        glDeleteSync(pPending->fence);
+        if (status != GL_ALREADY_SIGNALED && status != GL_CONDITION_SATISFIED) {
+            // A bad sync or a lost context; nothing says the program is whole
+            const ReloadEntry &entry = g_Entries[pPending->handle];
+            printf("Waiting for %s + %s failed (0x%x); keeping the old program\n",
+                entry.vertPath.c_str(), entry.fragPath.c_str(), status);
+            glDeleteProgram(pPending->program);
+            g_Pending.erase(g_Pending.begin() + i);
+            continue;
+        }
+        ReloadEntry *pEntry = &g_Entries[pPending->handle];
+        if (pEntry->program) {
+            glDeleteProgram(pEntry->program);
+        }
+        pEntry->program = pPending->program;
+        g_Pending.erase(g_Pending.begin() + i);
+        changed = true;
+    }
+    return changed;
+}
+
+GLuint shaderReloadProgram(int handle)
+{
+    std::lock_guard<std::mutex> lock(g_Mutex);
+    return g_Entries[handle].program;
+}
+
+void shaderReloadShutdown()
+{
+    if (g_Watcher.joinable()) {
+        SetEvent(g_StopEvent);
+        g_Watcher.join();
+        CloseHandle(g_StopEvent);
+        CloseHandle(g_WakeEvent);
+    }
+    if (g_WatcherContext) {
+        wglDeleteContext(g_WatcherContext);
+        g_WatcherContext = NULL;
+    }
+
+    for (size_t i = 0; i < g_Pending.size(); i++) {
+        glDeleteSync(g_Pending[i].fence);
+        glDeleteProgram(g_Pending[i].program);
+    }
+    g_Pending.clear();
+    for (size_t i = 0; i < g_Entries.size(); i++) {
+        glDeleteProgram(g_Entries[i].program);
+    }
+    g_Entries.clear();
+}
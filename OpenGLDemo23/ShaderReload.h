@@ -0,0 +1,40 @@
+/*
+ * Shader programs loaded from files, rebuilt in the background when the
+ * files change.
+ *
+ * A watcher thread owns a second GL context that shares objects with the
+ * main one.  It waits for the shader directory to change (or polls, if
+ * change notifications aren't available), recompiles and links any program
+ * whose files are newer, and hands it to the render thread with a fence.
+ * The render thread keeps using the old program until the new one has
+ * linked and the fence has passed, so an edit never stalls a frame.  A
+ * program that fails to compile or link prints its log and is dropped; the
+ * old one stays.
+ */
+#ifndef SHADER_RELOAD_H
+#define SHADER_RELOAD_H
+
+#include <GL/glew.h>
+
+// Start the watcher thread.  Must be called on the render thread with its
+// context current, before any other shaderReload call.  Paths given to
+// shaderReloadAdd are relative to 'directory'.
+bool shaderReloadInit(const char *directory);
+
+// Register a program.  It is built in the background like any other
+// change, so shaderReloadProgram returns 0 until the first build finishes.
+// Returns a handle for shaderReloadProgram.
+int shaderReloadAdd(const char *vertFile, const char *fragFile);
+
+// Call once a frame on the render thread.  Swaps in any programs that have
+// finished building and deletes the ones they replace.  Returns true if any
+// program changed, in which case uniform locations need looking up again.
+bool shaderReloadUpdate();
+
+// The current program for a handle, or 0 if none has built yet
+GLuint shaderReloadProgram(int handle);
+
+// Stop the watcher thread and delete everything.  Render thread only.
+void shaderReloadShutdown();
+
+#endif
@@ -0,0 +1,14 @@
+#version 430 core
+uniform sampler2D tex;
+in vec3 color;
+in vec2 vs_tex_coord;
+out vec4 fColor;
+void main() {
+    vec4 texColor = texture(tex, vs_tex_coord);
+    // Edit and save this file while the demo runs.  Try one of these lines
+    // for a different effect, or break it to see the error report.
+    fColor = vec4(color, 0) * (1 - texColor.a) + texColor;
+//    fColor = vec4(vs_tex_coord, 0., 255);
+//    fColor = vec4(color, 255) + texColor;
+//    fColor = texColor;
+}
@@ -0,0 +1,12 @@
+#version 430 core
+uniform mat4 ModelViewProject;
+layout(location = 0) in vec4 vPosition;
+layout(location = 1) in vec3 vColor;
+layout(location = 2) in vec2 vTexture;
+out vec3 color;
+out vec2 vs_tex_coord;
+void main() {
+    gl_Position = ModelViewProject * vPosition;
+    vs_tex_coord = vTexture;
+    color = vColor;
+}
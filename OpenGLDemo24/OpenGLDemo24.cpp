@@ -0,0 +1,330 @@
+/*
+ * Demo 24:
+ * Shader permutations.  Demo 16 picked its sampler with #define
+ * USE_BLOCKY_SAMPLER and had alternative fColor lines commented out.  Here
+ * texturing, vertex color and blocky sampling are feature bits, every
+ * combination is built at startup (see ShaderVariants.h), and each pyramid
+ * picks its own variant at draw time.
+ *
+ * Press B to flip the blocky bit on every pyramid, any other key to exit.
+ *
+ * See README.txt for prerequisites.
+ */
+#include <windows.h>
+#include <WinGDI.h>
+
+#include <GL/glew.h>
+#include <GL/wglew.h>
+#include <GL/GL.h>
+#include <GL/glut.h>
+
+#include <stdio.h>
+#include <stddef.h>
+
+#include <vmath.h>
+using vmath::mat4;
+
+#include "ShaderVariants.h"
+
+// Apparently someone is still using segmented memory qualifiers,
+// and windows.h is letting them.
+#undef near
+#undef far
+
+#define CENTER_Z        6.0f     // Distance from camera
+#define DEPTH_OF_FIELD  5.0f
+
+typedef struct {
+    GLsizei count;
+    GLuint vaoId;
+} ShapeInfo;
+
+ShapeInfo g_Pyramid;
+mat4 g_ProjectionMatrix(mat4::identity());
+unsigned int g_BlockyFlip = 0;
+
+// Feature bits, in the same order as FEATURE_NAMES
+#define FEATURE_TEXTURE         0x1
+#define FEATURE_VERTEX_COLOR    0x2
+#define FEATURE_BLOCKY          0x4     // Nearest sampling, done in the shader
+#define FEATURE_COUNT           3
+#define VARIANT_COUNT           (1 << FEATURE_COUNT)
+
+const char *const FEATURE_NAMES[FEATURE_COUNT] = {
+    "USE_TEXTURE",
+    "USE_VERTEX_COLOR",
+    "USE_BLOCKY",
+};
+
+// One pyramid per variant we want to show
+const unsigned int PYRAMID_VARIANTS[] = {
+    FEATURE_VERTEX_COLOR,
+    FEATURE_TEXTURE,
+    FEATURE_TEXTURE | FEATURE_VERTEX_COLOR,
+    FEATURE_TEXTURE | FEATURE_VERTEX_COLOR | FEATURE_BLOCKY,
+};
+#define PYRAMID_COUNT (sizeof(PYRAMID_VARIANTS) / sizeof(PYRAMID_VARIANTS[0]))
+
+// Must match hard-coded vPosition location in vertShaderSource
+#define V_POSITION 0
+
+// Must match hard-coded location in vertShaderSource
+#define C_POSITION 1
+
+// Must match hard-coded vTexture location in vertShaderSource
+#define T_POSITION 2
+
+// Must match hard-coded ModelViewProject location in vertShaderSource.
+// Every variant has it in the same place, so switching variants doesn't
+// mean looking it up again.
+#define MVP_LOCATION 0
+
+// Must match hard-coded tex binding in fragShaderSource
+#define TEXTURE_UNIT 1
+
+// The #version line and the feature #defines are added by ShaderVariants
+const GLchar *vertShaderSource =
+    "layout(location = 0) uniform mat4 ModelViewProject;\n"
+    "layout(location = 0) in vec4 vPosition;\n"
+    "layout(location = 1) in vec3 vColor;\n"
+    "layout(location = 2) in vec2 vTexture;\n"
+    "out vec3 color;\n"
+    "out vec2 vs_tex_coord;\n"
+    "void main() {\n"
+    "    gl_Position = ModelViewProject * vPosition;\n"
+    "#if USE_TEXTURE\n"
+    "    vs_tex_coord = vTexture;\n"
+    "#endif\n"
+    "#if USE_VERTEX_COLOR\n"
+    "    color = vColor;\n"
+    "#endif\n"
+    "}\n";
+
+const GLchar *fragShaderSource =
+    "layout(binding = 1) uniform sampler2D tex;\n"
+    "in vec3 color;\n"
+    "in vec2 vs_tex_coord;\n"
+    "out vec4 fColor;\n"
+    "void main() {\n"
+    "#if USE_VERTEX_COLOR\n"
+    "    vec4 base = vec4(color, 0);\n"
+    "#else\n"
+    "    vec4 base = vec4(.5, .5, .5, 0);\n"
+    "#endif\n"
+    "#if USE_TEXTURE\n"
+    "#if USE_BLOCKY\n"
+    // What the blocky sampler object did in Demo 16:  nearest texel, repeating
+    "    vec2 size = vec2(textureSize(tex, 0));\n"
+    "    vec4 texColor = texelFetch(tex, ivec2(mod(floor(vs_tex_coord * size), size)), 0);\n"
+    "#else\n"
+    "    vec4 texColor = texture(tex, vs_tex_coord);\n"
+    "#endif\n"
+    "    fColor = base * (1 - texColor.a) + texColor;\n"
+    "#else\n"
+    "    fColor = vec4(base.rgb, 1);\n"
+    "#endif\n"
+    "}\n";
+
+void setupShaders()
+{
+    variantsInit(FEATURE_NAMES, FEATURE_COUNT, vertShaderSource, fragShaderSource);
+
+    // Build every combination up front, so nothing compiles mid-frame
+    unsigned int keys[VARIANT_COUNT];
+    for (unsigned int key = 0; key < VARIANT_COUNT; key++) {
+        keys[key] = key;
+    }
+    int start = glutGet(GLUT_ELAPSED_TIME);
+    variantsPrecompile(keys, VARIANT_COUNT);
+    printf("Built %d shader variants in %d ms\n", VARIANT_COUNT, glutGet(GLUT_ELAPSED_TIME) - start);
+}
+
+// Convert a simple bitmap (one bit per pixel) into an RGBA bitmap (four bytes per pixel)
+GLubyte* BuildMonochromeBitmap(const GLubyte* bits, int width, int height, GLubyte red, GLubyte green, GLubyte blue)
+{
+    GLubyte* retval = (GLubyte *)malloc(width * height * 4);
+    if (retval) {
+        GLubyte* ptr = retval;
+        for (int y = 0; y < height; y++) {
+            for (int x = 0; x < width/8; x++) {
+                GLubyte next8 = *bits++;
+                for (int mask = 128; mask > 0; mask >>= 1) {
+                    if (next8 & mask) {
+                        *ptr++ = red;
+                        *ptr++ = green;
+                        *ptr++ = blue;
+                        *ptr++ = 255;
+                    }
+                    else {
+                        *ptr++ = 0;
+                        *ptr++ = 0;
+                        *ptr++ = 0;
+                        *ptr++ = 0;
+                    }
+                }
+            }
+        }
+    }
+    return retval;
+}
+
+#define BITMAP_WIDTH 16
+#define BITMAP_HEIGHT 16
+#define BIT_BYTES ((BITMAP_WIDTH / 8) * BITMAP_HEIGHT)
+
+void setupTextures()
+{
+    // smiley face
+    GLubyte bits[BIT_BYTES] = {
+        0x00, 0x00,
+        0x00, 0x00,
+        0x07, 0xE0,
+        0x08, 0x10,
+        0x10, 0x08,
+        0x20, 0x04,
+        0x44, 0x22,
+        0x40, 0x02,
+        0x40, 0x02,
+        0x40, 0x02,
+        0x42, 0x42,
+        0x23, 0xc4,
+        0x10, 0x08,
+        0x0c, 0x30,
+        0x03, 0xc0,
+        0x00, 0x00,
+    };
+
+    GLubyte* data = BuildMonochromeBitmap(bits, BITMAP_WIDTH, BITMAP_HEIGHT, 255, 0, 0);
+    if (data) {
+        GLuint texture;
+        glGenTextures(1, &texture);
+        glActiveTexture(GL_TEXTURE0 + TEXTURE_UNIT);
+        glBindTexture(GL_TEXTURE_2D, texture);
+        // Complete mipmaps for the smooth variants.  The blocky variants
+        // only ever read level 0.
+        glTexStorage2D(GL_TEXTURE_2D, 4, GL_RGBA8, BITMAP_WIDTH, BITMAP_HEIGHT);
+        glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, BITMAP_WIDTH, BITMAP_HEIGHT, GL_RGBA, GL_UNSIGNED_BYTE, data);
+        glGenerateMipmap(GL_TEXTURE_2D);
+        free(data);
+    }
+}
+
+void setupPyramid(ShapeInfo *pInfo)
+{
+    typedef struct {
+        GLfloat x, y, z;
+        GLubyte red, green, blue;
+        GLfloat texU, texV;
+    } VertexInfo;
+
+    static const VertexInfo pyramidData[] = {
+        // Bottom
+        { 0.0f, 0.f, .5f, 255, 0, 0, 0.f, 0.f},
+        { 0.433f, 0.f, -.25f, 255, 0, 0, 0.f, 1.f},
+        { -0.433f, 0.f, -.25f, 255, 0, 0, 1.f, 1.f},
+        // Side 1
+        { -0.433f, 0.f, -.25f, 0, 0, 255, 0.f, 0.f},
+        { 0.433f, 0.f, -.25f, 0, 255, 255, 1.f, 0.f},
+        { 0.0f, 0.75f, 0.f, 255, 0, 255, 1.f, 1.f},
+        // Side 2
+        { -0.433f, 0.f, -.25f, 255, 255, 0, 0.f, 0.f},
+        { 0.0f, 0.f, .5f, 255, 255, 0, 0.f, 1.f},
+        { 0.0f, 0.75f, 0.f, 255, 255, 0, 1.f, 1.f},
+        // Side 3
+        { 0.0f, 0.f, .5f, 0, 255, 0, 4.f, 4.f},
+        { 0.0f, 0.75f, 0.f, 0, 255, 0, 2.f, 0.f},
+        { 0.433f, 0.f, -.25f, 0, 255, 0, 0.f, 4.f},
+    };
+
+    GLuint vboId;
+    glGenVertexArrays(1, &pInfo->vaoId);
+    glBindVertexArray(pInfo->vaoId);
+    glGenBuffers(1, &vboId);
+    glBindBuffer(GL_ARRAY_BUFFER, vboId);
+    glBufferData(GL_ARRAY_BUFFER, sizeof(pyramidData), pyramidData, GL_STATIC_DRAW);
+
+    glVertexAttribPointer(V_POSITION, 3, GL_FLOAT, GL_FALSE, sizeof(VertexInfo), (GLvoid*)offsetof(VertexInfo, x));
+    glEnableVertexAttribArray(V_POSITION);
+    glVertexAttribPointer(C_POSITION, 3, GL_UNSIGNED_BYTE, GL_TRUE, sizeof(VertexInfo), (GLvoid*)offsetof(VertexInfo, red));
+    glEnableVertexAttribArray(C_POSITION);
+    glVertexAttribPointer(T_POSITION, 2, GL_FLOAT, GL_FALSE, sizeof(VertexInfo), (GLvoid*)offsetof(VertexInfo, texU));
+    glEnableVertexAttribArray(T_POSITION);
+
+    pInfo->count = 12;
+}
+
+void setupFrustum(float left, float right, float bottom, float top, float zNear, float zFar)
+{
+    g_ProjectionMatrix = vmath::frustum(left, right, bottom, top, zNear, zFar);
+}
+
+void drawTrianglesAt(float x, float y, float z, float rotyDegrees, float scale, unsigned int variant, ShapeInfo *pInfo)
+{
+    GLuint program = variantProgram(variant);
+    if (!program) {
+        return;
+    }
+    glUseProgram(program);
+
+    mat4 modelViewMatrix(vmath::translate(x, y, z - CENTER_Z));
+    modelViewMatrix *= vmath::rotate(rotyDegrees, 0.f, 1.f, 0.f);
+    modelViewMatrix *= vmath::scale(scale, scale, scale);
+
+    glUniformMatrix4fv(MVP_LOCATION, 1, GL_FALSE, g_ProjectionMatrix * modelViewMatrix);
+    glBindVertexArray(pInfo->vaoId);
+    glDrawArrays(GL_TRIANGLES, 0, pInfo->count);
+}
+
+void onDisplay()
+{
+    static int i = 0;
+    i++;
+    glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+    for (unsigned int n = 0; n < PYRAMID_COUNT; n++) {
+        // Only flip the blocky bit where there is a texture to be blocky
+        unsigned int variant = PYRAMID_VARIANTS[n];
+        if (variant & FEATURE_TEXTURE) {
+            variant ^= g_BlockyFlip;
+        }
+        float x = (n % 2) ? 1.1f : -1.1f;
+        float y = (n / 2) ? -1.f : .6f;
+        drawTrianglesAt(x, y, 0.f, i * .5f, 1.6f, variant, &g_Pyramid);
+    }
+    glutSwapBuffers();
+}
+
+void onKey(unsigned char key, int x, int y)
+{
+    if (key == 'b' || key == 'B') {
+        g_BlockyFlip ^= FEATURE_BLOCKY;
+        return;
+    }
+    variantsShutdown();
+    exit(0);
+}
+
+int main(int argc, char *argv[])
+{
+    glutInit(&argc, argv);
+    glutInitDisplayMode(GLUT_RGBA | GLUT_DOUBLE | GLUT_DEPTH);
+    glutInitWindowSize(640, 480);
+    glutCreateWindow(argv[0]);
+
+    glewInit();
+    wglSwapIntervalEXT(1);	// vsync
+
+    glEnable(GL_DEPTH_TEST);
+
+    GLfloat ratio = 640.0f / 480.0f;
+    setupFrustum(-ratio, ratio, -1., 1., CENTER_Z - DEPTH_OF_FIELD/2, CENTER_Z + DEPTH_OF_FIELD/2);
+
+    setupShaders();
+    setupPyramid(&g_Pyramid);
+    setupTextures();
+    glutDisplayFunc(onDisplay);
+    glutIdleFunc(onDisplay);
+    glutKeyboardFunc(onKey);
+    glutMainLoop();
+
+    return 0;
+}
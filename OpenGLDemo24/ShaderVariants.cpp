@@ -0,0 +1,164 @@
+/*
+ * Shader permutations.  See ShaderVariants.h.
+ */
+#include "ShaderVariants.h"
+
+#include <stdio.h>
+#include <string>
+#include <vector>
+
+typedef enum {
+    VARIANT_NOT_BUILT,
+    VARIANT_BUILT,
+    VARIANT_FAILED,
+} VariantState;
+
+typedef struct {
+    VariantState state;
+    GLuint program;
+} VariantInfo;
+
+// A build that has been started but not checked
+typedef struct {
+    unsigned int key;
+    GLuint vertShader, fragShader, program;
+} VariantBuild;
+
+static const char *const *g_FeatureNames;
+static int g_FeatureCount;
+static const char *g_VertSource, *g_FragSource;
+
+// Indexed by key
+static std::vector<VariantInfo> g_Variants;
+
+void variantsInit(const char *const *featureNames, int featureCount,
+    const char *vertSource, const char *fragSource)
+{
+    if (featureCount > MAX_VARIANT_FEATURES) {
+        featureCount = MAX_VARIANT_FEATURES;
+    }
+    g_FeatureNames = featureNames;
+    g_FeatureCount = featureCount;
+    g_VertSource = vertSource;
+    g_FragSource = fragSource;
+
+    VariantInfo empty = { VARIANT_NOT_BUILT, 0 };
+    g_Variants.assign(size_t(1) << featureCount, empty);
+}
+
+static std::string variantHeader(unsigned int key)
+{
+    std::string header("#version 430 core\n");
+    for (int i = 0; i < g_FeatureCount; i++) {
+        header += "#define ";
+        header += g_FeatureNames[i];
+        header += (key & (1u << i)) ? " 1\n" : " 0\n";
+    }
+    return header;
+}
+
+static GLuint startShader(GLenum type, const std::string &header, const char *source)
+{
+    const GLchar *sources[] = { header.c_str(), source };
+    GLuint shader = glCreateShader(type);
+    glShaderSource(shader, 2, sources, NULL);
+    glCompileShader(shader);
+    return shader;
+}
+
+static bool checkShader(GLuint shader, unsigned int key, const char *kind)
+{
+    GLint compiled;
+    glGetShaderiv(shader, GL_COMPILE_STATUS, &compiled);
+    if (!compiled) {
+        GLchar infoLog[4096];
+        GLsizei length;
+        glGetShaderInfoLog(shader, 4096, &length, infoLog);
+        printf("Variant %#x %s shader failed to compile:\n%s\n", key, kind, infoLog);
+    }
+    return compiled != 0;
+}
+
+static void finishBuild(const VariantBuild *pBuild)
+{
+    VariantInfo *pInfo = &g_Variants[pBuild->key];
+    GLint linked = 0;
+    if (checkShader(pBuild->vertShader, pBuild->key, "vertex") &&
+        checkShader(pBuild->fragShader, pBuild->key, "fragment")) {
+        glGetProgramiv(pBuild->program, GL_LINK_STATUS, &linked);
+        if (!linked) {
+            GLchar infoLog[4096];
+            GLsizei length;
+            glGetProgramInfoLog(pBuild->program, 4096, &length, infoLog);
+            printf("Variant %#x failed to link:\n%s\n", pBuild->key, infoLog);
+        }
+    }
+
+    // The program keeps what it needs from the shaders
+    glDetachShader(pBuild->program, pBuild->vertShader);
+    glDetachShader(pBuild->program, pBuild->fragShader);
+    glDeleteShader(pBuild->vertShader);
+    glDeleteShader(pBuild->fragShader);
+    if (linked) {
+        pInfo->state = VARIANT_BUILT;
+        pInfo->program = pBuild->program;
+    }
+    else {
+        pInfo->state = VARIANT_FAILED;
+        glDeleteProgram(pBuild->program);
+    }
+}
+
+void variantsPrecompile(const unsigned int *keys, int count)
+{
+    std::vector<VariantBuild> builds;
+    for (int i = 0; i < count; i++) {
+        unsigned int key = keys[i];
+        if (key >= g_Variants.size() || g_Variants[key].state != VARIANT_NOT_BUILT) {
+            continue;
+        }
+        // The same key may be listed twice
+        g_Variants[key].state = VARIANT_FAILED;
+
+        std::string header = variantHeader(key);
+        VariantBuild build;
+        build.key = key;
+        build.vertShader = startShader(GL_VERTEX_SHADER, header, g_VertSource);
+        build.fragShader = startShader(GL_FRAGMENT_SHADER, header, g_FragSource);
+        builds.push_back(build);
+    }
+
+    // Linking doesn't wait for the compile results either, as long as
+    // nothing asks for them.  A failed compile just makes the link fail.
+    for (size_t i = 0; i < builds.size(); i++) {
+        builds[i].program = glCreateProgram();
+        glAttachShader(builds[i].program, builds[i].vertShader);
+        glAttachShader(builds[i].program, builds[i].fragShader);
+        glLinkProgram(builds[i].program);
+    }
+
+    for (size_t i = 0; i < builds.size(); i++) {
+        finishBuild(&builds[i]);
+    }
+}
+
+GLuint variantProgram(unsigned int key)
+{
+    if (key >= g_Variants.size()) {
+        return 0;
+    }
+    if (g_Variants[key].state == VARIANT_NOT_BUILT) {
+        variantsPrecompile(&key, 1);
+    }
+    return g_Variants[key].program;
+}
+
+void variantsShutdown()
+{
+    for (size_t i = 0; i < g_Variants.size(); i++) {
+        if (g_Variants[i].program) {
+            glDeleteProgram(g_Variants[i].program);
+        }
+    }
+    g_Variants.clear();
+}
@@ -0,0 +1,36 @@
+/*
+ * Shader permutations chosen at run time.
+ *
+ * One vertex and one fragment shader source are written with #if on a set
+ * of feature names.  Each variant is a bit mask of features; building it
+ * defines every feature name to 1 or 0 ahead of the source, so the
+ * compiler strips the unused paths and the shader never branches on them.
+ *
+ * Built programs are cached by key in a table, so picking a variant for a
+ * draw is an array lookup.  Variants can be built ahead of time as a group,
+ * or on first use.
+ */
+#ifndef SHADER_VARIANTS_H
+#define SHADER_VARIANTS_H
+
+#include <GL/glew.h>
+
+#define MAX_VARIANT_FEATURES 8
+
+// 'featureNames' and the sources must stay valid until variantsShutdown.
+// The sources must not have a #version line; one is added.
+void variantsInit(const char *const *featureNames, int featureCount,
+    const char *vertSource, const char *fragSource);
+
+// Build every listed variant that isn't built yet.  All compiles and links
+// are started before any result is checked, so a driver with background
+// compiler threads can run them side by side.
+void variantsPrecompile(const unsigned int *keys, int count);
+
+// The program for a variant, built now if needed.  0 if it failed to build
+// (the log is printed once).
+GLuint variantProgram(unsigned int key);
+
+void variantsShutdown();
+
+#endif
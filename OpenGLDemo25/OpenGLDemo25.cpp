@@ -0,0 +1,324 @@
+/*
+ * Demo 25:
+ * Uniform buffer objects.  Instead of a glUniform call per draw, the
+ * projection, view and time go in a per-frame block, and every object's
+ * model matrix and tint go in an array block (see UniformBlocks.h).  Both
+ * are uploaded once a frame.  Each draw finds its own object through its
+ * base instance.
+ *
+ * Press M to switch between one draw call per object and a single
+ * glMultiDrawArraysIndirect, any other key to exit.
+ *
+ * See README.txt for prerequisites.
+ */
+#include <windows.h>
+#include <WinGDI.h>
+
+#include <GL/glew.h>
+#include <GL/wglew.h>
+#include <GL/GL.h>
+#include <GL/glut.h>
+
+#include <stdio.h>
+#include <stddef.h>
+#include <string.h>
+
+#include <vmath.h>
+using vmath::mat4;
+
+#include "UniformBlocks.h"
+
+// Apparently someone is still using segmented memory qualifiers,
+// and windows.h is letting them.
+#undef near
+#undef far
+
+#define CENTER_Z        14.0f    // Distance from camera
+#define DEPTH_OF_FIELD  10.0f
+
+#define GRID_COLUMNS    16
+#define GRID_ROWS       (MAX_OBJECTS / GRID_COLUMNS)
+
+typedef struct {
+    GLsizei count;
+    GLuint vaoId;
+} ShapeInfo;
+
+// Layout glMultiDrawArraysIndirect expects
+typedef struct {
+    GLuint count;
+    GLuint instanceCount;
+    GLuint first;
+    GLuint baseInstance;
+} DrawArraysCommand;
+
+ShapeInfo g_Pyramid;
+GLuint g_Program;
+GLuint g_FrameBuffer, g_ObjectBuffer, g_IndirectBuffer;
+FrameBlock g_Frame;
+ObjectBlock g_Objects;
+mat4 g_ProjectionMatrix(mat4::identity());
+bool g_MultiDraw = false;
+
+// Must match hard-coded vPosition location in vertShaderSource
+#define V_POSITION 0
+
+// Must match hard-coded location in vertShaderSource
+#define C_POSITION 1
+
+// Must match hard-coded vObjectId location in vertShaderSource
+#define ID_POSITION 4
+
+void setupShaders()
+{
+    GLchar infoLog[4096];
+    GLsizei length;
+
+    // vObjectId advances once per instance, and an instanced attribute
+    // starts at the draw's base instance.  So drawing one instance with
+    // base instance n reads n, which picks the object out of the block.
+    const GLchar *vertShaderSource[] = {
+        "#version 430 core\n",
+        FRAME_BLOCK_GLSL,
+        OBJECT_BLOCK_GLSL,
+        "layout(location = 0) in vec4 vPosition;\n"
+        "layout(location = 1) in vec3 vColor;\n"
+        "layout(location = 4) in uint vObjectId;\n"
+        "out vec3 color;\n"
+        "void main() {\n"
+        "    ObjectData object = objects[vObjectId];\n"
+        "    gl_Position = projection * view * object.model * vPosition;\n"
+        "    float pulse = .8 + .2 * sin(time * 3 + float(vObjectId));\n"
+        "    color = mix(vColor, object.tint.rgb, object.tint.a) * pulse;\n"
+        "}\n"
+    };
+    GLuint vertShader = glCreateShader(GL_VERTEX_SHADER);
+    glShaderSource(vertShader, sizeof(vertShaderSource) / sizeof(vertShaderSource[0]), vertShaderSource, NULL);
+
+    const GLchar *fragShaderSource[] = {
+        "#version 430 core\n"
+        "in vec3 color;\n"
+        "out vec4 fColor;\n"
+        "void main() {\n"
+        "    fColor = vec4(color, 1);\n"
+        "}\n"
+    };
+    GLuint fragShader = glCreateShader(GL_FRAGMENT_SHADER);
+    glShaderSource(fragShader, 1, fragShaderSource, NULL);
+
+    g_Program = glCreateProgram();
+    glAttachShader(g_Program, vertShader);
+    glCompileShader(vertShader);
+    glGetShaderInfoLog(vertShader, 4096, &length, infoLog);
+
+    glAttachShader(g_Program, fragShader);
+    glCompileShader(fragShader);
+    glGetShaderInfoLog(fragShader, 4096, &length, infoLog);
+
+    glLinkProgram(g_Program);
+    glUseProgram(g_Program);
+}
+
+// The static_asserts in UniformBlocks.h check the structs against the
+// std140 rules; this checks the rules against what the driver actually did.
+void checkOffset(const char *name, GLint expected)
+{
+    GLuint index;
+    glGetUniformIndices(g_Program, 1, &name, &index);
+    if (index == GL_INVALID_INDEX) {
+        printf("Uniform block member %s not found\n", name);
+        return;
+    }
+    GLint offset;
+    glGetActiveUniformsiv(g_Program, 1, &index, GL_UNIFORM_OFFSET, &offset);
+    if (offset != expected) {
+        printf("Uniform block member %s is at %d, but the C++ struct has it at %d\n", name, offset, expected);
+    }
+}
+
+void checkBlockSize(const char *name, GLint expected)
+{
+    GLuint blockIndex = glGetUniformBlockIndex(g_Program, name);
+    GLint size = 0;
+    if (blockIndex != GL_INVALID_INDEX) {
+        glGetActiveUniformBlockiv(g_Program, blockIndex, GL_UNIFORM_BLOCK_DATA_SIZE, &size);
+    }
+    if (size != expected) {
+        printf("Uniform block %s is %d bytes, but the C++ struct is %d\n", name, size, expected);
+    }
+}
+
+void setupBlocks()
+{
+    checkOffset("view", GLint(offsetof(FrameBlock, view)));
+    checkOffset("time", GLint(offsetof(FrameBlock, time)));
+    checkOffset("objects[0].tint", GLint(offsetof(ObjectData, tint)));
+    checkOffset("objects[1].model", GLint(sizeof(ObjectData)));
+    // std140 rounds the block size up to 16, so the padding is included
+    checkBlockSize("FrameBlock", GLint(sizeof(FrameBlock)));
+    checkBlockSize("ObjectBlock", GLint(sizeof(ObjectBlock)));
+
+    // Allocate now, fill every frame.  The bindings never change.
+    glGenBuffers(1, &g_FrameBuffer);
+    glBindBuffer(GL_UNIFORM_BUFFER, g_FrameBuffer);
+    glBufferData(GL_UNIFORM_BUFFER, sizeof(FrameBlock), NULL, GL_DYNAMIC_DRAW);
+    glBindBufferBase(GL_UNIFORM_BUFFER, FRAME_BLOCK_BINDING, g_FrameBuffer);
+
+    glGenBuffers(1, &g_ObjectBuffer);
+    glBindBuffer(GL_UNIFORM_BUFFER, g_ObjectBuffer);
+    glBufferData(GL_UNIFORM_BUFFER, sizeof(ObjectBlock), NULL, GL_DYNAMIC_DRAW);
+    glBindBufferBase(GL_UNIFORM_BUFFER, OBJECT_BLOCK_BINDING, g_ObjectBuffer);
+
+    // Every object is the whole pyramid; only the base instance differs
+    DrawArraysCommand commands[MAX_OBJECTS];
+    for (GLuint n = 0; n < MAX_OBJECTS; n++) {
+        DrawArraysCommand command = { GLuint(g_Pyramid.count), 1, 0, n };
+        commands[n] = command;
+    }
+    glGenBuffers(1, &g_IndirectBuffer);
+    glBindBuffer(GL_DRAW_INDIRECT_BUFFER, g_IndirectBuffer);
+    glBufferData(GL_DRAW_INDIRECT_BUFFER, sizeof(commands), commands, GL_STATIC_DRAW);
+}
+
+void setupPyramid(ShapeInfo *pInfo)
+{
+    typedef struct {
+        GLfloat x, y, z;
+        GLubyte red, green, blue;
+    } VertexInfo;
+
+    static const VertexInfo pyramidData[] = {
+        // Bottom
+        { 0.0f, 0.f, .5f, 255, 0, 0},
+        { 0.433f, 0.f, -.25f, 255, 0, 0},
+        { -0.433f, 0.f, -.25f, 255, 0, 0},
+        // Side 1
+        { -0.433f, 0.f, -.25f, 0, 0, 255},
+        { 0.433f, 0.f, -.25f, 0, 255, 255},
+        { 0.0f, 0.75f, 0.f, 255, 0, 255},
+        // Side 2
+        { -0.433f, 0.f, -.25f, 255, 255, 0},
+        { 0.0f, 0.f, .5f, 255, 255, 0},
+        { 0.0f, 0.75f, 0.f, 255, 255, 0},
+        // Side 3
+        { 0.0f, 0.f, .5f, 0, 255, 0},
+        { 0.433f, 0.f, -.25f, 0, 255, 0},
+        { 0.0f, 0.75f, 0.f, 0, 255, 0},
+    };
+
+    GLuint buffers[2];
+    glGenVertexArrays(1, &pInfo->vaoId);
+    glBindVertexArray(pInfo->vaoId);
+    glGenBuffers(2, buffers);
+    glBindBuffer(GL_ARRAY_BUFFER, buffers[0]);
+    glBufferData(GL_ARRAY_BUFFER, sizeof(pyramidData), pyramidData, GL_STATIC_DRAW);
+    glVertexAttribPointer(V_POSITION, 3, GL_FLOAT, GL_FALSE, sizeof(VertexInfo), (GLvoid*)offsetof(VertexInfo, x));
+    glEnableVertexAttribArray(V_POSITION);
+    glVertexAttribPointer(C_POSITION, 3, GL_UNSIGNED_BYTE, GL_TRUE, sizeof(VertexInfo), (GLvoid*)offsetof(VertexInfo, red));
+    glEnableVertexAttribArray(C_POSITION);
+
+    // Object ids 0..MAX_OBJECTS-1, one per instance
+    GLuint ids[MAX_OBJECTS];
+    for (GLuint n = 0; n < MAX_OBJECTS; n++) {
+        ids[n] = n;
+    }
+    glBindBuffer(GL_ARRAY_BUFFER, buffers[1]);
+    glBufferData(GL_ARRAY_BUFFER, sizeof(ids), ids, GL_STATIC_DRAW);
+    glVertexAttribIPointer(ID_POSITION, 1, GL_UNSIGNED_INT, sizeof(GLuint), 0);
+    glVertexAttribDivisor(ID_POSITION, 1);
+    glEnableVertexAttribArray(ID_POSITION);
+
+    pInfo->count = 12;
+    glBindVertexArray(0);
+}
+
+void setupFrustum(float left, float right, float bottom, float top, float zNear, float zFar)
+{
+    g_ProjectionMatrix = vmath::frustum(left, right, bottom, top, zNear, zFar);
+}
+
+// Fill in both blocks on the CPU, then upload each with one call
+void updateBlocks(int frame)
+{
+    mat4 view(vmath::translate(0.f, 0.f, -CENTER_Z));
+    memcpy(g_Frame.projection, (const float *)g_ProjectionMatrix, sizeof(g_Frame.projection));
+    memcpy(g_Frame.view, (const float *)view, sizeof(g_Frame.view));
+    g_Frame.time = glutGet(GLUT_ELAPSED_TIME) / 1000.f;
+
+    for (int n = 0; n < MAX_OBJECTS; n++) {
+        float x = (n % GRID_COLUMNS - (GRID_COLUMNS - 1) / 2.f) * 1.2f;
+        float y = (n / GRID_COLUMNS - (GRID_ROWS - 1) / 2.f) * 1.2f;
+        mat4 model(vmath::translate(x, y, 0.f));
+        model *= vmath::rotate(frame * (1.f + n % 5), 0.f, 1.f, 0.f);
+        ObjectData *pObject = &g_Objects.objects[n];
+        memcpy(pObject->model, (const float *)model, sizeof(pObject->model));
+        pObject->tint[0] = (n % 3 == 0) ? 1.f : .2f;
+        pObject->tint[1] = (n % 3 == 1) ? 1.f : .2f;
+        pObject->tint[2] = (n % 3 == 2) ? 1.f : .2f;
+        pObject->tint[3] = .5f * float(n / GRID_COLUMNS) / (GRID_ROWS - 1);
+    }
+
+    glBindBuffer(GL_UNIFORM_BUFFER, g_FrameBuffer);
+    glBufferSubData(GL_UNIFORM_BUFFER, 0, sizeof(FrameBlock), &g_Frame);
+    glBindBuffer(GL_UNIFORM_BUFFER, g_ObjectBuffer);
+    glBufferSubData(GL_UNIFORM_BUFFER, 0, sizeof(ObjectBlock), &g_Objects);
+}
+
+void onDisplay()
+{
+    static int i = 0;
+    i++;
+    updateBlocks(i);
+
+    glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+    glBindVertexArray(g_Pyramid.vaoId);
+    if (g_MultiDraw) {
+        glMultiDrawArraysIndirect(GL_TRIANGLES, 0, MAX_OBJECTS, 0);
+    }
+    else {
+        // No uniforms to set between draws
+        for (GLuint n = 0; n < MAX_OBJECTS; n++) {
+            glDrawArraysInstancedBaseInstance(GL_TRIANGLES, 0, g_Pyramid.count, 1, n);
+        }
+    }
+    glutSwapBuffers();
+}
+
+void onKey(unsigned char key, int x, int y)
+{
+    if (key == 'm' || key == 'M') {
+        g_MultiDraw = !g_MultiDraw;
+        printf("%s\n", g_MultiDraw ? "One multi-draw call" : "One draw call per object");
+        return;
+    }
+    exit(0);
+}
+
+int main(int argc, char *argv[])
+{
+    glutInit(&argc, argv);
+    glutInitDisplayMode(GLUT_RGBA | GLUT_DOUBLE | GLUT_DEPTH);
+    glutInitWindowSize(640, 480);
+    glutCreateWindow(argv[0]);
+
+    glewInit();
+    wglSwapIntervalEXT(1);	// vsync
+
+    glEnable(GL_DEPTH_TEST);
+
+    // Wide enough to see the whole grid
+    GLfloat ratio = 640.0f / 480.0f;
+    GLfloat zNear = CENTER_Z - DEPTH_OF_FIELD/2;
+    GLfloat top = zNear * .55f;
+    setupFrustum(-ratio * top, ratio * top, -top, top, zNear, CENTER_Z + DEPTH_OF_FIELD/2);
+
+    setupShaders();
+    setupPyramid(&g_Pyramid);
+    setupBlocks();
+    glutDisplayFunc(onDisplay);
+    glutIdleFunc(onDisplay);
+    glutKeyboardFunc(onKey);
+    glutMainLoop();
+
+    return 0;
+}
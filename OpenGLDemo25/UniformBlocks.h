@@ -0,0 +1,69 @@
+/*
+ * Uniform block layouts shared by C++ and GLSL.
+ *
+ * The GLSL declarations are kept here as strings, right next to the structs
+ * that mirror them, so they get changed together.  Both blocks use std140,
+ * which fixes the layout without asking the driver:  vec4 and mat4 columns
+ * are 16-byte aligned, and a struct's size (and so an array stride) is
+ * rounded up to 16.  The static_asserts check the C++ side matches those
+ * rules; setupBlocks in the demo also asks the driver at run time.
+ */
+#ifndef UNIFORM_BLOCKS_H
+#define UNIFORM_BLOCKS_H
+
+#include <stddef.h>
+
+#define STRINGIFY_(x)   #x
+#define STRINGIFY(x)    STRINGIFY_(x)
+
+// Must match the binding points in the GLSL below
+#define FRAME_BLOCK_BINDING     0
+#define OBJECT_BLOCK_BINDING    1
+
+// 128 * 80 bytes is under the 16KB every GL implementation allows for a
+// uniform block
+#define MAX_OBJECTS     128
+
+// Updated once a frame
+typedef struct {
+    float projection[16];   // Column major, like GL and vmath
+    float view[16];
+    float time;             // Seconds
+    float pad[3];           // std140 rounds the block up to 16 bytes
+} FrameBlock;
+
+#define FRAME_BLOCK_GLSL \
+    "layout(std140, binding = 0) uniform FrameBlock {\n" \
+    "    mat4 projection;\n" \
+    "    mat4 view;\n" \
+    "    float time;\n" \
+    "};\n"
+
+static_assert(offsetof(FrameBlock, view) == 64, "FrameBlock.view must be at the std140 offset");
+static_assert(offsetof(FrameBlock, time) == 128, "FrameBlock.time must be at the std140 offset");
+static_assert(sizeof(FrameBlock) % 16 == 0, "FrameBlock size must be a multiple of 16");
+
+// One per object, all updated together once a frame
+typedef struct {
+    float model[16];
+    float tint[4];          // rgb, and how much of it to use in a
+} ObjectData;
+
+typedef struct {
+    ObjectData objects[MAX_OBJECTS];
+} ObjectBlock;
+
+#define OBJECT_BLOCK_GLSL \
+    "struct ObjectData {\n" \
+    "    mat4 model;\n" \
+    "    vec4 tint;\n" \
+    "};\n" \
+    "layout(std140, binding = 1) uniform ObjectBlock {\n" \
+    "    ObjectData objects[" STRINGIFY(MAX_OBJECTS) "];\n" \
+    "};\n"
+
+static_assert(offsetof(ObjectData, tint) == 64, "ObjectData.tint must be at the std140 offset");
+static_assert(sizeof(ObjectData) == 80, "ObjectData must match the std140 array stride");
+static_assert(sizeof(ObjectBlock) <= 16384, "ObjectBlock must fit the minimum GL_MAX_UNIFORM_BLOCK_SIZE");
+
+#endif
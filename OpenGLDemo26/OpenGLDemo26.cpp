@@ -0,0 +1,366 @@
+/*
+ * Demo 26:
+ * Thousands of distinct textures with no texture binds per draw.  Each
+ * pyramid names its texture by index, and the shader finds it through a
+ * table of bindless handles, or a texture array where bindless textures
+ * aren't supported (see TextureTable.h).  The whole grid is one
+ * glMultiDrawArraysIndirect.
+ *
+ * The textures shift along the grid every half second, so residency keeps
+ * changing.
+ *
+ * See README.txt for prerequisites.
+ */
+#include <windows.h>
+#include <WinGDI.h>
+
+#include <GL/glew.h>
+#include <GL/wglew.h>
+#include <GL/GL.h>
+#include <GL/glut.h>
+
+#include <stdio.h>
+#include <stddef.h>
+#include <string.h>
+
+#include <vmath.h>
+using vmath::mat4;
+
+#include "TextureTable.h"
+
+// Apparently someone is still using segmented memory qualifiers,
+// and windows.h is letting them.
+#undef near
+#undef far
+
+#define CENTER_Z        30.0f    // Distance from camera
+#define DEPTH_OF_FIELD  10.0f
+
+// Exercise:  Set this to false to try the texture array path
+#define ALLOW_BINDLESS  true
+
+#define TEXTURE_COUNT   4096
+#define GRID_SIZE       30
+#define OBJECT_COUNT    (GRID_SIZE * GRID_SIZE)
+#define SHIFT_FRAMES    30      // How often the textures move along
+
+typedef struct {
+    GLsizei count;
+    GLuint vaoId;
+} ShapeInfo;
+
+// std430 layout of ObjectData in vertShaderSource.  The mat4 makes the
+// struct 16-byte aligned, so it is padded out to 80 bytes.
+typedef struct {
+    float model[16];
+    GLuint textureIndex;
+    GLuint pad[3];
+} ObjectData;
+
+static_assert(offsetof(ObjectData, textureIndex) == 64, "ObjectData.textureIndex must be at the std430 offset");
+static_assert(sizeof(ObjectData) == 80, "ObjectData must match the std430 array stride");
+
+typedef struct {
+    GLuint count;
+    GLuint instanceCount;
+    GLuint first;
+    GLuint baseInstance;
+} DrawArraysCommand;
+
+ShapeInfo g_Pyramid;
+GLuint g_ObjectBuffer;
+ObjectData g_Objects[OBJECT_COUNT];
+int g_TextureCount;
+mat4 g_ProjectionMatrix(mat4::identity());
+
+// Must match hard-coded vPosition location in vertShaderSource
+#define V_POSITION 0
+
+// Must match hard-coded vTexture location in vertShaderSource
+#define T_POSITION 2
+
+// Must match hard-coded vObjectId location in vertShaderSource
+#define ID_POSITION 4
+
+// Must match hard-coded ViewProject location in vertShaderSource
+#define VP_LOCATION 0
+
+// Must match hard-coded Objects binding in vertShaderSource
+#define OBJECT_BUFFER_BINDING 1
+
+void setupShaders()
+{
+    GLchar infoLog[4096];
+    GLsizei length;
+
+    const GLchar *vertShaderSource[] = {
+        "#version 430 core\n"
+        "struct ObjectData {\n"
+        "    mat4 model;\n"
+        "    uint textureIndex;\n"
+        "};\n"
+        "layout(std430, binding = 1) readonly buffer Objects {\n"
+        "    ObjectData objects[];\n"
+        "};\n"
+        "layout(location = 0) uniform mat4 ViewProject;\n"
+        "layout(location = 0) in vec4 vPosition;\n"
+        "layout(location = 2) in vec2 vTexture;\n"
+        "layout(location = 4) in uint vObjectId;\n"
+        "out vec2 vs_tex_coord;\n"
+        "flat out uint textureIndex;\n"
+        "void main() {\n"
+        "    gl_Position = ViewProject * objects[vObjectId].model * vPosition;\n"
+        "    vs_tex_coord = vTexture;\n"
+        "    textureIndex = objects[vObjectId].textureIndex;\n"
+        "}\n"
+    };
+    GLuint vertShader = glCreateShader(GL_VERTEX_SHADER);
+    glShaderSource(vertShader, 1, vertShaderSource, NULL);
+
+    // sampleTable comes from TextureTable, for whichever path it chose
+    const GLchar *fragShaderSource[] = {
+        "#version 430 core\n",
+        textureTableShaderSource(),
+        "in vec2 vs_tex_coord;\n"
+        "flat in uint textureIndex;\n"
+        "out vec4 fColor;\n"
+        "void main() {\n"
+        "    vec4 texColor = sampleTable(textureIndex, vs_tex_coord);\n"
+        "    fColor = vec4(mix(vec3(.15), texColor.rgb, texColor.a), 1);\n"
+        "}\n"
+    };
+    GLuint fragShader = glCreateShader(GL_FRAGMENT_SHADER);
+    glShaderSource(fragShader, sizeof(fragShaderSource) / sizeof(fragShaderSource[0]), fragShaderSource, NULL);
+
+    GLuint program = glCreateProgram();
+    glAttachShader(program, vertShader);
+    glCompileShader(vertShader);
+    glGetShaderInfoLog(vertShader, 4096, &length, infoLog);
+
+    glAttachShader(program, fragShader);
+    glCompileShader(fragShader);
+    glGetShaderInfoLog(fragShader, 4096, &length, infoLog);
+
+    glLinkProgram(program);
+    glUseProgram(program);
+}
+
+// Convert a simple bitmap (one bit per pixel) into an RGBA bitmap (four bytes per pixel)
+GLubyte* BuildMonochromeBitmap(const GLubyte* bits, int width, int height, GLubyte red, GLubyte green, GLubyte blue)
+{
+    GLubyte* retval = (GLubyte *)malloc(width * height * 4);
+    if (retval) {
+        GLubyte* ptr = retval;
+        for (int y = 0; y < height; y++) {
+            for (int x = 0; x < width/8; x++) {
+                GLubyte next8 = *bits++;
+                for (int mask = 128; mask > 0; mask >>= 1) {
+                    if (next8 & mask) {
+                        *ptr++ = red;
+                        *ptr++ = green;
+                        *ptr++ = blue;
+                        *ptr++ = 255;
+                    }
+                    else {
+                        *ptr++ = 0;
+                        *ptr++ = 0;
+                        *ptr++ = 0;
+                        *ptr++ = 0;
+                    }
+                }
+            }
+        }
+    }
+    return retval;
+}
+
+#define BITMAP_WIDTH 16
+#define BITMAP_HEIGHT 16
+#define BIT_BYTES ((BITMAP_WIDTH / 8) * BITMAP_HEIGHT)
+
+static unsigned int hash(unsigned int x)
+{
+    x ^= x >> 16;
+    x *= 0x7feb352d;
+    x ^= x >> 15;
+    x *= 0x846ca68b;
+    x ^= x >> 16;
+    return x;
+}
+
+static GLubyte reverseBits(GLubyte b)
+{
+    GLubyte r = 0;
+    for (int i = 0; i < 8; i++) {
+        r = GLubyte((r << 1) | ((b >> i) & 1));
+    }
+    return r;
+}
+
+// A different left-right symmetric pattern and color for every index
+void setupTextures()
+{
+    g_TextureCount = textureTableInit(TEXTURE_COUNT, BITMAP_WIDTH, BITMAP_HEIGHT, ALLOW_BINDLESS);
+    printf("%d textures, using %s\n", g_TextureCount,
+        textureTableIsBindless() ? "bindless handles" : "a texture array");
+
+    for (int t = 0; t < g_TextureCount; t++) {
+        GLubyte bits[BIT_BYTES];
+        for (int row = 0; row < BITMAP_HEIGHT; row++) {
+            GLubyte left = GLubyte(hash(t * BITMAP_HEIGHT + row));
+            bits[row * 2] = left;
+            bits[row * 2 + 1] = reverseBits(left);
+        }
+        unsigned int color = hash(~t);
+        GLubyte* data = BuildMonochromeBitmap(bits, BITMAP_WIDTH, BITMAP_HEIGHT,
+            GLubyte(color | 64), GLubyte((color >> 8) | 64), GLubyte((color >> 16) | 64));
+        if (data) {
+            textureTableUpload(t, data);
+            free(data);
+        }
+    }
+    textureTableFinish();
+}
+
+void setupPyramid(ShapeInfo *pInfo)
+{
+    typedef struct {
+        GLfloat x, y, z;
+        GLfloat texU, texV;
+    } VertexInfo;
+
+    static const VertexInfo pyramidData[] = {
+        // Bottom
+        { 0.0f, 0.f, .5f, 0.f, 0.f},
+        { 0.433f, 0.f, -.25f, 0.f, 1.f},
+        { -0.433f, 0.f, -.25f, 1.f, 1.f},
+        // Side 1
+        { -0.433f, 0.f, -.25f, 0.f, 0.f},
+        { 0.433f, 0.f, -.25f, 1.f, 0.f},
+        { 0.0f, 0.75f, 0.f, .5f, 1.f},
+        // Side 2
+        { -0.433f, 0.f, -.25f, 0.f, 0.f},
+        { 0.0f, 0.f, .5f, 1.f, 0.f},
+        { 0.0f, 0.75f, 0.f, .5f, 1.f},
+        // Side 3
+        { 0.0f, 0.f, .5f, 0.f, 0.f},
+        { 0.433f, 0.f, -.25f, 1.f, 0.f},
+        { 0.0f, 0.75f, 0.f, .5f, 1.f},
+    };
+
+    GLuint buffers[3];
+    glGenVertexArrays(1, &pInfo->vaoId);
+    glBindVertexArray(pInfo->vaoId);
+    glGenBuffers(3, buffers);
+    glBindBuffer(GL_ARRAY_BUFFER, buffers[0]);
+    glBufferData(GL_ARRAY_BUFFER, sizeof(pyramidData), pyramidData, GL_STATIC_DRAW);
+    glVertexAttribPointer(V_POSITION, 3, GL_FLOAT, GL_FALSE, sizeof(VertexInfo), (GLvoid*)offsetof(VertexInfo, x));
+    glEnableVertexAttribArray(V_POSITION);
+    glVertexAttribPointer(T_POSITION, 2, GL_FLOAT, GL_FALSE, sizeof(VertexInfo), (GLvoid*)offsetof(VertexInfo, texU));
+    glEnableVertexAttribArray(T_POSITION);
+    pInfo->count = 12;
+
+    // One instance per object, starting at the draw's base instance (as in
+    // Demo 25), so each draw command reads its own object
+    GLuint ids[OBJECT_COUNT];
+    DrawArraysCommand commands[OBJECT_COUNT];
+    for (GLuint n = 0; n < OBJECT_COUNT; n++) {
+        ids[n] = n;
+        DrawArraysCommand command = { GLuint(pInfo->count), 1, 0, n };
+        commands[n] = command;
+    }
+    glBindBuffer(GL_ARRAY_BUFFER, buffers[1]);
+    glBufferData(GL_ARRAY_BUFFER, sizeof(ids), ids, GL_STATIC_DRAW);
+    glVertexAttribIPointer(ID_POSITION, 1, GL_UNSIGNED_INT, sizeof(GLuint), 0);
+    glVertexAttribDivisor(ID_POSITION, 1);
+    glEnableVertexAttribArray(ID_POSITION);
+
+    glBindBuffer(GL_DRAW_INDIRECT_BUFFER, buffers[2]);
+    glBufferData(GL_DRAW_INDIRECT_BUFFER, sizeof(commands), commands, GL_STATIC_DRAW);
+
+    glGenBuffers(1, &g_ObjectBuffer);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, g_ObjectBuffer);
+    glBufferData(GL_SHADER_STORAGE_BUFFER, sizeof(g_Objects), NULL, GL_DYNAMIC_DRAW);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, OBJECT_BUFFER_BINDING, g_ObjectBuffer);
+}
+
+void setupFrustum(float left, float right, float bottom, float top, float zNear, float zFar)
+{
+    g_ProjectionMatrix = vmath::frustum(left, right, bottom, top, zNear, zFar);
+}
+
+void onDisplay()
+{
+    static int i = 0;
+    static int frames = 0;
+    static int lastReport = glutGet(GLUT_ELAPSED_TIME);
+    i++;
+
+    // Update every object, and tell the table which textures are needed
+    int shift = (i / SHIFT_FRAMES) * 37;
+    for (int n = 0; n < OBJECT_COUNT; n++) {
+        float x = (n % GRID_SIZE - (GRID_SIZE - 1) / 2.f) * 1.1f;
+        float y = (n / GRID_SIZE - (GRID_SIZE - 1) / 2.f) * 1.1f;
+        mat4 model(vmath::translate(x, y, -CENTER_Z));
+        model *= vmath::rotate(i * .5f + n * 7.f, 0.f, 1.f, 0.f);
+        memcpy(g_Objects[n].model, (const float *)model, sizeof(g_Objects[n].model));
+        g_Objects[n].textureIndex = GLuint((n + shift) % g_TextureCount);
+        textureTableUse(g_Objects[n].textureIndex);
+    }
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, g_ObjectBuffer);
+    glBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, sizeof(g_Objects), g_Objects);
+
+    // The only texture-related call this frame, however many textures
+    textureTableBind();
+
+    glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+    glUniformMatrix4fv(VP_LOCATION, 1, GL_FALSE, g_ProjectionMatrix);
+    glBindVertexArray(g_Pyramid.vaoId);
+    glMultiDrawArraysIndirect(GL_TRIANGLES, 0, OBJECT_COUNT, 0);
+    glutSwapBuffers();
+
+    frames++;
+    int now = glutGet(GLUT_ELAPSED_TIME);
+    if (now - lastReport >= 2000) {
+        TextureTableStats stats;
+        textureTableTakeStats(&stats);
+        printf("%.2f ms per frame, %d textures resident, %d made resident, %d evicted\n",
+            double(now - lastReport) / frames, stats.residentCount, stats.madeResident, stats.evicted);
+        frames = 0;
+        lastReport = now;
+    }
+}
+
+void onKey(unsigned char key, int x, int y)
+{
+    exit(0);
+}
+
+int main(int argc, char *argv[])
+{
+    glutInit(&argc, argv);
+    glutInitDisplayMode(GLUT_RGBA | GLUT_DOUBLE | GLUT_DEPTH);
+    glutInitWindowSize(640, 480);
+    glutCreateWindow(argv[0]);
+
+    glewInit();
+    wglSwapIntervalEXT(1);	// vsync
+
+    glEnable(GL_DEPTH_TEST);
+
+    GLfloat ratio = 640.0f / 480.0f;
+    GLfloat zNear = CENTER_Z - DEPTH_OF_FIELD/2;
+    GLfloat top = zNear * .6f;
+    setupFrustum(-ratio * top, ratio * top, -top, top, zNear, CENTER_Z + DEPTH_OF_FIELD/2);
+
+    // The shaders depend on which texture path was chosen
+    setupTextures();
+    setupShaders();
+    setupPyramid(&g_Pyramid);
+    glutDisplayFunc(onDisplay);
+    glutIdleFunc(onDisplay);
+    glutKeyboardFunc(onKey);
+    glutMainLoop();
+
+    return 0;
+}
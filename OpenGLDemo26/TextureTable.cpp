@@ -0,0 +1,215 @@
+/*
+ * Bindless texture table, with a texture array fallback.  See TextureTable.h.
+ */
+#include "TextureTable.h"
+
+#include <stdio.h>
+#include <vector>
+
+#define NO_ENTRY    (-1)
+
+// Residency for one bindless entry.  Resident entries are kept in a doubly
+// linked list, most recently used first, so touching one and finding the
+// one to evict are both O(1).
+typedef struct {
+    GLuint texture;
+    GLuint64 handle;
+    bool resident;
+    int prev, next;
+    unsigned int lastUsedFrame;
+} TableEntry;
+
+static bool g_Bindless;
+static int g_Count, g_Width, g_Height;
+static GLuint g_ArrayTexture;
+static GLuint g_HandleBuffer;
+static std::vector<TableEntry> g_Entries;
+static int g_MostRecent = NO_ENTRY, g_LeastRecent = NO_ENTRY;
+static unsigned int g_Frame = 1;
+static TextureTableStats g_Stats;
+
+static const char *bindlessSource =
+    "#extension GL_ARB_bindless_texture : require\n"
+    "layout(std430, binding = 2) readonly buffer TextureHandles {\n"
+    "    uvec2 handles[];\n"
+    "};\n"
+    "vec4 sampleTable(uint index, vec2 uv) {\n"
+    "    return texture(sampler2D(handles[index]), uv);\n"
+    "}\n";
+
+static const char *arraySource =
+    "layout(binding = 0) uniform sampler2DArray textureTable;\n"
+    "vec4 sampleTable(uint index, vec2 uv) {\n"
+    "    return texture(textureTable, vec3(uv, float(index)));\n"
+    "}\n";
+
+static void setSamplingParameters(GLenum target)
+{
+    glTexParameteri(target, GL_TEXTURE_WRAP_S, GL_REPEAT);
+    glTexParameteri(target, GL_TEXTURE_WRAP_T, GL_REPEAT);
+    glTexParameteri(target, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    glTexParameteri(target, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+}
+
+int textureTableInit(int count, int width, int height, bool allowBindless)
+{
+    g_Bindless = allowBindless && GLEW_ARB_bindless_texture;
+    g_Width = width;
+    g_Height = height;
+    g_Count = count;
+
+    if (g_Bindless) {
+        TableEntry empty = { 0, 0, false, NO_ENTRY, NO_ENTRY, 0 };
+        g_Entries.assign(count, empty);
+        for (int i = 0; i < count; i++) {
+            glGenTextures(1, &g_Entries[i].texture);
+            glBindTexture(GL_TEXTURE_2D, g_Entries[i].texture);
+            glTexStorage2D(GL_TEXTURE_2D, 1, GL_RGBA8, width, height);
+            setSamplingParameters(GL_TEXTURE_2D);
+        }
+        glBindTexture(GL_TEXTURE_2D, 0);
+    }
+    else {
+        GLint maxLayers;
+        glGetIntegerv(GL_MAX_ARRAY_TEXTURE_LAYERS, &maxLayers);
+        if (g_Count > maxLayers) {
+            printf("Texture arrays are limited to %d layers here, not %d\n", maxLayers, count);
+            g_Count = maxLayers;
+        }
+        glGenTextures(1, &g_ArrayTexture);
+        glBindTexture(GL_TEXTURE_2D_ARRAY, g_ArrayTexture);
+        glTexStorage3D(GL_TEXTURE_2D_ARRAY, 1, GL_RGBA8, width, height, g_Count);
+        setSamplingParameters(GL_TEXTURE_2D_ARRAY);
+    }
+    return g_Count;
+}
+
+void textureTableUpload(int index, const GLubyte *pRgba)
+{
+    if (index < 0 || index >= g_Count) {
+        return;
+    }
+    if (g_Bindless) {
+        glBindTexture(GL_TEXTURE_2D, g_Entries[index].texture);
+        glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, g_Width, g_Height, GL_RGBA, GL_UNSIGNED_BYTE, pRgba);
+    }
+    else {
+        glBindTexture(GL_TEXTURE_2D_ARRAY, g_ArrayTexture);
+        glTexSubImage3D(GL_TEXTURE_2D_ARRAY, 0, 0, 0, index, g_Width, g_Height, 1, GL_RGBA, GL_UNSIGNED_BYTE, pRgba);
+    }
+}
+
+void textureTableFinish()
+{
+    if (!g_Bindless) {
+        return;
+    }
+
+    // Taking a handle freezes the texture's state, so this comes after the
+    // uploads.  The handles never change, so the buffer is written once.
+    std::vector<GLuint64> handles(g_Count);
+    for (int i = 0; i < g_Count; i++) {
+        g_Entries[i].handle = glGetTextureHandleARB(g_Entries[i].texture);
+        handles[i] = g_Entries[i].handle;
+    }
+    glGenBuffers(1, &g_HandleBuffer);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, g_HandleBuffer);
+    glBufferData(GL_SHADER_STORAGE_BUFFER, handles.size() * sizeof(GLuint64), &handles[0], GL_STATIC_DRAW);
+}
+
+bool textureTableIsBindless()
+{
+    return g_Bindless;
+}
+
+const char *textureTableShaderSource()
+{
+    return g_Bindless ? bindlessSource : arraySource;
+}
+
+static void unlink(int index)
+{
+    TableEntry *pEntry = &g_Entries[index];
+    if (pEntry->prev != NO_ENTRY) {
+        g_Entries[pEntry->prev].next = pEntry->next;
+    }
+    else {
+        g_MostRecent = pEntry->next;
+    }
+    if (pEntry->next != NO_ENTRY) {
+        g_Entries[pEntry->next].prev = pEntry->prev;
+    }
+    else {
+        g_LeastRecent = pEntry->prev;
+    }
+    pEntry->prev = pEntry->next = NO_ENTRY;
+}
+
+static void pushMostRecent(int index)
+{
+    TableEntry *pEntry = &g_Entries[index];
+    pEntry->prev = NO_ENTRY;
+    pEntry->next = g_MostRecent;
+    if (g_MostRecent != NO_ENTRY) {
+        g_Entries[g_MostRecent].prev = index;
+    }
+    g_MostRecent = index;
+    if (g_LeastRecent == NO_ENTRY) {
+        g_LeastRecent = index;
+    }
+}
+
+void textureTableUse(int index)
+{
+    if (!g_Bindless || index < 0 || index >= g_Count) {
+        return;
+    }
+    TableEntry *pEntry = &g_Entries[index];
+    if (pEntry->resident) {
+        if (pEntry->lastUsedFrame != g_Frame) {
+            pEntry->lastUsedFrame = g_Frame;
+            unlink(index);
+            pushMostRecent(index);
+        }
+        return;
+    }
+
+    // Make room, but never evict something this frame needs; if the frame
+    // needs more than the limit, go over it.
+    while (g_Stats.residentCount >= TEXTURE_RESIDENT_LIMIT &&
+        g_Entries[g_LeastRecent].lastUsedFrame != g_Frame) {
+        int victim = g_LeastRecent;
+        unlink(victim);
+        glMakeTextureHandleNonResidentARB(g_Entries[victim].handle);
+        g_Entries[victim].resident = false;
+        g_Stats.residentCount--;
+        g_Stats.evicted++;
+    }
+
+    glMakeTextureHandleResidentARB(pEntry->handle);
+    pEntry->resident = true;
+    pEntry->lastUsedFrame = g_Frame;
+    pushMostRecent(index);
+    g_Stats.residentCount++;
+    g_Stats.madeResident++;
+}
+
+void textureTableBind()
+{
+    if (g_Bindless) {
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, TEXTURE_TABLE_BUFFER_BINDING, g_HandleBuffer);
+    }
+    else {
+        glActiveTexture(GL_TEXTURE0 + TEXTURE_TABLE_TEXTURE_UNIT);
+        glBindTexture(GL_TEXTURE_2D_ARRAY, g_ArrayTexture);
+    }
+    // Everything used after this belongs to the next frame
+    g_Frame++;
+}
+
+void textureTableTakeStats(TextureTableStats *pStats)
+{
+    *pStats = g_Stats;
+    g_Stats.madeResident = 0;
+    g_Stats.evicted = 0;
+}
@@ -0,0 +1,57 @@
+/*
+ * A table of many same-sized textures that shaders pick from by index, so
+ * drawing with a different texture never needs a bind.
+ *
+ * With GL_ARB_bindless_texture, each entry is its own texture, and the
+ * shader reads its 64-bit handle out of a storage buffer.  A handle has to
+ * be made resident before a draw uses it, and drivers limit how many can
+ * be, so the table keeps the most recently used ones resident, up to
+ * TEXTURE_RESIDENT_LIMIT, and evicts the least recently used.  Without
+ * the extension, the entries are the layers of one texture array instead,
+ * and the index picks the layer.
+ *
+ * Either way, the shader gets the same function:
+ *     vec4 sampleTable(uint index, vec2 uv);
+ */
+#ifndef TEXTURE_TABLE_H
+#define TEXTURE_TABLE_H
+
+#include <GL/glew.h>
+
+// Must match the bindings in textureTableShaderSource
+#define TEXTURE_TABLE_BUFFER_BINDING    2   // Bindless:  the handle buffer
+#define TEXTURE_TABLE_TEXTURE_UNIT      0   // Array:  the texture array
+
+// Most drivers handle a few thousand resident textures well
+#define TEXTURE_RESIDENT_LIMIT          1024
+
+typedef struct {
+    int residentCount;
+    int madeResident;       // Since the last call
+    int evicted;            // Since the last call
+} TextureTableStats;
+
+// Create storage for 'count' RGBA8 textures.  Uses bindless if
+// 'allowBindless' and the extension is there.  The texture array path can
+// hold fewer layers than asked for; returns the number of entries made.
+int textureTableInit(int count, int width, int height, bool allowBindless);
+
+// Fill one entry (width * height * 4 bytes)
+void textureTableUpload(int index, const GLubyte *pRgba);
+
+// Call after the uploads and before the first frame
+void textureTableFinish();
+
+bool textureTableIsBindless();
+
+// GLSL to put after the #version line of any shader that calls sampleTable
+const char *textureTableShaderSource();
+
+// Every frame:  call textureTableUse for each entry that will be drawn, then
+// textureTableBind once before drawing.
+void textureTableUse(int index);
+void textureTableBind();
+
+void textureTableTakeStats(TextureTableStats *pStats);
+
+#endif
@@ -0,0 +1,419 @@
+/*
+ * Demo 27:
+ * Deduplicated state.  Every pyramid describes its own sampler, vertex
+ * layout and program from scratch, the way Demo 16's setup functions do,
+ * but identical descriptions come back as the same GL object (see
+ * StateCache.h).  Drawing an object is then just binding a small set of
+ * cached handles, and binds that match the last ones are skipped.
+ *
+ * Press S to sort the draws by state and watch the bind count drop, any
+ * other key to exit.
+ *
+ * See README.txt for prerequisites.
+ */
+#include <windows.h>
+#include <WinGDI.h>
+
+#include <GL/glew.h>
+#include <GL/wglew.h>
+#include <GL/GL.h>
+#include <GL/glut.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stddef.h>
+
+#include <vmath.h>
+using vmath::mat4;
+
+#include "StateCache.h"
+
+// Apparently someone is still using segmented memory qualifiers,
+// and windows.h is letting them.
+#undef near
+#undef far
+
+#define CENTER_Z        12.0f    // Distance from camera
+#define DEPTH_OF_FIELD  8.0f
+
+#define GRID_SIZE       8
+#define OBJECT_COUNT    (GRID_SIZE * GRID_SIZE)
+
+typedef struct {
+    GLsizei count;
+    GLuint vboId;
+} ShapeInfo;
+
+typedef enum {
+    KIND_COLORED,
+    KIND_BLOCKY,
+    KIND_SMOOTH,
+    KIND_BLOCKY_AGAIN,  // Same as KIND_BLOCKY, described separately
+    KIND_COUNT
+} ObjectKind;
+
+typedef struct {
+    PipelineState state;
+    VertexLayoutDesc layout;    // For the buffer stride
+    const ShapeInfo *pShape;
+    float x, y;
+} ObjectInfo;
+
+typedef struct {
+    GLfloat x, y, z;
+    GLubyte red, green, blue;
+} ColorVertex;
+
+typedef struct {
+    GLfloat x, y, z;
+    GLubyte red, green, blue;
+    GLfloat texU, texV;
+} TexturedVertex;
+
+ShapeInfo g_ColoredPyramid, g_TexturedPyramid;
+ObjectInfo g_Objects[OBJECT_COUNT];
+ObjectInfo *g_DrawOrder[OBJECT_COUNT];
+mat4 g_ProjectionMatrix(mat4::identity());
+bool g_Sorted = false;
+
+// Must match hard-coded vPosition location in the vertex shaders
+#define V_POSITION 0
+
+// Must match hard-coded location in the vertex shaders
+#define C_POSITION 1
+
+// Must match hard-coded vTexture location in texturedVertSource
+#define T_POSITION 2
+
+// Must match hard-coded ModelViewProject location in the vertex shaders
+#define MVP_LOCATION 0
+
+// Must match hard-coded tex binding in texturedFragSource
+#define TEXTURE_UNIT 1
+
+const char *coloredVertSource =
+    "#version 430 core\n"
+    "layout(location = 0) uniform mat4 ModelViewProject;\n"
+    "layout(location = 0) in vec4 vPosition;\n"
+    "layout(location = 1) in vec3 vColor;\n"
+    "out vec3 color;\n"
+    "void main() {\n"
+    "    gl_Position = ModelViewProject * vPosition;\n"
+    "    color = vColor;\n"
+    "}\n";
+
+const char *coloredFragSource =
+    "#version 430 core\n"
+    "in vec3 color;\n"
+    "out vec4 fColor;\n"
+    "void main() {\n"
+    "    fColor = vec4(color, 1);\n"
+    "}\n";
+
+const char *texturedVertSource =
+    "#version 430 core\n"
+    "layout(location = 0) uniform mat4 ModelViewProject;\n"
+    "layout(location = 0) in vec4 vPosition;\n"
+    "layout(location = 1) in vec3 vColor;\n"
+    "layout(location = 2) in vec2 vTexture;\n"
+    "out vec3 color;\n"
+    "out vec2 vs_tex_coord;\n"
+    "void main() {\n"
+    "    gl_Position = ModelViewProject * vPosition;\n"
+    "    vs_tex_coord = vTexture;\n"
+    "    color = vColor;\n"
+    "}\n";
+
+const char *texturedFragSource =
+    "#version 430 core\n"
+    "layout(binding = 1) uniform sampler2D tex;\n"
+    "in vec3 color;\n"
+    "in vec2 vs_tex_coord;\n"
+    "out vec4 fColor;\n"
+    "void main() {\n"
+    "    vec4 texColor = texture(tex, vs_tex_coord);\n"
+    "    fColor = vec4(color, 0) * (1 - texColor.a) + texColor;\n"
+    "}\n";
+
+// Convert a simple bitmap (one bit per pixel) into an RGBA bitmap (four bytes per pixel)
+GLubyte* BuildMonochromeBitmap(const GLubyte* bits, int width, int height, GLubyte red, GLubyte green, GLubyte blue)
+{
+    GLubyte* retval = (GLubyte *)malloc(width * height * 4);
+    if (retval) {
+        GLubyte* ptr = retval;
+        for (int y = 0; y < height; y++) {
+            for (int x = 0; x < width/8; x++) {
+                GLubyte next8 = *bits++;
+                for (int mask = 128; mask > 0; mask >>= 1) {
+                    if (next8 & mask) {
+                        *ptr++ = red;
+                        *ptr++ = green;
+                        *ptr++ = blue;
+                        *ptr++ = 255;
+                    }
+                    else {
+                        *ptr++ = 0;
+                        *ptr++ = 0;
+                        *ptr++ = 0;
+                        *ptr++ = 0;
+                    }
+                }
+            }
+        }
+    }
+    return retval;
+}
+
+#define BITMAP_WIDTH 16
+#define BITMAP_HEIGHT 16
+#define BIT_BYTES ((BITMAP_WIDTH / 8) * BITMAP_HEIGHT)
+
+void setupTextures()
+{
+    // smiley face
+    GLubyte bits[BIT_BYTES] = {
+        0x00, 0x00,
+        0x00, 0x00,
+        0x07, 0xE0,
+        0x08, 0x10,
+        0x10, 0x08,
+        0x20, 0x04,
+        0x44, 0x22,
+        0x40, 0x02,
+        0x40, 0x02,
+        0x40, 0x02,
+        0x42, 0x42,
+        0x23, 0xc4,
+        0x10, 0x08,
+        0x0c, 0x30,
+        0x03, 0xc0,
+        0x00, 0x00,
+    };
+
+    GLubyte* data = BuildMonochromeBitmap(bits, BITMAP_WIDTH, BITMAP_HEIGHT, 255, 0, 0);
+    if (data) {
+        GLuint texture;
+        glGenTextures(1, &texture);
+        glActiveTexture(GL_TEXTURE0 + TEXTURE_UNIT);
+        glBindTexture(GL_TEXTURE_2D, texture);
+        // Complete mipmaps, for the smooth sampler
+        glTexStorage2D(GL_TEXTURE_2D, 4, GL_RGBA8, BITMAP_WIDTH, BITMAP_HEIGHT);
+        glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, BITMAP_WIDTH, BITMAP_HEIGHT, GL_RGBA, GL_UNSIGNED_BYTE, data);
+        glGenerateMipmap(GL_TEXTURE_2D);
+        free(data);
+    }
+}
+
+// The layouts are only descriptions now; the VAOs come from the cache
+void setupPyramids()
+{
+    static const TexturedVertex pyramidData[] = {
+        // Bottom
+        { 0.0f, 0.f, .5f, 255, 0, 0, 0.f, 0.f},
+        { 0.433f, 0.f, -.25f, 255, 0, 0, 0.f, 1.f},
+        { -0.433f, 0.f, -.25f, 255, 0, 0, 1.f, 1.f},
+        // Side 1
+        { -0.433f, 0.f, -.25f, 0, 0, 255, 0.f, 0.f},
+        { 0.433f, 0.f, -.25f, 0, 255, 255, 1.f, 0.f},
+        { 0.0f, 0.75f, 0.f, 255, 0, 255, 1.f, 1.f},
+        // Side 2
+        { -0.433f, 0.f, -.25f, 255, 255, 0, 0.f, 0.f},
+        { 0.0f, 0.f, .5f, 255, 255, 0, 0.f, 1.f},
+        { 0.0f, 0.75f, 0.f, 255, 255, 0, 1.f, 1.f},
+        // Side 3
+        { 0.0f, 0.f, .5f, 0, 255, 0, 4.f, 4.f},
+        { 0.0f, 0.75f, 0.f, 0, 255, 0, 2.f, 0.f},
+        { 0.433f, 0.f, -.25f, 0, 255, 0, 0.f, 4.f},
+    };
+    const int vertexCount = sizeof(pyramidData) / sizeof(pyramidData[0]);
+
+    // The colored pyramid is the same shape without texture coordinates
+    ColorVertex coloredData[vertexCount];
+    for (int i = 0; i < vertexCount; i++) {
+        ColorVertex v = { pyramidData[i].x, pyramidData[i].y, pyramidData[i].z,
+            pyramidData[i].red, pyramidData[i].green, pyramidData[i].blue };
+        coloredData[i] = v;
+    }
+
+    glGenBuffers(1, &g_TexturedPyramid.vboId);
+    glBindBuffer(GL_ARRAY_BUFFER, g_TexturedPyramid.vboId);
+    glBufferData(GL_ARRAY_BUFFER, sizeof(pyramidData), pyramidData, GL_STATIC_DRAW);
+    g_TexturedPyramid.count = vertexCount;
+
+    glGenBuffers(1, &g_ColoredPyramid.vboId);
+    glBindBuffer(GL_ARRAY_BUFFER, g_ColoredPyramid.vboId);
+    glBufferData(GL_ARRAY_BUFFER, sizeof(coloredData), coloredData, GL_STATIC_DRAW);
+    g_ColoredPyramid.count = vertexCount;
+}
+
+// Written the long way on purpose:  every object builds its own
+// descriptions, as separate setup code for each object would.
+void setupObject(ObjectKind kind, ObjectInfo *pObject)
+{
+    VertexLayoutDesc layout = { 0 };
+    ProgramDesc program;
+    PipelineState *pState = &pObject->state;
+    pState->sampler = 0;
+    pState->samplerUnit = TEXTURE_UNIT;
+
+    if (kind == KIND_COLORED) {
+        AttributeDesc position = { V_POSITION, 3, GL_FLOAT, GL_FALSE, GL_FALSE, offsetof(ColorVertex, x) };
+        AttributeDesc color = { C_POSITION, 3, GL_UNSIGNED_BYTE, GL_TRUE, GL_FALSE, offsetof(ColorVertex, red) };
+        layout.attributes[layout.attributeCount++] = position;
+        layout.attributes[layout.attributeCount++] = color;
+        layout.stride = sizeof(ColorVertex);
+        program.vertSource = coloredVertSource;
+        program.fragSource = coloredFragSource;
+        pObject->pShape = &g_ColoredPyramid;
+    }
+    else {
+        AttributeDesc position = { V_POSITION, 3, GL_FLOAT, GL_FALSE, GL_FALSE, offsetof(TexturedVertex, x) };
+        AttributeDesc color = { C_POSITION, 3, GL_UNSIGNED_BYTE, GL_TRUE, GL_FALSE, offsetof(TexturedVertex, red) };
+        AttributeDesc texture = { T_POSITION, 2, GL_FLOAT, GL_FALSE, GL_FALSE, offsetof(TexturedVertex, texU) };
+        layout.attributes[layout.attributeCount++] = position;
+        layout.attributes[layout.attributeCount++] = color;
+        layout.attributes[layout.attributeCount++] = texture;
+        layout.stride = sizeof(TexturedVertex);
+        program.vertSource = texturedVertSource;
+        program.fragSource = texturedFragSource;
+        pObject->pShape = &g_TexturedPyramid;
+
+        SamplerDesc sampler;
+        if (kind == KIND_SMOOTH) {
+            sampler.minFilter = GL_LINEAR_MIPMAP_LINEAR;
+            sampler.magFilter = GL_LINEAR;
+        }
+        else {
+            sampler.minFilter = GL_NEAREST;
+            sampler.magFilter = GL_NEAREST;
+        }
+        sampler.wrapS = GL_REPEAT;
+        sampler.wrapT = GL_REPEAT;
+        pState->sampler = stateSampler(&sampler);
+    }
+
+    pState->layout = stateVertexLayout(&layout);
+    pState->program = stateProgram(&program);
+    pObject->layout = layout;
+}
+
+void setupObjects()
+{
+    // Kinds are spread through the grid, so drawing in grid order keeps
+    // switching state
+    for (int n = 0; n < OBJECT_COUNT; n++) {
+        ObjectInfo *pObject = &g_Objects[n];
+        setupObject(ObjectKind(n % KIND_COUNT), pObject);
+        pObject->x = (n % GRID_SIZE - (GRID_SIZE - 1) / 2.f) * 1.2f;
+        pObject->y = (n / GRID_SIZE - (GRID_SIZE - 1) / 2.f) * 1.2f;
+        g_DrawOrder[n] = pObject;
+    }
+
+    StateCacheStats samplers, layouts, programs;
+    stateCacheStats(&samplers, &layouts, &programs);
+    printf("%d sampler requests made %d samplers\n", samplers.requests, samplers.created);
+    printf("%d layout requests made %d VAOs\n", layouts.requests, layouts.created);
+    printf("%d program requests made %d programs\n", programs.requests, programs.created);
+}
+
+static int compareState(const void *pA, const void *pB)
+{
+    const PipelineState *a = &(*(ObjectInfo *const *)pA)->state;
+    const PipelineState *b = &(*(ObjectInfo *const *)pB)->state;
+    // Programs are the most expensive to switch, so they go first
+    if (a->program != b->program) {
+        return a->program < b->program ? -1 : 1;
+    }
+    if (a->layout != b->layout) {
+        return a->layout < b->layout ? -1 : 1;
+    }
+    if (a->sampler != b->sampler) {
+        return a->sampler < b->sampler ? -1 : 1;
+    }
+    return 0;
+}
+
+void setDrawOrder(bool sorted)
+{
+    for (int n = 0; n < OBJECT_COUNT; n++) {
+        g_DrawOrder[n] = &g_Objects[n];
+    }
+    if (sorted) {
+        qsort(g_DrawOrder, OBJECT_COUNT, sizeof(g_DrawOrder[0]), compareState);
+    }
+}
+
+void setupFrustum(float left, float right, float bottom, float top, float zNear, float zFar)
+{
+    g_ProjectionMatrix = vmath::frustum(left, right, bottom, top, zNear, zFar);
+}
+
+void onDisplay()
+{
+    static int i = 0;
+    static int frames = 0;
+    static int binds = 0;
+    static int lastReport = glutGet(GLUT_ELAPSED_TIME);
+    i++;
+
+    glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+    for (int n = 0; n < OBJECT_COUNT; n++) {
+        const ObjectInfo *pObject = g_DrawOrder[n];
+        binds += stateBind(&pObject->state);
+        stateBindVertexBuffer(pObject->pShape->vboId, &pObject->layout);
+
+        mat4 modelViewMatrix(vmath::translate(pObject->x, pObject->y, -CENTER_Z));
+        modelViewMatrix *= vmath::rotate(i * .5f + n * 11.f, 0.f, 1.f, 0.f);
+        glUniformMatrix4fv(MVP_LOCATION, 1, GL_FALSE, g_ProjectionMatrix * modelViewMatrix);
+        glDrawArrays(GL_TRIANGLES, 0, pObject->pShape->count);
+    }
+    glutSwapBuffers();
+
+    frames++;
+    int now = glutGet(GLUT_ELAPSED_TIME);
+    if (now - lastReport >= 2000) {
+        printf("Draws %s: %.1f state binds per frame for %d objects\n",
+            g_Sorted ? "sorted" : "unsorted", double(binds) / frames, OBJECT_COUNT);
+        frames = 0;
+        binds = 0;
+        lastReport = now;
+    }
+}
+
+void onKey(unsigned char key, int x, int y)
+{
+    if (key == 's' || key == 'S') {
+        g_Sorted = !g_Sorted;
+        setDrawOrder(g_Sorted);
+        return;
+    }
+    exit(0);
+}
+
+int main(int argc, char *argv[])
+{
+    glutInit(&argc, argv);
+    glutInitDisplayMode(GLUT_RGBA | GLUT_DOUBLE | GLUT_DEPTH);
+    glutInitWindowSize(640, 480);
+    glutCreateWindow(argv[0]);
+
+    glewInit();
+    wglSwapIntervalEXT(1);	// vsync
+
+    glEnable(GL_DEPTH_TEST);
+
+    GLfloat ratio = 640.0f / 480.0f;
+    GLfloat zNear = CENTER_Z - DEPTH_OF_FIELD/2;
+    GLfloat top = zNear * .45f;
+    setupFrustum(-ratio * top, ratio * top, -top, top, zNear, CENTER_Z + DEPTH_OF_FIELD/2);
+
+    setupPyramids();
+    setupTextures();
+    setupObjects();
+    glutDisplayFunc(onDisplay);
+    glutIdleFunc(onDisplay);
+    glutKeyboardFunc(onKey);
+    glutMainLoop();
+
+    return 0;
+}
@@ -0,0 +1,285 @@
+/*
+ * Deduplicating state caches.  See StateCache.h.
+ */
+#include "StateCache.h"
+
+#include <stdio.h>
+#include <string>
+#include <atomic>
+#include <mutex>
+
+// What each cache stores and compares.  Programs keep their own copy of
+// the source, since the caller's strings may not live as long as the cache.
+typedef struct {
+    std::string vertSource;
+    std::string fragSource;
+} ProgramKey;
+
+// 64-bit FNV-1a
+#define HASH_START  0xcbf29ce484222325ULL
+
+static unsigned long long hashBytes(unsigned long long hash, const void *pData, size_t size)
+{
+    const unsigned char *p = (const unsigned char *)pData;
+    for (size_t i = 0; i < size; i++) {
+        hash = (hash ^ p[i]) * 0x100000001b3ULL;
+    }
+    return hash;
+}
+
+// Hash field by field, so padding bytes never count
+static unsigned long long hashOf(const SamplerDesc &desc)
+{
+    unsigned long long hash = HASH_START;
+    hash = hashBytes(hash, &desc.minFilter, sizeof(desc.minFilter));
+    hash = hashBytes(hash, &desc.magFilter, sizeof(desc.magFilter));
+    hash = hashBytes(hash, &desc.wrapS, sizeof(desc.wrapS));
+    return hashBytes(hash, &desc.wrapT, sizeof(desc.wrapT));
+}
+
+// The stride belongs to the buffer binding, not the VAO, so it isn't part
+// of the key.
+static unsigned long long hashOf(const VertexLayoutDesc &desc)
+{
+    unsigned long long hash = hashBytes(HASH_START, &desc.attributeCount, sizeof(desc.attributeCount));
+    for (int i = 0; i < desc.attributeCount; i++) {
+        const AttributeDesc &a = desc.attributes[i];
+        hash = hashBytes(hash, &a.location, sizeof(a.location));
+        hash = hashBytes(hash, &a.size, sizeof(a.size));
+        hash = hashBytes(hash, &a.type, sizeof(a.type));
+        hash = hashBytes(hash, &a.normalized, sizeof(a.normalized));
+        hash = hashBytes(hash, &a.integer, sizeof(a.integer));
+        hash = hashBytes(hash, &a.offset, sizeof(a.offset));
+    }
+    return hash;
+}
+
+static unsigned long long hashOf(const ProgramKey &key)
+{
+    unsigned long long hash = hashBytes(HASH_START, key.vertSource.data(), key.vertSource.size());
+    // Keep "ab" + "c" different from "a" + "bc"
+    hash = hashBytes(hash, "\0", 1);
+    return hashBytes(hash, key.fragSource.data(), key.fragSource.size());
+}
+
+static bool same(const SamplerDesc &a, const SamplerDesc &b)
+{
+    return a.minFilter == b.minFilter && a.magFilter == b.magFilter && a.wrapS == b.wrapS && a.wrapT == b.wrapT;
+}
+
+static bool same(const VertexLayoutDesc &a, const VertexLayoutDesc &b)
+{
+    if (a.attributeCount != b.attributeCount) {
+        return false;
+    }
+    for (int i = 0; i < a.attributeCount; i++) {
+        const AttributeDesc &x = a.attributes[i], &y = b.attributes[i];
+        if (x.location != y.location || x.size != y.size || x.type != y.type ||
+            x.normalized != y.normalized || x.integer != y.integer || x.offset != y.offset) {
+            return false;
+        }
+    }
+    return true;
+}
+
+static bool same(const ProgramKey &a, const ProgramKey &b)
+{
+    return a.vertSource == b.vertSource && a.fragSource == b.fragSource;
+}
+
+static PipelineState g_Bound = { 0, 0, 0, 0 };
+
+static GLuint create(const SamplerDesc &desc)
+{
+    GLuint sampler;
+    glGenSamplers(1, &sampler);
+    glSamplerParameteri(sampler, GL_TEXTURE_MIN_FILTER, desc.minFilter);
+    glSamplerParameteri(sampler, GL_TEXTURE_MAG_FILTER, desc.magFilter);
+    glSamplerParameteri(sampler, GL_TEXTURE_WRAP_S, desc.wrapS);
+    glSamplerParameteri(sampler, GL_TEXTURE_WRAP_T, desc.wrapT);
+    return sampler;
+}
+
+static GLuint create(const VertexLayoutDesc &desc)
+{
+    GLuint vao;
+    glGenVertexArrays(1, &vao);
+    glBindVertexArray(vao);
+    for (int i = 0; i < desc.attributeCount; i++) {
+        const AttributeDesc &a = desc.attributes[i];
+        if (a.integer) {
+            glVertexAttribIFormat(a.location, a.size, a.type, a.offset);
+        }
+        else {
+            glVertexAttribFormat(a.location, a.size, a.type, a.normalized, a.offset);
+        }
+        glVertexAttribBinding(a.location, 0);
+        glEnableVertexAttribArray(a.location);
+    }
+    glBindVertexArray(0);
+    g_Bound.layout = 0;
+    return vao;
+}
+
+static GLuint compileShader(GLenum type, const std::string &source)
+{
+    GLuint shader = glCreateShader(type);
+    const GLchar *pSource = source.c_str();
+    glShaderSource(shader, 1, &pSource, NULL);
+    glCompileShader(shader);
+    return shader;
+}
+
+static GLuint create(const ProgramKey &key)
+{
+    GLuint vertShader = compileShader(GL_VERTEX_SHADER, key.vertSource);
+    GLuint fragShader = compileShader(GL_FRAGMENT_SHADER, key.fragSource);
+    GLuint program = glCreateProgram();
+    glAttachShader(program, vertShader);
+    glAttachShader(program, fragShader);
+    glLinkProgram(program);
+    glDetachShader(program, vertShader);
+    glDetachShader(program, fragShader);
+    glDeleteShader(vertShader);
+    glDeleteShader(fragShader);
+
+    // A broken program is cached as 0, so it is only reported once
+    GLint linked;
+    glGetProgramiv(program, GL_LINK_STATUS, &linked);
+    if (!linked) {
+        GLchar infoLog[4096];
+        GLsizei length;
+        glGetProgramInfoLog(program, 4096, &length, infoLog);
+        printf("Program failed to build:\n%s\n", infoLog);
+        glDeleteProgram(program);
+        return 0;
+    }
+    return program;
+}
+
+// One cache.  A slot's key and object are written before its hash is
+// published, and never change afterwards, so a reader that sees the hash
+// (with acquire ordering) can read the rest without a lock.
+template <typename Key>
+class StateTable {
+public:
+    GLuint find(const Key &key)
+    {
+        m_Requests++;
+        unsigned long long hash = hashOf(key);
+        // Zero marks an empty slot
+        hash = hash ? hash : 1;
+        int slot;
+        if (probe(key, hash, &slot)) {
+            return m_Slots[slot].object;
+        }
+
+        std::lock_guard<std::mutex> lock(m_Mutex);
+        // Someone may have added it while we weren't holding the lock
+        if (probe(key, hash, &slot)) {
+            return m_Slots[slot].object;
+        }
+        if (slot < 0) {
+            printf("State cache full\n");
+            return 0;
+        }
+        m_Slots[slot].key = key;
+        m_Slots[slot].object = create(key);
+        m_Slots[slot].hash.store(hash, std::memory_order_release);
+        m_Created++;
+        return m_Slots[slot].object;
+    }
+
+    void stats(StateCacheStats *pStats)
+    {
+        pStats->requests = m_Requests;
+        pStats->created = m_Created;
+    }
+
+private:
+    typedef struct {
+        std::atomic<unsigned long long> hash;
+        Key key;
+        GLuint object;
+    } Slot;
+
+    // True and the slot if found; otherwise false and the first empty slot
+    // (or -1 if full).  Slots are never removed, so the first empty slot
+    // ends the search.
+    bool probe(const Key &key, unsigned long long hash, int *pSlot)
+    {
+        int start = int(hash % STATE_CACHE_SIZE);
+        for (int i = 0; i < STATE_CACHE_SIZE; i++) {
+            int slot = (start + i) % STATE_CACHE_SIZE;
+            unsigned long long slotHash = m_Slots[slot].hash.load(std::memory_order_acquire);
+            if (slotHash == 0) {
+                *pSlot = slot;
+                return false;
+            }
+            if (slotHash == hash && same(m_Slots[slot].key, key)) {
+                *pSlot = slot;
+                return true;
+            }
+        }
+        *pSlot = -1;
+        return false;
+    }
+
+    Slot m_Slots[STATE_CACHE_SIZE];
+    std::mutex m_Mutex;
+    std::atomic<int> m_Requests;
+    std::atomic<int> m_Created;
+};
+
+static StateTable<SamplerDesc> g_Samplers;
+static StateTable<VertexLayoutDesc> g_Layouts;
+static StateTable<ProgramKey> g_Programs;
+
+GLuint stateSampler(const SamplerDesc *pDesc)
+{
+    return g_Samplers.find(*pDesc);
+}
+
+GLuint stateVertexLayout(const VertexLayoutDesc *pDesc)
+{
+    return g_Layouts.find(*pDesc);
+}
+
+GLuint stateProgram(const ProgramDesc *pDesc)
+{
+    ProgramKey key;
+    key.vertSource = pDesc->vertSource;
+    key.fragSource = pDesc->fragSource;
+    return g_Programs.find(key);
+}
+
+int stateBind(const PipelineState *pState)
+{
+    int binds = 0;
+    if (pState->program != g_Bound.program) {
+        glUseProgram(pState->program);
+        binds++;
+    }
+    if (pState->layout != g_Bound.layout) {
+        glBindVertexArray(pState->layout);
+        binds++;
+    }
+    if (pState->sampler != g_Bound.sampler || pState->samplerUnit != g_Bound.samplerUnit) {
+        glBindSampler(pState->samplerUnit, pState->sampler);
+        binds++;
+    }
+    g_Bound = *pState;
+    return binds;
+}
+
+void stateBindVertexBuffer(GLuint buffer, const VertexLayoutDesc *pDesc)
+{
+    glBindVertexBuffer(0, buffer, 0, pDesc->stride);
+}
+
+void stateCacheStats(StateCacheStats *pSamplers, StateCacheStats *pLayouts, StateCacheStats *pPrograms)
+{
+    g_Samplers.stats(pSamplers);
+    g_Layouts.stats(pLayouts);
+    g_Programs.stats(pPrograms);
+}
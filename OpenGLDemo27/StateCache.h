@@ -0,0 +1,79 @@
+/*
+ * Deduplicating caches for samplers, vertex layouts and programs.
+ *
+ * State is described by value, and every description with the same
+ * contents maps to one GL object:  ask for the same sampler description a
+ * hundred times and one sampler gets made.  Each cache is a fixed-size
+ * open-addressing hash table keyed by a hash of the description.  Entries
+ * are published with an atomic store and never move or change after that,
+ * so looking up existing state takes no lock.  Creating new state takes a
+ * lock and must happen on the thread with the GL context.
+ *
+ * Vertex layouts use separate attribute formats (GL 4.3), so a VAO holds
+ * only the layout, and any buffer with that layout can be attached with
+ * glBindVertexBuffer at binding 0.
+ */
+#ifndef STATE_CACHE_H
+#define STATE_CACHE_H
+
+#include <GL/glew.h>
+
+#define MAX_LAYOUT_ATTRIBUTES   8
+
+// Capacity of each cache.  Plenty for a demo; a full cache returns 0.
+#define STATE_CACHE_SIZE        256
+
+typedef struct {
+    GLenum minFilter, magFilter;
+    GLenum wrapS, wrapT;
+} SamplerDesc;
+
+typedef struct {
+    GLuint location;
+    GLint size;             // Components
+    GLenum type;
+    GLboolean normalized;
+    GLboolean integer;      // Use glVertexAttribIFormat
+    GLuint offset;
+} AttributeDesc;
+
+typedef struct {
+    int attributeCount;
+    AttributeDesc attributes[MAX_LAYOUT_ATTRIBUTES];
+    GLsizei stride;         // Used by stateBindVertexBuffer
+} VertexLayoutDesc;
+
+// Sources are hashed by contents, so two copies of the same text match.
+// They must have their own #version line.
+typedef struct {
+    const char *vertSource;
+    const char *fragSource;
+} ProgramDesc;
+
+// Everything a draw needs besides its buffers and uniforms
+typedef struct {
+    GLuint program;
+    GLuint layout;          // A VAO from stateVertexLayout
+    GLuint sampler;
+    GLuint samplerUnit;
+} PipelineState;
+
+typedef struct {
+    int requests;           // Lookups of any kind
+    int created;            // GL objects made
+} StateCacheStats;
+
+GLuint stateSampler(const SamplerDesc *pDesc);
+GLuint stateVertexLayout(const VertexLayoutDesc *pDesc);
+GLuint stateProgram(const ProgramDesc *pDesc);
+
+// Bind a pipeline, skipping whatever already matches the last one bound.
+// Returns the number of GL binds made.
+int stateBind(const PipelineState *pState);
+
+// Attach a vertex buffer to the currently bound layout
+void stateBindVertexBuffer(GLuint buffer, const VertexLayoutDesc *pDesc);
+
+void stateCacheStats(StateCacheStats *pSamplers, StateCacheStats *pLayouts, StateCacheStats *pPrograms);
+
+#endif
@@ -0,0 +1,299 @@
+/*
+ * SSE keyframe sampling.  See AnimationSampler.h.
+ */
+#include "AnimationSampler.h"
+
+#include <math.h>
+#include <string.h>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+
+#include <xmmintrin.h>
+
+// Components of a key, in the order they are stored
+enum {
+    KEY_X, KEY_Y, KEY_Z,
+    KEY_QX, KEY_QY, KEY_QZ, KEY_QW,
+    KEY_SCALE,
+    KEY_COMPONENTS
+};
+
+// Below this many groups of four tracks, waking threads costs more than
+// it saves
+#define MIN_GROUPS_PER_THREAD 512
+
+bool animationCreate(AnimationSet *pSet, int trackCount, int keyCount, float keyInterval)
+{
+    pSet->trackCount = trackCount;
+    pSet->keyCount = keyCount;
+    pSet->keyInterval = keyInterval;
+    pSet->paddedTrackCount = (trackCount + 3) & ~3;
+
+    size_t floats = size_t(keyCount) * KEY_COMPONENTS * pSet->paddedTrackCount;
+    pSet->pKeys = (float *)_mm_malloc(floats * sizeof(float), 16);
+    if (!pSet->pKeys) {
+        return false;
+    }
+
+    // Identity everywhere, so padding tracks blend to something harmless
+    memset(pSet->pKeys, 0, floats * sizeof(float));
+    for (int key = 0; key < keyCount; key++) {
+        float *pKey = pSet->pKeys + size_t(key) * KEY_COMPONENTS * pSet->paddedTrackCount;
+        for (int track = 0; track < pSet->paddedTrackCount; track++) {
+            pKey[KEY_QW * pSet->paddedTrackCount + track] = 1.f;
+            pKey[KEY_SCALE * pSet->paddedTrackCount + track] = 1.f;
+        }
+    }
+    return true;
+}
+
+void animationDestroy(AnimationSet *pSet)
+{
+    _mm_free(pSet->pKeys);
+    pSet->pKeys = NULL;
+}
+
+void animationSetKey(AnimationSet *pSet, int track, int key, const AnimationKey *pKey)
+{
+    float values[KEY_COMPONENTS] = {
+        pKey->position[0], pKey->position[1], pKey->position[2],
+        pKey->rotation[0], pKey->rotation[1], pKey->rotation[2], pKey->rotation[3],
+        pKey->scale
+    };
+    float *pDest = pSet->pKeys + size_t(key) * KEY_COMPONENTS * pSet->paddedTrackCount + track;
+    for (int c = 0; c < KEY_COMPONENTS; c++) {
+        pDest[c * pSet->paddedTrackCount] = values[c];
+    }
+}
+
+// Store four tracks' worth of one matrix column, given as x, y, z and w
+// across the tracks.  pDest points at the first track's column.
+static inline void storeColumn(float *pDest, __m128 x, __m128 y, __m128 z, __m128 w)
+{
+    _MM_TRANSPOSE4_PS(x, y, z, w);
+    _mm_storeu_ps(pDest, x);
+    _mm_storeu_ps(pDest + 16, y);
+    _mm_storeu_ps(pDest + 32, z);
+    _mm_storeu_ps(pDest + 48, w);
+}
+
+static void sampleRange(const AnimationSet *pSet, int key0, int key1, float blend,
+    int firstGroup, int lastGroup, float *pMatrices)
+{
+    const int padded = pSet->paddedTrackCount;
+    const float *pKey0 = pSet->pKeys + size_t(key0) * KEY_COMPONENTS * padded;
+    const float *pKey1 = pSet->pKeys + size_t(key1) * KEY_COMPONENTS * padded;
+    const __m128 zero = _mm_setzero_ps();
+    const __m128 one = _mm_set1_ps(1.f);
+    const __m128 two = _mm_set1_ps(2.f);
+    const __m128 signBit = _mm_set1_ps(-0.f);
+    const __m128 t = _mm_set1_ps(blend);
+
+    // The slerp approximation's blend factor is a cubic in t whose shape
+    // depends on the angle between the keys.  These parts depend only on t.
+    const __m128 tCentered = _mm_set1_ps(blend - .5f);
+    const __m128 tSquared = _mm_mul_ps(tCentered, tCentered);
+    const __m128 tCubic = _mm_set1_ps(blend * (blend - .5f) * (blend - 1.f));
+
+    for (int group = firstGroup; group < lastGroup; group++) {
+        const float *p0 = pKey0 + group * 4;
+        const float *p1 = pKey1 + group * 4;
+        float *pDest = pMatrices + size_t(group) * 4 * 16;
+
+        // The last group may be partly padding, which has nowhere to go
+        __m128 partial[16];
+        int tracks = pSet->trackCount - group * 4;
+        if (tracks < 4) {
+            pDest = (float *)partial;
+        }
+
+        // Position and scale:  lerp
+        __m128 px = _mm_load_ps(p0 + KEY_X * padded);
+        __m128 py = _mm_load_ps(p0 + KEY_Y * padded);
+        __m128 pz = _mm_load_ps(p0 + KEY_Z * padded);
+        __m128 s = _mm_load_ps(p0 + KEY_SCALE * padded);
+        px = _mm_add_ps(px, _mm_mul_ps(t, _mm_sub_ps(_mm_load_ps(p1 + KEY_X * padded), px)));
+        py = _mm_add_ps(py, _mm_mul_ps(t, _mm_sub_ps(_mm_load_ps(p1 + KEY_Y * padded), py)));
+        pz = _mm_add_ps(pz, _mm_mul_ps(t, _mm_sub_ps(_mm_load_ps(p1 + KEY_Z * padded), pz)));
+        s = _mm_add_ps(s, _mm_mul_ps(t, _mm_sub_ps(_mm_load_ps(p1 + KEY_SCALE * padded), s)));
+
+        // Rotation:  take the short way round, then nlerp with the blend
+        // factor adjusted so the result follows slerp to within about 1e-3
+        // (Kapoulkine's "onlerp" fit).  True slerp needs acos and sin per
+        // lane, which SSE doesn't have.
+        __m128 ax = _mm_load_ps(p0 + KEY_QX * padded);
+        __m128 ay = _mm_load_ps(p0 + KEY_QY * padded);
+        __m128 az = _mm_load_ps(p0 + KEY_QZ * padded);
+        __m128 aw = _mm_load_ps(p0 + KEY_QW * padded);
+        __m128 bx = _mm_load_ps(p1 + KEY_QX * padded);
+        __m128 by = _mm_load_ps(p1 + KEY_QY * padded);
+        __m128 bz = _mm_load_ps(p1 + KEY_QZ * padded);
+        __m128 bw = _mm_load_ps(p1 + KEY_QW * padded);
+        __m128 dot = _mm_add_ps(_mm_add_ps(_mm_mul_ps(ax, bx), _mm_mul_ps(ay, by)),
+            _mm_add_ps(_mm_mul_ps(az, bz), _mm_mul_ps(aw, bw)));
+        __m128 flip = _mm_and_ps(dot, signBit);
+        bx = _mm_xor_ps(bx, flip);
+        by = _mm_xor_ps(by, flip);
+        bz = _mm_xor_ps(bz, flip);
+        bw = _mm_xor_ps(bw, flip);
+        __m128 d = _mm_andnot_ps(signBit, dot);
+
+        __m128 A = _mm_add_ps(_mm_set1_ps(1.0904f), _mm_mul_ps(d, _mm_add_ps(_mm_set1_ps(-3.2452f),
+            _mm_mul_ps(d, _mm_sub_ps(_mm_set1_ps(3.55645f), _mm_mul_ps(d, _mm_set1_ps(1.43519f)))))));
+        __m128 B = _mm_add_ps(_mm_set1_ps(0.848013f), _mm_mul_ps(d, _mm_add_ps(_mm_set1_ps(-1.06021f),
+            _mm_mul_ps(d, _mm_set1_ps(0.215638f)))));
+        __m128 k = _mm_add_ps(_mm_mul_ps(A, tSquared), B);
+        __m128 ot = _mm_add_ps(t, _mm_mul_ps(tCubic, k));
+
+        __m128 qx = _mm_add_ps(ax, _mm_mul_ps(ot, _mm_sub_ps(bx, ax)));
+        __m128 qy = _mm_add_ps(ay, _mm_mul_ps(ot, _mm_sub_ps(by, ay)));
+        __m128 qz = _mm_add_ps(az, _mm_mul_ps(ot, _mm_sub_ps(bz, az)));
+        __m128 qw = _mm_add_ps(aw, _mm_mul_ps(ot, _mm_sub_ps(bw, aw)));
+        __m128 lengthSquared = _mm_add_ps(_mm_add_ps(_mm_mul_ps(qx, qx), _mm_mul_ps(qy, qy)),
+            _mm_add_ps(_mm_mul_ps(qz, qz), _mm_mul_ps(qw, qw)));
+
+        // Normalizing and doubling at once:  every term of the matrix is
+        // 2 * q * q / |q|^2
+        __m128 twoOverLength = _mm_div_ps(two, lengthSquared);
+        __m128 x2 = _mm_mul_ps(qx, twoOverLength);
+        __m128 y2 = _mm_mul_ps(qy, twoOverLength);
+        __m128 z2 = _mm_mul_ps(qz, twoOverLength);
+        __m128 xx = _mm_mul_ps(qx, x2), yy = _mm_mul_ps(qy, y2), zz = _mm_mul_ps(qz, z2);
+        __m128 xy = _mm_mul_ps(qx, y2), xz = _mm_mul_ps(qx, z2), yz = _mm_mul_ps(qy, z2);
+        __m128 wx = _mm_mul_ps(qw, x2), wy = _mm_mul_ps(qw, y2), wz = _mm_mul_ps(qw, z2);
+
+        storeColumn(pDest,
+            _mm_mul_ps(s, _mm_sub_ps(one, _mm_add_ps(yy, zz))),
+            _mm_mul_ps(s, _mm_add_ps(xy, wz)),
+            _mm_mul_ps(s, _mm_sub_ps(xz, wy)),
+            zero);
+        storeColumn(pDest + 4,
+            _mm_mul_ps(s, _mm_sub_ps(xy, wz)),
+            _mm_mul_ps(s, _mm_sub_ps(one, _mm_add_ps(xx, zz))),
+            _mm_mul_ps(s, _mm_add_ps(yz, wx)),
+            zero);
+        storeColumn(pDest + 8,
+            _mm_mul_ps(s, _mm_add_ps(xz, wy)),
+            _mm_mul_ps(s, _mm_sub_ps(yz, wx)),
+            _mm_mul_ps(s, _mm_sub_ps(one, _mm_add_ps(xx, yy))),
+            zero);
+        storeColumn(pDest + 12, px, py, pz, one);
+
+        if (tracks < 4) {
+            memcpy(pMatrices + size_t(group) * 4 * 16, partial, tracks * 16 * sizeof(float));
+        }
+    }
+}
+
+typedef struct {
+    const AnimationSet *pSet;
+    int key0, key1;
+    float blend;
+    int groups, chunk;
+    float *pMatrices;
+} SampleBatch;
+
+// Sampling runs every frame, so the workers are started once, on the first
+// call that wants them, and sleep between frames.  Thread 0 is the caller.
+// Never freed:  the workers are still blocked on it at exit.
+typedef struct {
+    std::mutex mutex;
+    std::condition_variable wake, done;
+    int workers;
+    long long generation;       // Batches ever started
+    int active;                 // Threads in the current batch
+    int remaining;              // Workers not yet done with it
+    SampleBatch batch;
+} WorkerPool;
+
+static WorkerPool *g_pPool;
+
+static void sampleChunk(const SampleBatch *pBatch, int i)
+{
+    int first = i * pBatch->chunk;
+    int last = first + pBatch->chunk < pBatch->groups ? first + pBatch->chunk : pBatch->groups;
+    if (first < last) {
+        sampleRange(pBatch->pSet, pBatch->key0, pBatch->key1, pBatch->blend, first, last, pBatch->pMatrices);
+    }
+}
+
+static void workerMain(int i)
+{
+    WorkerPool *pPool = g_pPool;
+    long long seen = 0;
+    for (;;) {
+        SampleBatch batch;
+        {
+            std::unique_lock<std::mutex> lock(pPool->mutex);
+            while (pPool->generation == seen) {
+                pPool->wake.wait(lock);
+            }
+            seen = pPool->generation;
+            if (i >= pPool->active) {
+                continue;
+            }
+            batch = pPool->batch;
+        }
+        sampleChunk(&batch, i);
+
+        std::lock_guard<std::mutex> lock(pPool->mutex);
+        if (--pPool->remaining == 0) {
+            pPool->done.notify_one();
+        }
+    }
+}
+
+void animationSample(const AnimationSet *pSet, float t, float *pMatrices, int threadCount)
+{
+    if (pSet->trackCount <= 0 || pSet->keyCount <= 0) {
+        return;
+    }
+
+    // Every track blends the same two keys by the same amount
+    float position = t / pSet->keyInterval;
+    float whole = floorf(position);
+    float blend = position - whole;
+    int key0 = int(fmodf(whole, float(pSet->keyCount)));
+    key0 = key0 < 0 ? key0 + pSet->keyCount : key0;
+    int key1 = key0 + 1 < pSet->keyCount ? key0 + 1 : 0;
+
+    int groups = pSet->paddedTrackCount / 4;
+    if (threadCount <= 0) {
+        threadCount = int(std::thread::hardware_concurrency());
+        if (threadCount <= 0) {
+            threadCount = 1;
+        }
+    }
+    if (threadCount > groups / MIN_GROUPS_PER_THREAD) {
+        threadCount = groups / MIN_GROUPS_PER_THREAD > 0 ? groups / MIN_GROUPS_PER_THREAD : 1;
+    }
+    int chunk = (groups + threadCount - 1) / threadCount;
+
+    // The keys are only read, and each thread writes its own matrices.  The
+    // calling thread takes the first chunk itself.
+    SampleBatch batch = { pSet, key0, key1, blend, groups, chunk, pMatrices };
+    if (threadCount == 1) {
+        sampleChunk(&batch, 0);
+        return;
+    }
+    if (!g_pPool) {
+        g_pPool = new WorkerPool();
+    }
+    {
+        std::lock_guard<std::mutex> lock(g_pPool->mutex);
+        while (g_pPool->workers < threadCount - 1) {
+            std::thread(workerMain, ++g_pPool->workers).detach();
+        }
+        g_pPool->batch = batch;
+        g_pPool->active = threadCount;
+        g_pPool->remaining = threadCount - 1;
+        g_pPool->generation++;
+        g_pPool->wake.notify_all();
+    }
+    sampleChunk(&batch, 0);
+    std::unique_lock<std::mutex> lock(g_pPool->mutex);
+    while (g_pPool->remaining > 0) {
+        g_pPool->done.wait(lock);
+    }
+}
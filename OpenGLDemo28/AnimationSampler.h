@@ -0,0 +1,45 @@
+/*
+ * Keyframe animation for many objects at once.
+ *
+ * A track is a loop of keys, each holding a position, a rotation quaternion
+ * and a uniform scale.  All the tracks in a set share their key times
+ * (keyCount keys, keyInterval seconds apart, as baked clips usually are),
+ * so at any time t every track blends the same pair of keys by the same
+ * amount.  That lets the keys be stored structure-of-arrays, one array per
+ * component per key, and four tracks be blended at once with SSE:  positions
+ * and scales with a lerp, rotations with an approximated slerp.
+ *
+ * Sampling writes column-major model matrices (the same as GL and vmath)
+ * straight to the destination, which can be a write-only mapped GL buffer,
+ * and is split across threads.
+ */
+#ifndef ANIMATION_SAMPLER_H
+#define ANIMATION_SAMPLER_H
+
+typedef struct {
+    float position[3];
+    float rotation[4];      // Unit quaternion x, y, z, w
+    float scale;
+} AnimationKey;
+
+typedef struct {
+    int trackCount;
+    int keyCount;
+    float keyInterval;      // Seconds between keys
+    int paddedTrackCount;   // trackCount rounded up to a multiple of 4
+    float *pKeys;           // [key][component][paddedTrackCount]
+} AnimationSet;
+
+// Allocate room for the keys; every key starts as the identity.  Returns
+// false if out of memory.
+bool animationCreate(AnimationSet *pSet, int trackCount, int keyCount, float keyInterval);
+void animationDestroy(AnimationSet *pSet);
+
+void animationSetKey(AnimationSet *pSet, int track, int key, const AnimationKey *pKey);
+
+// Evaluate every track at time t (in seconds, looping after keyCount keys)
+// into pMatrices, 16 floats per track.  threadCount <= 0 means one thread
+// per core.
+void animationSample(const AnimationSet *pSet, float t, float *pMatrices, int threadCount);
+
+#endif
@@ -0,0 +1,322 @@
+/*
+ * Demo 28:
+ * Keyframed animation for 20,000 pyramids.  Instead of working out each
+ * object's motion with sines and cosines in onDisplay, every pyramid has an
+ * authored track of positions, rotations and scales, and all the tracks are
+ * sampled at once with SSE on every core (see AnimationSampler.h).  The
+ * sampler writes the model matrices straight into a persistently mapped
+ * buffer, and everything is drawn with one instanced draw.
+ *
+ * Press T to switch between one sampling thread and one per core, any
+ * other key to exit.
+ *
+ * See README.txt for prerequisites.
+ */
+#include <windows.h>
+#include <WinGDI.h>
+
+#include <GL/glew.h>
+#include <GL/wglew.h>
+#include <GL/GL.h>
+#include <GL/glut.h>
+
+#include <stdio.h>
+#include <stddef.h>
+
+#include <vmath.h>
+using vmath::mat4;
+
+#include "AnimationSampler.h"
+
+// Apparently someone is still using segmented memory qualifiers,
+// and windows.h is letting them.
+#undef near
+#undef far
+
+#define CENTER_Z        60.0f    // Distance from camera
+#define DEPTH_OF_FIELD  10.0f
+
+// Exercise:  Raise this until sampling shows up in the frame time
+#define GRID_WIDTH      160
+#define GRID_HEIGHT     125
+#define OBJECT_COUNT    (GRID_WIDTH * GRID_HEIGHT)
+#define GRID_SPACING    .45f
+
+#define KEY_COUNT       8
+#define KEY_INTERVAL    .5f     // Seconds, so every track loops in 4
+
+// Frames the GPU may be behind by.  Each has its own region of the
+// matrix buffer, so the sampler never writes what is still being drawn.
+#define RING_FRAMES     3
+
+typedef struct {
+    GLsizei count;
+    GLuint vaoId;
+} ShapeInfo;
+
+ShapeInfo g_Pyramid;
+AnimationSet g_Animation;
+GLuint g_MatrixBuffer;
+GLsizeiptr g_RegionSize;
+char *g_pMappedMatrices;
+GLsync g_Fences[RING_FRAMES];
+int g_ThreadCount = 0;          // 0 = one per core
+mat4 g_ProjectionMatrix(mat4::identity());
+
+// Must match hard-coded vPosition location in vertShaderSource
+#define V_POSITION 0
+
+// Must match hard-coded location in vertShaderSource
+#define C_POSITION 1
+
+// Must match hard-coded ViewProject location in vertShaderSource
+#define VP_LOCATION 0
+
+// Must match hard-coded Models binding in vertShaderSource
+#define MATRIX_BUFFER_BINDING 1
+
+void setupShaders()
+{
+    GLchar infoLog[4096];
+    GLsizei length;
+
+    const GLchar *vertShaderSource[] = {
+        "#version 430 core\n"
+        "layout(std430, binding = 1) readonly buffer Models {\n"
+        "    mat4 models[];\n"
+        "};\n"
+        "layout(location = 0) uniform mat4 ViewProject;\n"
+        "layout(location = 0) in vec4 vPosition;\n"
+        "layout(location = 1) in vec3 vColor;\n"
+        "out vec3 color;\n"
+        "void main() {\n"
+        "    gl_Position = ViewProject * models[gl_InstanceID] * vPosition;\n"
+        "    color = vColor;\n"
+        "}\n"
+    };
+    GLuint vertShader = glCreateShader(GL_VERTEX_SHADER);
+    glShaderSource(vertShader, 1, vertShaderSource, NULL);
+
+    const GLchar *fragShaderSource[] = {
+        "#version 430 core\n"
+        "in vec3 color;\n"
+        "out vec4 fColor;\n"
+        "void main() {\n"
+        "    fColor = vec4(color, 1);\n"
+        "}\n"
+    };
+    GLuint fragShader = glCreateShader(GL_FRAGMENT_SHADER);
+    glShaderSource(fragShader, 1, fragShaderSource, NULL);
+
+    GLuint program = glCreateProgram();
+    glAttachShader(program, vertShader);
+    glCompileShader(vertShader);
+    glGetShaderInfoLog(vertShader, 4096, &length, infoLog);
+
+    glAttachShader(program, fragShader);
+    glCompileShader(fragShader);
+    glGetShaderInfoLog(fragShader, 4096, &length, infoLog);
+
+    glLinkProgram(program);
+    glUseProgram(program);
+}
+
+void setupPyramid(ShapeInfo *pInfo)
+{
+    typedef struct {
+        GLfloat x, y, z;
+        GLubyte red, green, blue;
+    } VertexInfo;
+
+    static const VertexInfo pyramidData[] = {
+        // Bottom
+        { 0.0f, 0.f, .5f, 255, 0, 0},
+        { 0.433f, 0.f, -.25f, 255, 0, 0},
+        { -0.433f, 0.f, -.25f, 255, 0, 0},
+        // Side 1
+        { -0.433f, 0.f, -.25f, 0, 0, 255},
+        { 0.433f, 0.f, -.25f, 0, 255, 255},
+        { 0.0f, 0.75f, 0.f, 255, 0, 255},
+        // Side 2
+        { -0.433f, 0.f, -.25f, 255, 255, 0},
+        { 0.0f, 0.f, .5f, 255, 255, 0},
+        { 0.0f, 0.75f, 0.f, 255, 255, 0},
+        // Side 3
+        { 0.0f, 0.f, .5f, 0, 255, 0},
+        { 0.0f, 0.75f, 0.f, 0, 255, 0},
+        { 0.433f, 0.f, -.25f, 0, 255, 0},
+    };
+
+    GLuint bufferId;
+    glGenVertexArrays(1, &pInfo->vaoId);
+    glBindVertexArray(pInfo->vaoId);
+    glGenBuffers(1, &bufferId);
+    glBindBuffer(GL_ARRAY_BUFFER, bufferId);
+    glBufferData(GL_ARRAY_BUFFER, sizeof(pyramidData), pyramidData, GL_STATIC_DRAW);
+    glVertexAttribPointer(V_POSITION, 3, GL_FLOAT, GL_FALSE, sizeof(VertexInfo), (GLvoid*)offsetof(VertexInfo, x));
+    glEnableVertexAttribArray(V_POSITION);
+    glVertexAttribPointer(C_POSITION, 3, GL_UNSIGNED_BYTE, GL_TRUE, sizeof(VertexInfo), (GLvoid*)offsetof(VertexInfo, red));
+    glEnableVertexAttribArray(C_POSITION);
+    pInfo->count = 12;
+}
+
+static unsigned int hash(unsigned int x)
+{
+    x ^= x >> 16;
+    x *= 0x7feb352d;
+    x ^= x >> 15;
+    x *= 0x846ca68b;
+    x ^= x >> 16;
+    return x;
+}
+
+// A repeatable random number from -1 to 1
+static float signedRandom(unsigned int seed)
+{
+    return float(hash(seed) & 0xffff) / 32767.5f - 1.f;
+}
+
+// Stand-in for authored animation:  every pyramid bobs around its place in
+// the grid, tumbling about its own axis and pulsing in size.  The last key
+// leads back into the first, so the loop is seamless.
+void setupAnimation()
+{
+    if (!animationCreate(&g_Animation, OBJECT_COUNT, KEY_COUNT, KEY_INTERVAL)) {
+        printf("Out of memory for %d tracks\n", OBJECT_COUNT);
+        exit(1);
+    }
+
+    for (int n = 0; n < OBJECT_COUNT; n++) {
+        float homeX = (n % GRID_WIDTH - (GRID_WIDTH - 1) / 2.f) * GRID_SPACING;
+        float homeY = (n / GRID_WIDTH - (GRID_HEIGHT - 1) / 2.f) * GRID_SPACING;
+        float axis[3] = { signedRandom(n * 3), signedRandom(n * 3 + 1), signedRandom(n * 3 + 2) + .01f };
+        float length = sqrtf(axis[0] * axis[0] + axis[1] * axis[1] + axis[2] * axis[2]);
+        axis[0] /= length;
+        axis[1] /= length;
+        axis[2] /= length;
+        int spins = 1 + hash(~n) % 2;
+
+        for (int k = 0; k < KEY_COUNT; k++) {
+            unsigned int seed = (n * KEY_COUNT + k) * 4;
+            float turn = float(k) / KEY_COUNT;
+            float halfAngle = float(M_PI) * spins * turn;
+            AnimationKey key = {
+                { homeX + signedRandom(seed) * .15f, homeY + signedRandom(seed + 1) * .15f, -CENTER_Z + signedRandom(seed + 2) * 2.f },
+                { axis[0] * sinf(halfAngle), axis[1] * sinf(halfAngle), axis[2] * sinf(halfAngle), cosf(halfAngle) },
+                .35f + .1f * sinf(2.f * float(M_PI) * turn)
+            };
+            animationSetKey(&g_Animation, n, k, &key);
+        }
+    }
+}
+
+// One region per frame in flight, each offset to a legal SSBO binding
+// offset, mapped once and written in place for the life of the demo.
+void setupMatrixBuffer()
+{
+    GLint alignment;
+    glGetIntegerv(GL_SHADER_STORAGE_BUFFER_OFFSET_ALIGNMENT, &alignment);
+    g_RegionSize = OBJECT_COUNT * 16 * sizeof(float);
+    g_RegionSize = (g_RegionSize + alignment - 1) / alignment * alignment;
+
+    GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+    glGenBuffers(1, &g_MatrixBuffer);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, g_MatrixBuffer);
+    glBufferStorage(GL_SHADER_STORAGE_BUFFER, g_RegionSize * RING_FRAMES, NULL, flags);
+    g_pMappedMatrices = (char *)glMapBufferRange(GL_SHADER_STORAGE_BUFFER, 0, g_RegionSize * RING_FRAMES, flags);
+}
+
+void setupFrustum(float left, float right, float bottom, float top, float zNear, float zFar)
+{
+    g_ProjectionMatrix = vmath::frustum(left, right, bottom, top, zNear, zFar);
+}
+
+double timeMs()
+{
+    static LARGE_INTEGER frequency = { 0 };
+    if (frequency.QuadPart == 0) {
+        QueryPerformanceFrequency(&frequency);
+    }
+    LARGE_INTEGER now;
+    QueryPerformanceCounter(&now);
+    return 1000. * double(now.QuadPart) / double(frequency.QuadPart);
+}
+
+void onDisplay()
+{
+    static int i = 0;
+    static int frames = 0;
+    static double sampleTime = 0;
+    static double startTime = timeMs();
+    static double lastReport = startTime;
+    int region = i % RING_FRAMES;
+    i++;
+
+    // Wait until the GPU is done with the frame that last used this region
+    if (g_Fences[region]) {
+        glClientWaitSync(g_Fences[region], GL_SYNC_FLUSH_COMMANDS_BIT, 1000000000);
+        glDeleteSync(g_Fences[region]);
+        g_Fences[region] = 0;
+    }
+
+    double start = timeMs();
+    float *pMatrices = (float *)(g_pMappedMatrices + region * g_RegionSize);
+    animationSample(&g_Animation, float((start - startTime) / 1000.), pMatrices, g_ThreadCount);
+    sampleTime += timeMs() - start;
+
+    glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+    glBindBufferRange(GL_SHADER_STORAGE_BUFFER, MATRIX_BUFFER_BINDING, g_MatrixBuffer, region * g_RegionSize, g_RegionSize);
+    glUniformMatrix4fv(VP_LOCATION, 1, GL_FALSE, g_ProjectionMatrix);
+    glBindVertexArray(g_Pyramid.vaoId);
+    glDrawArraysInstanced(GL_TRIANGLES, 0, g_Pyramid.count, OBJECT_COUNT);
+    g_Fences[region] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    glutSwapBuffers();
+
+    frames++;
+    double now = timeMs();
+    if (now - lastReport >= 2000) {
+        printf("%d tracks sampled in %.3f ms on %s, %.2f ms per frame\n", OBJECT_COUNT,
+            sampleTime / frames, g_ThreadCount == 1 ? "one thread" : "every core", (now - lastReport) / frames);
+        frames = 0;
+        sampleTime = 0;
+        lastReport = now;
+    }
+}
+
+void onKey(unsigned char key, int x, int y)
+{
+    if (key == 't' || key == 'T') {
+        g_ThreadCount = g_ThreadCount == 1 ? 0 : 1;
+        return;
+    }
+    exit(0);
+}
+
+int main(int argc, char *argv[])
+{
+    glutInit(&argc, argv);
+    glutInitDisplayMode(GLUT_RGBA | GLUT_DOUBLE | GLUT_DEPTH);
+    glutInitWindowSize(640, 480);
+    glutCreateWindow(argv[0]);
+
+    glewInit();
+    wglSwapIntervalEXT(1);	// vsync
+
+    glEnable(GL_DEPTH_TEST);
+
+    GLfloat ratio = 640.0f / 480.0f;
+    GLfloat zNear = CENTER_Z - DEPTH_OF_FIELD/2;
+    GLfloat top = zNear * .5f;
+    setupFrustum(-ratio * top, ratio * top, -top, top, zNear, CENTER_Z + DEPTH_OF_FIELD/2);
+
+    setupShaders();
+    setupPyramid(&g_Pyramid);
+    setupAnimation();
+    setupMatrixBuffer();
+    glutDisplayFunc(onDisplay);
+    glutIdleFunc(onDisplay);
+    glutKeyboardFunc(onKey);
+    glutMainLoop();
+
+    return 0;
+}
@@ -0,0 +1,152 @@
+/*
+ * Demo 29:
+ * A fountain of 262,144 particles, drawn with one call.  The particles are
+ * emitted, moved and killed by a compute shader, or by SSE code on every
+ * core when the renderer is a software one (see ParticleSystem.h).  Both
+ * paths are benchmarked at startup.
+ *
+ * Press G to switch between GPU and CPU simulation, any other key to exit.
+ *
+ * See README.txt for prerequisites.
+ */
+#include <windows.h>
+#include <WinGDI.h>
+
+#include <GL/glew.h>
+#include <GL/wglew.h>
+#include <GL/GL.h>
+#include <GL/glut.h>
+
+#include <stdio.h>
+#include <stddef.h>
+
+#include <vmath.h>
+using vmath::mat4;
+
+#include "ParticleSystem.h"
+
+// Apparently someone is still using segmented memory qualifiers,
+// and windows.h is letting them.
+#undef near
+#undef far
+
+#define CENTER_Z        14.0f    // Distance from camera
+#define DEPTH_OF_FIELD  12.0f
+
+// Exercise:  Find the count where each path stops keeping up with vsync
+#define PARTICLE_COUNT  (256 * 1024)
+#define AVERAGE_LIFE    3.f     // Must match the emission rules in ParticleSystem.cpp
+
+#define BENCHMARK_STEPS 100
+
+ParticlePath g_Path = PARTICLES_GPU;
+bool g_GpuAvailable;
+mat4 g_ProjectionMatrix(mat4::identity());
+
+void setupFrustum(float left, float right, float bottom, float top, float zNear, float zFar)
+{
+    g_ProjectionMatrix = vmath::frustum(left, right, bottom, top, zNear, zFar);
+}
+
+double timeMs()
+{
+    static LARGE_INTEGER frequency = { 0 };
+    if (frequency.QuadPart == 0) {
+        QueryPerformanceFrequency(&frequency);
+    }
+    LARGE_INTEGER now;
+    QueryPerformanceCounter(&now);
+    return 1000. * double(now.QuadPart) / double(frequency.QuadPart);
+}
+
+void setupParticles()
+{
+    // Emit about as fast as particles die, so the pool stays nearly full
+    if (!particlesInit(PARTICLE_COUNT, PARTICLE_COUNT / AVERAGE_LIFE)) {
+        printf("Out of memory for %d particles\n", PARTICLE_COUNT);
+        exit(1);
+    }
+
+    g_GpuAvailable = particlesGpuAvailable();
+    if (g_GpuAvailable) {
+        printf("GPU simulation: %.1f million particles per second\n",
+            particlesBenchmark(PARTICLES_GPU, BENCHMARK_STEPS) / 1e6);
+    }
+    printf("CPU simulation: %.1f million particles per second\n",
+        particlesBenchmark(PARTICLES_CPU, BENCHMARK_STEPS) / 1e6);
+
+    g_Path = g_GpuAvailable && !particlesPreferCpu() ? PARTICLES_GPU : PARTICLES_CPU;
+    printf("Simulating on the %s\n", g_Path == PARTICLES_GPU ? "GPU" : "CPU");
+}
+
+void onDisplay()
+{
+    static int i = 0;
+    static int frames = 0;
+    static double lastFrame = timeMs();
+    static double lastReport = lastFrame;
+    i++;
+
+    // Real time, but no giant steps after a stall
+    double now = timeMs();
+    float dt = float(now - lastFrame) / 1000.f;
+    dt = dt < .05f ? dt : .05f;
+    lastFrame = now;
+
+    particlesUpdate(g_Path, dt);
+
+    mat4 viewMatrix(vmath::translate(0.f, -3.f, -CENTER_Z));
+    viewMatrix *= vmath::rotate(i * .1f, 0.f, 1.f, 0.f);
+
+    glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+    particlesDraw(g_ProjectionMatrix * viewMatrix, g_Path);
+    glutSwapBuffers();
+
+    frames++;
+    if (now - lastReport >= 2000) {
+        printf("%s: %.2f ms per frame\n", g_Path == PARTICLES_GPU ? "GPU" : "CPU", (now - lastReport) / frames);
+        frames = 0;
+        lastReport = now;
+    }
+}
+
+void onKey(unsigned char key, int x, int y)
+{
+    if ((key == 'g' || key == 'G') && g_GpuAvailable) {
+        // Each path has its own pool, so start the fountain over
+        g_Path = g_Path == PARTICLES_GPU ? PARTICLES_CPU : PARTICLES_GPU;
+        particlesReset();
+        printf("Simulating on the %s\n", g_Path == PARTICLES_GPU ? "GPU" : "CPU");
+        return;
+    }
+    exit(0);
+}
+
+int main(int argc, char *argv[])
+{
+    glutInit(&argc, argv);
+    glutInitDisplayMode(GLUT_RGBA | GLUT_DOUBLE | GLUT_DEPTH);
+    glutInitWindowSize(640, 480);
+    glutCreateWindow(argv[0]);
+
+    glewInit();
+    wglSwapIntervalEXT(1);	// vsync
+
+    // Particles glow where they pile up
+    glEnable(GL_BLEND);
+    glBlendFunc(GL_ONE, GL_ONE);
+    glEnable(GL_PROGRAM_POINT_SIZE);
+
+    GLfloat ratio = 640.0f / 480.0f;
+    GLfloat zNear = CENTER_Z - DEPTH_OF_FIELD/2;
+    GLfloat top = zNear * .5f;
+    setupFrustum(-ratio * top, ratio * top, -top, top, zNear, CENTER_Z + DEPTH_OF_FIELD/2);
+
+    setupParticles();
+    glutDisplayFunc(onDisplay);
+    glutIdleFunc(onDisplay);
+    glutKeyboardFunc(onKey);
+    glutMainLoop();
+
+    return 0;
+}
@@ -0,0 +1,577 @@
+/*
+ * GPU and SSE particle simulation.  See ParticleSystem.h.
+ */
+#include "ParticleSystem.h"
+
+#include <windows.h>
+
+#include <GL/glew.h>
+
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include <xmmintrin.h>
+
+// Must match local_size_x in computeSource
+#define GROUP_SIZE      256
+
+#define GRAVITY         9.8f
+#define BOUNCE          .5f     // Fraction of speed kept on a bounce
+
+// Below this many groups of four particles, waking threads costs more
+// than it saves
+#define MIN_GROUPS_PER_THREAD 4096
+
+// Must match the hard-coded bindings and locations in the shaders
+#define POSITION_BINDING    1
+#define VELOCITY_BINDING    2
+#define DT_LOCATION         0
+#define EMIT_LOCATION       1
+#define FRAME_LOCATION      2
+#define COUNT_LOCATION      3
+#define VP_LOCATION         0
+#define PARTICLE_LOCATION   0
+
+// The emission rules are written twice, once here and once in C below, and
+// the two must agree.
+static const char *computeSource =
+    "#version 430 core\n"
+    "layout(local_size_x = 256) in;\n"
+    "layout(std430, binding = 1) buffer Positions {\n"
+    "    vec4 positions[];\n"   // xyz, remaining life
+    "};\n"
+    "layout(std430, binding = 2) buffer Velocities {\n"
+    "    vec4 velocities[];\n"
+    "};\n"
+    "layout(binding = 0, offset = 0) uniform atomic_uint emitted;\n"
+    "layout(location = 0) uniform float dt;\n"
+    "layout(location = 1) uniform uint emitCount;\n"
+    "layout(location = 2) uniform uint frame;\n"
+    "layout(location = 3) uniform uint count;\n"
+    "uint hash(uint x) {\n"
+    "    x ^= x >> 16;\n"
+    "    x *= 0x7feb352du;\n"
+    "    x ^= x >> 15;\n"
+    "    x *= 0x846ca68bu;\n"
+    "    x ^= x >> 16;\n"
+    "    return x;\n"
+    "}\n"
+    "float randomUnit(uint seed) {\n"
+    "    return float(hash(seed) & 0xffffu) / 65535.0;\n"
+    "}\n"
+    "void main() {\n"
+    "    uint i = gl_GlobalInvocationID.x;\n"
+    "    if (i >= count) {\n"
+    "        return;\n"
+    "    }\n"
+    "    vec4 p = positions[i];\n"
+    "    vec4 v = velocities[i];\n"
+    "    if (p.w <= 0) {\n"
+    "        if (atomicCounterIncrement(emitted) >= emitCount) {\n"
+    "            return;\n"
+    "        }\n"
+    "        uint seed = hash(i ^ (frame * 0x9e3779b9u));\n"
+    "        float angle = 6.2831853 * randomUnit(seed);\n"
+    "        float spread = 1.5 * randomUnit(seed + 1u);\n"
+    "        positions[i] = vec4(0, 0, 0, 2 + 2 * randomUnit(seed + 3u));\n"
+    "        velocities[i] = vec4(cos(angle) * spread, 6 + 3 * randomUnit(seed + 2u), sin(angle) * spread, 0);\n"
+    "        return;\n"
+    "    }\n"
+    "    v.y -= 9.8 * dt;\n"
+    "    p.xyz += v.xyz * dt;\n"
+    "    if (p.y < 0) {\n"
+    "        p.y = -p.y;\n"
+    "        v.y = -v.y * 0.5;\n"
+    "    }\n"
+    "    p.w -= dt;\n"
+    "    positions[i] = p;\n"
+    "    velocities[i] = v;\n"
+    "}\n";
+
+// Dead particles are moved off screen.  Live ones fade as they age.  The
+// GPU path reads the positions the compute shader wrote straight from its
+// storage buffer.
+static const char *drawVertSource =
+    "#version 430 core\n"
+    "layout(std430, binding = 1) readonly buffer Positions {\n"
+    "    vec4 positions[];\n"
+    "};\n"
+    "layout(location = 0) uniform mat4 ViewProject;\n"
+    "out vec4 color;\n"
+    "void main() {\n"
+    "    vec4 p = positions[gl_VertexID];\n"
+    "    gl_Position = p.w > 0 ? ViewProject * vec4(p.xyz, 1) : vec4(2, 2, 2, 1);\n"
+    "    gl_PointSize = 2;\n"
+    "    color = vec4(.3, .6, 1, 1) * min(p.w, 1) * .5;\n"
+    "}\n";
+
+static const char *drawFragSource =
+    "#version 430 core\n"
+    "in vec4 color;\n"
+    "out vec4 fColor;\n"
+    "void main() {\n"
+    "    fColor = color;\n"
+    "}\n";
+
+// The same for the CPU path, which has to work without GL 4.3:  positions
+// come in as an ordinary vertex attribute.
+static const char *cpuDrawVertSource =
+    "#version 330 core\n"
+    "layout(location = 0) in vec4 vParticle;\n"
+    "uniform mat4 ViewProject;\n"
+    "out vec4 color;\n"
+    "void main() {\n"
+    "    vec4 p = vParticle;\n"
+    "    gl_Position = p.w > 0 ? ViewProject * vec4(p.xyz, 1) : vec4(2, 2, 2, 1);\n"
+    "    gl_PointSize = 2;\n"
+    "    color = vec4(.3, .6, 1, 1) * min(p.w, 1) * .5;\n"
+    "}\n";
+
+static const char *cpuDrawFragSource =
+    "#version 330 core\n"
+    "in vec4 color;\n"
+    "out vec4 fColor;\n"
+    "void main() {\n"
+    "    fColor = color;\n"
+    "}\n";
+
+static int g_Capacity;
+static float g_EmitPerSecond, g_EmitCarry;
+static unsigned int g_Frame;
+static bool g_GpuAvailable;
+static GLuint g_ComputeProgram, g_DrawProgram, g_EmptyVao;
+static GLuint g_GpuPositions, g_GpuVelocities, g_EmitCounter;
+static GLuint g_CpuDrawProgram, g_CpuVao, g_CpuPositions;
+static GLint g_CpuVpLocation;
+
+// CPU pool, structure-of-arrays and padded to a multiple of four
+static int g_PaddedCapacity;
+static float *g_pX, *g_pY, *g_pZ, *g_pVx, *g_pVy, *g_pVz, *g_pLife;
+static float *g_pUpload;        // xyz, life for each particle
+static std::atomic<int> g_Emitted;
+
+static GLuint buildProgram(GLenum type1, const char *source1, GLenum type2, const char *source2)
+{
+    GLchar infoLog[4096];
+    GLsizei length;
+    GLuint program = glCreateProgram();
+    GLenum types[2] = { type1, type2 };
+    const char *sources[2] = { source1, source2 };
+    for (int i = 0; i < 2 && sources[i]; i++) {
+        GLuint shader = glCreateShader(types[i]);
+        glShaderSource(shader, 1, &sources[i], NULL);
+        glCompileShader(shader);
+        glGetShaderInfoLog(shader, 4096, &length, infoLog);
+        if (length > 0) {
+            printf("%s\n", infoLog);
+        }
+        glAttachShader(program, shader);
+        glDeleteShader(shader);
+    }
+    glLinkProgram(program);
+    return program;
+}
+
+static unsigned int hash(unsigned int x)
+{
+    x ^= x >> 16;
+    x *= 0x7feb352d;
+    x ^= x >> 15;
+    x *= 0x846ca68b;
+    x ^= x >> 16;
+    return x;
+}
+
+static float randomUnit(unsigned int seed)
+{
+    return float(hash(seed) & 0xffff) / 65535.f;
+}
+
+static double timeMs()
+{
+    static LARGE_INTEGER frequency = { 0 };
+    if (frequency.QuadPart == 0) {
+        QueryPerformanceFrequency(&frequency);
+    }
+    LARGE_INTEGER now;
+    QueryPerformanceCounter(&now);
+    return 1000. * double(now.QuadPart) / double(frequency.QuadPart);
+}
+
+bool particlesInit(int capacity, float emitPerSecond)
+{
+    g_Capacity = capacity;
+    g_EmitPerSecond = emitPerSecond;
+    g_PaddedCapacity = (capacity + 3) & ~3;
+
+    float **arrays[] = { &g_pX, &g_pY, &g_pZ, &g_pVx, &g_pVy, &g_pVz, &g_pLife };
+    for (int i = 0; i < int(sizeof(arrays) / sizeof(arrays[0])); i++) {
+        *arrays[i] = (float *)_mm_malloc(g_PaddedCapacity * sizeof(float), 16);
+        if (!*arrays[i]) {
+            return false;
+        }
+    }
+    g_pUpload = (float *)_mm_malloc(g_PaddedCapacity * 4 * sizeof(float), 16);
+    if (!g_pUpload) {
+        return false;
+    }
+
+    g_CpuDrawProgram = buildProgram(GL_VERTEX_SHADER, cpuDrawVertSource, GL_FRAGMENT_SHADER, cpuDrawFragSource);
+    g_CpuVpLocation = glGetUniformLocation(g_CpuDrawProgram, "ViewProject");
+    glGenVertexArrays(1, &g_CpuVao);
+    glBindVertexArray(g_CpuVao);
+    glGenBuffers(1, &g_CpuPositions);
+    glBindBuffer(GL_ARRAY_BUFFER, g_CpuPositions);
+    glBufferData(GL_ARRAY_BUFFER, g_PaddedCapacity * 4 * sizeof(float), NULL, GL_STREAM_DRAW);
+    glVertexAttribPointer(PARTICLE_LOCATION, 4, GL_FLOAT, GL_FALSE, 4 * sizeof(float), 0);
+    glEnableVertexAttribArray(PARTICLE_LOCATION);
+    glBindVertexArray(0);
+
+    // The GPU path needs compute, and storage buffers in the vertex stage,
+    // which 4.3 allows an implementation not to have
+    GLint vertexStorageBlocks = 0;
+    if (glewIsSupported("GL_VERSION_4_3")) {
+        glGetIntegerv(GL_MAX_VERTEX_SHADER_STORAGE_BLOCKS, &vertexStorageBlocks);
+    }
+    g_GpuAvailable = vertexStorageBlocks > 0;
+    if (g_GpuAvailable) {
+        g_ComputeProgram = buildProgram(GL_COMPUTE_SHADER, computeSource, 0, NULL);
+        g_DrawProgram = buildProgram(GL_VERTEX_SHADER, drawVertSource, GL_FRAGMENT_SHADER, drawFragSource);
+
+        // Everything the draw needs comes from the position buffer, but core
+        // profile still wants a VAO bound
+        glGenVertexArrays(1, &g_EmptyVao);
+
+        GLuint buffers[2];
+        glGenBuffers(2, buffers);
+        g_GpuPositions = buffers[0];
+        g_GpuVelocities = buffers[1];
+        for (int i = 0; i < 2; i++) {
+            glBindBuffer(GL_SHADER_STORAGE_BUFFER, buffers[i]);
+            glBufferData(GL_SHADER_STORAGE_BUFFER, g_PaddedCapacity * 4 * sizeof(float), NULL, GL_DYNAMIC_COPY);
+        }
+
+        glGenBuffers(1, &g_EmitCounter);
+        glBindBuffer(GL_ATOMIC_COUNTER_BUFFER, g_EmitCounter);
+        glBufferData(GL_ATOMIC_COUNTER_BUFFER, sizeof(GLuint), NULL, GL_DYNAMIC_DRAW);
+    }
+
+    particlesReset();
+    return true;
+}
+
+bool particlesGpuAvailable()
+{
+    return g_GpuAvailable;
+}
+
+bool particlesPreferCpu()
+{
+    const char *renderer = (const char *)glGetString(GL_RENDERER);
+    return renderer && (strstr(renderer, "llvmpipe") || strstr(renderer, "softpipe") ||
+        strstr(renderer, "GDI Generic") || strstr(renderer, "SwiftShader"));
+}
+
+void particlesReset()
+{
+    // Life is what marks a particle dead, and zero bits are zero floats
+    std::vector<float> zeros(g_PaddedCapacity * 4, 0.f);
+    glBindBuffer(GL_ARRAY_BUFFER, g_CpuPositions);
+    glBufferSubData(GL_ARRAY_BUFFER, 0, zeros.size() * sizeof(float), &zeros[0]);
+    if (g_GpuAvailable) {
+        GLuint buffers[2] = { g_GpuPositions, g_GpuVelocities };
+        for (int i = 0; i < 2; i++) {
+            glBindBuffer(GL_SHADER_STORAGE_BUFFER, buffers[i]);
+            glBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, zeros.size() * sizeof(float), &zeros[0]);
+        }
+    }
+
+    float *arrays[] = { g_pX, g_pY, g_pZ, g_pVx, g_pVy, g_pVz, g_pLife };
+    for (int i = 0; i < int(sizeof(arrays) / sizeof(arrays[0])); i++) {
+        memset(arrays[i], 0, g_PaddedCapacity * sizeof(float));
+    }
+    g_EmitCarry = 0;
+}
+
+static void updateGpu(float dt, unsigned int emitCount)
+{
+    GLuint zero = 0;
+    glBindBuffer(GL_ATOMIC_COUNTER_BUFFER, g_EmitCounter);
+    glBufferSubData(GL_ATOMIC_COUNTER_BUFFER, 0, sizeof(zero), &zero);
+    glBindBufferBase(GL_ATOMIC_COUNTER_BUFFER, 0, g_EmitCounter);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, POSITION_BINDING, g_GpuPositions);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, VELOCITY_BINDING, g_GpuVelocities);
+
+    glUseProgram(g_ComputeProgram);
+    glUniform1f(DT_LOCATION, dt);
+    glUniform1ui(EMIT_LOCATION, emitCount);
+    glUniform1ui(FRAME_LOCATION, g_Frame);
+    glUniform1ui(COUNT_LOCATION, g_Capacity);
+    glDispatchCompute((g_Capacity + GROUP_SIZE - 1) / GROUP_SIZE, 1, 1);
+
+    // The draw reads what the dispatch wrote, and the next step's counter
+    // reset and any particlesReset overwrite it with glBufferSubData
+    glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT | GL_BUFFER_UPDATE_BARRIER_BIT | GL_ATOMIC_COUNTER_BARRIER_BIT);
+}
+
+static void spawn(int i, unsigned int frame)
+{
+    unsigned int seed = hash(unsigned(i) ^ (frame * 0x9e3779b9u));
+    float angle = 6.2831853f * randomUnit(seed);
+    float spread = 1.5f * randomUnit(seed + 1);
+    g_pX[i] = g_pY[i] = g_pZ[i] = 0.f;
+    g_pLife[i] = 2.f + 2.f * randomUnit(seed + 3);
+    g_pVx[i] = cosf(angle) * spread;
+    g_pVy[i] = 6.f + 3.f * randomUnit(seed + 2);
+    g_pVz[i] = sinf(angle) * spread;
+}
+
+static inline __m128 select(__m128 mask, __m128 a, __m128 b)
+{
+    return _mm_or_ps(_mm_and_ps(mask, a), _mm_andnot_ps(mask, b));
+}
+
+// Step groups [firstGroup, lastGroup) of four particles.  Particles that
+// were dead at the start of the step are left alone by the SSE part, then
+// offered for emission, just as in computeSource.
+static void stepRange(float dt, int emitCount, unsigned int frame, int firstGroup, int lastGroup)
+{
+    const __m128 zero = _mm_setzero_ps();
+    const __m128 signBit = _mm_set1_ps(-0.f);
+    const __m128 vdt = _mm_set1_ps(dt);
+    const __m128 fall = _mm_set1_ps(GRAVITY * dt);
+    const __m128 bounce = _mm_set1_ps(-BOUNCE);
+    bool emitting = emitCount > 0;
+
+    for (int group = firstGroup; group < lastGroup; group++) {
+        int i = group * 4;
+        __m128 life = _mm_load_ps(g_pLife + i);
+        __m128 alive = _mm_cmpgt_ps(life, zero);
+        int aliveMask = _mm_movemask_ps(alive);
+
+        if (aliveMask) {
+            __m128 vx = _mm_load_ps(g_pVx + i);
+            __m128 vy = _mm_sub_ps(_mm_load_ps(g_pVy + i), fall);
+            __m128 vz = _mm_load_ps(g_pVz + i);
+            __m128 x = _mm_add_ps(_mm_load_ps(g_pX + i), _mm_mul_ps(vx, vdt));
+            __m128 y = _mm_add_ps(_mm_load_ps(g_pY + i), _mm_mul_ps(vy, vdt));
+            __m128 z = _mm_add_ps(_mm_load_ps(g_pZ + i), _mm_mul_ps(vz, vdt));
+
+            __m128 below = _mm_cmplt_ps(y, zero);
+            y = _mm_xor_ps(y, _mm_and_ps(below, signBit));
+            vy = select(below, _mm_mul_ps(vy, bounce), vy);
+
+            _mm_store_ps(g_pX + i, select(alive, x, _mm_load_ps(g_pX + i)));
+            _mm_store_ps(g_pY + i, select(alive, y, _mm_load_ps(g_pY + i)));
+            _mm_store_ps(g_pZ + i, select(alive, z, _mm_load_ps(g_pZ + i)));
+            _mm_store_ps(g_pVy + i, select(alive, vy, _mm_load_ps(g_pVy + i)));
+            _mm_store_ps(g_pLife + i, select(alive, _mm_sub_ps(life, vdt), life));
+        }
+
+        // Padding past the capacity is never emitted, so it never draws
+        int deadMask = ~aliveMask & 15;
+        while (emitting && deadMask) {
+            int lane = 0;
+            while (!(deadMask & (1 << lane))) {
+                lane++;
+            }
+            deadMask &= ~(1 << lane);
+            if (i + lane >= g_Capacity) {
+                break;
+            }
+            if (g_Emitted.fetch_add(1) >= emitCount) {
+                emitting = false;
+                break;
+            }
+            spawn(i + lane, frame);
+        }
+    }
+}
+
+typedef struct {
+    float dt;
+    int emitCount;
+    unsigned int frame;
+    int groups, chunk;
+} StepBatch;
+
+// The CPU path steps every frame, so its workers are started by the first
+// step that needs them and then sleep between frames.  Thread 0 is the
+// caller.  The pool is never freed; workers are still blocked on it when
+// the program exits.
+typedef struct {
+    std::mutex mutex;
+    std::condition_variable wake, done;
+    int workers;
+    long long generation;       // Steps ever handed out
+    int active;                 // Threads in the current step
+    int remaining;              // Workers still in it
+    StepBatch batch;
+} WorkerPool;
+
+static WorkerPool *g_pPool;
+
+static void stepChunk(const StepBatch *pBatch, int t)
+{
+    int first = t * pBatch->chunk;
+    int last = first + pBatch->chunk < pBatch->groups ? first + pBatch->chunk : pBatch->groups;
+    if (first < last) {
+        stepRange(pBatch->dt, pBatch->emitCount, pBatch->frame, first, last);
+    }
+}
+
+static void workerMain(int t)
+{
+    WorkerPool *pPool = g_pPool;
+    long long seen = 0;
+    for (;;) {
+        StepBatch batch;
+        {
+            std::unique_lock<std::mutex> lock(pPool->mutex);
+            while (pPool->generation == seen) {
+                pPool->wake.wait(lock);
+            }
+            seen = pPool->generation;
+            if (t >= pPool->active) {
+                continue;
+            }
+            batch = pPool->batch;
+        }
+        stepChunk(&batch, t);
+
+        std::lock_guard<std::mutex> lock(pPool->mutex);
+        if (--pPool->remaining == 0) {
+            pPool->done.notify_one();
+        }
+    }
+}
+
+// Split the pool across threads; the calling thread takes the first chunk
+static void stepCpu(float dt, int emitCount, unsigned int frame)
+{
+    g_Emitted = 0;
+    int groups = g_PaddedCapacity / 4;
+    int threadCount = int(std::thread::hardware_concurrency());
+    if (threadCount <= 0) {
+        threadCount = 1;
+    }
+    if (threadCount > groups / MIN_GROUPS_PER_THREAD) {
+        threadCount = groups / MIN_GROUPS_PER_THREAD > 0 ? groups / MIN_GROUPS_PER_THREAD : 1;
+    }
+    int chunk = (groups + threadCount - 1) / threadCount;
+
+    StepBatch batch = { dt, emitCount, frame, groups, chunk };
+    if (threadCount == 1) {
+        stepChunk(&batch, 0);
+        return;
+    }
+    if (!g_pPool) {
+        g_pPool = new WorkerPool();
+    }
+    {
+        std::lock_guard<std::mutex> lock(g_pPool->mutex);
+        while (g_pPool->workers < threadCount - 1) {
+            std::thread(workerMain, ++g_pPool->workers).detach();
+        }
+        g_pPool->batch = batch;
+        g_pPool->active = threadCount;
+        g_pPool->remaining = threadCount - 1;
+        g_pPool->generation++;
+        g_pPool->wake.notify_all();
+    }
+    stepChunk(&batch, 0);
+    std::unique_lock<std::mutex> lock(g_pPool->mutex);
+    while (g_pPool->remaining > 0) {
+        g_pPool->done.wait(lock);
+    }
+}
+
+// Interleave the pool into the layout cpuDrawVertSource reads, four
+// particles at a time
+static void uploadCpu()
+{
+    for (int i = 0; i < g_PaddedCapacity; i += 4) {
+        __m128 x = _mm_load_ps(g_pX + i);
+        __m128 y = _mm_load_ps(g_pY + i);
+        __m128 z = _mm_load_ps(g_pZ + i);
+        __m128 life = _mm_load_ps(g_pLife + i);
+        _MM_TRANSPOSE4_PS(x, y, z, life);
+        _mm_store_ps(g_pUpload + i * 4, x);
+        _mm_store_ps(g_pUpload + i * 4 + 4, y);
+        _mm_store_ps(g_pUpload + i * 4 + 8, z);
+        _mm_store_ps(g_pUpload + i * 4 + 12, life);
+    }
+    glBindBuffer(GL_ARRAY_BUFFER, g_CpuPositions);
+    glBufferSubData(GL_ARRAY_BUFFER, 0, g_PaddedCapacity * 4 * sizeof(float), g_pUpload);
+}
+
+void particlesUpdate(ParticlePath path, float dt)
+{
+    // Carry the fraction over, so low rates still emit
+    g_EmitCarry += g_EmitPerSecond * dt;
+    int emitCount = int(g_EmitCarry);
+    g_EmitCarry -= emitCount;
+
+    if (path == PARTICLES_GPU) {
+        updateGpu(dt, emitCount);
+    }
+    else {
+        stepCpu(dt, emitCount, g_Frame);
+        uploadCpu();
+    }
+    g_Frame++;
+}
+
+void particlesDraw(const float *viewProjection, ParticlePath path)
+{
+    if (path == PARTICLES_GPU) {
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, POSITION_BINDING, g_GpuPositions);
+        glUseProgram(g_DrawProgram);
+        glUniformMatrix4fv(VP_LOCATION, 1, GL_FALSE, viewProjection);
+        glBindVertexArray(g_EmptyVao);
+    }
+    else {
+        glUseProgram(g_CpuDrawProgram);
+        glUniformMatrix4fv(g_CpuVpLocation, 1, GL_FALSE, viewProjection);
+        glBindVertexArray(g_CpuVao);
+    }
+    glDrawArrays(GL_POINTS, 0, g_Capacity);
+}
+
+double particlesBenchmark(ParticlePath path, int steps)
+{
+    const float dt = 1.f / 60.f;
+
+    // Fill the pool first, so the benchmark isn't timing empty slots
+    particlesReset();
+    float saved = g_EmitPerSecond;
+    g_EmitPerSecond = float(g_Capacity) / dt;
+    particlesUpdate(path, dt);
+    g_EmitPerSecond = saved;
+
+    glFinish();
+    double start = timeMs();
+    for (int i = 0; i < steps; i++) {
+        g_EmitCarry += g_EmitPerSecond * dt;
+        int emitCount = int(g_EmitCarry);
+        g_EmitCarry -= emitCount;
+        if (path == PARTICLES_GPU) {
+            updateGpu(dt, emitCount);
+        }
+        else {
+            stepCpu(dt, emitCount, g_Frame);
+        }
+        g_Frame++;
+    }
+    glFinish();
+    double elapsed = timeMs() - start;
+
+    particlesReset();
+    return double(g_Capacity) * steps / (elapsed / 1000.);
+}
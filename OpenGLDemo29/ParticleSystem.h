@@ -0,0 +1,52 @@
+/*
+ * A fountain of particles, simulated on the GPU or the CPU.
+ *
+ * Particles live in a fixed pool that stays in GL buffers for the life of
+ * the system.  Every step, live particles fall under gravity, bounce off the
+ * ground and age, and up to a budget of dead particles are emitted again at
+ * the fountain.  The GPU path does this in a compute shader, with an atomic
+ * counter handing out the emission budget, and never reads anything back.
+ * The CPU path keeps the pool structure-of-arrays, steps four particles at a
+ * time with SSE on every core, and uploads the positions for drawing; it is
+ * for software renderers such as llvmpipe, where compute is slower than the
+ * CPU it runs on, and for GL 3.3 contexts without compute.  Both paths
+ * follow exactly the same rules.
+ *
+ * However many particles there are, drawing them is one glDrawArrays of
+ * points.
+ */
+#ifndef PARTICLE_SYSTEM_H
+#define PARTICLE_SYSTEM_H
+
+typedef enum {
+    PARTICLES_GPU,
+    PARTICLES_CPU,
+} ParticlePath;
+
+// Make the pool, its buffers and programs, with every particle dead.
+// 'emitPerSecond' is the emission budget.  Returns false if out of memory.
+// The GPU path is only set up if particlesGpuAvailable says so afterwards.
+bool particlesInit(int capacity, float emitPerSecond);
+
+// True if the context has GL 4.3 with storage buffers in the vertex stage.
+// Otherwise only PARTICLES_CPU may be passed below.
+bool particlesGpuAvailable();
+
+// True if the renderer looks like a software one, where the CPU path is
+// the better choice
+bool particlesPreferCpu();
+
+// Kill every particle on both paths
+void particlesReset();
+
+// Advance the simulation by dt seconds
+void particlesUpdate(ParticlePath path, float dt);
+
+// Draw every particle.  Leaves the particle drawing program bound.
+void particlesDraw(const float *viewProjection, ParticlePath path);
+
+// Time 'steps' updates of the whole pool, and return particles per second.
+// The CPU figure leaves out the upload for drawing.  Resets the pool.
+double particlesBenchmark(ParticlePath path, int steps);
+
+#endif
@@ -0,0 +1,339 @@
+/*
+ * Demo 30:
+ * Closed-form animation evaluated on the GPU.  Each pyramid orbits a
+ * point and spins, like the one in Demo 16, but its orbit radius, phase,
+ * angular speed, spin rate and scale are written once into an instance
+ * buffer.  The vertex shader works out the motion from a time uniform, so
+ * each frame the CPU sets one float and makes one draw, however many
+ * objects there are.
+ *
+ * Press A to switch to the Demo 16 way (a matrix and a draw per object,
+ * worked out on the CPU) and compare the CPU time per frame; any other key
+ * exits.
+ *
+ * See README.txt for prerequisites.
+ */
+#include <windows.h>
+#include <WinGDI.h>
+
+#include <GL/glew.h>
+#include <GL/wglew.h>
+#include <GL/GL.h>
+#include <GL/glut.h>
+
+#include <stdio.h>
+#include <stddef.h>
+
+#include <vmath.h>
+using vmath::mat4;
+
+// Apparently someone is still using segmented memory qualifiers,
+// and windows.h is letting them.
+#undef near
+#undef far
+
+#define CENTER_Z        50.0f    // Distance from camera
+#define DEPTH_OF_FIELD  10.0f
+
+// Exercise:  Raise this and watch only the CPU-side mode slow down
+#define GRID_SIZE       64
+#define OBJECT_COUNT    (GRID_SIZE * GRID_SIZE)
+
+typedef struct {
+    GLsizei count;
+    GLuint vaoId;
+} ShapeInfo;
+
+// Everything about an object's motion.  Must match the instance
+// attributes in gpuVertSource.
+typedef struct {
+    GLfloat centerX, centerY, centerZ;
+    GLfloat radius, phase, angularSpeed;    // Radians, radians per second
+    GLfloat spinRate, scale;                // Degrees per second
+} OrbitInfo;
+
+ShapeInfo g_Pyramid;
+OrbitInfo g_Orbits[OBJECT_COUNT];
+GLuint g_GpuProgram, g_CpuProgram;
+bool g_GpuAnimation = true;
+mat4 g_ProjectionMatrix(mat4::identity());
+
+// Must match hard-coded vPosition location in the vertex shaders
+#define V_POSITION 0
+
+// Must match hard-coded location in the vertex shaders
+#define C_POSITION 1
+
+// Must match hard-coded instance attribute locations in gpuVertSource
+#define CENTER_POSITION 4
+#define ORBIT_POSITION  5
+#define SPIN_POSITION   6
+
+// Must match hard-coded ViewProject location in gpuVertSource, and
+// ModelViewProject in cpuVertSource
+#define MATRIX_LOCATION 0
+
+// Must match hard-coded Time location in gpuVertSource
+#define TIME_LOCATION   1
+
+const GLchar *gpuVertSource =
+    "#version 430 core\n"
+    "layout(location = 0) uniform mat4 ViewProject;\n"
+    "layout(location = 1) uniform float Time;\n"
+    "layout(location = 0) in vec4 vPosition;\n"
+    "layout(location = 1) in vec3 vColor;\n"
+    "layout(location = 4) in vec3 vCenter;\n"
+    "layout(location = 5) in vec3 vOrbit;\n"     // radius, phase, angular speed
+    "layout(location = 6) in vec2 vSpin;\n"      // spin rate, scale
+    "out vec3 color;\n"
+    "void main() {\n"
+    "    float angle = vOrbit.y + vOrbit.z * Time;\n"
+    "    vec3 position = vCenter + vec3(vOrbit.x * cos(angle), vOrbit.x * sin(angle), 0);\n"
+    // Scale, then spin about y, then move into place, as drawTrianglesAt does
+    "    float spin = radians(vSpin.x * Time);\n"
+    "    vec3 p = vPosition.xyz * vSpin.y;\n"
+    "    p = vec3(cos(spin) * p.x + sin(spin) * p.z, p.y, cos(spin) * p.z - sin(spin) * p.x);\n"
+    "    gl_Position = ViewProject * vec4(p + position, 1);\n"
+    "    color = vColor;\n"
+    "}\n";
+
+const GLchar *cpuVertSource =
+    "#version 430 core\n"
+    "layout(location = 0) uniform mat4 ModelViewProject;\n"
+    "layout(location = 0) in vec4 vPosition;\n"
+    "layout(location = 1) in vec3 vColor;\n"
+    "out vec3 color;\n"
+    "void main() {\n"
+    "    gl_Position = ModelViewProject * vPosition;\n"
+    "    color = vColor;\n"
+    "}\n";
+
+const GLchar *fragSource =
+    "#version 430 core\n"
+    "in vec3 color;\n"
+    "out vec4 fColor;\n"
+    "void main() {\n"
+    "    fColor = vec4(color, 1);\n"
+    "}\n";
+
+GLuint buildProgram(const GLchar *vertSource)
+{
+    GLchar infoLog[4096];
+    GLsizei length;
+
+    GLuint vertShader = glCreateShader(GL_VERTEX_SHADER);
+    glShaderSource(vertShader, 1, &vertSource, NULL);
+    GLuint fragShader = glCreateShader(GL_FRAGMENT_SHADER);
+    glShaderSource(fragShader, 1, &fragSource, NULL);
+
+    GLuint program = glCreateProgram();
+    glAttachShader(program, vertShader);
+    glCompileShader(vertShader);
+    glGetShaderInfoLog(vertShader, 4096, &length, infoLog);
+
+    glAttachShader(program, fragShader);
+    glCompileShader(fragShader);
+    glGetShaderInfoLog(fragShader, 4096, &length, infoLog);
+
+    glLinkProgram(program);
+    return program;
+}
+
+void setupShaders()
+{
+    g_GpuProgram = buildProgram(gpuVertSource);
+    g_CpuProgram = buildProgram(cpuVertSource);
+}
+
+static unsigned int hash(unsigned int x)
+{
+    x ^= x >> 16;
+    x *= 0x7feb352d;
+    x ^= x >> 15;
+    x *= 0x846ca68b;
+    x ^= x >> 16;
+    return x;
+}
+
+// A repeatable random number from 0 to 1
+static float random01(unsigned int seed)
+{
+    return float(hash(seed) & 0xffff) / 65535.f;
+}
+
+// Every object gets its own orbit, once
+void setupOrbits()
+{
+    for (int n = 0; n < OBJECT_COUNT; n++) {
+        OrbitInfo *pOrbit = &g_Orbits[n];
+        pOrbit->centerX = (n % GRID_SIZE - (GRID_SIZE - 1) / 2.f) * .9f;
+        pOrbit->centerY = (n / GRID_SIZE - (GRID_SIZE - 1) / 2.f) * .9f;
+        pOrbit->centerZ = -CENTER_Z;
+        pOrbit->radius = .1f + .2f * random01(n * 5);
+        pOrbit->phase = 2.f * float(M_PI) * random01(n * 5 + 1);
+        pOrbit->angularSpeed = (random01(n * 5 + 2) - .5f) * 8.f;
+        pOrbit->spinRate = 60.f + 240.f * random01(n * 5 + 3);
+        pOrbit->scale = .25f + .15f * random01(n * 5 + 4);
+    }
+}
+
+void setupPyramid(ShapeInfo *pInfo)
+{
+    typedef struct {
+        GLfloat x, y, z;
+        GLubyte red, green, blue;
+    } VertexInfo;
+
+    static const VertexInfo pyramidData[] = {
+        // Bottom
+        { 0.0f, 0.f, .5f, 255, 0, 0},
+        { 0.433f, 0.f, -.25f, 255, 0, 0},
+        { -0.433f, 0.f, -.25f, 255, 0, 0},
+        // Side 1
+        { -0.433f, 0.f, -.25f, 0, 0, 255},
+        { 0.433f, 0.f, -.25f, 0, 255, 255},
+        { 0.0f, 0.75f, 0.f, 255, 0, 255},
+        // Side 2
+        { -0.433f, 0.f, -.25f, 255, 255, 0},
+        { 0.0f, 0.f, .5f, 255, 255, 0},
+        { 0.0f, 0.75f, 0.f, 255, 255, 0},
+        // Side 3
+        { 0.0f, 0.f, .5f, 0, 255, 0},
+        { 0.0f, 0.75f, 0.f, 0, 255, 0},
+        { 0.433f, 0.f, -.25f, 0, 255, 0},
+    };
+
+    GLuint buffers[2];
+    glGenVertexArrays(1, &pInfo->vaoId);
+    glBindVertexArray(pInfo->vaoId);
+    glGenBuffers(2, buffers);
+    glBindBuffer(GL_ARRAY_BUFFER, buffers[0]);
+    glBufferData(GL_ARRAY_BUFFER, sizeof(pyramidData), pyramidData, GL_STATIC_DRAW);
+    glVertexAttribPointer(V_POSITION, 3, GL_FLOAT, GL_FALSE, sizeof(VertexInfo), (GLvoid*)offsetof(VertexInfo, x));
+    glEnableVertexAttribArray(V_POSITION);
+    glVertexAttribPointer(C_POSITION, 3, GL_UNSIGNED_BYTE, GL_TRUE, sizeof(VertexInfo), (GLvoid*)offsetof(VertexInfo, red));
+    glEnableVertexAttribArray(C_POSITION);
+    pInfo->count = 12;
+
+    // The orbits never change, so they are uploaded once.  The CPU-side
+    // mode draws without instancing and never reads these.
+    glBindBuffer(GL_ARRAY_BUFFER, buffers[1]);
+    glBufferData(GL_ARRAY_BUFFER, sizeof(g_Orbits), g_Orbits, GL_STATIC_DRAW);
+    glVertexAttribPointer(CENTER_POSITION, 3, GL_FLOAT, GL_FALSE, sizeof(OrbitInfo), (GLvoid*)offsetof(OrbitInfo, centerX));
+    glVertexAttribPointer(ORBIT_POSITION, 3, GL_FLOAT, GL_FALSE, sizeof(OrbitInfo), (GLvoid*)offsetof(OrbitInfo, radius));
+    glVertexAttribPointer(SPIN_POSITION, 2, GL_FLOAT, GL_FALSE, sizeof(OrbitInfo), (GLvoid*)offsetof(OrbitInfo, spinRate));
+    GLuint instanceAttributes[] = { CENTER_POSITION, ORBIT_POSITION, SPIN_POSITION };
+    for (int i = 0; i < 3; i++) {
+        glVertexAttribDivisor(instanceAttributes[i], 1);
+        glEnableVertexAttribArray(instanceAttributes[i]);
+    }
+}
+
+void setupFrustum(float left, float right, float bottom, float top, float zNear, float zFar)
+{
+    g_ProjectionMatrix = vmath::frustum(left, right, bottom, top, zNear, zFar);
+}
+
+double timeMs()
+{
+    static LARGE_INTEGER frequency = { 0 };
+    if (frequency.QuadPart == 0) {
+        QueryPerformanceFrequency(&frequency);
+    }
+    LARGE_INTEGER now;
+    QueryPerformanceCounter(&now);
+    return 1000. * double(now.QuadPart) / double(frequency.QuadPart);
+}
+
+// The same motion as gpuVertSource, one object at a time
+void drawOnCpu(float time)
+{
+    glUseProgram(g_CpuProgram);
+    for (int n = 0; n < OBJECT_COUNT; n++) {
+        const OrbitInfo *pOrbit = &g_Orbits[n];
+        float angle = pOrbit->phase + pOrbit->angularSpeed * time;
+        mat4 modelViewMatrix(vmath::translate(pOrbit->centerX + pOrbit->radius * cosf(angle),
+            pOrbit->centerY + pOrbit->radius * sinf(angle), pOrbit->centerZ));
+        modelViewMatrix *= vmath::rotate(pOrbit->spinRate * time, 0.f, 1.f, 0.f);
+        modelViewMatrix *= vmath::scale(pOrbit->scale, pOrbit->scale, pOrbit->scale);
+        glUniformMatrix4fv(MATRIX_LOCATION, 1, GL_FALSE, g_ProjectionMatrix * modelViewMatrix);
+        glDrawArrays(GL_TRIANGLES, 0, g_Pyramid.count);
+    }
+}
+
+void drawOnGpu(float time)
+{
+    glUseProgram(g_GpuProgram);
+    glUniformMatrix4fv(MATRIX_LOCATION, 1, GL_FALSE, g_ProjectionMatrix);
+    glUniform1f(TIME_LOCATION, time);
+    glDrawArraysInstanced(GL_TRIANGLES, 0, g_Pyramid.count, OBJECT_COUNT);
+}
+
+void onDisplay()
+{
+    static int frames = 0;
+    static double cpuTime = 0;
+    static double startTime = timeMs();
+    static double lastReport = startTime;
+
+    double start = timeMs();
+    float time = float((start - startTime) / 1000.);
+
+    glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+    glBindVertexArray(g_Pyramid.vaoId);
+    if (g_GpuAnimation) {
+        drawOnGpu(time);
+    }
+    else {
+        drawOnCpu(time);
+    }
+    cpuTime += timeMs() - start;
+    glutSwapBuffers();
+
+    frames++;
+    double now = timeMs();
+    if (now - lastReport >= 2000) {
+        printf("%s animation: %.3f ms of CPU time per frame for %d objects\n",
+            g_GpuAnimation ? "GPU" : "CPU", cpuTime / frames, OBJECT_COUNT);
+        frames = 0;
+        cpuTime = 0;
+        lastReport = now;
+    }
+}
+
+void onKey(unsigned char key, int x, int y)
+{
+    if (key == 'a' || key == 'A') {
+        g_GpuAnimation = !g_GpuAnimation;
+        return;
+    }
+    exit(0);
+}
+
+int main(int argc, char *argv[])
+{
+    glutInit(&argc, argv);
+    glutInitDisplayMode(GLUT_RGBA | GLUT_DOUBLE | GLUT_DEPTH);
+    glutInitWindowSize(640, 480);
+    glutCreateWindow(argv[0]);
+
+    glewInit();
+    wglSwapIntervalEXT(1);	// vsync
+
+    glEnable(GL_DEPTH_TEST);
+
+    GLfloat ratio = 640.0f / 480.0f;
+    GLfloat zNear = CENTER_Z - DEPTH_OF_FIELD/2;
+    GLfloat top = zNear * .6f;
+    setupFrustum(-ratio * top, ratio * top, -top, top, zNear, CENTER_Z + DEPTH_OF_FIELD/2);
+
+    setupShaders();
+    setupOrbits();
+    setupPyramid(&g_Pyramid);
+    glutDisplayFunc(onDisplay);
+    glutIdleFunc(onDisplay);
+    glutKeyboardFunc(onKey);
+    glutMainLoop();
+
+    return 0;
+}
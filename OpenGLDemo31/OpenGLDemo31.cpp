@@ -0,0 +1,332 @@
+/*
+ * Demo 31:
+ * Scratch memory for staging.  BuildMonochromeBitmap used to malloc every
+ * bitmap and setupTextures freed it right after the upload.  Here the
+ * bitmaps come from per-thread scratch arenas instead (see ScratchArena.h):
+ * the 256 textures made at startup use load scratch, released in one go
+ * when loading is done, and the 32 textures rebuilt every frame use frame
+ * scratch, released at the end of each frame.  After the first frame no
+ * memory is taken from the system at all, which the stats show.
+ *
+ * See README.txt for prerequisites.
+ */
+#include <windows.h>
+#include <WinGDI.h>
+
+#include <GL/glew.h>
+#include <GL/wglew.h>
+#include <GL/GL.h>
+#include <GL/glut.h>
+
+#include <stdio.h>
+#include <stddef.h>
+
+#include <vmath.h>
+using vmath::mat4;
+
+#include "ScratchArena.h"
+
+// Apparently someone is still using segmented memory qualifiers,
+// and windows.h is letting them.
+#undef near
+#undef far
+
+#define CENTER_Z        16.0f    // Distance from camera
+#define DEPTH_OF_FIELD  6.0f
+
+// Must match hard-coded GRID_SIZE in vertShaderSource
+#define GRID_SIZE       16
+#define OBJECT_COUNT    (GRID_SIZE * GRID_SIZE)
+
+// Exercise:  Raise this and watch the frame scratch peak grow, while the
+// system allocations stay put after the first frame
+#define LAYERS_PER_FRAME 32     // Must divide OBJECT_COUNT
+
+typedef struct {
+    GLsizei count;
+    GLuint vaoId;
+} ShapeInfo;
+
+ShapeInfo g_Pyramid;
+GLuint g_TextureArray;
+mat4 g_ProjectionMatrix(mat4::identity());
+
+// Must match hard-coded vPosition location in vertShaderSource
+#define V_POSITION 0
+
+// Must match hard-coded vTexture location in vertShaderSource
+#define T_POSITION 2
+
+// Must match hard-coded ViewProject and Spin locations in vertShaderSource
+#define VP_LOCATION     0
+#define SPIN_LOCATION   1
+
+// Must match hard-coded textures binding in fragShaderSource
+#define TEXTURE_UNIT    0
+
+void setupShaders()
+{
+    GLchar infoLog[4096];
+    GLsizei length;
+
+    // Each instance is a cell of the grid, with its own texture layer
+    const GLchar *vertShaderSource[] = {
+        "#version 430 core\n"
+        "#define GRID_SIZE 16\n"
+        "layout(location = 0) uniform mat4 ViewProject;\n"
+        "layout(location = 1) uniform float Spin;\n"
+        "layout(location = 0) in vec4 vPosition;\n"
+        "layout(location = 2) in vec2 vTexture;\n"
+        "out vec2 vs_tex_coord;\n"
+        "flat out int layer;\n"
+        "void main() {\n"
+        "    vec2 cell = vec2(gl_InstanceID % GRID_SIZE, gl_InstanceID / GRID_SIZE) - (GRID_SIZE - 1) / 2.0;\n"
+        "    float angle = radians(Spin + gl_InstanceID * 7.0);\n"
+        "    vec3 p = vPosition.xyz;\n"
+        "    p = vec3(cos(angle) * p.x + sin(angle) * p.z, p.y, cos(angle) * p.z - sin(angle) * p.x);\n"
+        "    gl_Position = ViewProject * vec4(p + vec3(cell * 1.1, 0), 1);\n"
+        "    vs_tex_coord = vTexture;\n"
+        "    layer = gl_InstanceID;\n"
+        "}\n"
+    };
+    GLuint vertShader = glCreateShader(GL_VERTEX_SHADER);
+    glShaderSource(vertShader, 1, vertShaderSource, NULL);
+
+    const GLchar *fragShaderSource[] = {
+        "#version 430 core\n"
+        "layout(binding = 0) uniform sampler2DArray textures;\n"
+        "in vec2 vs_tex_coord;\n"
+        "flat in int layer;\n"
+        "out vec4 fColor;\n"
+        "void main() {\n"
+        "    vec4 texColor = texture(textures, vec3(vs_tex_coord, layer));\n"
+        "    fColor = vec4(mix(vec3(.15), texColor.rgb, texColor.a), 1);\n"
+        "}\n"
+    };
+    GLuint fragShader = glCreateShader(GL_FRAGMENT_SHADER);
+    glShaderSource(fragShader, 1, fragShaderSource, NULL);
+
+    GLuint program = glCreateProgram();
+    glAttachShader(program, vertShader);
+    glCompileShader(vertShader);
+    glGetShaderInfoLog(vertShader, 4096, &length, infoLog);
+
+    glAttachShader(program, fragShader);
+    glCompileShader(fragShader);
+    glGetShaderInfoLog(fragShader, 4096, &length, infoLog);
+
+    glLinkProgram(program);
+    glUseProgram(program);
+}
+
+// Convert a simple bitmap (one bit per pixel) into an RGBA bitmap (four bytes per pixel).
+// The result is scratch memory with the given lifetime; nothing frees it.
+GLubyte* BuildMonochromeBitmap(const GLubyte* bits, int width, int height, GLubyte red, GLubyte green, GLubyte blue,
+    ScratchLifetime lifetime)
+{
+    GLubyte* retval = (GLubyte *)scratchAlloc(lifetime, width * height * 4);
+    if (retval) {
+        GLubyte* ptr = retval;
+        for (int y = 0; y < height; y++) {
+            for (int x = 0; x < width/8; x++) {
+                GLubyte next8 = *bits++;
+                for (int mask = 128; mask > 0; mask >>= 1) {
+                    if (next8 & mask) {
+                        *ptr++ = red;
+                        *ptr++ = green;
+                        *ptr++ = blue;
+                        *ptr++ = 255;
+                    }
+                    else {
+                        *ptr++ = 0;
+                        *ptr++ = 0;
+                        *ptr++ = 0;
+                        *ptr++ = 0;
+                    }
+                }
+            }
+        }
+    }
+    return retval;
+}
+
+#define BITMAP_WIDTH 16
+#define BITMAP_HEIGHT 16
+#define BIT_BYTES ((BITMAP_WIDTH / 8) * BITMAP_HEIGHT)
+
+static unsigned int hash(unsigned int x)
+{
+    x ^= x >> 16;
+    x *= 0x7feb352d;
+    x ^= x >> 15;
+    x *= 0x846ca68b;
+    x ^= x >> 16;
+    return x;
+}
+
+static GLubyte reverseBits(GLubyte b)
+{
+    GLubyte r = 0;
+    for (int i = 0; i < 8; i++) {
+        r = GLubyte((r << 1) | ((b >> i) & 1));
+    }
+    return r;
+}
+
+// A left-right symmetric pattern and color for each layer and generation,
+// built and uploaded through scratch memory
+void buildLayer(int layer, unsigned int generation, ScratchLifetime lifetime)
+{
+    unsigned int seed = hash(layer * 65599 + generation);
+    GLubyte *bits = (GLubyte *)scratchAlloc(lifetime, BIT_BYTES);
+    if (!bits) {
+        return;
+    }
+    for (int row = 0; row < BITMAP_HEIGHT; row++) {
+        GLubyte left = GLubyte(hash(seed + row));
+        bits[row * 2] = left;
+        bits[row * 2 + 1] = reverseBits(left);
+    }
+    unsigned int color = hash(~seed);
+    GLubyte* data = BuildMonochromeBitmap(bits, BITMAP_WIDTH, BITMAP_HEIGHT,
+        GLubyte(color | 64), GLubyte((color >> 8) | 64), GLubyte((color >> 16) | 64), lifetime);
+    if (data) {
+        glTexSubImage3D(GL_TEXTURE_2D_ARRAY, 0, 0, 0, layer, BITMAP_WIDTH, BITMAP_HEIGHT, 1, GL_RGBA, GL_UNSIGNED_BYTE, data);
+    }
+}
+
+void printStats(const char *pWhen, ScratchLifetime lifetime)
+{
+    ScratchStats stats;
+    scratchStats(lifetime, &stats);
+    printf("%s: %u scratch allocations (%u KB), peak %u KB, %d from the system (%u KB held)\n", pWhen,
+        unsigned(stats.allocations), unsigned(stats.totalBytes / 1024), unsigned(stats.peakBytes / 1024),
+        stats.systemAllocations, unsigned(stats.reservedBytes / 1024));
+}
+
+void setupTextures()
+{
+    glGenTextures(1, &g_TextureArray);
+    glActiveTexture(GL_TEXTURE0 + TEXTURE_UNIT);
+    glBindTexture(GL_TEXTURE_2D_ARRAY, g_TextureArray);
+    glTexStorage3D(GL_TEXTURE_2D_ARRAY, 1, GL_RGBA8, BITMAP_WIDTH, BITMAP_HEIGHT, OBJECT_COUNT);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+
+    // Everything built while loading goes when loading is done
+    ScratchMark loading = scratchBeginLoad();
+    for (int layer = 0; layer < OBJECT_COUNT; layer++) {
+        buildLayer(layer, 0, SCRATCH_LOAD);
+    }
+    scratchEndLoad(loading);
+    printStats("Loading", SCRATCH_LOAD);
+}
+
+void setupPyramid(ShapeInfo *pInfo)
+{
+    typedef struct {
+        GLfloat x, y, z;
+        GLfloat texU, texV;
+    } VertexInfo;
+
+    static const VertexInfo pyramidData[] = {
+        // Bottom
+        { 0.0f, 0.f, .5f, 0.f, 0.f},
+        { 0.433f, 0.f, -.25f, 0.f, 1.f},
+        { -0.433f, 0.f, -.25f, 1.f, 1.f},
+        // Side 1
+        { -0.433f, 0.f, -.25f, 0.f, 0.f},
+        { 0.433f, 0.f, -.25f, 1.f, 0.f},
+        { 0.0f, 0.75f, 0.f, .5f, 1.f},
+        // Side 2
+        { -0.433f, 0.f, -.25f, 0.f, 0.f},
+        { 0.0f, 0.f, .5f, 1.f, 0.f},
+        { 0.0f, 0.75f, 0.f, .5f, 1.f},
+        // Side 3
+        { 0.0f, 0.f, .5f, 0.f, 0.f},
+        { 0.433f, 0.f, -.25f, 1.f, 0.f},
+        { 0.0f, 0.75f, 0.f, .5f, 1.f},
+    };
+
+    GLuint bufferId;
+    glGenVertexArrays(1, &pInfo->vaoId);
+    glBindVertexArray(pInfo->vaoId);
+    glGenBuffers(1, &bufferId);
+    glBindBuffer(GL_ARRAY_BUFFER, bufferId);
+    glBufferData(GL_ARRAY_BUFFER, sizeof(pyramidData), pyramidData, GL_STATIC_DRAW);
+    glVertexAttribPointer(V_POSITION, 3, GL_FLOAT, GL_FALSE, sizeof(VertexInfo), (GLvoid*)offsetof(VertexInfo, x));
+    glEnableVertexAttribArray(V_POSITION);
+    glVertexAttribPointer(T_POSITION, 2, GL_FLOAT, GL_FALSE, sizeof(VertexInfo), (GLvoid*)offsetof(VertexInfo, texU));
+    glEnableVertexAttribArray(T_POSITION);
+    pInfo->count = 12;
+}
+
+void setupFrustum(float left, float right, float bottom, float top, float zNear, float zFar)
+{
+    g_ProjectionMatrix = vmath::frustum(left, right, bottom, top, zNear, zFar);
+}
+
+void onDisplay()
+{
+    static int i = 0;
+    static int lastReport = glutGet(GLUT_ELAPSED_TIME);
+    i++;
+
+    // A band of layers gets new patterns every frame, so the whole grid
+    // changes every OBJECT_COUNT / LAYERS_PER_FRAME frames
+    int first = (i * LAYERS_PER_FRAME) % OBJECT_COUNT;
+    unsigned int generation = unsigned(i * LAYERS_PER_FRAME / OBJECT_COUNT);
+    for (int layer = first; layer < first + LAYERS_PER_FRAME; layer++) {
+        buildLayer(layer, generation, SCRATCH_FRAME);
+    }
+
+    glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+    glUniformMatrix4fv(VP_LOCATION, 1, GL_FALSE, g_ProjectionMatrix * vmath::translate(0.f, 0.f, -CENTER_Z));
+    glUniform1f(SPIN_LOCATION, i * .5f);
+    glBindVertexArray(g_Pyramid.vaoId);
+    glDrawArraysInstanced(GL_TRIANGLES, 0, g_Pyramid.count, OBJECT_COUNT);
+    glutSwapBuffers();
+
+    // The uploads have copied the staging data, so this frame's scratch
+    // can go
+    scratchEndFrame();
+
+    int now = glutGet(GLUT_ELAPSED_TIME);
+    if (now - lastReport >= 2000) {
+        printStats("Frames so far", SCRATCH_FRAME);
+        lastReport = now;
+    }
+}
+
+void onKey(unsigned char key, int x, int y)
+{
+    exit(0);
+}
+
+int main(int argc, char *argv[])
+{
+    glutInit(&argc, argv);
+    glutInitDisplayMode(GLUT_RGBA | GLUT_DOUBLE | GLUT_DEPTH);
+    glutInitWindowSize(640, 480);
+    glutCreateWindow(argv[0]);
+
+    glewInit();
+    wglSwapIntervalEXT(1);	// vsync
+
+    glEnable(GL_DEPTH_TEST);
+
+    GLfloat ratio = 640.0f / 480.0f;
+    GLfloat zNear = CENTER_Z - DEPTH_OF_FIELD/2;
+    GLfloat top = zNear * .65f;
+    setupFrustum(-ratio * top, ratio * top, -top, top, zNear, CENTER_Z + DEPTH_OF_FIELD/2);
+
+    setupShaders();
+    setupTextures();
+    setupPyramid(&g_Pyramid);
+    glutDisplayFunc(onDisplay);
+    glutIdleFunc(onDisplay);
+    glutKeyboardFunc(onKey);
+    glutMainLoop();
+
+    return 0;
+}
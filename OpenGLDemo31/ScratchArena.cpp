@@ -0,0 +1,196 @@
+/*
+ * Per-thread bump allocators.  See ScratchArena.h.
+ */
+#include "ScratchArena.h"
+
+#include <atomic>
+#include <mutex>
+#include <vector>
+
+#include <xmmintrin.h>
+
+typedef struct {
+    char *pMemory;
+    size_t size;
+} Block;
+
+// One bump allocator.  Only its own thread allocates from it or moves it;
+// the counters are atomic so scratchStats can read them from anywhere.
+class Arena {
+public:
+    Arena() : m_Current(0), m_Offset(0), m_Passed(0),
+        m_InUse(0), m_Peak(0), m_Total(0), m_Allocations(0), m_Reserved(0), m_SystemAllocations(0)
+    {
+    }
+
+    ~Arena()
+    {
+        for (size_t i = 0; i < m_Blocks.size(); i++) {
+            _mm_free(m_Blocks[i].pMemory);
+        }
+    }
+
+    void *alloc(size_t size, size_t alignment)
+    {
+        // Try the current block, then any later ones kept from before
+        while (m_Current < int(m_Blocks.size())) {
+            const Block &block = m_Blocks[m_Current];
+            size_t start = (m_Offset + alignment - 1) & ~(alignment - 1);
+            if (start + size <= block.size) {
+                m_Offset = start + size;
+                account(size);
+                return block.pMemory + start;
+            }
+            // The rest of this block goes unused until the next release
+            m_Passed += block.size;
+            m_Current++;
+            m_Offset = 0;
+        }
+
+        // Blocks are aligned to SCRATCH_MAX_ALIGN, so a new block's start
+        // meets any alignment we accept
+        size_t blockSize = SCRATCH_BLOCK_SIZE;
+        if (size > blockSize) {
+            blockSize = (size + SCRATCH_MAX_ALIGN - 1) & ~size_t(SCRATCH_MAX_ALIGN - 1);
+        }
+        Block block = { (char *)_mm_malloc(blockSize, SCRATCH_MAX_ALIGN), blockSize };
+        if (!block.pMemory) {
+            return NULL;
+        }
+        m_Blocks.push_back(block);
+        m_Reserved.store(m_Reserved.load(std::memory_order_relaxed) + blockSize, std::memory_order_relaxed);
+        m_SystemAllocations.store(m_SystemAllocations.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+        m_Offset = size;
+        account(size);
+        return block.pMemory;
+    }
+
+    ScratchMark mark()
+    {
+        ScratchMark mark = { m_Current, m_Offset };
+        return mark;
+    }
+
+    void release(ScratchMark mark)
+    {
+        m_Current = mark.block;
+        m_Offset = mark.offset;
+        m_Passed = 0;
+        for (int i = 0; i < m_Current; i++) {
+            m_Passed += m_Blocks[i].size;
+        }
+        m_InUse.store(m_Passed + m_Offset, std::memory_order_relaxed);
+    }
+
+    void stats(ScratchStats *pStats)
+    {
+        pStats->inUseBytes += m_InUse.load(std::memory_order_relaxed);
+        pStats->peakBytes += m_Peak.load(std::memory_order_relaxed);
+        pStats->totalBytes += m_Total.load(std::memory_order_relaxed);
+        pStats->allocations += m_Allocations.load(std::memory_order_relaxed);
+        pStats->reservedBytes += m_Reserved.load(std::memory_order_relaxed);
+        pStats->systemAllocations += m_SystemAllocations.load(std::memory_order_relaxed);
+    }
+
+private:
+    void account(size_t size)
+    {
+        size_t inUse = m_Passed + m_Offset;
+        m_InUse.store(inUse, std::memory_order_relaxed);
+        if (inUse > m_Peak.load(std::memory_order_relaxed)) {
+            m_Peak.store(inUse, std::memory_order_relaxed);
+        }
+        m_Total.store(m_Total.load(std::memory_order_relaxed) + size, std::memory_order_relaxed);
+        m_Allocations.store(m_Allocations.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+    }
+
+    std::vector<Block> m_Blocks;
+    int m_Current;
+    size_t m_Offset;
+    size_t m_Passed;        // Size of the blocks before m_Current
+
+    std::atomic<size_t> m_InUse, m_Peak, m_Total, m_Allocations, m_Reserved;
+    std::atomic<int> m_SystemAllocations;
+};
+
+typedef struct {
+    Arena arenas[SCRATCH_LIFETIMES];
+} ThreadScratch;
+
+// Plain pointers are all VS2013 allows in thread-local storage
+static __declspec(thread) ThreadScratch *t_pScratch;
+
+// Every thread's scratch, for scratchStats, and what exited threads left
+static std::mutex g_Mutex;
+static std::vector<ThreadScratch *> g_Threads;
+static ScratchStats g_Retired[SCRATCH_LIFETIMES];
+
+static ThreadScratch *threadScratch()
+{
+    if (!t_pScratch) {
+        t_pScratch = new ThreadScratch;
+        std::lock_guard<std::mutex> lock(g_Mutex);
+        g_Threads.push_back(t_pScratch);
+    }
+    return t_pScratch;
+}
+
+void *scratchAlloc(ScratchLifetime lifetime, size_t size, size_t alignment)
+{
+    if (alignment > SCRATCH_MAX_ALIGN || (alignment & (alignment - 1)) != 0) {
+        return NULL;
+    }
+    alignment = alignment < SCRATCH_ALIGN ? SCRATCH_ALIGN : alignment;
+    return threadScratch()->arenas[lifetime].alloc(size, alignment);
+}
+
+void scratchEndFrame()
+{
+    ScratchMark start = { 0, 0 };
+    threadScratch()->arenas[SCRATCH_FRAME].release(start);
+}
+
+ScratchMark scratchBeginLoad()
+{
+    return threadScratch()->arenas[SCRATCH_LOAD].mark();
+}
+
+void scratchEndLoad(ScratchMark mark)
+{
+    threadScratch()->arenas[SCRATCH_LOAD].release(mark);
+}
+
+void scratchThreadExit()
+{
+    if (!t_pScratch) {
+        return;
+    }
+    std::lock_guard<std::mutex> lock(g_Mutex);
+    for (int lifetime = 0; lifetime < SCRATCH_LIFETIMES; lifetime++) {
+        // Nothing is in use once the thread is gone, and nothing is reserved
+        // once its blocks are freed
+        ScratchStats stats = { 0 };
+        t_pScratch->arenas[lifetime].stats(&stats);
+        g_Retired[lifetime].peakBytes += stats.peakBytes;
+        g_Retired[lifetime].totalBytes += stats.totalBytes;
+        g_Retired[lifetime].allocations += stats.allocations;
+        g_Retired[lifetime].systemAllocations += stats.systemAllocations;
+    }
+    for (size_t i = 0; i < g_Threads.size(); i++) {
+        if (g_Threads[i] == t_pScratch) {
+            g_Threads.erase(g_Threads.begin() + i);
+            break;
+        }
+    }
+    delete t_pScratch;
+    t_pScratch = NULL;
+}
+
+void scratchStats(ScratchLifetime lifetime, ScratchStats *pStats)
+{
+    std::lock_guard<std::mutex> lock(g_Mutex);
+    *pStats = g_Retired[lifetime];
+    for (size_t i = 0; i < g_Threads.size(); i++) {
+        g_Threads[i]->arenas[lifetime].stats(pStats);
+    }
+}
@@ -0,0 +1,64 @@
+/*
+ * Scratch memory for short-lived staging data.
+ *
+ * Every thread gets its own pair of bump allocators, so allocating is a
+ * pointer increment with no lock.  Frame scratch is all released at once
+ * by scratchEndFrame; load scratch is released back to a mark taken with
+ * scratchBeginLoad, so loads can nest.  Released memory is kept for reuse,
+ * and the system allocator is only called when an arena first grows past
+ * what it has ever needed, so in steady state there is no malloc traffic.
+ *
+ * Nothing is freed individually, and memory from one thread's scratch must
+ * not outlive that thread's next release.  Everything is aligned to at
+ * least SCRATCH_ALIGN bytes, enough for SSE and AVX loads and for copying
+ * into mapped buffers a cache line at a time.
+ */
+#ifndef SCRATCH_ARENA_H
+#define SCRATCH_ARENA_H
+
+#include <stddef.h>
+
+#define SCRATCH_ALIGN       64
+#define SCRATCH_MAX_ALIGN   4096            // Blocks are aligned to this
+#define SCRATCH_BLOCK_SIZE  (1024 * 1024)   // Bigger requests get their own block
+
+typedef enum {
+    SCRATCH_FRAME,      // Released by scratchEndFrame
+    SCRATCH_LOAD,       // Released by scratchEndLoad
+    SCRATCH_LIFETIMES
+} ScratchLifetime;
+
+// A point to release load scratch back to
+typedef struct {
+    int block;
+    size_t offset;
+} ScratchMark;
+
+typedef struct {
+    size_t inUseBytes;          // Allocated and not yet released
+    size_t peakBytes;           // Each thread's most ever in use, added up
+    size_t totalBytes;          // Everything ever allocated
+    size_t allocations;         // Calls to scratchAlloc
+    size_t reservedBytes;       // Held from the system, in use or not
+    int systemAllocations;      // Blocks ever taken from the system
+} ScratchStats;
+
+// 'alignment' must be a power of two, no more than SCRATCH_MAX_ALIGN;
+// smaller than SCRATCH_ALIGN is rounded up.  Returns NULL if out of memory
+// or the alignment can't be met.
+void *scratchAlloc(ScratchLifetime lifetime, size_t size, size_t alignment = SCRATCH_ALIGN);
+
+// Release all of this thread's frame scratch
+void scratchEndFrame();
+
+ScratchMark scratchBeginLoad();
+void scratchEndLoad(ScratchMark mark);
+
+// Give this thread's memory back to the system.  Call before a thread that
+// used scratch memory exits.
+void scratchThreadExit();
+
+// Totals over every thread, for one lifetime
+void scratchStats(ScratchLifetime lifetime, ScratchStats *pStats);
+
+#endif
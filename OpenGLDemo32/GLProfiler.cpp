@@ -0,0 +1,265 @@
+/*
+ * GL call wrappers, counters and trace.  See GLProfiler.h.
+ */
+#include <windows.h>
+
+#define GL_PROFILER_IMPLEMENTATION
+#include "GLProfiler.h"
+
+#if GL_PROFILE
+
+#include <stdio.h>
+#include <string.h>
+#include <algorithm>
+#include <vector>
+
+// Enough for a few seconds of a busy demo
+#define MAX_TRACE_EVENTS    (1024 * 1024)
+
+#define FRAME_EVENT         (-1)
+#define SETUP_EVENT         (-2)
+
+enum {
+#define GL_PROFILE_ID(name) ID_##name,
+    GL_PROFILE_GLEW_FUNCTIONS(GL_PROFILE_ID)
+    GL_PROFILE_CORE_FUNCTIONS(GL_PROFILE_ID)
+#undef GL_PROFILE_ID
+    FUNCTION_COUNT
+};
+
+static const char *g_Names[FUNCTION_COUNT] = {
+#define GL_PROFILE_NAME(name) "gl" #name,
+    GL_PROFILE_GLEW_FUNCTIONS(GL_PROFILE_NAME)
+    GL_PROFILE_CORE_FUNCTIONS(GL_PROFILE_NAME)
+#undef GL_PROFILE_NAME
+};
+
+// Until glProfilerInit, the redirected GL 1.1 calls go straight through
+#define GL_PROFILE_DEFINE(name) decltype(&::gl##name) glProfiled##name = &::gl##name;
+GL_PROFILE_CORE_FUNCTIONS(GL_PROFILE_DEFINE)
+#undef GL_PROFILE_DEFINE
+
+typedef struct {
+    int calls;
+    long long ticks;
+    int errors;
+} CallStats;
+
+typedef struct {
+    long long start;
+    long long duration;
+    int id;                 // A function, FRAME_EVENT or SETUP_EVENT
+    int frame;
+} TraceEvent;
+
+static DWORD g_ThreadId;
+static long long g_Frequency, g_StartTicks, g_FrameStartTicks;
+static int g_FrameNumber;
+static CallStats g_Frame[FUNCTION_COUNT];
+static CallStats g_Window[FUNCTION_COUNT];
+static int g_WindowFrames;
+static bool g_Reported[FUNCTION_COUNT];
+static std::vector<TraceEvent> g_Trace;
+
+static long long ticks()
+{
+    LARGE_INTEGER now;
+    QueryPerformanceCounter(&now);
+    return now.QuadPart;
+}
+
+static void trace(int id, long long start, long long end)
+{
+    if (g_Trace.size() < g_Trace.capacity()) {
+        TraceEvent event = { start, end - start, id, g_FrameNumber };
+        g_Trace.push_back(event);
+    }
+}
+
+// Lives for the length of one wrapped call.  The time is taken before the
+// error check, so the check doesn't count against the call.
+class CallScope {
+public:
+    CallScope(int id) : m_Id(id), m_Active(GetCurrentThreadId() == g_ThreadId)
+    {
+        m_Start = m_Active ? ticks() : 0;
+    }
+
+    ~CallScope()
+    {
+        if (!m_Active) {
+            return;
+        }
+        long long end = ticks();
+        g_Frame[m_Id].calls++;
+        g_Frame[m_Id].ticks += end - m_Start;
+        trace(m_Id, m_Start, end);
+
+        if (m_Id != ID_GetError) {
+            GLenum error = ::glGetError();
+            if (error != GL_NO_ERROR) {
+                // Only the first from each entry point is printed; a call
+                // made every frame would flood the console
+                g_Frame[m_Id].errors++;
+                if (!g_Reported[m_Id]) {
+                    printf("GL error 0x%04x from %s in frame %d (more are only counted)\n",
+                        error, g_Names[m_Id], g_FrameNumber);
+                    g_Reported[m_Id] = true;
+                }
+            }
+        }
+    }
+
+private:
+    int m_Id;
+    bool m_Active;
+    long long m_Start;
+};
+
+// One wrapper per entry point, made from its pointer type, so no
+// signatures need to be written out.  Returning a void call is legal C++,
+// so void and value-returning functions share the code.
+template <int Id, typename F> struct Wrapper;
+
+template <int Id, typename R, typename... Args>
+struct Wrapper<Id, R (GLAPIENTRY *)(Args...)> {
+    static R (GLAPIENTRY *real)(Args...);
+
+    static R GLAPIENTRY call(Args... args)
+    {
+        CallScope scope(Id);
+        return real(args...);
+    }
+};
+
+template <int Id, typename R, typename... Args>
+R (GLAPIENTRY *Wrapper<Id, R (GLAPIENTRY *)(Args...)>::real)(Args...) = NULL;
+
+template <int Id, typename F>
+static void install(F *pPointer)
+{
+    // Installing twice would wrap the wrapper
+    if (*pPointer && *pPointer != &Wrapper<Id, F>::call) {
+        Wrapper<Id, F>::real = *pPointer;
+        *pPointer = &Wrapper<Id, F>::call;
+    }
+}
+
+void glProfilerInit()
+{
+    LARGE_INTEGER frequency;
+    QueryPerformanceFrequency(&frequency);
+    g_Frequency = frequency.QuadPart;
+    g_StartTicks = g_FrameStartTicks = ticks();
+    g_ThreadId = GetCurrentThreadId();
+    g_Trace.reserve(MAX_TRACE_EVENTS);
+
+#define GL_PROFILE_INSTALL_GLEW(name) install<ID_##name>(&__glew##name);
+    GL_PROFILE_GLEW_FUNCTIONS(GL_PROFILE_INSTALL_GLEW)
+#undef GL_PROFILE_INSTALL_GLEW
+#define GL_PROFILE_INSTALL_CORE(name) install<ID_##name>(&glProfiled##name);
+    GL_PROFILE_CORE_FUNCTIONS(GL_PROFILE_INSTALL_CORE)
+#undef GL_PROFILE_INSTALL_CORE
+}
+
+static double ticksToUs(long long ticks)
+{
+    return 1e6 * double(ticks) / double(g_Frequency);
+}
+
+static bool busiestFirst(int a, int b)
+{
+    return g_Window[a].ticks > g_Window[b].ticks;
+}
+
+static void printTable(const char *pTitle, int frames)
+{
+    std::vector<int> ids;
+    for (int id = 0; id < FUNCTION_COUNT; id++) {
+        if (g_Window[id].calls > 0) {
+            ids.push_back(id);
+        }
+    }
+    std::sort(ids.begin(), ids.end(), busiestFirst);
+
+    printf("%s, per frame over %d frame%s:\n", pTitle, frames, frames == 1 ? "" : "s");
+    printf("    %-34s %10s %12s %8s\n", "Entry point", "Calls", "CPU us", "Errors");
+    int calls = 0;
+    long long ticks = 0;
+    for (size_t i = 0; i < ids.size(); i++) {
+        const CallStats &stats = g_Window[ids[i]];
+        printf("    %-34s %10.1f %12.2f %8d\n", g_Names[ids[i]],
+            double(stats.calls) / frames, ticksToUs(stats.ticks) / frames, stats.errors);
+        calls += stats.calls;
+        ticks += stats.ticks;
+    }
+    printf("    %-34s %10.1f %12.2f\n", "Total", double(calls) / frames, ticksToUs(ticks) / frames);
+}
+
+void glProfilerEndFrame()
+{
+    long long now = ticks();
+    trace(g_FrameNumber == 0 ? SETUP_EVENT : FRAME_EVENT, g_FrameStartTicks, now);
+    g_FrameStartTicks = now;
+
+    for (int id = 0; id < FUNCTION_COUNT; id++) {
+        g_Window[id].calls += g_Frame[id].calls;
+        g_Window[id].ticks += g_Frame[id].ticks;
+        g_Window[id].errors += g_Frame[id].errors;
+        g_Frame[id].calls = 0;
+        g_Frame[id].ticks = 0;
+        g_Frame[id].errors = 0;
+    }
+    g_WindowFrames++;
+
+    // Setup is reported by itself, so it doesn't skew the frame averages
+    if (g_FrameNumber == 0) {
+        glProfilerReport();
+    }
+    g_FrameNumber++;
+}
+
+void glProfilerReport()
+{
+    if (g_WindowFrames == 0) {
+        return;
+    }
+    printTable(g_FrameNumber == 0 ? "GL calls during setup" : "GL calls", g_FrameNumber == 0 ? 1 : g_WindowFrames);
+    memset(g_Window, 0, sizeof(g_Window));
+    g_WindowFrames = 0;
+}
+
+bool glProfilerWriteTrace(const char *pPath)
+{
+    FILE *pFile = fopen(pPath, "w");
+    if (!pFile) {
+        return false;
+    }
+    fprintf(pFile, "{\"displayTimeUnit\": \"ms\", \"traceEvents\": [\n");
+    for (size_t i = 0; i < g_Trace.size(); i++) {
+        const TraceEvent &event = g_Trace[i];
+        char frameName[32];
+        const char *pName;
+        const char *pCategory = "frame";
+        if (event.id == SETUP_EVENT) {
+            pName = "Setup";
+        }
+        else if (event.id == FRAME_EVENT) {
+            sprintf(frameName, "Frame %d", event.frame);
+            pName = frameName;
+        }
+        else {
+            pName = g_Names[event.id];
+            pCategory = "gl";
+        }
+        fprintf(pFile, "%s{\"name\": \"%s\", \"cat\": \"%s\", \"ph\": \"X\", \"ts\": %.3f, \"dur\": %.3f, \"pid\": 1, \"tid\": 1}",
+            i == 0 ? "" : ",\n", pName, pCategory,
+            ticksToUs(event.start - g_StartTicks), ticksToUs(event.duration));
+    }
+    fprintf(pFile, "\n]}\n");
+    fclose(pFile);
+    printf("Wrote %u trace events to %s\n", unsigned(g_Trace.size()), pPath);
+    return true;
+}
+
+#endif
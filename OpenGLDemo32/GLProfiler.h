@@ -0,0 +1,115 @@
+/*
+ * Per-call GL profiling.
+ *
+ * glProfilerInit puts a wrapper in front of the GL entry points listed
+ * below.  Every wrapped call is counted and timed, and glGetError is
+ * checked after it, so an error is reported against the call that caused
+ * it.  glProfilerReport prints a table of calls and CPU time per frame for
+ * each entry point, and glProfilerWriteTrace saves every call as a Chrome
+ * trace (load it at chrome://tracing).  Only calls made on the thread that
+ * called glProfilerInit are recorded.
+ *
+ * GLEW entry points are reached through function pointers, so the pointers
+ * themselves are swapped, and calls from any file are seen.  GL 1.1 entry
+ * points are plain functions exported by opengl32.dll, so they are
+ * redirected with macros instead, and only in files that include this
+ * header after the GL headers.
+ *
+ * Since errors are read after every call, the application's own
+ * glGetError calls will see GL_NO_ERROR.
+ *
+ * Build with GL_PROFILE defined as 0 to compile all of this out:  the API
+ * becomes empty inline functions and GL calls go straight to the driver.
+ */
+#ifndef GL_PROFILER_H
+#define GL_PROFILER_H
+
+#include <GL/glew.h>
+
+#ifndef GL_PROFILE
+#define GL_PROFILE 1
+#endif
+
+// Entry points reached through GLEW function pointers
+#define GL_PROFILE_GLEW_FUNCTIONS(X) \
+    X(ActiveTexture) X(AttachShader) X(BindBuffer) X(BindBufferBase) \
+    X(BindBufferRange) X(BindFramebuffer) X(BindSampler) X(BindVertexArray) \
+    X(BindVertexBuffer) X(BufferData) X(BufferStorage) X(BufferSubData) \
+    X(ClientWaitSync) X(CompileShader) X(CreateProgram) X(CreateShader) \
+    X(DeleteProgram) X(DeleteShader) X(DeleteSync) X(DetachShader) \
+    X(DispatchCompute) X(DrawArraysInstanced) X(DrawArraysInstancedBaseInstance) \
+    X(DrawElementsInstanced) X(EnableVertexAttribArray) X(FenceSync) \
+    X(GenBuffers) X(GenFramebuffers) X(GenQueries) X(GenSamplers) \
+    X(GenVertexArrays) X(GenerateMipmap) X(GetProgramInfoLog) X(GetProgramiv) \
+    X(GetShaderInfoLog) X(GetShaderiv) X(GetUniformLocation) X(LinkProgram) \
+    X(MapBufferRange) X(MemoryBarrier) X(MultiDrawArraysIndirect) \
+    X(SamplerParameteri) X(ShaderSource) X(TexStorage2D) X(TexStorage3D) \
+    X(TexSubImage3D) X(Uniform1f) X(Uniform1i) X(Uniform1ui) X(Uniform4fv) \
+    X(UniformMatrix4fv) X(UnmapBuffer) X(UseProgram) X(VertexAttribBinding) \
+    X(VertexAttribDivisor) X(VertexAttribFormat) X(VertexAttribIFormat) \
+    X(VertexAttribIPointer) X(VertexAttribPointer)
+
+// GL 1.1 entry points.  Each needs a matching #define below.
+#define GL_PROFILE_CORE_FUNCTIONS(X) \
+    X(BindTexture) X(BlendFunc) X(Clear) X(ClearColor) X(DeleteTextures) \
+    X(DepthMask) X(Disable) X(DrawArrays) X(DrawElements) X(Enable) \
+    X(Finish) X(Flush) X(GenTextures) X(GetError) X(GetFloatv) \
+    X(GetIntegerv) X(GetString) X(PixelStorei) X(TexImage2D) \
+    X(TexParameteri) X(TexSubImage2D) X(Viewport)
+
+#if GL_PROFILE
+
+// Call after glewInit, on the thread that owns the context
+void glProfilerInit();
+
+// Call once a frame, after swapping.  Everything before the first call is
+// reported as setup.
+void glProfilerEndFrame();
+
+// Print calls and CPU time per frame for each entry point, averaged over
+// the frames since the last report
+void glProfilerReport();
+
+// Returns false if the file couldn't be written.  Calls past the trace
+// capacity are counted but not traced.
+bool glProfilerWriteTrace(const char *pPath);
+
+#define GL_PROFILE_DECLARE(name) extern decltype(&::gl##name) glProfiled##name;
+GL_PROFILE_CORE_FUNCTIONS(GL_PROFILE_DECLARE)
+#undef GL_PROFILE_DECLARE
+
+#ifndef GL_PROFILER_IMPLEMENTATION
+#define glBindTexture   glProfiledBindTexture
+#define glBlendFunc     glProfiledBlendFunc
+#define glClear         glProfiledClear
+#define glClearColor    glProfiledClearColor
+#define glDeleteTextures glProfiledDeleteTextures
+#define glDepthMask     glProfiledDepthMask
+#define glDisable       glProfiledDisable
+#define glDrawArrays    glProfiledDrawArrays
+#define glDrawElements  glProfiledDrawElements
+#define glEnable        glProfiledEnable
+#define glFinish        glProfiledFinish
+#define glFlush         glProfiledFlush
+#define glGenTextures   glProfiledGenTextures
+#define glGetError      glProfiledGetError
+#define glGetFloatv     glProfiledGetFloatv
+#define glGetIntegerv   glProfiledGetIntegerv
+#define glGetString     glProfiledGetString
+#define glPixelStorei   glProfiledPixelStorei
+#define glTexImage2D    glProfiledTexImage2D
+#define glTexParameteri glProfiledTexParameteri
+#define glTexSubImage2D glProfiledTexSubImage2D
+#define glViewport      glProfiledViewport
+#endif
+
+#else
+
+inline void glProfilerInit() {}
+inline void glProfilerEndFrame() {}
+inline void glProfilerReport() {}
+inline bool glProfilerWriteTrace(const char *) { return false; }
+
+#endif
+
+#endif
@@ -0,0 +1,332 @@
+/*
+ * Demo 32:
+ * Profiling every GL call.  The textured pyramids of Demo 16 are drawn in
+ * a ring, the Demo 16 way:  a uniform, a bind and a draw for each one.
+ * GLProfiler wraps the GL entry points, checks glGetError after each
+ * call, and prints how many times each entry point was called per frame
+ * and how much CPU time it took, first for setup and then every two
+ * seconds.
+ *
+ * Press W to write every call so far to gl_trace.json, which can be opened
+ * at chrome://tracing; any other key writes it and exits.
+ *
+ * Build with GL_PROFILE defined as 0 to see the same demo with the
+ * profiler compiled out.
+ *
+ * See README.txt for prerequisites.
+ */
+#include <windows.h>
+#include <WinGDI.h>
+
+#include <GL/glew.h>
+#include <GL/wglew.h>
+#include <GL/GL.h>
+#include <GL/glut.h>
+
+#include <stdio.h>
+#include <stddef.h>
+
+#include <vmath.h>
+using vmath::mat4;
+
+// Must come after the GL headers, so its macros aren't undone
+#include "GLProfiler.h"
+
+// Apparently someone is still using segmented memory qualifiers,
+// and windows.h is letting them.
+#undef near
+#undef far
+
+#define CENTER_Z        12.0f    // Distance from camera
+#define DEPTH_OF_FIELD  8.0f
+
+// Exercise:  Raise this and watch the glUniformMatrix4fv and glDrawArrays
+// rows grow with it, while everything else stays the same
+#define OBJECT_COUNT    64
+#define RING_RADIUS     4.0f
+
+#define TRACE_FILE      "gl_trace.json"
+
+typedef struct {
+    GLsizei count;
+    GLuint vaoId;
+} ShapeInfo;
+
+ShapeInfo g_Pyramid;
+GLint g_MatrixUniform, g_SamplerUniform;
+mat4 g_ProjectionMatrix(mat4::identity());
+
+#define BLOCKY_SAMPLER 1
+
+// Must match hard-coded vPosition location in vertShaderSource
+#define V_POSITION 0
+
+// Must match hard-coded location in vertShaderSource
+#define C_POSITION 1
+
+// Must match hard-coded vTexture location in vertShaderSource
+#define T_POSITION 2
+
+void setupShaders()
+{
+    GLchar infoLog[4096];
+    GLsizei length;
+
+    const GLchar *vertShaderSource[] = {
+        "#version 430 core\n"
+        "uniform mat4 ModelViewProject;\n"
+        "layout(location = 0) in vec4 vPosition;\n"
+        "layout(location = 1) in vec3 vColor;\n"
+        "layout(location = 2) in vec2 vTexture;\n"
+        "out vec3 color;\n"
+        "out vec2 vs_tex_coord;\n"
+        "void main() {\n"
+        "    gl_Position = ModelViewProject * vPosition;\n"
+        "    vs_tex_coord = vTexture;\n"
+        "    color = vColor;\n"
+        "}\n"
+    };
+    GLuint vertShader = glCreateShader(GL_VERTEX_SHADER);
+    glShaderSource(vertShader, 1, vertShaderSource, NULL);
+
+    const GLchar *fragShaderSource[] = {
+        "#version 430 core\n"
+        "uniform sampler2D tex;\n"
+        "in vec3 color;\n"
+        "in vec2 vs_tex_coord;\n"
+        "out vec4 fColor;\n"
+        "void main() {\n"
+        "    vec4 texColor = texture(tex, vs_tex_coord);\n"
+        "    fColor = vec4(color, 0) * (1 - texColor.a) + texColor;\n"
+        "}\n"
+    };
+    GLuint fragShader = glCreateShader(GL_FRAGMENT_SHADER);
+    glShaderSource(fragShader, 1, fragShaderSource, NULL);
+
+    GLuint program = glCreateProgram();
+    glAttachShader(program, vertShader);
+    glCompileShader(vertShader);
+    glGetShaderInfoLog(vertShader, 4096, &length, infoLog);
+
+    glAttachShader(program, fragShader);
+    glCompileShader(fragShader);
+    glGetShaderInfoLog(fragShader, 4096, &length, infoLog);
+
+    glLinkProgram(program);
+    glUseProgram(program);
+    g_MatrixUniform = glGetUniformLocation(program, "ModelViewProject");
+    g_SamplerUniform = glGetUniformLocation(program, "tex");
+}
+
+// Convert a simple bitmap (one bit per pixel) into an RGBA bitmap (four bytes per pixel)
+GLubyte* BuildMonochromeBitmap(const GLubyte* bits, int width, int height, GLubyte red, GLubyte green, GLubyte blue)
+{
+    GLubyte* retval = (GLubyte *)malloc(width * height * 4);
+    if (retval) {
+        GLubyte* ptr = retval;
+        for (int y = 0; y < height; y++) {
+            for (int x = 0; x < width/8; x++) {
+                GLubyte next8 = *bits++;
+                for (int mask = 128; mask > 0; mask >>= 1) {
+                    if (next8 & mask) {
+                        *ptr++ = red;
+                        *ptr++ = green;
+                        *ptr++ = blue;
+                        *ptr++ = 255;
+                    }
+                    else {
+                        *ptr++ = 0;
+                        *ptr++ = 0;
+                        *ptr++ = 0;
+                        *ptr++ = 0;
+                    }
+                }
+            }
+        }
+    }
+    return retval;
+}
+
+#define BITMAP_WIDTH 16
+#define BITMAP_HEIGHT 16
+#define BIT_BYTES ((BITMAP_WIDTH / 8) * BITMAP_HEIGHT)
+
+void setupTextures()
+{
+    // smiley face
+    GLubyte bits[BIT_BYTES] = {
+        0x00, 0x00,
+        0x00, 0x00,
+        0x07, 0xE0,
+        0x08, 0x10,
+        0x10, 0x08,
+        0x20, 0x04,
+        0x44, 0x22,
+        0x40, 0x02,
+        0x40, 0x02,
+        0x40, 0x02,
+        0x42, 0x42,
+        0x23, 0xc4,
+        0x10, 0x08,
+        0x0c, 0x30,
+        0x03, 0xc0,
+        0x00, 0x00,
+    };
+
+    GLubyte* data = BuildMonochromeBitmap(bits, BITMAP_WIDTH, BITMAP_HEIGHT, 255, 0, 0);
+    if (!data) {
+        return;
+    }
+    GLuint texture;
+    glGenTextures(1, &texture);
+    glActiveTexture(GL_TEXTURE0 + BLOCKY_SAMPLER);
+    glBindTexture(GL_TEXTURE_2D, texture);
+    // Exercise:  Make this GL_TEXTURE_3D and see which call the profiler
+    // blames for the error
+    glTexStorage2D(GL_TEXTURE_2D, 1, GL_RGBA8, BITMAP_WIDTH, BITMAP_HEIGHT);
+    glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, BITMAP_WIDTH, BITMAP_HEIGHT, GL_RGBA, GL_UNSIGNED_BYTE, data);
+    free(data);
+
+    GLuint sampler;
+    glGenSamplers(1, &sampler);
+    glBindSampler(BLOCKY_SAMPLER, sampler);
+    glSamplerParameteri(sampler, GL_TEXTURE_WRAP_S, GL_REPEAT);
+    glSamplerParameteri(sampler, GL_TEXTURE_WRAP_T, GL_REPEAT);
+    glSamplerParameteri(sampler, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    glSamplerParameteri(sampler, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    glUniform1i(g_SamplerUniform, BLOCKY_SAMPLER);
+}
+
+void setupPyramid(ShapeInfo *pInfo)
+{
+    typedef struct {
+        GLfloat x, y, z;
+        GLubyte red, green, blue;
+        GLfloat texU, texV;
+    } VertexInfo;
+
+    static const VertexInfo pyramidData[] = {
+        // Bottom
+        { 0.0f, 0.f, .5f, 255, 0, 0, 0.f, 0.f},
+        { 0.433f, 0.f, -.25f, 255, 0, 0, 0.f, 1.f},
+        { -0.433f, 0.f, -.25f, 255, 0, 0, 1.f, 1.f},
+        // Side 1
+        { -0.433f, 0.f, -.25f, 0, 0, 255, 0.f, 0.f},
+        { 0.433f, 0.f, -.25f, 0, 255, 255, 1.f, 0.f},
+        { 0.0f, 0.75f, 0.f, 255, 0, 255, 1.f, 1.f},
+        // Side 2
+        { -0.433f, 0.f, -.25f, 255, 255, 0, 0.f, 0.f},
+        { 0.0f, 0.f, .5f, 255, 255, 0, 0.f, 1.f},
+        { 0.0f, 0.75f, 0.f, 255, 255, 0, 1.f, 1.f},
+        // Side 3
+        { 0.0f, 0.f, .5f, 0, 255, 0, 4.f, 4.f},
+        { 0.0f, 0.75f, 0.f, 0, 255, 0, 2.f, 0.f},
+        { 0.433f, 0.f, -.25f, 0, 255, 0, 0.f, 4.f},
+    };
+
+    GLuint vboId;
+    glGenVertexArrays(1, &pInfo->vaoId);
+    glBindVertexArray(pInfo->vaoId);
+    glGenBuffers(1, &vboId);
+    glBindBuffer(GL_ARRAY_BUFFER, vboId);
+    glBufferData(GL_ARRAY_BUFFER, sizeof(pyramidData), pyramidData, GL_STATIC_DRAW);
+
+    glVertexAttribPointer(V_POSITION, 3, GL_FLOAT, GL_FALSE, sizeof(VertexInfo), (GLvoid*)offsetof(VertexInfo, x));
+    glEnableVertexAttribArray(V_POSITION);
+    glVertexAttribPointer(C_POSITION, 3, GL_UNSIGNED_BYTE, GL_TRUE, sizeof(VertexInfo), (GLvoid*)offsetof(VertexInfo, red));
+    glEnableVertexAttribArray(C_POSITION);
+    glVertexAttribPointer(T_POSITION, 2, GL_FLOAT, GL_FALSE, sizeof(VertexInfo), (GLvoid*)offsetof(VertexInfo, texU));
+    glEnableVertexAttribArray(T_POSITION);
+
+    pInfo->count = 12;
+}
+
+void setupFrustum(float left, float right, float bottom, float top, float zNear, float zFar)
+{
+    g_ProjectionMatrix = vmath::frustum(left, right, bottom, top, zNear, zFar);
+}
+
+double timeMs()
+{
+    static LARGE_INTEGER frequency = { 0 };
+    if (frequency.QuadPart == 0) {
+        QueryPerformanceFrequency(&frequency);
+    }
+    LARGE_INTEGER now;
+    QueryPerformanceCounter(&now);
+    return 1000. * double(now.QuadPart) / double(frequency.QuadPart);
+}
+
+void drawTrianglesAt(float x, float y, float z, float rotyDegrees, float scale, ShapeInfo *pInfo)
+{
+    mat4 modelViewMatrix(vmath::translate(x, y, z - CENTER_Z));
+    modelViewMatrix *= vmath::rotate(rotyDegrees, 0.f, 1.f, 0.f);
+    modelViewMatrix *= vmath::scale(scale, scale, scale);
+
+    glUniformMatrix4fv(g_MatrixUniform, 1, GL_FALSE, g_ProjectionMatrix * modelViewMatrix);
+    // Exercise:  Bind pInfo's buffer name here instead, as Demo 16 does by
+    // mistake, and watch the profiler catch it
+    glBindVertexArray(pInfo->vaoId);
+    glDrawArrays(GL_TRIANGLES, 0, pInfo->count);
+}
+
+void onDisplay()
+{
+    static double startTime = timeMs();
+    static double lastReport = startTime;
+
+    float time = float((timeMs() - startTime) / 1000.);
+    glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+    for (int n = 0; n < OBJECT_COUNT; n++) {
+        float angle = time / 4.f + 2 * float(M_PI) * n / OBJECT_COUNT;
+        drawTrianglesAt(RING_RADIUS * cosf(angle), RING_RADIUS * sinf(angle), 0.f,
+            time * 90.f + n * 10.f, 1.f, &g_Pyramid);
+    }
+    glutSwapBuffers();
+    glProfilerEndFrame();
+
+    double now = timeMs();
+    if (now - lastReport >= 2000) {
+        glProfilerReport();
+        lastReport = now;
+    }
+}
+
+void onKey(unsigned char key, int x, int y)
+{
+    glProfilerWriteTrace(TRACE_FILE);
+    if (key == 'w' || key == 'W') {
+        return;
+    }
+    exit(0);
+}
+
+int main(int argc, char *argv[])
+{
+    glutInit(&argc, argv);
+    glutInitDisplayMode(GLUT_RGBA | GLUT_DOUBLE | GLUT_DEPTH);
+    glutInitWindowSize(640, 480);
+    glutCreateWindow(argv[0]);
+
+    glewInit();
+    // Everything from here on is counted as setup, until the first frame
+    glProfilerInit();
+    wglSwapIntervalEXT(1);	// vsync
+
+    glEnable(GL_DEPTH_TEST);
+
+    GLfloat ratio = 640.0f / 480.0f;
+    GLfloat zNear = CENTER_Z - DEPTH_OF_FIELD/2;
+    GLfloat top = zNear * .5f;
+    setupFrustum(-ratio * top, ratio * top, -top, top, zNear, CENTER_Z + DEPTH_OF_FIELD/2);
+
+    setupShaders();
+    setupPyramid(&g_Pyramid);
+    setupTextures();
+    glutDisplayFunc(onDisplay);
+    glutIdleFunc(onDisplay);
+    glutKeyboardFunc(onKey);
+    glutMainLoop();
+
+    return 0;
+}
@@ -0,0 +1,464 @@
+/*
+ * Demo 33:
+ * A CPU and GPU timeline.  A grid of textured pyramids is drawn the Demo
+ * 16 way, a matrix and a draw each, with the matrices built on every core
+ * first.  Setup, each stage of the frame and each worker's share are
+ * marked with TIMELINE_ZONE, and the two GPU passes with
+ * TIMELINE_GPU_ZONE, so they all line up on one timeline (see Timeline.h).
+ * The cost of one zone is printed at startup, and zone counts every two
+ * seconds.
+ *
+ * Press W to write the timeline to timeline.json, which opens in
+ * chrome://tracing or ui.perfetto.dev; any other key writes it and exits.
+ *
+ * See README.txt for prerequisites.
+ */
+#include <windows.h>
+#include <WinGDI.h>
+
+#include <GL/glew.h>
+#include <GL/wglew.h>
+#include <GL/GL.h>
+#include <GL/glut.h>
+
+#include <stdio.h>
+#include <stddef.h>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+
+#include <vmath.h>
+using vmath::mat4;
+
+#include "Timeline.h"
+
+// Apparently someone is still using segmented memory qualifiers,
+// and windows.h is letting them.
+#undef near
+#undef far
+
+#define CENTER_Z        40.0f    // Distance from camera
+#define DEPTH_OF_FIELD  10.0f
+
+#define GRID_SIZE       32
+#define OBJECT_COUNT    (GRID_SIZE * GRID_SIZE)
+#define GRID_SPACING    1.5f
+
+// Below this, waking a thread costs more than it saves.
+// Exercise:  Set it to OBJECT_COUNT and see the workers vanish from the
+// timeline and "build MVPs" grow on the main row.
+#define MIN_OBJECTS_PER_THREAD  128
+
+#define TRACE_FILE      "timeline.json"
+
+typedef struct {
+    GLsizei count;
+    GLuint vaoId;
+} ShapeInfo;
+
+ShapeInfo g_Pyramid;
+GLint g_MatrixUniform, g_SamplerUniform;
+mat4 g_ProjectionMatrix(mat4::identity());
+mat4 g_Matrices[OBJECT_COUNT];
+
+#define BLOCKY_SAMPLER 1
+
+// Must match hard-coded vPosition location in vertShaderSource
+#define V_POSITION 0
+
+// Must match hard-coded location in vertShaderSource
+#define C_POSITION 1
+
+// Must match hard-coded vTexture location in vertShaderSource
+#define T_POSITION 2
+
+void setupShaders()
+{
+    TIMELINE_ZONE("setupShaders");
+    GLchar infoLog[4096];
+    GLsizei length;
+
+    const GLchar *vertShaderSource[] = {
+        "#version 430 core\n"
+        "uniform mat4 ModelViewProject;\n"
+        "layout(location = 0) in vec4 vPosition;\n"
+        "layout(location = 1) in vec3 vColor;\n"
+        "layout(location = 2) in vec2 vTexture;\n"
+        "out vec3 color;\n"
+        "out vec2 vs_tex_coord;\n"
+        "void main() {\n"
+        "    gl_Position = ModelViewProject * vPosition;\n"
+        "    vs_tex_coord = vTexture;\n"
+        "    color = vColor;\n"
+        "}\n"
+    };
+    GLuint vertShader = glCreateShader(GL_VERTEX_SHADER);
+    glShaderSource(vertShader, 1, vertShaderSource, NULL);
+
+    const GLchar *fragShaderSource[] = {
+        "#version 430 core\n"
+        "uniform sampler2D tex;\n"
+        "in vec3 color;\n"
+        "in vec2 vs_tex_coord;\n"
+        "out vec4 fColor;\n"
+        "void main() {\n"
+        "    vec4 texColor = texture(tex, vs_tex_coord);\n"
+        "    fColor = vec4(color, 0) * (1 - texColor.a) + texColor;\n"
+        "}\n"
+    };
+    GLuint fragShader = glCreateShader(GL_FRAGMENT_SHADER);
+    glShaderSource(fragShader, 1, fragShaderSource, NULL);
+
+    GLuint program = glCreateProgram();
+    glAttachShader(program, vertShader);
+    glCompileShader(vertShader);
+    glGetShaderInfoLog(vertShader, 4096, &length, infoLog);
+
+    glAttachShader(program, fragShader);
+    glCompileShader(fragShader);
+    glGetShaderInfoLog(fragShader, 4096, &length, infoLog);
+
+    glLinkProgram(program);
+    glUseProgram(program);
+    g_MatrixUniform = glGetUniformLocation(program, "ModelViewProject");
+    g_SamplerUniform = glGetUniformLocation(program, "tex");
+}
+
+// Convert a simple bitmap (one bit per pixel) into an RGBA bitmap (four bytes per pixel)
+GLubyte* BuildMonochromeBitmap(const GLubyte* bits, int width, int height, GLubyte red, GLubyte green, GLubyte blue)
+{
+    GLubyte* retval = (GLubyte *)malloc(width * height * 4);
+    if (retval) {
+        GLubyte* ptr = retval;
+        for (int y = 0; y < height; y++) {
+            for (int x = 0; x < width/8; x++) {
+                GLubyte next8 = *bits++;
+                for (int mask = 128; mask > 0; mask >>= 1) {
+                    if (next8 & mask) {
+                        *ptr++ = red;
+                        *ptr++ = green;
+                        *ptr++ = blue;
+                        *ptr++ = 255;
+                    }
+                    else {
+                        *ptr++ = 0;
+                        *ptr++ = 0;
+                        *ptr++ = 0;
+                        *ptr++ = 0;
+                    }
+                }
+            }
+        }
+    }
+    return retval;
+}
+
+#define BITMAP_WIDTH 16
+#define BITMAP_HEIGHT 16
+#define BIT_BYTES ((BITMAP_WIDTH / 8) * BITMAP_HEIGHT)
+
+void setupTextures()
+{
+    TIMELINE_ZONE("setupTextures");
+
+    // smiley face
+    GLubyte bits[BIT_BYTES] = {
+        0x00, 0x00,
+        0x00, 0x00,
+        0x07, 0xE0,
+        0x08, 0x10,
+        0x10, 0x08,
+        0x20, 0x04,
+        0x44, 0x22,
+        0x40, 0x02,
+        0x40, 0x02,
+        0x40, 0x02,
+        0x42, 0x42,
+        0x23, 0xc4,
+        0x10, 0x08,
+        0x0c, 0x30,
+        0x03, 0xc0,
+        0x00, 0x00,
+    };
+
+    GLubyte* data = BuildMonochromeBitmap(bits, BITMAP_WIDTH, BITMAP_HEIGHT, 255, 0, 0);
+    if (!data) {
+        return;
+    }
+    GLuint texture;
+    glGenTextures(1, &texture);
+    glActiveTexture(GL_TEXTURE0 + BLOCKY_SAMPLER);
+    glBindTexture(GL_TEXTURE_2D, texture);
+    glTexStorage2D(GL_TEXTURE_2D, 1, GL_RGBA8, BITMAP_WIDTH, BITMAP_HEIGHT);
+    glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, BITMAP_WIDTH, BITMAP_HEIGHT, GL_RGBA, GL_UNSIGNED_BYTE, data);
+    free(data);
+
+    GLuint sampler;
+    glGenSamplers(1, &sampler);
+    glBindSampler(BLOCKY_SAMPLER, sampler);
+    glSamplerParameteri(sampler, GL_TEXTURE_WRAP_S, GL_REPEAT);
+    glSamplerParameteri(sampler, GL_TEXTURE_WRAP_T, GL_REPEAT);
+    glSamplerParameteri(sampler, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    glSamplerParameteri(sampler, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    glUniform1i(g_SamplerUniform, BLOCKY_SAMPLER);
+}
+
+void setupPyramid(ShapeInfo *pInfo)
+{
+    TIMELINE_ZONE("setupPyramid");
+
+    typedef struct {
+        GLfloat x, y, z;
+        GLubyte red, green, blue;
+        GLfloat texU, texV;
+    } VertexInfo;
+
+    static const VertexInfo pyramidData[] = {
+        // Bottom
+        { 0.0f, 0.f, .5f, 255, 0, 0, 0.f, 0.f},
+        { 0.433f, 0.f, -.25f, 255, 0, 0, 0.f, 1.f},
+        { -0.433f, 0.f, -.25f, 255, 0, 0, 1.f, 1.f},
+        // Side 1
+        { -0.433f, 0.f, -.25f, 0, 0, 255, 0.f, 0.f},
+        { 0.433f, 0.f, -.25f, 0, 255, 255, 1.f, 0.f},
+        { 0.0f, 0.75f, 0.f, 255, 0, 255, 1.f, 1.f},
+        // Side 2
+        { -0.433f, 0.f, -.25f, 255, 255, 0, 0.f, 0.f},
+        { 0.0f, 0.f, .5f, 255, 255, 0, 0.f, 1.f},
+        { 0.0f, 0.75f, 0.f, 255, 255, 0, 1.f, 1.f},
+        // Side 3
+        { 0.0f, 0.f, .5f, 0, 255, 0, 4.f, 4.f},
+        { 0.0f, 0.75f, 0.f, 0, 255, 0, 2.f, 0.f},
+        { 0.433f, 0.f, -.25f, 0, 255, 0, 0.f, 4.f},
+    };
+
+    GLuint vboId;
+    glGenVertexArrays(1, &pInfo->vaoId);
+    glBindVertexArray(pInfo->vaoId);
+    glGenBuffers(1, &vboId);
+    glBindBuffer(GL_ARRAY_BUFFER, vboId);
+    glBufferData(GL_ARRAY_BUFFER, sizeof(pyramidData), pyramidData, GL_STATIC_DRAW);
+
+    glVertexAttribPointer(V_POSITION, 3, GL_FLOAT, GL_FALSE, sizeof(VertexInfo), (GLvoid*)offsetof(VertexInfo, x));
+    glEnableVertexAttribArray(V_POSITION);
+    glVertexAttribPointer(C_POSITION, 3, GL_UNSIGNED_BYTE, GL_TRUE, sizeof(VertexInfo), (GLvoid*)offsetof(VertexInfo, red));
+    glEnableVertexAttribArray(C_POSITION);
+    glVertexAttribPointer(T_POSITION, 2, GL_FLOAT, GL_FALSE, sizeof(VertexInfo), (GLvoid*)offsetof(VertexInfo, texU));
+    glEnableVertexAttribArray(T_POSITION);
+
+    pInfo->count = 12;
+}
+
+void setupFrustum(float left, float right, float bottom, float top, float zNear, float zFar)
+{
+    g_ProjectionMatrix = vmath::frustum(left, right, bottom, top, zNear, zFar);
+}
+
+double timeMs()
+{
+    static LARGE_INTEGER frequency = { 0 };
+    if (frequency.QuadPart == 0) {
+        QueryPerformanceFrequency(&frequency);
+    }
+    LARGE_INTEGER now;
+    QueryPerformanceCounter(&now);
+    return 1000. * double(now.QuadPart) / double(frequency.QuadPart);
+}
+
+void buildMatrices(float time, int first, int last)
+{
+    TIMELINE_ZONE("build MVPs (share)");
+    for (int n = first; n < last; n++) {
+        float x = (n % GRID_SIZE - (GRID_SIZE - 1) / 2.f) * GRID_SPACING;
+        float y = (n / GRID_SIZE - (GRID_SIZE - 1) / 2.f) * GRID_SPACING;
+        mat4 modelViewMatrix(vmath::translate(x, y, -CENTER_Z));
+        modelViewMatrix *= vmath::rotate(time * 90.f + n * 7.f, 0.f, 1.f, 0.f);
+        g_Matrices[n] = g_ProjectionMatrix * modelViewMatrix;
+    }
+}
+
+// The MVP workers are started the first frame they're needed and kept, so
+// each keeps one row in the timeline and a frame only pays to wake them.
+// Worker t builds share t of every frame; the main thread builds share 0.
+// Never freed, as the workers are still waiting on it at exit.
+typedef struct {
+    std::mutex mutex;
+    std::condition_variable wake, done;
+    int workers;
+    long long generation;       // Frames handed out
+    int active;                 // Threads sharing the current frame
+    int remaining;              // Workers still building it
+    float time;
+    int share;
+} MatrixWorkers;
+
+MatrixWorkers *g_pWorkers;
+
+void buildShare(float time, int share, int t)
+{
+    int first = t * share;
+    int last = first + share < OBJECT_COUNT ? first + share : OBJECT_COUNT;
+    if (first < last) {
+        buildMatrices(time, first, last);
+    }
+}
+
+void buildMatricesWorker(int t)
+{
+    char name[32];
+    sprintf(name, "MVP worker %d", t);
+    timelineSetThreadName(name);
+
+    MatrixWorkers *pWorkers = g_pWorkers;
+    long long seen = 0;
+    for (;;) {
+        float time;
+        int share;
+        {
+            std::unique_lock<std::mutex> lock(pWorkers->mutex);
+            while (pWorkers->generation == seen) {
+                pWorkers->wake.wait(lock);
+            }
+            seen = pWorkers->generation;
+            if (t >= pWorkers->active) {
+                continue;
+            }
+            time = pWorkers->time;
+            share = pWorkers->share;
+        }
+        buildShare(time, share, t);
+
+        std::lock_guard<std::mutex> lock(pWorkers->mutex);
+        if (--pWorkers->remaining == 0) {
+            pWorkers->done.notify_one();
+        }
+    }
+}
+
+void buildAllMatrices(float time)
+{
+    TIMELINE_ZONE("build MVPs");
+    int threadCount = int(std::thread::hardware_concurrency());
+    if (threadCount > OBJECT_COUNT / MIN_OBJECTS_PER_THREAD) {
+        threadCount = OBJECT_COUNT / MIN_OBJECTS_PER_THREAD;
+    }
+    if (threadCount <= 0) {
+        threadCount = 1;
+    }
+    int share = (OBJECT_COUNT + threadCount - 1) / threadCount;
+
+    // The calling thread takes the first share itself
+    if (threadCount == 1) {
+        buildShare(time, share, 0);
+        return;
+    }
+    if (!g_pWorkers) {
+        g_pWorkers = new MatrixWorkers();
+    }
+    {
+        std::lock_guard<std::mutex> lock(g_pWorkers->mutex);
+        while (g_pWorkers->workers < threadCount - 1) {
+            std::thread(buildMatricesWorker, ++g_pWorkers->workers).detach();
+        }
+        g_pWorkers->time = time;
+        g_pWorkers->share = share;
+        g_pWorkers->active = threadCount;
+        g_pWorkers->remaining = threadCount - 1;
+        g_pWorkers->generation++;
+        g_pWorkers->wake.notify_all();
+    }
+    buildShare(time, share, 0);
+    std::unique_lock<std::mutex> lock(g_pWorkers->mutex);
+    while (g_pWorkers->remaining > 0) {
+        g_pWorkers->done.wait(lock);
+    }
+}
+
+void submit()
+{
+    TIMELINE_ZONE("submit");
+    {
+        TIMELINE_GPU_ZONE("clear");
+        glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+    }
+    {
+        TIMELINE_GPU_ZONE("pyramids");
+        glBindVertexArray(g_Pyramid.vaoId);
+        for (int n = 0; n < OBJECT_COUNT; n++) {
+            glUniformMatrix4fv(g_MatrixUniform, 1, GL_FALSE, g_Matrices[n]);
+            glDrawArrays(GL_TRIANGLES, 0, g_Pyramid.count);
+        }
+    }
+}
+
+void onDisplay()
+{
+    static int frames = 0;
+    static double startTime = timeMs();
+    static double lastReport = startTime;
+    static TimelineStats lastStats = { 0 };
+
+    buildAllMatrices(float((timeMs() - startTime) / 1000.));
+    submit();
+    {
+        TIMELINE_ZONE("swap");
+        glutSwapBuffers();
+    }
+    timelineEndFrame();
+
+    frames++;
+    double now = timeMs();
+    if (now - lastReport >= 2000) {
+        TimelineStats stats;
+        timelineStats(&stats);
+        printf("%.1f CPU zones and %.1f GPU zones per frame, %lld GPU zones dropped\n",
+            double(stats.zones - lastStats.zones) / frames,
+            double(stats.gpuZones - lastStats.gpuZones) / frames, stats.gpuDropped);
+        lastStats = stats;
+        frames = 0;
+        lastReport = now;
+    }
+}
+
+void onKey(unsigned char key, int x, int y)
+{
+    timelineWriteTrace(TRACE_FILE);
+    if (key == 'w' || key == 'W') {
+        return;
+    }
+    exit(0);
+}
+
+int main(int argc, char *argv[])
+{
+    glutInit(&argc, argv);
+    glutInitDisplayMode(GLUT_RGBA | GLUT_DOUBLE | GLUT_DEPTH);
+    glutInitWindowSize(640, 480);
+    glutCreateWindow(argv[0]);
+
+    glewInit();
+    wglSwapIntervalEXT(1);	// vsync
+
+    timelineInit();
+    timelineSetThreadName("Main");
+    TimelineStats stats;
+    timelineStats(&stats);
+    printf("One zone costs %.1f ns\n", stats.zoneCostNs);
+
+    glEnable(GL_DEPTH_TEST);
+
+    GLfloat ratio = 640.0f / 480.0f;
+    GLfloat zNear = CENTER_Z - DEPTH_OF_FIELD/2;
+    GLfloat top = zNear * .7f;
+    setupFrustum(-ratio * top, ratio * top, -top, top, zNear, CENTER_Z + DEPTH_OF_FIELD/2);
+
+    setupShaders();
+    setupPyramid(&g_Pyramid);
+    setupTextures();
+    glutDisplayFunc(onDisplay);
+    glutIdleFunc(onDisplay);
+    glutKeyboardFunc(onKey);
+    glutMainLoop();
+
+    return 0;
+}
@@ -0,0 +1,309 @@
+/*
+ * Per-thread zone rings and GPU timestamps.  See Timeline.h.
+ */
+#include <windows.h>
+
+#include <GL/glew.h>
+
+#include "Timeline.h"
+
+#if TIMELINE_ENABLE
+
+#include <stdio.h>
+#include <string.h>
+#include <atomic>
+#include <mutex>
+#include <vector>
+
+// How often GPU time is matched up with QueryPerformanceCounter again, so
+// the two clocks don't drift apart
+#define CALIBRATE_MS        1000
+
+// Zones timed by timelineInit to measure the cost of one
+#define COST_SAMPLES        100000
+
+typedef struct {
+    const char *pName;
+    long long start, end;       // QueryPerformanceCounter ticks
+} ZoneEvent;
+
+// One row of the trace.  Only the thread that owns the ring writes events;
+// the head is published with release so a reader sees whole events.
+typedef struct {
+    std::atomic<long long> head;        // Events ever pushed
+    ZoneEvent *pEvents;
+    char name[64];
+    bool inUse;
+} Ring;
+
+static long long frequency()
+{
+    LARGE_INTEGER frequency;
+    QueryPerformanceFrequency(&frequency);
+    return frequency.QuadPart;
+}
+
+static const long long g_Frequency = frequency();
+static long long g_StartTicks;
+static double g_ZoneCostNs;
+
+// Plain pointers are all VS2013 allows in thread-local storage
+static __declspec(thread) Ring *t_pRing;
+
+// Rings are never freed, so a pointer to one stays good for the life of
+// the program; the mutex only guards the list, the names and inUse
+static std::mutex g_Mutex;
+static std::vector<Ring *> g_Rings;
+
+// GPU zones, owned by the GL thread.  Slots are used in order; zones from
+// g_GpuTail up to g_GpuHead are waiting for their results.
+static Ring *g_pGpuRing;
+static GLuint g_GpuQueries[2 * TIMELINE_GPU_ZONES];
+static const char *g_GpuNames[TIMELINE_GPU_ZONES];
+static bool g_GpuEnded[TIMELINE_GPU_ZONES];
+static long long g_GpuHead, g_GpuTail;
+static std::atomic<long long> g_GpuResolved, g_GpuDropped;
+
+// A GPU time in nanoseconds and the QueryPerformanceCounter reading taken
+// with it
+static GLint64 g_CalibrationGpuNs;
+static long long g_CalibrationTicks;
+
+static long long g_FrameStart;
+
+long long timelineTicks()
+{
+    LARGE_INTEGER now;
+    QueryPerformanceCounter(&now);
+    return now.QuadPart;
+}
+
+static Ring *newRing(const char *pName)
+{
+    Ring *pRing = new Ring;
+    pRing->head.store(0, std::memory_order_relaxed);
+    pRing->pEvents = new ZoneEvent[TIMELINE_RING_EVENTS];
+    strncpy(pRing->name, pName, sizeof(pRing->name) - 1);
+    pRing->name[sizeof(pRing->name) - 1] = '\0';
+    pRing->inUse = true;
+    return pRing;
+}
+
+// Called with g_Mutex held
+static Ring *threadRingLocked()
+{
+    if (t_pRing) {
+        return t_pRing;
+    }
+    for (size_t i = 0; i < g_Rings.size(); i++) {
+        if (!g_Rings[i]->inUse) {
+            g_Rings[i]->inUse = true;
+            return t_pRing = g_Rings[i];
+        }
+    }
+    char name[64];
+    sprintf(name, "Thread %d", int(g_Rings.size()));
+    t_pRing = newRing(name);
+    g_Rings.push_back(t_pRing);
+    return t_pRing;
+}
+
+static void push(Ring *pRing, const char *pName, long long start, long long end)
+{
+    long long head = pRing->head.load(std::memory_order_relaxed);
+    ZoneEvent &event = pRing->pEvents[head & (TIMELINE_RING_EVENTS - 1)];
+    event.pName = pName;
+    event.start = start;
+    event.end = end;
+    pRing->head.store(head + 1, std::memory_order_release);
+}
+
+void timelineRecord(const char *pName, long long start, long long end)
+{
+    Ring *pRing = t_pRing;
+    if (!pRing) {
+        std::lock_guard<std::mutex> lock(g_Mutex);
+        pRing = threadRingLocked();
+    }
+    push(pRing, pName, start, end);
+}
+
+static void calibrate()
+{
+    glGetInteger64v(GL_TIMESTAMP, &g_CalibrationGpuNs);
+    g_CalibrationTicks = timelineTicks();
+}
+
+void timelineInit()
+{
+    g_StartTicks = g_FrameStart = timelineTicks();
+
+    // Timed against a ring of its own, so the samples don't crowd real
+    // zones out of this thread's ring
+    Ring *pScratch = newRing("");
+    long long start = timelineTicks();
+    for (int i = 0; i < COST_SAMPLES; i++) {
+        push(pScratch, "cost", timelineTicks(), timelineTicks());
+    }
+    g_ZoneCostNs = 1e9 * double(timelineTicks() - start) / double(g_Frequency) / COST_SAMPLES;
+    delete[] pScratch->pEvents;
+    delete pScratch;
+
+    std::lock_guard<std::mutex> lock(g_Mutex);
+    threadRingLocked();
+    if (!g_pGpuRing) {
+        g_pGpuRing = newRing("GPU");
+        g_Rings.push_back(g_pGpuRing);
+        glGenQueries(2 * TIMELINE_GPU_ZONES, g_GpuQueries);
+    }
+    calibrate();
+}
+
+void timelineSetThreadName(const char *pName)
+{
+    std::lock_guard<std::mutex> lock(g_Mutex);
+    Ring *pRing = threadRingLocked();
+    strncpy(pRing->name, pName, sizeof(pRing->name) - 1);
+}
+
+void timelineThreadExit()
+{
+    if (!t_pRing) {
+        return;
+    }
+    std::lock_guard<std::mutex> lock(g_Mutex);
+    t_pRing->inUse = false;
+    t_pRing = NULL;
+}
+
+int timelineGpuBegin()
+{
+    if (g_GpuHead - g_GpuTail >= TIMELINE_GPU_ZONES) {
+        g_GpuDropped.fetch_add(1, std::memory_order_relaxed);
+        return -1;
+    }
+    int slot = int(g_GpuHead % TIMELINE_GPU_ZONES);
+    g_GpuEnded[slot] = false;
+    glQueryCounter(g_GpuQueries[2 * slot], GL_TIMESTAMP);
+    g_GpuHead++;
+    return slot;
+}
+
+void timelineGpuEnd(int slot, const char *pName)
+{
+    if (slot < 0) {
+        return;
+    }
+    glQueryCounter(g_GpuQueries[2 * slot + 1], GL_TIMESTAMP);
+    g_GpuNames[slot] = pName;
+    g_GpuEnded[slot] = true;
+}
+
+static long long gpuToTicks(GLuint64 ns)
+{
+    return g_CalibrationTicks + (GLint64(ns) - g_CalibrationGpuNs) * g_Frequency / 1000000000;
+}
+
+void timelineEndFrame()
+{
+    long long now = timelineTicks();
+    timelineRecord("Frame", g_FrameStart, now);
+    g_FrameStart = now;
+
+    // Zones finish in the order they were started, except that an outer
+    // zone ends after the ones inside it; stopping at the first that isn't
+    // ready keeps the rest for next frame
+    while (g_GpuTail < g_GpuHead) {
+        int slot = int(g_GpuTail % TIMELINE_GPU_ZONES);
+        GLint available = 0;
+        if (g_GpuEnded[slot]) {
+            glGetQueryObjectiv(g_GpuQueries[2 * slot + 1], GL_QUERY_RESULT_AVAILABLE, &available);
+        }
+        if (!available) {
+            break;
+        }
+        GLuint64 start, end;
+        glGetQueryObjectui64v(g_GpuQueries[2 * slot], GL_QUERY_RESULT, &start);
+        glGetQueryObjectui64v(g_GpuQueries[2 * slot + 1], GL_QUERY_RESULT, &end);
+        push(g_pGpuRing, g_GpuNames[slot], gpuToTicks(start), gpuToTicks(end));
+        g_GpuResolved.fetch_add(1, std::memory_order_relaxed);
+        g_GpuTail++;
+    }
+
+    if (1000. * double(now - g_CalibrationTicks) / double(g_Frequency) >= CALIBRATE_MS) {
+        calibrate();
+    }
+}
+
+void timelineStats(TimelineStats *pStats)
+{
+    std::lock_guard<std::mutex> lock(g_Mutex);
+    pStats->zones = 0;
+    pStats->overwritten = 0;
+    for (size_t i = 0; i < g_Rings.size(); i++) {
+        if (g_Rings[i] == g_pGpuRing) {
+            continue;
+        }
+        long long head = g_Rings[i]->head.load(std::memory_order_relaxed);
+        pStats->zones += head;
+        pStats->overwritten += head > TIMELINE_RING_EVENTS ? head - TIMELINE_RING_EVENTS : 0;
+    }
+    pStats->gpuZones = g_GpuResolved.load(std::memory_order_relaxed);
+    pStats->gpuDropped = g_GpuDropped.load(std::memory_order_relaxed);
+    pStats->zoneCostNs = g_ZoneCostNs;
+}
+
+static double ticksToUs(long long ticks)
+{
+    return 1e6 * double(ticks) / double(g_Frequency);
+}
+
+bool timelineWriteTrace(const char *pPath)
+{
+    FILE *pFile = fopen(pPath, "w");
+    if (!pFile) {
+        return false;
+    }
+    std::lock_guard<std::mutex> lock(g_Mutex);
+    fprintf(pFile, "{\"displayTimeUnit\": \"ms\", \"traceEvents\": [\n");
+    fprintf(pFile, "{\"name\": \"process_name\", \"ph\": \"M\", \"pid\": 1, \"args\": {\"name\": \"Timeline\"}}");
+    size_t written = 0;
+    std::vector<ZoneEvent> events;
+    for (size_t row = 0; row < g_Rings.size(); row++) {
+        Ring *pRing = g_Rings[row];
+        fprintf(pFile, ",\n{\"name\": \"thread_name\", \"ph\": \"M\", \"pid\": 1, \"tid\": %d, \"args\": {\"name\": \"%s\"}}",
+            int(row), pRing->name);
+        fprintf(pFile, ",\n{\"name\": \"thread_sort_index\", \"ph\": \"M\", \"pid\": 1, \"tid\": %d, \"args\": {\"sort_index\": %d}}",
+            int(row), int(row));
+
+        // The owner may keep pushing while we copy.  Whatever it could have
+        // overwritten by the time we finish is left out.
+        long long head = pRing->head.load(std::memory_order_acquire);
+        long long first = head > TIMELINE_RING_EVENTS ? head - TIMELINE_RING_EVENTS : 0;
+        events.clear();
+        for (long long i = first; i < head; i++) {
+            events.push_back(pRing->pEvents[i & (TIMELINE_RING_EVENTS - 1)]);
+        }
+        // The fence keeps the plain reads of the copy above from moving
+        // after this load; the acquire on the load alone wouldn't
+        std::atomic_thread_fence(std::memory_order_acquire);
+        long long after = pRing->head.load(std::memory_order_relaxed);
+        long long safe = after - TIMELINE_RING_EVENTS + 1;
+        for (long long i = first; i < head; i++) {
+            if (i < safe) {
+                continue;
+            }
+            const ZoneEvent &event = events[size_t(i - first)];
+            fprintf(pFile, ",\n{\"name\": \"%s\", \"cat\": \"%s\", \"ph\": \"X\", \"ts\": %.3f, \"dur\": %.3f, \"pid\": 1, \"tid\": %d}",
+                event.pName, pRing == g_pGpuRing ? "gpu" : "cpu",
+                ticksToUs(event.start - g_StartTicks), ticksToUs(event.end - event.start), int(row));
+            written++;
+        }
+    }
+    fprintf(pFile, "\n]}\n");
+    fclose(pFile);
+    printf("Wrote %u zones to %s\n", unsigned(written), pPath);
+    return true;
+}
+
+#endif
@@ -0,0 +1,107 @@
+/*
+ * Named CPU and GPU zones on one timeline.
+ *
+ * TIMELINE_ZONE("name") times the rest of the enclosing block on the CPU.
+ * TIMELINE_GPU_ZONE("name") does the same, and also brackets the GL
+ * commands issued in the block with glQueryCounter timestamps, so the
+ * time the GPU spent on them shows up on a row of its own, lined up with
+ * the CPU rows.  Names must be string literals, or otherwise outlive the
+ * timeline; only the pointer is kept.
+ *
+ * Each thread writes its zones into its own ring buffer with no lock, so a
+ * zone costs two QueryPerformanceCounter calls and a store.  Rings hold
+ * the last TIMELINE_RING_EVENTS zones and then overwrite the oldest, so
+ * the timeline can stay on indefinitely.  A ring is handed on to the next
+ * new thread once its thread calls timelineThreadExit, so short-lived
+ * workers reuse the same few rows.
+ *
+ * timelineWriteTrace saves everything still in the rings as Chrome trace
+ * JSON, which both chrome://tracing and ui.perfetto.dev open.
+ *
+ * Build with TIMELINE_ENABLE defined as 0 to compile all of this out.
+ */
+#ifndef TIMELINE_H
+#define TIMELINE_H
+
+#ifndef TIMELINE_ENABLE
+#define TIMELINE_ENABLE 1
+#endif
+
+#define TIMELINE_RING_EVENTS    65536   // Per thread.  Must be a power of two.
+#define TIMELINE_GPU_ZONES      1024    // Waiting for results at once
+
+typedef struct {
+    long long zones;            // Recorded, on every thread
+    long long overwritten;      // Pushed out of a full ring
+    long long gpuZones;         // Resolved
+    long long gpuDropped;       // Too many waiting for results
+    double zoneCostNs;          // Measured by timelineInit
+} TimelineStats;
+
+#if TIMELINE_ENABLE
+
+// Call after glewInit, on the thread that owns the context.  GPU zones can
+// only be used on that thread.
+void timelineInit();
+
+// Names the calling thread's row in the trace
+void timelineSetThreadName(const char *pName);
+
+// Call before a thread that recorded zones exits
+void timelineThreadExit();
+
+// Call once a frame on the GL thread, after swapping.  Collects GPU zones
+// whose results are ready; it never waits for the GPU.
+void timelineEndFrame();
+
+void timelineStats(TimelineStats *pStats);
+
+// Returns false if the file couldn't be written
+bool timelineWriteTrace(const char *pPath);
+
+long long timelineTicks();
+void timelineRecord(const char *pName, long long start, long long end);
+int timelineGpuBegin();
+void timelineGpuEnd(int slot, const char *pName);
+
+class TimelineZone {
+public:
+    TimelineZone(const char *pName) : m_pName(pName), m_Start(timelineTicks()) {}
+    ~TimelineZone() { timelineRecord(m_pName, m_Start, timelineTicks()); }
+
+protected:
+    const char *m_pName;
+
+private:
+    long long m_Start;
+};
+
+class TimelineGpuZone : public TimelineZone {
+public:
+    TimelineGpuZone(const char *pName) : TimelineZone(pName), m_Slot(timelineGpuBegin()) {}
+    ~TimelineGpuZone() { timelineGpuEnd(m_Slot, m_pName); }
+
+private:
+    int m_Slot;
+};
+
+#define TIMELINE_CONCAT2(a, b) a##b
+#define TIMELINE_CONCAT(a, b) TIMELINE_CONCAT2(a, b)
+#define TIMELINE_ZONE(name) TimelineZone TIMELINE_CONCAT(timelineZone, __LINE__)(name)
+#define TIMELINE_GPU_ZONE(name) TimelineGpuZone TIMELINE_CONCAT(timelineZone, __LINE__)(name)
+
+#else
+
+inline void timelineInit() {}
+inline void timelineSetThreadName(const char *) {}
+inline void timelineThreadExit() {}
+inline void timelineEndFrame() {}
+inline void timelineStats(TimelineStats *pStats) { *pStats = TimelineStats(); }
+inline bool timelineWriteTrace(const char *) { return false; }
+
+#define TIMELINE_ZONE(name)
+#define TIMELINE_GPU_ZONE(name)
+
+#endif
+
+#endif
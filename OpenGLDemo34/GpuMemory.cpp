@@ -0,0 +1,384 @@
+/*
+ * GPU resource registry.  See GpuMemory.h.
+ */
+#include "GpuMemory.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <algorithm>
+#include <map>
+#include <string>
+#include <vector>
+
+typedef struct {
+    GpuResourceKind kind;
+    GLuint name;
+    GLenum target;
+    GLenum format;              // Internal format, or usage for a buffer
+    GLsizei width, height, depth, levels, samples;
+    size_t bytes;
+    char owner[48];
+} GpuResource;
+
+typedef struct {
+    GLenum format;
+    const char *pName;
+    int blockBytes;
+    int blockSize;              // Texels on a side of a block; 1 if not compressed
+} FormatInfo;
+
+// Three-channel 8-bit formats are counted at four bytes a texel, since
+// that is how every current driver stores them
+static const FormatInfo g_Formats[] = {
+#define FORMAT(format, bytes, block) { format, #format, bytes, block },
+    FORMAT(GL_R8, 1, 1)
+    FORMAT(GL_RG8, 2, 1)
+    FORMAT(GL_RGB8, 4, 1)
+    FORMAT(GL_RGBA8, 4, 1)
+    FORMAT(GL_SRGB8, 4, 1)
+    FORMAT(GL_SRGB8_ALPHA8, 4, 1)
+    FORMAT(GL_RGB10_A2, 4, 1)
+    FORMAT(GL_R11F_G11F_B10F, 4, 1)
+    FORMAT(GL_R16F, 2, 1)
+    FORMAT(GL_RG16F, 4, 1)
+    FORMAT(GL_RGBA16F, 8, 1)
+    FORMAT(GL_R32F, 4, 1)
+    FORMAT(GL_RG32F, 8, 1)
+    FORMAT(GL_RGBA32F, 16, 1)
+    FORMAT(GL_R32UI, 4, 1)
+    FORMAT(GL_RGBA32UI, 16, 1)
+    FORMAT(GL_DEPTH_COMPONENT16, 2, 1)
+    FORMAT(GL_DEPTH_COMPONENT24, 4, 1)
+    FORMAT(GL_DEPTH_COMPONENT32F, 4, 1)
+    FORMAT(GL_DEPTH24_STENCIL8, 4, 1)
+    FORMAT(GL_DEPTH32F_STENCIL8, 8, 1)
+    FORMAT(GL_COMPRESSED_RGB_S3TC_DXT1_EXT, 8, 4)
+    FORMAT(GL_COMPRESSED_RGBA_S3TC_DXT1_EXT, 8, 4)
+    FORMAT(GL_COMPRESSED_RGBA_S3TC_DXT5_EXT, 16, 4)
+    FORMAT(GL_COMPRESSED_RED_RGTC1, 8, 4)
+    FORMAT(GL_COMPRESSED_RG_RGTC2, 16, 4)
+    FORMAT(GL_COMPRESSED_RGBA_BPTC_UNORM, 16, 4)
+#undef FORMAT
+};
+
+static const struct {
+    GLenum usage;
+    const char *pName;
+} g_Usages[] = {
+#define USAGE(usage) { usage, #usage },
+    USAGE(GL_STREAM_DRAW) USAGE(GL_STREAM_READ) USAGE(GL_STREAM_COPY)
+    USAGE(GL_STATIC_DRAW) USAGE(GL_STATIC_READ) USAGE(GL_STATIC_COPY)
+    USAGE(GL_DYNAMIC_DRAW) USAGE(GL_DYNAMIC_READ) USAGE(GL_DYNAMIC_COPY)
+#undef USAGE
+};
+
+static const char *g_KindNames[GPU_RESOURCE_KINDS] = { "buffer", "texture", "renderbuffer" };
+
+static std::map<unsigned long long, GpuResource> g_Live;
+static GpuMemStats g_Stats;
+static GpuBudgetPolicy g_Policy = GPU_BUDGET_WARN;
+
+static unsigned long long key(GpuResourceKind kind, GLuint name)
+{
+    return (unsigned long long)kind << 32 | name;
+}
+
+static const FormatInfo *findFormat(GLenum format)
+{
+    for (size_t i = 0; i < sizeof(g_Formats) / sizeof(g_Formats[0]); i++) {
+        if (g_Formats[i].format == format) {
+            return &g_Formats[i];
+        }
+    }
+    return NULL;
+}
+
+static double megabytes(size_t bytes)
+{
+    return double(bytes) / (1024. * 1024.);
+}
+
+size_t gpuMemImageSize(GLenum target, GLenum internalFormat, GLsizei width, GLsizei height, GLsizei depth,
+    GLsizei levels, GLsizei samples)
+{
+    const FormatInfo *pFormat = findFormat(internalFormat);
+    if (!pFormat) {
+        return 0;
+    }
+    // Only a 3D texture gets smaller in depth at each level
+    bool shrinkDepth = target == GL_TEXTURE_3D;
+    size_t faces = target == GL_TEXTURE_CUBE_MAP ? 6 : 1;
+    size_t bytes = 0;
+    for (int level = 0; level < levels; level++) {
+        size_t w = width >> level > 0 ? width >> level : 1;
+        size_t h = height >> level > 0 ? height >> level : 1;
+        size_t d = !shrinkDepth ? depth : depth >> level > 0 ? depth >> level : 1;
+        size_t blocksX = (w + pFormat->blockSize - 1) / pFormat->blockSize;
+        size_t blocksY = (h + pFormat->blockSize - 1) / pFormat->blockSize;
+        bytes += blocksX * blocksY * d * faces * pFormat->blockBytes;
+    }
+    return bytes * (samples > 1 ? samples : 1);
+}
+
+// Applies the budget to an allocation that would grow the total by
+// 'growth'.  Returns false if it is refused.
+static bool checkBudget(const char *pOwner, GpuResourceKind kind, size_t growth)
+{
+    if (g_Stats.budgetBytes == 0 || g_Stats.totalBytes + growth <= g_Stats.budgetBytes) {
+        return true;
+    }
+    g_Stats.overBudget++;
+    bool refuse = g_Policy == GPU_BUDGET_REFUSE;
+    printf("GPU memory budget of %.2f MB %s:  %.2f MB %s for %s would make %.2f MB\n",
+        megabytes(g_Stats.budgetBytes), refuse ? "refused an allocation" : "exceeded",
+        megabytes(growth), g_KindNames[kind], pOwner, megabytes(g_Stats.totalBytes + growth));
+    if (refuse) {
+        g_Stats.refused++;
+    }
+    return !refuse;
+}
+
+// An allocation the driver couldn't make isn't recorded
+static bool allocated(const char *pOwner, GpuResourceKind kind)
+{
+    if (glGetError() == GL_OUT_OF_MEMORY) {
+        printf("Out of GPU memory making a %s for %s\n", g_KindNames[kind], pOwner);
+        return false;
+    }
+    return true;
+}
+
+static void add(GpuResource *pResource, const char *pOwner)
+{
+    strncpy(pResource->owner, pOwner, sizeof(pResource->owner) - 1);
+    pResource->owner[sizeof(pResource->owner) - 1] = '\0';
+    g_Live[key(pResource->kind, pResource->name)] = *pResource;
+
+    g_Stats.liveBytes[pResource->kind] += pResource->bytes;
+    g_Stats.liveCount[pResource->kind]++;
+    g_Stats.totalBytes += pResource->bytes;
+    g_Stats.peakBytes = std::max(g_Stats.peakBytes, g_Stats.totalBytes);
+}
+
+GLuint gpuMemCreateBuffer(const char *pOwner, GLenum target, GLsizeiptr size, const void *pData, GLenum usage)
+{
+    if (!checkBudget(pOwner, GPU_RESOURCE_BUFFER, size)) {
+        return 0;
+    }
+    GLuint buffer;
+    glGenBuffers(1, &buffer);
+    glBindBuffer(target, buffer);
+    glBufferData(target, size, pData, usage);
+    if (!allocated(pOwner, GPU_RESOURCE_BUFFER)) {
+        glDeleteBuffers(1, &buffer);
+        return 0;
+    }
+
+    GpuResource resource = { GPU_RESOURCE_BUFFER, buffer, target, usage };
+    resource.bytes = size;
+    add(&resource, pOwner);
+    return buffer;
+}
+
+bool gpuMemBufferData(GLuint buffer, GLenum target, GLsizeiptr size, const void *pData, GLenum usage)
+{
+    std::map<unsigned long long, GpuResource>::iterator it = g_Live.find(key(GPU_RESOURCE_BUFFER, buffer));
+    if (it == g_Live.end()) {
+        return false;
+    }
+    GpuResource &resource = it->second;
+    size_t growth = size_t(size) > resource.bytes ? size - resource.bytes : 0;
+    if (!checkBudget(resource.owner, GPU_RESOURCE_BUFFER, growth)) {
+        return false;
+    }
+    glBindBuffer(target, buffer);
+    glBufferData(target, size, pData, usage);
+    // A failed glBufferData leaves the buffer with no storage at all
+    size_t bytes = allocated(resource.owner, GPU_RESOURCE_BUFFER) ? size : 0;
+
+    g_Stats.liveBytes[GPU_RESOURCE_BUFFER] += bytes - resource.bytes;
+    g_Stats.totalBytes += bytes - resource.bytes;
+    g_Stats.peakBytes = std::max(g_Stats.peakBytes, g_Stats.totalBytes);
+    resource.bytes = bytes;
+    resource.format = usage;
+    return bytes == size_t(size);
+}
+
+GLuint gpuMemCreateTexture(const char *pOwner, GLenum target, GLsizei levels, GLenum internalFormat,
+    GLsizei width, GLsizei height, GLsizei depth)
+{
+    size_t bytes = gpuMemImageSize(target, internalFormat, width, height, depth, levels);
+    if (bytes == 0) {
+        printf("GPU memory doesn't know format 0x%04x; %s's texture is counted as empty\n", internalFormat, pOwner);
+    }
+    if (!checkBudget(pOwner, GPU_RESOURCE_TEXTURE, bytes)) {
+        return 0;
+    }
+    GLuint texture;
+    glGenTextures(1, &texture);
+    glBindTexture(target, texture);
+    if (target == GL_TEXTURE_3D || target == GL_TEXTURE_2D_ARRAY || target == GL_TEXTURE_CUBE_MAP_ARRAY) {
+        glTexStorage3D(target, levels, internalFormat, width, height, depth);
+    }
+    else {
+        glTexStorage2D(target, levels, internalFormat, width, height);
+    }
+    if (!allocated(pOwner, GPU_RESOURCE_TEXTURE)) {
+        glDeleteTextures(1, &texture);
+        return 0;
+    }
+
+    GpuResource resource = { GPU_RESOURCE_TEXTURE, texture, target, internalFormat, width, height, depth, levels, 0 };
+    resource.bytes = bytes;
+    add(&resource, pOwner);
+    return texture;
+}
+
+GLuint gpuMemCreateRenderbuffer(const char *pOwner, GLenum internalFormat, GLsizei width, GLsizei height,
+    GLsizei samples)
+{
+    size_t bytes = gpuMemImageSize(GL_RENDERBUFFER, internalFormat, width, height, 1, 1, samples);
+    if (bytes == 0) {
+        printf("GPU memory doesn't know format 0x%04x; %s's renderbuffer is counted as empty\n", internalFormat, pOwner);
+    }
+    if (!checkBudget(pOwner, GPU_RESOURCE_RENDERBUFFER, bytes)) {
+        return 0;
+    }
+    GLuint renderbuffer;
+    glGenRenderbuffers(1, &renderbuffer);
+    glBindRenderbuffer(GL_RENDERBUFFER, renderbuffer);
+    if (samples > 0) {
+        glRenderbufferStorageMultisample(GL_RENDERBUFFER, samples, internalFormat, width, height);
+    }
+    else {
+        glRenderbufferStorage(GL_RENDERBUFFER, internalFormat, width, height);
+    }
+    if (!allocated(pOwner, GPU_RESOURCE_RENDERBUFFER)) {
+        glDeleteRenderbuffers(1, &renderbuffer);
+        return 0;
+    }
+
+    GpuResource resource = { GPU_RESOURCE_RENDERBUFFER, renderbuffer, GL_RENDERBUFFER, internalFormat,
+        width, height, 1, 1, samples };
+    resource.bytes = bytes;
+    add(&resource, pOwner);
+    return renderbuffer;
+}
+
+void gpuMemDelete(GpuResourceKind kind, GLuint name)
+{
+    std::map<unsigned long long, GpuResource>::iterator it = g_Live.find(key(kind, name));
+    if (it != g_Live.end()) {
+        g_Stats.liveBytes[kind] -= it->second.bytes;
+        g_Stats.liveCount[kind]--;
+        g_Stats.totalBytes -= it->second.bytes;
+        g_Live.erase(it);
+    }
+    switch (kind) {
+    case GPU_RESOURCE_BUFFER:
+        glDeleteBuffers(1, &name);
+        break;
+    case GPU_RESOURCE_TEXTURE:
+        glDeleteTextures(1, &name);
+        break;
+    case GPU_RESOURCE_RENDERBUFFER:
+        glDeleteRenderbuffers(1, &name);
+        break;
+    default:
+        break;
+    }
+}
+
+void gpuMemSetBudget(size_t bytes, GpuBudgetPolicy policy)
+{
+    g_Stats.budgetBytes = bytes;
+    g_Policy = policy;
+}
+
+void gpuMemStats(GpuMemStats *pStats)
+{
+    *pStats = g_Stats;
+}
+
+static bool biggestFirst(const GpuResource *pA, const GpuResource *pB)
+{
+    return pA->bytes > pB->bytes;
+}
+
+static bool biggestOwnerFirst(const std::pair<std::string, size_t> &a, const std::pair<std::string, size_t> &b)
+{
+    return a.second > b.second;
+}
+
+static const char *formatName(const GpuResource *pResource, char *pBuffer)
+{
+    if (pResource->kind == GPU_RESOURCE_BUFFER) {
+        for (size_t i = 0; i < sizeof(g_Usages) / sizeof(g_Usages[0]); i++) {
+            if (g_Usages[i].usage == pResource->format) {
+                return g_Usages[i].pName;
+            }
+        }
+    }
+    else {
+        const FormatInfo *pFormat = findFormat(pResource->format);
+        if (pFormat) {
+            return pFormat->pName;
+        }
+    }
+    sprintf(pBuffer, "0x%04x", pResource->format);
+    return pBuffer;
+}
+
+void gpuMemDump()
+{
+    std::vector<const GpuResource *> live;
+    for (std::map<unsigned long long, GpuResource>::const_iterator it = g_Live.begin(); it != g_Live.end(); ++it) {
+        live.push_back(&it->second);
+    }
+    std::sort(live.begin(), live.end(), biggestFirst);
+
+    printf("GPU memory:  %.2f MB in %u resources, peak %.2f MB", megabytes(g_Stats.totalBytes),
+        unsigned(live.size()), megabytes(g_Stats.peakBytes));
+    if (g_Stats.budgetBytes) {
+        printf(", budget %.2f MB", megabytes(g_Stats.budgetBytes));
+    }
+    printf("\n    %-24s %-13s %6s %10s  %-34s %s\n", "Owner", "Kind", "Name", "MB", "Format or usage", "Size");
+
+    std::vector<std::pair<std::string, size_t> > owners;
+    for (size_t i = 0; i < live.size(); i++) {
+        const GpuResource *pResource = live[i];
+        char formatBuffer[16], size[64];
+        if (pResource->kind == GPU_RESOURCE_BUFFER) {
+            sprintf(size, "%u bytes", unsigned(pResource->bytes));
+        }
+        else {
+            int length = sprintf(size, "%dx%d", pResource->width, pResource->height);
+            if (pResource->depth > 1) {
+                length += sprintf(size + length, "x%d", pResource->depth);
+            }
+            if (pResource->levels > 1) {
+                length += sprintf(size + length, ", %d levels", pResource->levels);
+            }
+            if (pResource->samples > 1) {
+                sprintf(size + length, ", %d samples", pResource->samples);
+            }
+        }
+        printf("    %-24s %-13s %6u %10.3f  %-34s %s\n", pResource->owner, g_KindNames[pResource->kind],
+            pResource->name, megabytes(pResource->bytes), formatName(pResource, formatBuffer), size);
+
+        size_t o = 0;
+        while (o < owners.size() && owners[o].first != pResource->owner) {
+            o++;
+        }
+        if (o == owners.size()) {
+            owners.push_back(std::make_pair(std::string(pResource->owner), size_t(0)));
+        }
+        owners[o].second += pResource->bytes;
+    }
+
+    std::sort(owners.begin(), owners.end(), biggestOwnerFirst);
+    printf("  By owner:\n");
+    for (size_t o = 0; o < owners.size(); o++) {
+        printf("    %-24s %10.3f MB\n", owners[o].first.c_str(), megabytes(owners[o].second));
+    }
+}
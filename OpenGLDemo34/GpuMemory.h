@@ -0,0 +1,84 @@
+/*
+ * Accounting for GPU memory.
+ *
+ * Buffers, textures and renderbuffers made through these functions are
+ * recorded with their size, format, usage and an owner label, and removed
+ * again by gpuMemDelete.  Running totals and the peak are kept for each
+ * kind of resource, and gpuMemDump prints everything that is still alive,
+ * biggest first, with a subtotal for each owner.
+ *
+ * Sizes are what the data needs:  every mip level, every layer and every
+ * sample, in whole blocks for compressed formats.  Drivers add padding and
+ * alignment on top, so treat the totals as a lower bound on what is
+ * resident.
+ *
+ * A budget can be set.  Going over it prints a warning naming the
+ * allocation that crossed it; with GPU_BUDGET_REFUSE the allocation is
+ * refused instead, and the create function returns 0.
+ *
+ * Each create function reads glGetError to catch GL_OUT_OF_MEMORY, so an
+ * error left over from an earlier call is lost.  Call everything on the
+ * thread that owns the context.
+ */
+#ifndef GPU_MEMORY_H
+#define GPU_MEMORY_H
+
+#include <GL/glew.h>
+#include <stddef.h>
+
+typedef enum {
+    GPU_RESOURCE_BUFFER,
+    GPU_RESOURCE_TEXTURE,
+    GPU_RESOURCE_RENDERBUFFER,
+    GPU_RESOURCE_KINDS
+} GpuResourceKind;
+
+typedef enum {
+    GPU_BUDGET_WARN,        // Allocate anyway, and say so
+    GPU_BUDGET_REFUSE       // Say so, and don't allocate
+} GpuBudgetPolicy;
+
+typedef struct {
+    size_t liveBytes[GPU_RESOURCE_KINDS];
+    int liveCount[GPU_RESOURCE_KINDS];
+    size_t totalBytes;          // Live, every kind
+    size_t peakBytes;           // Highest totalBytes has been
+    size_t budgetBytes;         // 0 if there is no budget
+    int overBudget;             // Allocations that went over it
+    int refused;                // ... and were refused
+} GpuMemStats;
+
+// Returns 0 if the budget refused it.  The buffer is left bound to 'target'.
+GLuint gpuMemCreateBuffer(const char *pOwner, GLenum target, GLsizeiptr size, const void *pData, GLenum usage);
+
+// Respecify a buffer made by gpuMemCreateBuffer, as glBufferData would.
+// Returns false, leaving the buffer as it was, if the budget refused it.
+bool gpuMemBufferData(GLuint buffer, GLenum target, GLsizeiptr size, const void *pData, GLenum usage);
+
+// Immutable storage, as glTexStorage2D and glTexStorage3D make.  'depth' is
+// the layer count for array targets and 1 for 2D.  The texture is left
+// bound to 'target' on the active unit.
+GLuint gpuMemCreateTexture(const char *pOwner, GLenum target, GLsizei levels, GLenum internalFormat,
+    GLsizei width, GLsizei height, GLsizei depth = 1);
+
+GLuint gpuMemCreateRenderbuffer(const char *pOwner, GLenum internalFormat, GLsizei width, GLsizei height,
+    GLsizei samples = 0);
+
+// Deletes the GL object too
+void gpuMemDelete(GpuResourceKind kind, GLuint name);
+
+// 0 removes the budget
+void gpuMemSetBudget(size_t bytes, GpuBudgetPolicy policy = GPU_BUDGET_WARN);
+
+void gpuMemStats(GpuMemStats *pStats);
+
+// Print every live resource, then a subtotal for each owner
+void gpuMemDump();
+
+// Bytes a texture or renderbuffer of this target, format and size needs;
+// 0 for a format the table doesn't know.  Use GL_RENDERBUFFER for a
+// renderbuffer.
+size_t gpuMemImageSize(GLenum target, GLenum internalFormat, GLsizei width, GLsizei height, GLsizei depth,
+    GLsizei levels, GLsizei samples = 0);
+
+#endif
@@ -0,0 +1,446 @@
+/*
+ * Demo 34:
+ * Keeping track of GPU memory.  Every buffer, texture and renderbuffer is
+ * made through GpuMemory.h, which records its size, format, usage and
+ * owner, keeps totals and a peak, and warns when a budget is crossed.  The
+ * scene is drawn into an offscreen target and copied to the window, and
+ * "levels" of textures can be loaded and unloaded to watch the totals move.
+ *
+ * Press L to load a level and U to unload the oldest; D dumps everything
+ * that is alive; B switches the budget between warning and refusing.  Any
+ * other key exits.
+ *
+ * See README.txt for prerequisites.
+ */
+#include <windows.h>
+#include <WinGDI.h>
+
+#include <GL/glew.h>
+#include <GL/wglew.h>
+#include <GL/GL.h>
+#include <GL/glut.h>
+
+#include <stdio.h>
+#include <stddef.h>
+#include <deque>
+
+#include <vmath.h>
+using vmath::mat4;
+
+#include "GpuMemory.h"
+
+// Apparently someone is still using segmented memory qualifiers,
+// and windows.h is letting them.
+#undef near
+#undef far
+
+#define CENTER_Z        12.0f    // Distance from camera
+#define DEPTH_OF_FIELD  8.0f
+
+#define WINDOW_WIDTH    640
+#define WINDOW_HEIGHT   480
+
+#define OBJECT_COUNT    32
+#define RING_RADIUS     4.0f
+
+// A level is LEVEL_TEXTURES textures of LEVEL_TEXTURE_SIZE squared, RGBA8
+// with full mipmaps:  about 21 MB.
+// Exercise:  Try GL_COMPRESSED_RGBA_S3TC_DXT1_EXT for the level textures
+// (uploading with glCompressedTexSubImage2D) and see how many more fit.
+#define LEVEL_TEXTURES      16
+#define LEVEL_TEXTURE_SIZE  512
+#define LEVEL_TEXTURE_LEVELS 10
+
+#define GPU_BUDGET_BYTES    (64 * 1024 * 1024)
+
+typedef struct {
+    GLsizei count;
+    GLuint vaoId;
+} ShapeInfo;
+
+typedef struct {
+    int number;
+    char owner[32];
+    GLuint textures[LEVEL_TEXTURES];
+} LevelInfo;
+
+ShapeInfo g_Pyramid;
+GLuint g_PyramidBuffer, g_SmileyTexture;
+GLuint g_SceneFbo, g_SceneColor, g_SceneDepth;
+std::deque<LevelInfo> g_Levels;
+int g_NextLevel = 1;
+GpuBudgetPolicy g_BudgetPolicy = GPU_BUDGET_WARN;
+mat4 g_ProjectionMatrix(mat4::identity());
+
+// Must match hard-coded vPosition location in vertShaderSource
+#define V_POSITION 0
+
+// Must match hard-coded location in vertShaderSource
+#define C_POSITION 1
+
+// Must match hard-coded vTexture location in vertShaderSource
+#define T_POSITION 2
+
+// Must match hard-coded ModelViewProject location in vertShaderSource
+#define MATRIX_LOCATION 0
+
+void setupShaders()
+{
+    GLchar infoLog[4096];
+    GLsizei length;
+
+    const GLchar *vertShaderSource[] = {
+        "#version 430 core\n"
+        "layout(location = 0) uniform mat4 ModelViewProject;\n"
+        "layout(location = 0) in vec4 vPosition;\n"
+        "layout(location = 1) in vec3 vColor;\n"
+        "layout(location = 2) in vec2 vTexture;\n"
+        "out vec3 color;\n"
+        "out vec2 vs_tex_coord;\n"
+        "void main() {\n"
+        "    gl_Position = ModelViewProject * vPosition;\n"
+        "    vs_tex_coord = vTexture;\n"
+        "    color = vColor;\n"
+        "}\n"
+    };
+    GLuint vertShader = glCreateShader(GL_VERTEX_SHADER);
+    glShaderSource(vertShader, 1, vertShaderSource, NULL);
+
+    const GLchar *fragShaderSource[] = {
+        "#version 430 core\n"
+        "layout(binding = 0) uniform sampler2D tex;\n"
+        "in vec3 color;\n"
+        "in vec2 vs_tex_coord;\n"
+        "out vec4 fColor;\n"
+        "void main() {\n"
+        "    vec4 texColor = texture(tex, vs_tex_coord);\n"
+        "    fColor = vec4(color, 0) * (1 - texColor.a) + texColor;\n"
+        "}\n"
+    };
+    GLuint fragShader = glCreateShader(GL_FRAGMENT_SHADER);
+    glShaderSource(fragShader, 1, fragShaderSource, NULL);
+
+    GLuint program = glCreateProgram();
+    glAttachShader(program, vertShader);
+    glCompileShader(vertShader);
+    glGetShaderInfoLog(vertShader, 4096, &length, infoLog);
+
+    glAttachShader(program, fragShader);
+    glCompileShader(fragShader);
+    glGetShaderInfoLog(fragShader, 4096, &length, infoLog);
+
+    glLinkProgram(program);
+    glUseProgram(program);
+}
+
+// Convert a simple bitmap (one bit per pixel) into an RGBA bitmap (four bytes per pixel)
+GLubyte* BuildMonochromeBitmap(const GLubyte* bits, int width, int height, GLubyte red, GLubyte green, GLubyte blue)
+{
+    GLubyte* retval = (GLubyte *)malloc(width * height * 4);
+    if (retval) {
+        GLubyte* ptr = retval;
+        for (int y = 0; y < height; y++) {
+            for (int x = 0; x < width/8; x++) {
+                GLubyte next8 = *bits++;
+                for (int mask = 128; mask > 0; mask >>= 1) {
+                    if (next8 & mask) {
+                        *ptr++ = red;
+                        *ptr++ = green;
+                        *ptr++ = blue;
+                        *ptr++ = 255;
+                    }
+                    else {
+                        *ptr++ = 0;
+                        *ptr++ = 0;
+                        *ptr++ = 0;
+                        *ptr++ = 0;
+                    }
+                }
+            }
+        }
+    }
+    return retval;
+}
+
+#define BITMAP_WIDTH 16
+#define BITMAP_HEIGHT 16
+#define BIT_BYTES ((BITMAP_WIDTH / 8) * BITMAP_HEIGHT)
+
+void setupTextures()
+{
+    // smiley face
+    GLubyte bits[BIT_BYTES] = {
+        0x00, 0x00,
+        0x00, 0x00,
+        0x07, 0xE0,
+        0x08, 0x10,
+        0x10, 0x08,
+        0x20, 0x04,
+        0x44, 0x22,
+        0x40, 0x02,
+        0x40, 0x02,
+        0x40, 0x02,
+        0x42, 0x42,
+        0x23, 0xc4,
+        0x10, 0x08,
+        0x0c, 0x30,
+        0x03, 0xc0,
+        0x00, 0x00,
+    };
+
+    GLubyte* data = BuildMonochromeBitmap(bits, BITMAP_WIDTH, BITMAP_HEIGHT, 255, 0, 0);
+    if (!data) {
+        return;
+    }
+    g_SmileyTexture = gpuMemCreateTexture("smiley", GL_TEXTURE_2D, 1, GL_RGBA8, BITMAP_WIDTH, BITMAP_HEIGHT);
+    glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, BITMAP_WIDTH, BITMAP_HEIGHT, GL_RGBA, GL_UNSIGNED_BYTE, data);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    free(data);
+}
+
+void setupPyramid(ShapeInfo *pInfo)
+{
+    typedef struct {
+        GLfloat x, y, z;
+        GLubyte red, green, blue;
+        GLfloat texU, texV;
+    } VertexInfo;
+
+    static const VertexInfo pyramidData[] = {
+        // Bottom
+        { 0.0f, 0.f, .5f, 255, 0, 0, 0.f, 0.f},
+        { 0.433f, 0.f, -.25f, 255, 0, 0, 0.f, 1.f},
+        { -0.433f, 0.f, -.25f, 255, 0, 0, 1.f, 1.f},
+        // Side 1
+        { -0.433f, 0.f, -.25f, 0, 0, 255, 0.f, 0.f},
+        { 0.433f, 0.f, -.25f, 0, 255, 255, 1.f, 0.f},
+        { 0.0f, 0.75f, 0.f, 255, 0, 255, 1.f, 1.f},
+        // Side 2
+        { -0.433f, 0.f, -.25f, 255, 255, 0, 0.f, 0.f},
+        { 0.0f, 0.f, .5f, 255, 255, 0, 0.f, 1.f},
+        { 0.0f, 0.75f, 0.f, 255, 255, 0, 1.f, 1.f},
+        // Side 3
+        { 0.0f, 0.f, .5f, 0, 255, 0, 4.f, 4.f},
+        { 0.0f, 0.75f, 0.f, 0, 255, 0, 2.f, 0.f},
+        { 0.433f, 0.f, -.25f, 0, 255, 0, 0.f, 4.f},
+    };
+
+    glGenVertexArrays(1, &pInfo->vaoId);
+    glBindVertexArray(pInfo->vaoId);
+    g_PyramidBuffer = gpuMemCreateBuffer("pyramid", GL_ARRAY_BUFFER, sizeof(pyramidData), pyramidData, GL_STATIC_DRAW);
+
+    glVertexAttribPointer(V_POSITION, 3, GL_FLOAT, GL_FALSE, sizeof(VertexInfo), (GLvoid*)offsetof(VertexInfo, x));
+    glEnableVertexAttribArray(V_POSITION);
+    glVertexAttribPointer(C_POSITION, 3, GL_UNSIGNED_BYTE, GL_TRUE, sizeof(VertexInfo), (GLvoid*)offsetof(VertexInfo, red));
+    glEnableVertexAttribArray(C_POSITION);
+    glVertexAttribPointer(T_POSITION, 2, GL_FLOAT, GL_FALSE, sizeof(VertexInfo), (GLvoid*)offsetof(VertexInfo, texU));
+    glEnableVertexAttribArray(T_POSITION);
+
+    pInfo->count = 12;
+}
+
+void setupSceneTarget()
+{
+    g_SceneColor = gpuMemCreateTexture("scene target", GL_TEXTURE_2D, 1, GL_RGBA8, WINDOW_WIDTH, WINDOW_HEIGHT);
+    g_SceneDepth = gpuMemCreateRenderbuffer("scene target", GL_DEPTH24_STENCIL8, WINDOW_WIDTH, WINDOW_HEIGHT);
+
+    glGenFramebuffers(1, &g_SceneFbo);
+    glBindFramebuffer(GL_FRAMEBUFFER, g_SceneFbo);
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, g_SceneColor, 0);
+    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_STENCIL_ATTACHMENT, GL_RENDERBUFFER, g_SceneDepth);
+    if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE) {
+        printf("Scene framebuffer is incomplete\n");
+    }
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+}
+
+void setupFrustum(float left, float right, float bottom, float top, float zNear, float zFar)
+{
+    g_ProjectionMatrix = vmath::frustum(left, right, bottom, top, zNear, zFar);
+}
+
+void deleteLevel(LevelInfo *pLevel)
+{
+    for (int i = 0; i < LEVEL_TEXTURES; i++) {
+        if (pLevel->textures[i]) {
+            gpuMemDelete(GPU_RESOURCE_TEXTURE, pLevel->textures[i]);
+        }
+    }
+}
+
+void loadLevel()
+{
+    LevelInfo level = { g_NextLevel++ };
+    sprintf(level.owner, "level %d", level.number);
+
+    GLubyte *pPixels = (GLubyte *)malloc(LEVEL_TEXTURE_SIZE * LEVEL_TEXTURE_SIZE * 4);
+    if (!pPixels) {
+        return;
+    }
+    for (int i = 0; i < LEVEL_TEXTURES; i++) {
+        level.textures[i] = gpuMemCreateTexture(level.owner, GL_TEXTURE_2D, LEVEL_TEXTURE_LEVELS, GL_RGBA8,
+            LEVEL_TEXTURE_SIZE, LEVEL_TEXTURE_SIZE);
+        if (!level.textures[i]) {
+            // Refused by the budget.  Half a level is no use.
+            printf("Couldn't load %s\n", level.owner);
+            deleteLevel(&level);
+            free(pPixels);
+            return;
+        }
+
+        // Stripes over the vertex colors, tinted differently for each level
+        // and texture
+        GLubyte red = GLubyte(level.number * 97), green = GLubyte(i * 16), blue = GLubyte(255 - level.number * 53);
+        GLubyte *pPixel = pPixels;
+        for (int y = 0; y < LEVEL_TEXTURE_SIZE; y++) {
+            for (int x = 0; x < LEVEL_TEXTURE_SIZE; x++) {
+                bool stripe = ((x + y) / (LEVEL_TEXTURE_SIZE / 8)) % 2 == 0;
+                *pPixel++ = red;
+                *pPixel++ = green;
+                *pPixel++ = blue;
+                *pPixel++ = stripe ? 192 : 0;
+            }
+        }
+        glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, LEVEL_TEXTURE_SIZE, LEVEL_TEXTURE_SIZE, GL_RGBA, GL_UNSIGNED_BYTE, pPixels);
+        glGenerateMipmap(GL_TEXTURE_2D);
+    }
+    free(pPixels);
+    g_Levels.push_back(level);
+    printf("Loaded %s\n", level.owner);
+}
+
+void unloadLevel()
+{
+    if (g_Levels.empty()) {
+        return;
+    }
+    printf("Unloaded %s\n", g_Levels.front().owner);
+    deleteLevel(&g_Levels.front());
+    g_Levels.pop_front();
+}
+
+double timeMs()
+{
+    static LARGE_INTEGER frequency = { 0 };
+    if (frequency.QuadPart == 0) {
+        QueryPerformanceFrequency(&frequency);
+    }
+    LARGE_INTEGER now;
+    QueryPerformanceCounter(&now);
+    return 1000. * double(now.QuadPart) / double(frequency.QuadPart);
+}
+
+void drawTrianglesAt(float x, float y, float z, float rotyDegrees, float scale, ShapeInfo *pInfo)
+{
+    mat4 modelViewMatrix(vmath::translate(x, y, z - CENTER_Z));
+    modelViewMatrix *= vmath::rotate(rotyDegrees, 0.f, 1.f, 0.f);
+    modelViewMatrix *= vmath::scale(scale, scale, scale);
+
+    glUniformMatrix4fv(MATRIX_LOCATION, 1, GL_FALSE, g_ProjectionMatrix * modelViewMatrix);
+    glBindVertexArray(pInfo->vaoId);
+    glDrawArrays(GL_TRIANGLES, 0, pInfo->count);
+}
+
+void onDisplay()
+{
+    static double startTime = timeMs();
+    static double lastReport = startTime;
+
+    float time = float((timeMs() - startTime) / 1000.);
+    glBindFramebuffer(GL_FRAMEBUFFER, g_SceneFbo);
+    glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+    for (int n = 0; n < OBJECT_COUNT; n++) {
+        // The newest level's textures, or the smiley if none is loaded
+        glBindTexture(GL_TEXTURE_2D, g_Levels.empty() ? g_SmileyTexture : g_Levels.back().textures[n % LEVEL_TEXTURES]);
+        float angle = time / 4.f + 2 * float(M_PI) * n / OBJECT_COUNT;
+        drawTrianglesAt(RING_RADIUS * cosf(angle), RING_RADIUS * sinf(angle), 0.f,
+            time * 90.f + n * 10.f, 1.2f, &g_Pyramid);
+    }
+
+    glBindFramebuffer(GL_READ_FRAMEBUFFER, g_SceneFbo);
+    glBindFramebuffer(GL_DRAW_FRAMEBUFFER, 0);
+    glBlitFramebuffer(0, 0, WINDOW_WIDTH, WINDOW_HEIGHT, 0, 0, WINDOW_WIDTH, WINDOW_HEIGHT,
+        GL_COLOR_BUFFER_BIT, GL_NEAREST);
+    glutSwapBuffers();
+
+    double now = timeMs();
+    if (now - lastReport >= 2000) {
+        GpuMemStats stats;
+        gpuMemStats(&stats);
+        printf("GPU memory:  %.2f MB (buffers %.2f, textures %.2f, renderbuffers %.2f), peak %.2f, budget %.2f, %d level%s loaded\n",
+            stats.totalBytes / 1048576., stats.liveBytes[GPU_RESOURCE_BUFFER] / 1048576.,
+            stats.liveBytes[GPU_RESOURCE_TEXTURE] / 1048576., stats.liveBytes[GPU_RESOURCE_RENDERBUFFER] / 1048576.,
+            stats.peakBytes / 1048576., stats.budgetBytes / 1048576.,
+            int(g_Levels.size()), g_Levels.size() == 1 ? "" : "s");
+        lastReport = now;
+    }
+}
+
+void onKey(unsigned char key, int x, int y)
+{
+    switch (key) {
+    case 'l':
+    case 'L':
+        loadLevel();
+        return;
+    case 'u':
+    case 'U':
+        unloadLevel();
+        return;
+    case 'd':
+    case 'D':
+        gpuMemDump();
+        return;
+    case 'b':
+    case 'B':
+        g_BudgetPolicy = g_BudgetPolicy == GPU_BUDGET_WARN ? GPU_BUDGET_REFUSE : GPU_BUDGET_WARN;
+        gpuMemSetBudget(GPU_BUDGET_BYTES, g_BudgetPolicy);
+        printf("Going over budget now %s\n", g_BudgetPolicy == GPU_BUDGET_WARN ? "warns" : "is refused");
+        return;
+    }
+
+    // Everything is given back, so the last dump should be empty
+    while (!g_Levels.empty()) {
+        unloadLevel();
+    }
+    gpuMemDelete(GPU_RESOURCE_TEXTURE, g_SmileyTexture);
+    gpuMemDelete(GPU_RESOURCE_BUFFER, g_PyramidBuffer);
+    gpuMemDelete(GPU_RESOURCE_TEXTURE, g_SceneColor);
+    gpuMemDelete(GPU_RESOURCE_RENDERBUFFER, g_SceneDepth);
+    gpuMemDump();
+    exit(0);
+}
+
+int main(int argc, char *argv[])
+{
+    glutInit(&argc, argv);
+    glutInitDisplayMode(GLUT_RGBA | GLUT_DOUBLE | GLUT_DEPTH);
+    glutInitWindowSize(WINDOW_WIDTH, WINDOW_HEIGHT);
+    glutCreateWindow(argv[0]);
+
+    glewInit();
+    wglSwapIntervalEXT(1);	// vsync
+
+    gpuMemSetBudget(GPU_BUDGET_BYTES, g_BudgetPolicy);
+
+    glEnable(GL_DEPTH_TEST);
+
+    GLfloat ratio = float(WINDOW_WIDTH) / float(WINDOW_HEIGHT);
+    GLfloat zNear = CENTER_Z - DEPTH_OF_FIELD/2;
+    GLfloat top = zNear * .5f;
+    setupFrustum(-ratio * top, ratio * top, -top, top, zNear, CENTER_Z + DEPTH_OF_FIELD/2);
+
+    setupShaders();
+    setupPyramid(&g_Pyramid);
+    setupTextures();
+    setupSceneTarget();
+    gpuMemDump();
+
+    glutDisplayFunc(onDisplay);
+    glutIdleFunc(onDisplay);
+    glutKeyboardFunc(onKey);
+    glutMainLoop();
+
+    return 0;
+}
@@ -0,0 +1,254 @@
+/*
+ * KHR_debug capture, classing and deduplication.  See DebugOutput.h.
+ */
+#include "DebugOutput.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <algorithm>
+#include <map>
+#include <mutex>
+#include <string>
+#include <vector>
+
+// Longest object label looked up for a shader log
+#define MAX_LABEL   256
+
+typedef struct {
+    GLenum source, type, severity;
+    GLuint id;
+    DebugClass debugClass;
+    std::string text;           // As first seen
+    long long count;
+    int firstFrame;
+} DebugMessage;
+
+static const char *g_ClassNames[DEBUG_CLASSES] = {
+    "error", "performance", "undefined", "portability", "shader", "other"
+};
+
+// Asynchronous output can call back on a driver thread, so everything
+// below is guarded
+static std::mutex g_Mutex;
+static std::vector<DebugMessage> g_Messages;
+static std::map<unsigned long long, size_t> g_Index;
+static DebugStats g_Stats;
+static bool g_HaveDebug;
+
+const char *debugClassName(DebugClass debugClass)
+{
+    return g_ClassNames[debugClass];
+}
+
+static const char *sourceName(GLenum source)
+{
+    switch (source) {
+    case GL_DEBUG_SOURCE_API:               return "API";
+    case GL_DEBUG_SOURCE_WINDOW_SYSTEM:     return "window system";
+    case GL_DEBUG_SOURCE_SHADER_COMPILER:   return "shader compiler";
+    case GL_DEBUG_SOURCE_THIRD_PARTY:       return "third party";
+    case GL_DEBUG_SOURCE_APPLICATION:       return "application";
+    default:                                return "other";
+    }
+}
+
+static DebugClass classify(GLenum source, GLenum type)
+{
+    if (source == GL_DEBUG_SOURCE_SHADER_COMPILER) {
+        return DEBUG_CLASS_SHADER;
+    }
+    switch (type) {
+    case GL_DEBUG_TYPE_ERROR:               return DEBUG_CLASS_ERROR;
+    case GL_DEBUG_TYPE_PERFORMANCE:         return DEBUG_CLASS_PERFORMANCE;
+    case GL_DEBUG_TYPE_DEPRECATED_BEHAVIOR:
+    case GL_DEBUG_TYPE_UNDEFINED_BEHAVIOR:  return DEBUG_CLASS_UNDEFINED;
+    case GL_DEBUG_TYPE_PORTABILITY:         return DEBUG_CLASS_PORTABILITY;
+    default:                                return DEBUG_CLASS_OTHER;
+    }
+}
+
+// FNV-1a over the text with every run of digits taken as one '#', so
+// "buffer 3" and "buffer 12" hash the same
+static unsigned long long messageKey(GLenum source, GLenum type, GLuint id, const char *pText)
+{
+    unsigned long long hash = 14695981039346656037ULL;
+    unsigned int header[3] = { source, type, id };
+    for (size_t i = 0; i < sizeof(header); i++) {
+        hash = (hash ^ ((const unsigned char *)header)[i]) * 1099511628211ULL;
+    }
+    bool inNumber = false;
+    for (const char *p = pText; *p; p++) {
+        bool digit = *p >= '0' && *p <= '9';
+        if (digit && inNumber) {
+            continue;
+        }
+        inNumber = digit;
+        hash = (hash ^ (unsigned char)(digit ? '#' : *p)) * 1099511628211ULL;
+    }
+    return hash;
+}
+
+static void deliver(GLenum source, GLenum type, GLuint id, GLenum severity, const char *pText)
+{
+    DebugClass debugClass = classify(source, type);
+    unsigned long long key = messageKey(source, type, id, pText);
+
+    std::lock_guard<std::mutex> lock(g_Mutex);
+    std::map<unsigned long long, size_t>::iterator it = g_Index.find(key);
+    if (it == g_Index.end()) {
+        DebugMessage message = { source, type, severity, id, debugClass, pText, 0, g_Stats.frames };
+        it = g_Index.insert(std::make_pair(key, g_Messages.size())).first;
+        g_Messages.push_back(message);
+        g_Stats.unique++;
+        printf("GL %s (%s, id %u) in frame %d:  %s\n", g_ClassNames[debugClass], sourceName(source), id,
+            g_Stats.frames, pText);
+    }
+    g_Messages[it->second].count++;
+    g_Stats.thisFrame[debugClass]++;
+    g_Stats.total[debugClass]++;
+}
+
+static void GLAPIENTRY onDebugMessage(GLenum source, GLenum type, GLuint id, GLenum severity, GLsizei length,
+    const GLchar *message, const void *userParam)
+{
+    // Our own markers, not news
+    if (type == GL_DEBUG_TYPE_PUSH_GROUP || type == GL_DEBUG_TYPE_POP_GROUP) {
+        return;
+    }
+    deliver(source, type, id, severity, message);
+}
+
+bool debugOutputInit(bool synchronous)
+{
+    g_HaveDebug = GLEW_KHR_debug != 0;
+    if (!g_HaveDebug) {
+        printf("No KHR_debug; only shader logs will be reported\n");
+        return false;
+    }
+    GLint flags = 0;
+    glGetIntegerv(GL_CONTEXT_FLAGS, &flags);
+    if (!(flags & GL_CONTEXT_FLAG_DEBUG_BIT)) {
+        printf("Not a debug context; the driver may not say much\n");
+    }
+
+    // Low-severity messages are off by default, and that is where many
+    // drivers put their performance warnings
+    glDebugMessageControl(GL_DONT_CARE, GL_DONT_CARE, GL_DONT_CARE, 0, NULL, GL_TRUE);
+    // GLEW versions disagree about whether userParam is const
+    glDebugMessageCallback((GLDEBUGPROC)onDebugMessage, NULL);
+    glEnable(GL_DEBUG_OUTPUT);
+    if (synchronous) {
+        glEnable(GL_DEBUG_OUTPUT_SYNCHRONOUS);
+    }
+    else {
+        glDisable(GL_DEBUG_OUTPUT_SYNCHRONOUS);
+    }
+    return true;
+}
+
+void debugOutputLabel(GLenum identifier, GLuint name, const char *pLabel)
+{
+    if (g_HaveDebug) {
+        glObjectLabel(identifier, name, -1, pLabel);
+    }
+}
+
+static void objectName(GLenum identifier, GLuint name, char *pName)
+{
+    GLsizei length = 0;
+    if (g_HaveDebug) {
+        glGetObjectLabel(identifier, name, MAX_LABEL, &length, pName);
+    }
+    if (length == 0) {
+        sprintf(pName, "%s %u", identifier == GL_SHADER ? "shader" : "program", name);
+    }
+}
+
+// Sends a compile or link log down the channel.  An empty log says nothing.
+static void reportLog(GLenum identifier, GLuint name, bool succeeded, const std::vector<GLchar> &log)
+{
+    if (log.size() <= 1 || log[0] == '\0') {
+        return;
+    }
+    char label[MAX_LABEL];
+    objectName(identifier, name, label);
+    std::string text = std::string(label) + (identifier == GL_SHADER ? " compile " : " link ") +
+        (succeeded ? "warnings" : "failed") + ":\n" + &log[0];
+    while (!text.empty() && (text[text.size() - 1] == '\n' || text[text.size() - 1] == '\r')) {
+        text.erase(text.size() - 1);
+    }
+    deliver(GL_DEBUG_SOURCE_SHADER_COMPILER, succeeded ? GL_DEBUG_TYPE_OTHER : GL_DEBUG_TYPE_ERROR, 0,
+        succeeded ? GL_DEBUG_SEVERITY_LOW : GL_DEBUG_SEVERITY_HIGH, text.c_str());
+}
+
+bool debugCompileShader(GLuint shader)
+{
+    glCompileShader(shader);
+    GLint status = GL_FALSE, length = 0;
+    glGetShaderiv(shader, GL_COMPILE_STATUS, &status);
+    glGetShaderiv(shader, GL_INFO_LOG_LENGTH, &length);
+    std::vector<GLchar> log(length > 0 ? length : 1, '\0');
+    if (length > 0) {
+        glGetShaderInfoLog(shader, length, NULL, &log[0]);
+    }
+    reportLog(GL_SHADER, shader, status == GL_TRUE, log);
+    return status == GL_TRUE;
+}
+
+bool debugLinkProgram(GLuint program)
+{
+    glLinkProgram(program);
+    GLint status = GL_FALSE, length = 0;
+    glGetProgramiv(program, GL_LINK_STATUS, &status);
+    glGetProgramiv(program, GL_INFO_LOG_LENGTH, &length);
+    std::vector<GLchar> log(length > 0 ? length : 1, '\0');
+    if (length > 0) {
+        glGetProgramInfoLog(program, length, NULL, &log[0]);
+    }
+    reportLog(GL_PROGRAM, program, status == GL_TRUE, log);
+    return status == GL_TRUE;
+}
+
+void debugOutputEndFrame()
+{
+    std::lock_guard<std::mutex> lock(g_Mutex);
+    if (g_Stats.thisFrame[DEBUG_CLASS_PERFORMANCE] > 0) {
+        g_Stats.framesWithPerformance++;
+    }
+    memcpy(g_Stats.lastFrame, g_Stats.thisFrame, sizeof(g_Stats.lastFrame));
+    memset(g_Stats.thisFrame, 0, sizeof(g_Stats.thisFrame));
+    g_Stats.frames++;
+}
+
+void debugOutputStats(DebugStats *pStats)
+{
+    std::lock_guard<std::mutex> lock(g_Mutex);
+    *pStats = g_Stats;
+}
+
+static bool mostFrequentFirst(const DebugMessage *pA, const DebugMessage *pB)
+{
+    return pA->count > pB->count;
+}
+
+void debugOutputReport()
+{
+    std::lock_guard<std::mutex> lock(g_Mutex);
+    std::vector<const DebugMessage *> messages;
+    for (size_t i = 0; i < g_Messages.size(); i++) {
+        messages.push_back(&g_Messages[i]);
+    }
+    std::sort(messages.begin(), messages.end(), mostFrequentFirst);
+
+    printf("%u distinct GL messages over %d frames:\n", unsigned(messages.size()), g_Stats.frames);
+    printf("    %10s  %-12s %-16s %8s  %s\n", "Count", "Class", "Source", "From", "First line");
+    for (size_t i = 0; i < messages.size(); i++) {
+        const DebugMessage *pMessage = messages[i];
+        std::string firstLine = pMessage->text.substr(0, pMessage->text.find('\n'));
+        if (firstLine.size() > 100) {
+            firstLine = firstLine.substr(0, 97) + "...";
+        }
+        printf("    %10lld  %-12s %-16s %8d  %s\n", pMessage->count, g_ClassNames[pMessage->debugClass],
+            sourceName(pMessage->source), pMessage->firstFrame, firstLine.c_str());
+    }
+}
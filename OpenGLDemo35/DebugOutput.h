@@ -0,0 +1,66 @@
+/*
+ * One channel for everything the driver has to say.
+ *
+ * debugOutputInit installs a KHR_debug callback.  Each message is put in a
+ * class (error, performance, and so on) and deduplicated:  messages with
+ * the same source, type and id whose text differs only in its numbers,
+ * such as buffer names or sizes, count as one.  The first of each is
+ * printed as it arrives; the rest are only counted, per frame and in
+ * total, and debugOutputReport lists them all with their counts.
+ *
+ * Shader compile and program link logs go through the same channel, named
+ * by the labels given with debugOutputLabel, so a warning from a
+ * successful compile is seen instead of being thrown away.
+ *
+ * Drivers say far more in a debug context; see glutInitContextFlags.
+ */
+#ifndef DEBUG_OUTPUT_H
+#define DEBUG_OUTPUT_H
+
+#include <GL/glew.h>
+
+typedef enum {
+    DEBUG_CLASS_ERROR,
+    DEBUG_CLASS_PERFORMANCE,
+    DEBUG_CLASS_UNDEFINED,      // Undefined or deprecated behavior
+    DEBUG_CLASS_PORTABILITY,
+    DEBUG_CLASS_SHADER,         // Compile and link logs
+    DEBUG_CLASS_OTHER,
+    DEBUG_CLASSES
+} DebugClass;
+
+typedef struct {
+    int thisFrame[DEBUG_CLASSES];
+    int lastFrame[DEBUG_CLASSES];
+    long long total[DEBUG_CLASSES];
+    int unique;                 // Distinct messages seen
+    int frames;                 // Frames ended
+    int framesWithPerformance;  // ... that had a performance message
+} DebugStats;
+
+// Call after glewInit.  Returns false if the context has no KHR_debug, in
+// which case only shader logs are reported.  Synchronous output calls back
+// inside the GL call that caused the message, which is slower but puts
+// the offending call on the debugger's stack.
+bool debugOutputInit(bool synchronous);
+
+// glObjectLabel, if it is available.  'identifier' is GL_BUFFER,
+// GL_SHADER, GL_PROGRAM, GL_TEXTURE and so on.
+void debugOutputLabel(GLenum identifier, GLuint name, const char *pLabel);
+
+// Compile or link, and report the log if there is one.  Return whether it
+// succeeded.
+bool debugCompileShader(GLuint shader);
+bool debugLinkProgram(GLuint program);
+
+// Call once a frame, after swapping
+void debugOutputEndFrame();
+
+void debugOutputStats(DebugStats *pStats);
+
+// Every distinct message so far, most frequent first
+void debugOutputReport();
+
+const char *debugClassName(DebugClass debugClass);
+
+#endif
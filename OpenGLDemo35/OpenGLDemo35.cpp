@@ -0,0 +1,339 @@
+/*
+ * Demo 35:
+ * Listening to the driver.  The window asks for a debug context, and
+ * DebugOutput.h collects everything the driver reports, with shader and
+ * program logs on the same channel.  Messages are classed and
+ * deduplicated, so a warning that fires every frame is printed once and
+ * then counted.
+ *
+ * The demo starts out careless on purpose:  a ring of pyramids takes its
+ * tints from a uniform buffer made GL_STATIC_DRAW but rewritten every
+ * frame, and the center pixel is read back into client memory every frame,
+ * which waits for the GPU.  Drivers that report performance problems
+ * complain about both.  Press C to switch to the careful way (an orphaned
+ * GL_STREAM_DRAW buffer, and readback through two pixel buffers a frame
+ * apart) and watch the complaints stop.
+ *
+ * Press R for every distinct message so far; any other key exits.
+ *
+ * See README.txt for prerequisites.
+ */
+#include <windows.h>
+#include <WinGDI.h>
+
+#include <GL/glew.h>
+#include <GL/wglew.h>
+#include <GL/GL.h>
+#include <GL/glut.h>
+#include <GL/freeglut_ext.h>
+
+#include <stdio.h>
+#include <stddef.h>
+
+#include <vmath.h>
+using vmath::mat4;
+
+#include "DebugOutput.h"
+
+// Apparently someone is still using segmented memory qualifiers,
+// and windows.h is letting them.
+#undef near
+#undef far
+
+#define CENTER_Z        12.0f    // Distance from camera
+#define DEPTH_OF_FIELD  8.0f
+
+#define WINDOW_WIDTH    640
+#define WINDOW_HEIGHT   480
+
+// Must match the tints array size in vertShaderSource
+#define OBJECT_COUNT    32
+#define RING_RADIUS     4.0f
+
+// Comment out for an ordinary context, and see how much less is said
+#define DEBUG_CONTEXT
+
+// Synchronous output is slower, but a breakpoint in the callback then
+// stops inside the call that caused the message
+#define SYNCHRONOUS_OUTPUT  true
+
+typedef struct {
+    GLsizei count;
+    GLuint vaoId;
+} ShapeInfo;
+
+ShapeInfo g_Pyramid;
+GLuint g_TintBuffer;
+GLuint g_ReadBuffers[2];
+bool g_Careful = false;
+mat4 g_ProjectionMatrix(mat4::identity());
+
+// Must match hard-coded vPosition location in vertShaderSource
+#define V_POSITION 0
+
+// Must match hard-coded location in vertShaderSource
+#define C_POSITION 1
+
+// Must match hard-coded ViewProject and Time locations in vertShaderSource
+#define MATRIX_LOCATION 0
+#define TIME_LOCATION   1
+
+// Must match hard-coded Tints binding in vertShaderSource
+#define TINT_BINDING    0
+
+void setupShaders()
+{
+    const GLchar *vertShaderSource[] = {
+        "#version 430 core\n"
+        "layout(location = 0) uniform mat4 ViewProject;\n"
+        "layout(location = 1) uniform float Time;\n"
+        "layout(std140, binding = 0) uniform Tints {\n"
+        "    vec4 tints[32];\n"
+        "};\n"
+        "layout(location = 0) in vec4 vPosition;\n"
+        "layout(location = 1) in vec3 vColor;\n"
+        "out vec3 color;\n"
+        "void main() {\n"
+        "    float angle = Time / 4.0 + 6.2831853 * gl_InstanceID / 32.0;\n"
+        "    float spin = radians(Time * 90.0 + gl_InstanceID * 10.0);\n"
+        "    vec3 p = vec3(cos(spin) * vPosition.x + sin(spin) * vPosition.z, vPosition.y,\n"
+        "        -sin(spin) * vPosition.x + cos(spin) * vPosition.z) * 1.2;\n"
+        "    p += vec3(4.0 * cos(angle), 4.0 * sin(angle), -12.0);\n"
+        "    gl_Position = ViewProject * vec4(p, 1.0);\n"
+        "    color = mix(vColor, tints[gl_InstanceID].rgb, tints[gl_InstanceID].a);\n"
+        "}\n"
+    };
+    GLuint vertShader = glCreateShader(GL_VERTEX_SHADER);
+    glShaderSource(vertShader, 1, vertShaderSource, NULL);
+    debugOutputLabel(GL_SHADER, vertShader, "ring vertex shader");
+
+    // Exercise:  Break a line here and see the compile log arrive as a
+    // shader message, named by its label
+    const GLchar *fragShaderSource[] = {
+        "#version 430 core\n"
+        "in vec3 color;\n"
+        "out vec4 fColor;\n"
+        "void main() {\n"
+        "    fColor = vec4(color, 1.0);\n"
+        "}\n"
+    };
+    GLuint fragShader = glCreateShader(GL_FRAGMENT_SHADER);
+    glShaderSource(fragShader, 1, fragShaderSource, NULL);
+    debugOutputLabel(GL_SHADER, fragShader, "ring fragment shader");
+
+    GLuint program = glCreateProgram();
+    debugOutputLabel(GL_PROGRAM, program, "ring program");
+    glAttachShader(program, vertShader);
+    debugCompileShader(vertShader);
+    glAttachShader(program, fragShader);
+    debugCompileShader(fragShader);
+    debugLinkProgram(program);
+    glUseProgram(program);
+}
+
+void setupPyramid(ShapeInfo *pInfo)
+{
+    typedef struct {
+        GLfloat x, y, z;
+        GLubyte red, green, blue;
+    } VertexInfo;
+
+    static const VertexInfo pyramidData[] = {
+        // Bottom
+        { 0.0f, 0.f, .5f, 255, 0, 0},
+        { 0.433f, 0.f, -.25f, 255, 0, 0},
+        { -0.433f, 0.f, -.25f, 255, 0, 0},
+        // Side 1
+        { -0.433f, 0.f, -.25f, 0, 0, 255},
+        { 0.433f, 0.f, -.25f, 0, 255, 255},
+        { 0.0f, 0.75f, 0.f, 255, 0, 255},
+        // Side 2
+        { -0.433f, 0.f, -.25f, 255, 255, 0},
+        { 0.0f, 0.f, .5f, 255, 255, 0},
+        { 0.0f, 0.75f, 0.f, 255, 255, 0},
+        // Side 3
+        { 0.0f, 0.f, .5f, 0, 255, 0},
+        { 0.0f, 0.75f, 0.f, 0, 255, 0},
+        { 0.433f, 0.f, -.25f, 0, 255, 0},
+    };
+
+    GLuint vboId;
+    glGenVertexArrays(1, &pInfo->vaoId);
+    glBindVertexArray(pInfo->vaoId);
+    debugOutputLabel(GL_VERTEX_ARRAY, pInfo->vaoId, "pyramid");
+    glGenBuffers(1, &vboId);
+    glBindBuffer(GL_ARRAY_BUFFER, vboId);
+    debugOutputLabel(GL_BUFFER, vboId, "pyramid vertices");
+    glBufferData(GL_ARRAY_BUFFER, sizeof(pyramidData), pyramidData, GL_STATIC_DRAW);
+
+    glVertexAttribPointer(V_POSITION, 3, GL_FLOAT, GL_FALSE, sizeof(VertexInfo), (GLvoid*)offsetof(VertexInfo, x));
+    glEnableVertexAttribArray(V_POSITION);
+    glVertexAttribPointer(C_POSITION, 3, GL_UNSIGNED_BYTE, GL_TRUE, sizeof(VertexInfo), (GLvoid*)offsetof(VertexInfo, red));
+    glEnableVertexAttribArray(C_POSITION);
+
+    pInfo->count = 12;
+}
+
+// Rebuilt whenever the mode changes, so each mode starts from its own
+// usage hint
+void setupBuffers()
+{
+    if (g_TintBuffer) {
+        glDeleteBuffers(1, &g_TintBuffer);
+        glDeleteBuffers(2, g_ReadBuffers);
+    }
+    glGenBuffers(1, &g_TintBuffer);
+    glBindBuffer(GL_UNIFORM_BUFFER, g_TintBuffer);
+    debugOutputLabel(GL_BUFFER, g_TintBuffer, "tints");
+    // The careless way:  the hint promises the contents never change
+    glBufferData(GL_UNIFORM_BUFFER, OBJECT_COUNT * 4 * sizeof(GLfloat), NULL,
+        g_Careful ? GL_STREAM_DRAW : GL_STATIC_DRAW);
+    glBindBufferBase(GL_UNIFORM_BUFFER, TINT_BINDING, g_TintBuffer);
+
+    glGenBuffers(2, g_ReadBuffers);
+    for (int i = 0; i < 2; i++) {
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, g_ReadBuffers[i]);
+        debugOutputLabel(GL_BUFFER, g_ReadBuffers[i], i == 0 ? "readback 0" : "readback 1");
+        glBufferData(GL_PIXEL_PACK_BUFFER, 4, NULL, GL_STREAM_READ);
+    }
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+}
+
+void setupFrustum(float left, float right, float bottom, float top, float zNear, float zFar)
+{
+    g_ProjectionMatrix = vmath::frustum(left, right, bottom, top, zNear, zFar);
+}
+
+double timeMs()
+{
+    static LARGE_INTEGER frequency = { 0 };
+    if (frequency.QuadPart == 0) {
+        QueryPerformanceFrequency(&frequency);
+    }
+    LARGE_INTEGER now;
+    QueryPerformanceCounter(&now);
+    return 1000. * double(now.QuadPart) / double(frequency.QuadPart);
+}
+
+void updateTints(float time)
+{
+    GLfloat tints[OBJECT_COUNT][4];
+    for (int n = 0; n < OBJECT_COUNT; n++) {
+        float phase = time * 2.f + n * .4f;
+        tints[n][0] = .5f + .5f * cosf(phase);
+        tints[n][1] = .5f + .5f * cosf(phase + 2.f);
+        tints[n][2] = .5f + .5f * cosf(phase + 4.f);
+        tints[n][3] = .5f;
+    }
+    glBindBuffer(GL_UNIFORM_BUFFER, g_TintBuffer);
+    if (g_Careful) {
+        // Orphan the storage the last frame may still be reading
+        glBufferData(GL_UNIFORM_BUFFER, sizeof(tints), NULL, GL_STREAM_DRAW);
+    }
+    glBufferSubData(GL_UNIFORM_BUFFER, 0, sizeof(tints), tints);
+}
+
+// The color under the center of the window.  Careful mode reads last
+// frame's, which is long finished, instead of waiting for this one.
+void readCenter(GLubyte pixel[4])
+{
+    static int frame = 0;
+    if (!g_Careful) {
+        glReadPixels(WINDOW_WIDTH / 2, WINDOW_HEIGHT / 2, 1, 1, GL_RGBA, GL_UNSIGNED_BYTE, pixel);
+        return;
+    }
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, g_ReadBuffers[frame % 2]);
+    glReadPixels(WINDOW_WIDTH / 2, WINDOW_HEIGHT / 2, 1, 1, GL_RGBA, GL_UNSIGNED_BYTE, 0);
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, g_ReadBuffers[(frame + 1) % 2]);
+    glGetBufferSubData(GL_PIXEL_PACK_BUFFER, 0, 4, pixel);
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+    frame++;
+}
+
+void onDisplay()
+{
+    static int frames = 0;
+    static double startTime = timeMs();
+    static double lastReport = startTime;
+    static double cpuTime = 0;
+
+    double start = timeMs();
+    float time = float((start - startTime) / 1000.);
+    updateTints(time);
+    glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+    glUniformMatrix4fv(MATRIX_LOCATION, 1, GL_FALSE, g_ProjectionMatrix);
+    glUniform1f(TIME_LOCATION, time);
+    glDrawArraysInstanced(GL_TRIANGLES, 0, g_Pyramid.count, OBJECT_COUNT);
+    GLubyte center[4];
+    readCenter(center);
+    cpuTime += timeMs() - start;
+    glutSwapBuffers();
+    debugOutputEndFrame();
+
+    frames++;
+    double now = timeMs();
+    if (now - lastReport >= 2000) {
+        DebugStats stats;
+        debugOutputStats(&stats);
+        printf("%s:  %.3f ms CPU per frame; last frame had %d performance and %d error messages; "
+            "%d of %d frames had performance messages\n",
+            g_Careful ? "Careful" : "Careless", cpuTime / frames,
+            stats.lastFrame[DEBUG_CLASS_PERFORMANCE], stats.lastFrame[DEBUG_CLASS_ERROR],
+            stats.framesWithPerformance, stats.frames);
+        frames = 0;
+        cpuTime = 0;
+        lastReport = now;
+    }
+}
+
+void onKey(unsigned char key, int x, int y)
+{
+    switch (key) {
+    case 'c':
+    case 'C':
+        g_Careful = !g_Careful;
+        setupBuffers();
+        return;
+    case 'r':
+    case 'R':
+        debugOutputReport();
+        return;
+    }
+    debugOutputReport();
+    exit(0);
+}
+
+int main(int argc, char *argv[])
+{
+    glutInit(&argc, argv);
+#ifdef DEBUG_CONTEXT
+    glutInitContextVersion(4, 3);
+    glutInitContextProfile(GLUT_COMPATIBILITY_PROFILE);
+    glutInitContextFlags(GLUT_DEBUG);
+#endif
+    glutInitDisplayMode(GLUT_RGBA | GLUT_DOUBLE | GLUT_DEPTH);
+    glutInitWindowSize(WINDOW_WIDTH, WINDOW_HEIGHT);
+    glutCreateWindow(argv[0]);
+
+    glewInit();
+    // As early as possible, so setup is covered too
+    debugOutputInit(SYNCHRONOUS_OUTPUT);
+    wglSwapIntervalEXT(1);	// vsync
+
+    glEnable(GL_DEPTH_TEST);
+
+    GLfloat ratio = float(WINDOW_WIDTH) / float(WINDOW_HEIGHT);
+    GLfloat zNear = CENTER_Z - DEPTH_OF_FIELD/2;
+    GLfloat top = zNear * .5f;
+    setupFrustum(-ratio * top, ratio * top, -top, top, zNear, CENTER_Z + DEPTH_OF_FIELD/2);
+
+    setupShaders();
+    setupPyramid(&g_Pyramid);
+    setupBuffers();
+    glutDisplayFunc(onDisplay);
+    glutIdleFunc(onDisplay);
+    glutKeyboardFunc(onKey);
+    glutMainLoop();
+
+    return 0;
+}
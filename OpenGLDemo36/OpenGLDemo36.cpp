@@ -0,0 +1,492 @@
+/*
+ * Demo 36:
+ * Loading a scene from a binary package that is used in place.  The
+ * meshes, textures, shaders and instance tables live in scene.pkg (see
+ * ScenePackage.h), which is memory-mapped; vertex, index, instance and
+ * texture data go from the mapping straight to the GL, and nothing is
+ * parsed.  The package is built from the arrays below the first time the
+ * demo runs, or whenever the one on disk is from another version.
+ *
+ * Press L to load the package again and see how long it takes; any other
+ * key exits.
+ *
+ * See README.txt for prerequisites.
+ */
+#include <windows.h>
+#include <WinGDI.h>
+
+#include <GL/glew.h>
+#include <GL/wglew.h>
+#include <GL/GL.h>
+#include <GL/glut.h>
+
+#include <stdio.h>
+#include <stddef.h>
+#include <string.h>
+#include <vector>
+
+#include <vmath.h>
+using vmath::mat4;
+
+#include "ScenePackage.h"
+
+// Apparently someone is still using segmented memory qualifiers,
+// and windows.h is letting them.
+#undef near
+#undef far
+
+#define CENTER_Z        60.0f    // Distance from camera
+#define DEPTH_OF_FIELD  40.0f
+
+#define PACKAGE_FILE    "scene.pkg"
+
+// Instances are laid out on a GRID_SIZE square, pyramids and cubes
+// alternating like a checkerboard
+#define GRID_SIZE       64
+#define GRID_SPACING    1.f
+
+#define CHECKER_SIZE    256
+#define CHECKER_LEVELS  9
+
+#define MAX_MESHES      8
+
+typedef struct {
+    GLfloat x, y, z;
+    GLubyte red, green, blue;
+    GLfloat texU, texV;
+} VertexInfo;
+
+typedef struct {
+    GLuint vaoId;
+    GLuint textureId;
+    GLsizei indexCount;
+    GLenum indexType;
+    GLsizei instanceCount;
+} MeshInfo;
+
+ScenePackage g_Package;
+MeshInfo g_Meshes[MAX_MESHES];
+int g_MeshCount;
+GLuint g_Program;
+std::vector<GLuint> g_Buffers;
+mat4 g_ProjectionMatrix(mat4::identity());
+
+// Must match hard-coded instance attribute locations in sceneVertSource
+#define PLACEMENT_POSITION  4
+#define SCALE_TINT_POSITION 5
+
+// Must match hard-coded ViewProject location in sceneVertSource
+#define MATRIX_LOCATION 0
+
+const GLchar *sceneVertSource =
+    "#version 430 core\n"
+    "layout(location = 0) uniform mat4 ViewProject;\n"
+    "layout(location = 0) in vec4 vPosition;\n"
+    "layout(location = 1) in vec3 vColor;\n"
+    "layout(location = 2) in vec2 vTexture;\n"
+    "layout(location = 4) in vec4 iPlacement;\n"      // x, y, z, rotation
+    "layout(location = 5) in vec4 iScaleTint;\n"      // scale, tint
+    "out vec3 color;\n"
+    "out vec2 vs_tex_coord;\n"
+    "void main() {\n"
+    "    float a = radians(iPlacement.w);\n"
+    "    vec3 p = vPosition.xyz * iScaleTint.x;\n"
+    "    p = vec3(cos(a) * p.x + sin(a) * p.z, p.y, -sin(a) * p.x + cos(a) * p.z);\n"
+    "    gl_Position = ViewProject * vec4(p + iPlacement.xyz, 1.0);\n"
+    "    color = vColor * iScaleTint.yzw;\n"
+    "    vs_tex_coord = vTexture;\n"
+    "}\n";
+
+const GLchar *sceneFragSource =
+    "#version 430 core\n"
+    "layout(binding = 0) uniform sampler2D tex;\n"
+    "in vec3 color;\n"
+    "in vec2 vs_tex_coord;\n"
+    "out vec4 fColor;\n"
+    "void main() {\n"
+    "    vec4 texColor = texture(tex, vs_tex_coord);\n"
+    "    fColor = vec4(color, 1) * (1 - texColor.a) + texColor;\n"
+    "}\n";
+
+static const VertexInfo pyramidData[] = {
+    // Bottom
+    { 0.0f, 0.f, .5f, 255, 0, 0, 0.f, 0.f},
+    { 0.433f, 0.f, -.25f, 255, 0, 0, 0.f, 1.f},
+    { -0.433f, 0.f, -.25f, 255, 0, 0, 1.f, 1.f},
+    // Side 1
+    { -0.433f, 0.f, -.25f, 0, 0, 255, 0.f, 0.f},
+    { 0.433f, 0.f, -.25f, 0, 255, 255, 1.f, 0.f},
+    { 0.0f, 0.75f, 0.f, 255, 0, 255, 1.f, 1.f},
+    // Side 2
+    { -0.433f, 0.f, -.25f, 255, 255, 0, 0.f, 0.f},
+    { 0.0f, 0.f, .5f, 255, 255, 0, 0.f, 1.f},
+    { 0.0f, 0.75f, 0.f, 255, 255, 0, 1.f, 1.f},
+    // Side 3
+    { 0.0f, 0.f, .5f, 0, 255, 0, 4.f, 4.f},
+    { 0.0f, 0.75f, 0.f, 0, 255, 0, 2.f, 0.f},
+    { 0.433f, 0.f, -.25f, 0, 255, 0, 0.f, 4.f},
+};
+
+static const GLushort pyramidIndices[] = { 0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11 };
+
+// Four corners per face, so each face gets its own texture coordinates
+static const VertexInfo cubeData[] = {
+    { -.3f, -.3f, .3f, 200, 200, 255, 0.f, 0.f}, { .3f, -.3f, .3f, 200, 200, 255, 1.f, 0.f},
+    { .3f, .3f, .3f, 200, 200, 255, 1.f, 1.f}, { -.3f, .3f, .3f, 200, 200, 255, 0.f, 1.f},
+    { .3f, -.3f, -.3f, 200, 255, 200, 0.f, 0.f}, { -.3f, -.3f, -.3f, 200, 255, 200, 1.f, 0.f},
+    { -.3f, .3f, -.3f, 200, 255, 200, 1.f, 1.f}, { .3f, .3f, -.3f, 200, 255, 200, 0.f, 1.f},
+    { -.3f, -.3f, -.3f, 255, 200, 200, 0.f, 0.f}, { -.3f, -.3f, .3f, 255, 200, 200, 1.f, 0.f},
+    { -.3f, .3f, .3f, 255, 200, 200, 1.f, 1.f}, { -.3f, .3f, -.3f, 255, 200, 200, 0.f, 1.f},
+    { .3f, -.3f, .3f, 255, 255, 200, 0.f, 0.f}, { .3f, -.3f, -.3f, 255, 255, 200, 1.f, 0.f},
+    { .3f, .3f, -.3f, 255, 255, 200, 1.f, 1.f}, { .3f, .3f, .3f, 255, 255, 200, 0.f, 1.f},
+    { -.3f, .3f, .3f, 255, 200, 255, 0.f, 0.f}, { .3f, .3f, .3f, 255, 200, 255, 1.f, 0.f},
+    { .3f, .3f, -.3f, 255, 200, 255, 1.f, 1.f}, { -.3f, .3f, -.3f, 255, 200, 255, 0.f, 1.f},
+    { -.3f, -.3f, -.3f, 200, 255, 255, 0.f, 0.f}, { .3f, -.3f, -.3f, 200, 255, 255, 1.f, 0.f},
+    { .3f, -.3f, .3f, 200, 255, 255, 1.f, 1.f}, { -.3f, -.3f, .3f, 200, 255, 255, 0.f, 1.f},
+};
+
+static const GLushort cubeIndices[] = {
+    0, 1, 2, 0, 2, 3, 4, 5, 6, 4, 6, 7, 8, 9, 10, 8, 10, 11,
+    12, 13, 14, 12, 14, 15, 16, 17, 18, 16, 18, 19, 20, 21, 22, 20, 22, 23,
+};
+
+// Convert a simple bitmap (one bit per pixel) into an RGBA bitmap (four bytes per pixel)
+GLubyte* BuildMonochromeBitmap(const GLubyte* bits, int width, int height, GLubyte red, GLubyte green, GLubyte blue)
+{
+    GLubyte* retval = (GLubyte *)malloc(width * height * 4);
+    if (retval) {
+        GLubyte* ptr = retval;
+        for (int y = 0; y < height; y++) {
+            for (int x = 0; x < width/8; x++) {
+                GLubyte next8 = *bits++;
+                for (int mask = 128; mask > 0; mask >>= 1) {
+                    if (next8 & mask) {
+                        *ptr++ = red;
+                        *ptr++ = green;
+                        *ptr++ = blue;
+                        *ptr++ = 255;
+                    }
+                    else {
+                        *ptr++ = 0;
+                        *ptr++ = 0;
+                        *ptr++ = 0;
+                        *ptr++ = 0;
+                    }
+                }
+            }
+        }
+    }
+    return retval;
+}
+
+#define BITMAP_WIDTH 16
+#define BITMAP_HEIGHT 16
+#define BIT_BYTES ((BITMAP_WIDTH / 8) * BITMAP_HEIGHT)
+
+int addSmileyTexture(PackageBuilder *pBuilder)
+{
+    // smiley face
+    GLubyte bits[BIT_BYTES] = {
+        0x00, 0x00,
+        0x00, 0x00,
+        0x07, 0xE0,
+        0x08, 0x10,
+        0x10, 0x08,
+        0x20, 0x04,
+        0x44, 0x22,
+        0x40, 0x02,
+        0x40, 0x02,
+        0x40, 0x02,
+        0x42, 0x42,
+        0x23, 0xc4,
+        0x10, 0x08,
+        0x0c, 0x30,
+        0x03, 0xc0,
+        0x00, 0x00,
+    };
+
+    GLubyte* data = BuildMonochromeBitmap(bits, BITMAP_WIDTH, BITMAP_HEIGHT, 255, 0, 0);
+    PackageTexture texture = { GL_RGBA8, GL_RGBA, GL_UNSIGNED_BYTE, BITMAP_WIDTH, BITMAP_HEIGHT, 1 };
+    texture.levelSizes[0] = BITMAP_WIDTH * BITMAP_HEIGHT * 4;
+    const void *levels[] = { data };
+    int section = packageAddTexture(pBuilder, "smiley", &texture, levels);
+    free(data);
+    return section;
+}
+
+// A translucent checkerboard with its whole mip chain, each level boxed
+// down from the one before
+int addCheckerTexture(PackageBuilder *pBuilder)
+{
+    PackageTexture texture = { GL_RGBA8, GL_RGBA, GL_UNSIGNED_BYTE, CHECKER_SIZE, CHECKER_SIZE, CHECKER_LEVELS };
+    std::vector<std::vector<GLubyte> > levels(CHECKER_LEVELS);
+    const void *pLevels[CHECKER_LEVELS];
+    for (int level = 0; level < CHECKER_LEVELS; level++) {
+        int size = CHECKER_SIZE >> level;
+        levels[level].resize(size * size * 4);
+        GLubyte *pTexel = &levels[level][0];
+        for (int y = 0; y < size; y++) {
+            for (int x = 0; x < size; x++, pTexel += 4) {
+                if (level == 0) {
+                    bool dark = ((x / 32) ^ (y / 32)) & 1;
+                    pTexel[0] = pTexel[1] = pTexel[2] = dark ? 0 : 255;
+                    pTexel[3] = dark ? 0 : 96;
+                    continue;
+                }
+                const GLubyte *pAbove = &levels[level - 1][0];
+                int above = size * 2;
+                for (int c = 0; c < 4; c++) {
+                    pTexel[c] = GLubyte((pAbove[((2 * y) * above + 2 * x) * 4 + c] +
+                        pAbove[((2 * y) * above + 2 * x + 1) * 4 + c] +
+                        pAbove[((2 * y + 1) * above + 2 * x) * 4 + c] +
+                        pAbove[((2 * y + 1) * above + 2 * x + 1) * 4 + c] + 2) / 4);
+                }
+            }
+        }
+        texture.levelSizes[level] = levels[level].size();
+        pLevels[level] = &levels[level][0];
+    }
+    return packageAddTexture(pBuilder, "checker", &texture, pLevels);
+}
+
+void describeVertices(PackageMesh *pMesh)
+{
+    PackageAttribute attributes[] = {
+        { 0, 3, GL_FLOAT, GL_FALSE, offsetof(VertexInfo, x) },
+        { 1, 3, GL_UNSIGNED_BYTE, GL_TRUE, offsetof(VertexInfo, red) },
+        { 2, 2, GL_FLOAT, GL_FALSE, offsetof(VertexInfo, texU) },
+    };
+    pMesh->vertexStride = sizeof(VertexInfo);
+    pMesh->attributeCount = 3;
+    memcpy(pMesh->attributes, attributes, sizeof(attributes));
+}
+
+bool buildPackage()
+{
+    PackageBuilder *pBuilder = packageBuilderCreate();
+    packageAddShader(pBuilder, "scene.vert", GL_VERTEX_SHADER, sceneVertSource);
+    packageAddShader(pBuilder, "scene.frag", GL_FRAGMENT_SHADER, sceneFragSource);
+
+    std::vector<PackageInstance> instances[2];
+    for (int row = 0; row < GRID_SIZE; row++) {
+        for (int column = 0; column < GRID_SIZE; column++) {
+            int n = row * GRID_SIZE + column;
+            PackageInstance instance = {
+                (column - (GRID_SIZE - 1) / 2.f) * GRID_SPACING,
+                (row - (GRID_SIZE - 1) / 2.f) * GRID_SPACING,
+                -CENTER_Z + float((n * 7) % 5),
+                float((n * 37) % 360),
+                .8f + .1f * float(n % 4),
+                { .5f + .5f * float(row) / GRID_SIZE, .6f, .5f + .5f * float(column) / GRID_SIZE },
+            };
+            instances[(row + column) % 2].push_back(instance);
+        }
+    }
+
+    PackageMesh meshes[2] = { { 0 } };
+    meshes[0].vertexSection = packageAddBlob(pBuilder, PACKAGE_VERTICES, "pyramid", pyramidData, sizeof(pyramidData));
+    meshes[0].indexSection = packageAddBlob(pBuilder, PACKAGE_INDICES, "pyramid", pyramidIndices, sizeof(pyramidIndices));
+    meshes[0].textureSection = addSmileyTexture(pBuilder);
+    meshes[0].instanceSection = packageAddBlob(pBuilder, PACKAGE_INSTANCES, "pyramids",
+        &instances[0][0], instances[0].size() * sizeof(PackageInstance));
+    meshes[0].indexCount = sizeof(pyramidIndices) / sizeof(pyramidIndices[0]);
+    meshes[0].indexType = GL_UNSIGNED_SHORT;
+    describeVertices(&meshes[0]);
+
+    meshes[1].vertexSection = packageAddBlob(pBuilder, PACKAGE_VERTICES, "cube", cubeData, sizeof(cubeData));
+    meshes[1].indexSection = packageAddBlob(pBuilder, PACKAGE_INDICES, "cube", cubeIndices, sizeof(cubeIndices));
+    meshes[1].textureSection = addCheckerTexture(pBuilder);
+    meshes[1].instanceSection = packageAddBlob(pBuilder, PACKAGE_INSTANCES, "cubes",
+        &instances[1][0], instances[1].size() * sizeof(PackageInstance));
+    meshes[1].indexCount = sizeof(cubeIndices) / sizeof(cubeIndices[0]);
+    meshes[1].indexType = GL_UNSIGNED_SHORT;
+    describeVertices(&meshes[1]);
+
+    packageAddBlob(pBuilder, PACKAGE_MESHES, "meshes", meshes, sizeof(meshes));
+    bool ok = packageWrite(pBuilder, PACKAGE_FILE);
+    packageBuilderDestroy(pBuilder);
+    printf(ok ? "Built %s\n" : "Couldn't write %s\n", PACKAGE_FILE);
+    return ok;
+}
+
+double timeMs()
+{
+    static LARGE_INTEGER frequency = { 0 };
+    if (frequency.QuadPart == 0) {
+        QueryPerformanceFrequency(&frequency);
+    }
+    LARGE_INTEGER now;
+    QueryPerformanceCounter(&now);
+    return 1000. * double(now.QuadPart) / double(frequency.QuadPart);
+}
+
+void unloadScene()
+{
+    for (int m = 0; m < g_MeshCount; m++) {
+        glDeleteVertexArrays(1, &g_Meshes[m].vaoId);
+        glDeleteTextures(1, &g_Meshes[m].textureId);
+    }
+    g_MeshCount = 0;
+    if (!g_Buffers.empty()) {
+        glDeleteBuffers(GLsizei(g_Buffers.size()), &g_Buffers[0]);
+        g_Buffers.clear();
+    }
+    if (g_Program) {
+        glDeleteProgram(g_Program);
+        g_Program = 0;
+    }
+    packageClose(&g_Package);
+}
+
+bool setupProgram()
+{
+    GLchar infoLog[4096];
+    GLsizei length;
+
+    GLuint vertShader = packageCreateShader(&g_Package, packageFind(&g_Package, PACKAGE_SHADER, "scene.vert"));
+    GLuint fragShader = packageCreateShader(&g_Package, packageFind(&g_Package, PACKAGE_SHADER, "scene.frag"));
+    if (!vertShader || !fragShader) {
+        printf("%s is missing its shaders\n", PACKAGE_FILE);
+        return false;
+    }
+
+    g_Program = glCreateProgram();
+    glAttachShader(g_Program, vertShader);
+    glCompileShader(vertShader);
+    glGetShaderInfoLog(vertShader, 4096, &length, infoLog);
+
+    glAttachShader(g_Program, fragShader);
+    glCompileShader(fragShader);
+    glGetShaderInfoLog(fragShader, 4096, &length, infoLog);
+
+    glLinkProgram(g_Program);
+    glDeleteShader(vertShader);
+    glDeleteShader(fragShader);
+    glUseProgram(g_Program);
+    return true;
+}
+
+void setupMesh(const PackageMesh *pMesh, MeshInfo *pInfo)
+{
+    glGenVertexArrays(1, &pInfo->vaoId);
+    glBindVertexArray(pInfo->vaoId);
+
+    g_Buffers.push_back(packageCreateBuffer(&g_Package, pMesh->vertexSection, GL_ARRAY_BUFFER));
+    for (uint32_t a = 0; a < pMesh->attributeCount; a++) {
+        const PackageAttribute &attribute = pMesh->attributes[a];
+        glVertexAttribPointer(attribute.location, attribute.components, attribute.type,
+            GLboolean(attribute.normalized), pMesh->vertexStride, (GLvoid*)(size_t)attribute.offset);
+        glEnableVertexAttribArray(attribute.location);
+    }
+
+    // The instance table goes up as it lies in the file
+    g_Buffers.push_back(packageCreateBuffer(&g_Package, pMesh->instanceSection, GL_ARRAY_BUFFER));
+    glVertexAttribPointer(PLACEMENT_POSITION, 4, GL_FLOAT, GL_FALSE, sizeof(PackageInstance),
+        (GLvoid*)offsetof(PackageInstance, x));
+    glVertexAttribPointer(SCALE_TINT_POSITION, 4, GL_FLOAT, GL_FALSE, sizeof(PackageInstance),
+        (GLvoid*)offsetof(PackageInstance, scale));
+    glVertexAttribDivisor(PLACEMENT_POSITION, 1);
+    glVertexAttribDivisor(SCALE_TINT_POSITION, 1);
+    glEnableVertexAttribArray(PLACEMENT_POSITION);
+    glEnableVertexAttribArray(SCALE_TINT_POSITION);
+
+    // Bound while the VAO is, so the VAO keeps it
+    g_Buffers.push_back(packageCreateBuffer(&g_Package, pMesh->indexSection, GL_ELEMENT_ARRAY_BUFFER));
+    glBindVertexArray(0);
+
+    pInfo->textureId = packageCreateTexture(&g_Package, pMesh->textureSection);
+    pInfo->indexCount = pMesh->indexCount;
+    pInfo->indexType = pMesh->indexType;
+    packageInstances(&g_Package, pMesh->instanceSection, &pInfo->instanceCount);
+}
+
+bool loadScene()
+{
+    unloadScene();
+    double start = timeMs();
+    if (!packageOpen(PACKAGE_FILE, &g_Package)) {
+        return false;
+    }
+    int meshCount;
+    const PackageMesh *pMeshes = packageMeshes(&g_Package, packageFind(&g_Package, PACKAGE_MESHES, NULL), &meshCount);
+    if (!pMeshes || !setupProgram()) {
+        packageClose(&g_Package);
+        return false;
+    }
+    g_MeshCount = meshCount < MAX_MESHES ? meshCount : MAX_MESHES;
+    for (int m = 0; m < g_MeshCount; m++) {
+        setupMesh(&pMeshes[m], &g_Meshes[m]);
+    }
+    // Everything is in the GL now, so the mapping isn't needed
+    size_t size = g_Package.size;
+    packageClose(&g_Package);
+
+    // The GL copies lazily, so wait for it to be done before stopping the clock
+    glFinish();
+    double elapsed = timeMs() - start;
+    printf("Loaded %.2f MB in %.2f ms (%.0f MB/s)\n", size / 1048576., elapsed, size / 1048576. / (elapsed / 1000.));
+    return true;
+}
+
+void setupFrustum(float left, float right, float bottom, float top, float zNear, float zFar)
+{
+    g_ProjectionMatrix = vmath::frustum(left, right, bottom, top, zNear, zFar);
+}
+
+void onDisplay()
+{
+    static double startTime = timeMs();
+    float time = float((timeMs() - startTime) / 1000.);
+
+    glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+    // Turn the whole grid slowly, about its center
+    mat4 viewMatrix(vmath::translate(0.f, 0.f, -CENTER_Z));
+    viewMatrix *= vmath::rotate(time * 10.f, 0.f, 0.f, 1.f);
+    viewMatrix *= vmath::translate(0.f, 0.f, CENTER_Z);
+    glUniformMatrix4fv(MATRIX_LOCATION, 1, GL_FALSE, g_ProjectionMatrix * viewMatrix);
+    for (int m = 0; m < g_MeshCount; m++) {
+        const MeshInfo &mesh = g_Meshes[m];
+        glBindTexture(GL_TEXTURE_2D, mesh.textureId);
+        glBindVertexArray(mesh.vaoId);
+        glDrawElementsInstanced(GL_TRIANGLES, mesh.indexCount, mesh.indexType, 0, mesh.instanceCount);
+    }
+    glutSwapBuffers();
+}
+
+void onKey(unsigned char key, int x, int y)
+{
+    if (key == 'l' || key == 'L') {
+        loadScene();
+        return;
+    }
+    exit(0);
+}
+
+int main(int argc, char *argv[])
+{
+    glutInit(&argc, argv);
+    glutInitDisplayMode(GLUT_RGBA | GLUT_DOUBLE | GLUT_DEPTH);
+    glutInitWindowSize(640, 480);
+    glutCreateWindow(argv[0]);
+
+    glewInit();
+    wglSwapIntervalEXT(1);	// vsync
+
+    glEnable(GL_DEPTH_TEST);
+
+    GLfloat ratio = 640.0f / 480.0f;
+    GLfloat zNear = CENTER_Z - DEPTH_OF_FIELD/2;
+    GLfloat top = zNear * .6f;
+    setupFrustum(-ratio * top, ratio * top, -top, top, zNear, CENTER_Z + DEPTH_OF_FIELD/2);
+
+    // A package from another version is refused, and built again
+    if (!loadScene() && (!buildPackage() || !loadScene())) {
+        return 1;
+    }
+    glutDisplayFunc(onDisplay);
+    glutIdleFunc(onDisplay);
+    glutKeyboardFunc(onKey);
+    glutMainLoop();
+
+    return 0;
+}
@@ -0,0 +1,477 @@
+/*
+ * Mapped scene packages.  See ScenePackage.h.
+ */
+#include <windows.h>
+
+#include "ScenePackage.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <vector>
+
+struct PackageBuilder {
+    std::vector<PackageSection> sections;
+    std::vector<std::vector<unsigned char> > payloads;
+};
+
+// The texture formats a package may hold.  Uncompressed formats must come
+// with exactly this format and type; compressed ones with format 0.
+typedef struct {
+    GLenum internalFormat, format, type;
+    uint32_t blockSize;             // Texels across a block; 1 if uncompressed
+    uint32_t blockBytes;            // Bytes per block, or per texel
+} PackageFormat;
+
+static const PackageFormat packageFormats[] = {
+    { GL_R8,                            GL_RED,     GL_UNSIGNED_BYTE,   1,  1 },
+    { GL_RG8,                           GL_RG,      GL_UNSIGNED_BYTE,   1,  2 },
+    { GL_RGB8,                          GL_RGB,     GL_UNSIGNED_BYTE,   1,  3 },
+    { GL_RGBA8,                         GL_RGBA,    GL_UNSIGNED_BYTE,   1,  4 },
+    { GL_SRGB8_ALPHA8,                  GL_RGBA,    GL_UNSIGNED_BYTE,   1,  4 },
+    { GL_RGBA16F,                       GL_RGBA,    GL_HALF_FLOAT,      1,  8 },
+    { GL_RGBA32F,                       GL_RGBA,    GL_FLOAT,           1,  16 },
+    { GL_COMPRESSED_RGBA_S3TC_DXT1_EXT, 0,          0,                  4,  8 },
+    { GL_COMPRESSED_RGBA_S3TC_DXT5_EXT, 0,          0,                  4,  16 },
+    { GL_COMPRESSED_RED_RGTC1,          0,          0,                  4,  8 },
+    { GL_COMPRESSED_RG_RGTC2,           0,          0,                  4,  16 },
+    { GL_COMPRESSED_RGBA_BPTC_UNORM,    0,          0,                  4,  16 },
+};
+
+static size_t alignUp(size_t offset)
+{
+    return (offset + PACKAGE_ALIGN - 1) & ~size_t(PACKAGE_ALIGN - 1);
+}
+
+static const PackageFormat *findFormat(const PackageTexture *pTexture)
+{
+    for (size_t i = 0; i < sizeof(packageFormats) / sizeof(packageFormats[0]); i++) {
+        const PackageFormat *pFormat = &packageFormats[i];
+        if (pFormat->internalFormat == pTexture->internalFormat) {
+            bool matches = pFormat->format == pTexture->format && pFormat->type == pTexture->type;
+            return matches ? pFormat : NULL;
+        }
+    }
+    return NULL;
+}
+
+// What a level must hold, with rows tightly packed
+static uint64_t levelSize(const PackageFormat *pFormat, uint32_t width, uint32_t height, uint32_t level)
+{
+    uint64_t levelWidth = width >> level > 0 ? width >> level : 1;
+    uint64_t levelHeight = height >> level > 0 ? height >> level : 1;
+    uint64_t blocksWide = (levelWidth + pFormat->blockSize - 1) / pFormat->blockSize;
+    uint64_t blocksHigh = (levelHeight + pFormat->blockSize - 1) / pFormat->blockSize;
+    return blocksWide * blocksHigh * pFormat->blockBytes;
+}
+
+// Checks only what has to hold before any section is touched; each
+// section's own contents are checked when it is asked for
+static const char *validate(const ScenePackage *pPackage)
+{
+    if (pPackage->size < sizeof(PackageHeader)) {
+        return "too short for a header";
+    }
+    const PackageHeader *pHeader = pPackage->pHeader;
+    if (pHeader->magic != PACKAGE_MAGIC) {
+        return "not a scene package";
+    }
+    if (pHeader->version != PACKAGE_VERSION) {
+        return "made for a different version";
+    }
+    if (pHeader->fileSize != pPackage->size) {
+        return "truncated";
+    }
+    if (pHeader->sectionCount > (pPackage->size - sizeof(PackageHeader)) / sizeof(PackageSection)) {
+        return "section table runs past the end";
+    }
+    for (uint32_t i = 0; i < pHeader->sectionCount; i++) {
+        const PackageSection &section = pPackage->pSections[i];
+        if (section.type >= PACKAGE_SECTION_TYPES) {
+            return "unknown section type";
+        }
+        if (section.offset % PACKAGE_ALIGN != 0) {
+            return "misaligned section";
+        }
+        if (section.offset > pPackage->size || section.size > pPackage->size - section.offset) {
+            return "section runs past the end";
+        }
+        if (memchr(section.name, '\0', sizeof(section.name)) == NULL) {
+            return "unterminated section name";
+        }
+    }
+    return NULL;
+}
+
+bool packageOpen(const char *pPath, ScenePackage *pPackage)
+{
+    memset(pPackage, 0, sizeof(*pPackage));
+
+    // Sequential scan tells the cache manager to read well ahead
+    HANDLE hFile = CreateFileA(pPath, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+    if (hFile == INVALID_HANDLE_VALUE) {
+        printf("Can't open %s\n", pPath);
+        return false;
+    }
+    LARGE_INTEGER size;
+    if (!GetFileSizeEx(hFile, &size) || size.QuadPart == 0) {
+        printf("%s is empty\n", pPath);
+        CloseHandle(hFile);
+        return false;
+    }
+    HANDLE hMapping = CreateFileMappingA(hFile, NULL, PAGE_READONLY, 0, 0, NULL);
+    const void *pView = hMapping ? MapViewOfFile(hMapping, FILE_MAP_READ, 0, 0, 0) : NULL;
+    if (!pView) {
+        printf("Can't map %s\n", pPath);
+        if (hMapping) {
+            CloseHandle(hMapping);
+        }
+        CloseHandle(hFile);
+        return false;
+    }
+
+    pPackage->pBase = (const unsigned char *)pView;
+    pPackage->size = size_t(size.QuadPart);
+    pPackage->pHeader = (const PackageHeader *)pView;
+    pPackage->pSections = (const PackageSection *)(pPackage->pBase + sizeof(PackageHeader));
+    pPackage->hFile = hFile;
+    pPackage->hMapping = hMapping;
+
+    const char *pError = validate(pPackage);
+    if (pError) {
+        printf("Can't use %s:  %s\n", pPath, pError);
+        packageClose(pPackage);
+        return false;
+    }
+    return true;
+}
+
+void packageClose(ScenePackage *pPackage)
+{
+    if (pPackage->pBase) {
+        UnmapViewOfFile(pPackage->pBase);
+    }
+    if (pPackage->hMapping) {
+        CloseHandle(pPackage->hMapping);
+    }
+    if (pPackage->hFile) {
+        CloseHandle(pPackage->hFile);
+    }
+    memset(pPackage, 0, sizeof(*pPackage));
+}
+
+int packageFind(const ScenePackage *pPackage, PackageSectionType type, const char *pName)
+{
+    for (uint32_t i = 0; i < pPackage->pHeader->sectionCount; i++) {
+        const PackageSection &section = pPackage->pSections[i];
+        if (section.type == uint32_t(type) && (!pName || strcmp(section.name, pName) == 0)) {
+            return int(i);
+        }
+    }
+    return -1;
+}
+
+static const PackageSection *sectionOf(const ScenePackage *pPackage, int section, PackageSectionType type)
+{
+    if (section < 0 || uint32_t(section) >= pPackage->pHeader->sectionCount) {
+        return NULL;
+    }
+    const PackageSection *pSection = &pPackage->pSections[section];
+    return pSection->type == uint32_t(type) ? pSection : NULL;
+}
+
+const void *packageData(const ScenePackage *pPackage, int section)
+{
+    if (section < 0 || uint32_t(section) >= pPackage->pHeader->sectionCount) {
+        return NULL;
+    }
+    return pPackage->pBase + pPackage->pSections[section].offset;
+}
+
+size_t packageSize(const ScenePackage *pPackage, int section)
+{
+    if (section < 0 || uint32_t(section) >= pPackage->pHeader->sectionCount) {
+        return 0;
+    }
+    return size_t(pPackage->pSections[section].size);
+}
+
+// Bytes in one component of a vertex attribute, or 0 if the type isn't one
+static uint32_t componentSize(uint32_t type)
+{
+    switch (type) {
+    case GL_BYTE:
+    case GL_UNSIGNED_BYTE:
+        return 1;
+    case GL_SHORT:
+    case GL_UNSIGNED_SHORT:
+    case GL_HALF_FLOAT:
+        return 2;
+    case GL_INT:
+    case GL_UNSIGNED_INT:
+    case GL_FLOAT:
+        return 4;
+    default:
+        return 0;
+    }
+}
+
+// Everything a draw of the mesh reads has to lie inside its sections,
+// indices included, or the GPU reads past them
+static bool meshValid(const ScenePackage *pPackage, const PackageMesh &mesh)
+{
+    const PackageSection *pVertices = sectionOf(pPackage, mesh.vertexSection, PACKAGE_VERTICES);
+    const PackageSection *pIndices = sectionOf(pPackage, mesh.indexSection, PACKAGE_INDICES);
+    const PackageSection *pInstances = sectionOf(pPackage, mesh.instanceSection, PACKAGE_INSTANCES);
+    if (!pVertices || !pIndices || !pInstances || !sectionOf(pPackage, mesh.textureSection, PACKAGE_TEXTURE)) {
+        return false;
+    }
+    if (mesh.attributeCount > PACKAGE_MAX_ATTRIBUTES) {
+        return false;
+    }
+    if (mesh.vertexStride == 0 || mesh.vertexStride > pVertices->size) {
+        return false;
+    }
+    for (uint32_t a = 0; a < mesh.attributeCount; a++) {
+        const PackageAttribute &attribute = mesh.attributes[a];
+        uint32_t size = componentSize(attribute.type);
+        if (size == 0 || attribute.components < 1 || attribute.components > 4 ||
+            attribute.location >= PACKAGE_MAX_LOCATION ||
+            uint64_t(attribute.offset) + attribute.components * size > mesh.vertexStride) {
+            return false;
+        }
+    }
+    if (pInstances->size == 0 || pInstances->size % sizeof(PackageInstance) != 0) {
+        return false;
+    }
+
+    uint32_t indexSize = mesh.indexType == GL_UNSIGNED_SHORT ? 2 : mesh.indexType == GL_UNSIGNED_INT ? 4 : 0;
+    if (indexSize == 0 || uint64_t(mesh.indexCount) * indexSize > pIndices->size) {
+        return false;
+    }
+    uint64_t vertexCount = pVertices->size / mesh.vertexStride;
+    const void *pIndexData = packageData(pPackage, mesh.indexSection);
+    for (uint32_t i = 0; i < mesh.indexCount; i++) {
+        uint32_t index = indexSize == 2 ? ((const uint16_t *)pIndexData)[i] : ((const uint32_t *)pIndexData)[i];
+        if (index >= vertexCount) {
+            return false;
+        }
+    }
+    return true;
+}
+
+const PackageMesh *packageMeshes(const ScenePackage *pPackage, int section, int *pCount)
+{
+    *pCount = 0;
+    const PackageSection *pSection = sectionOf(pPackage, section, PACKAGE_MESHES);
+    if (!pSection || pSection->size % sizeof(PackageMesh) != 0) {
+        return NULL;
+    }
+    const PackageMesh *pMeshes = (const PackageMesh *)packageData(pPackage, section);
+    int count = int(pSection->size / sizeof(PackageMesh));
+
+    // A mesh that points at the wrong kind of section, or past the end of
+    // one, would be drawn from garbage, so the whole table is refused
+    for (int i = 0; i < count; i++) {
+        if (!meshValid(pPackage, pMeshes[i])) {
+            printf("Mesh %d in section %s is broken\n", i, pSection->name);
+            return NULL;
+        }
+    }
+    *pCount = count;
+    return pMeshes;
+}
+
+const PackageInstance *packageInstances(const ScenePackage *pPackage, int section, int *pCount)
+{
+    *pCount = 0;
+    const PackageSection *pSection = sectionOf(pPackage, section, PACKAGE_INSTANCES);
+    if (!pSection || pSection->size % sizeof(PackageInstance) != 0) {
+        return NULL;
+    }
+    *pCount = int(pSection->size / sizeof(PackageInstance));
+    return (const PackageInstance *)packageData(pPackage, section);
+}
+
+GLuint packageCreateBuffer(const ScenePackage *pPackage, int section, GLenum target)
+{
+    const void *pData = packageData(pPackage, section);
+    if (!pData) {
+        return 0;
+    }
+    GLuint buffer;
+    glGenBuffers(1, &buffer);
+    glBindBuffer(target, buffer);
+    glBufferData(target, packageSize(pPackage, section), pData, GL_STATIC_DRAW);
+    return buffer;
+}
+
+GLuint packageCreateTexture(const ScenePackage *pPackage, int section)
+{
+    const PackageSection *pSection = sectionOf(pPackage, section, PACKAGE_TEXTURE);
+    if (!pSection || pSection->size < sizeof(PackageTexture)) {
+        return 0;
+    }
+    const unsigned char *pData = (const unsigned char *)packageData(pPackage, section);
+    const PackageTexture *pTexture = (const PackageTexture *)pData;
+    const PackageFormat *pFormat = findFormat(pTexture);
+    if (!pFormat) {
+        printf("Texture %s has an unknown format\n", pSection->name);
+        return 0;
+    }
+    uint32_t largest = pTexture->width > pTexture->height ? pTexture->width : pTexture->height;
+    uint32_t maxLevels = 0;
+    while (maxLevels < 32 && largest >> maxLevels) {
+        maxLevels++;
+    }
+    if (pTexture->levels == 0 || pTexture->levels > PACKAGE_MAX_LEVELS || pTexture->levels > maxLevels) {
+        printf("Texture %s has a bad size or level count\n", pSection->name);
+        return 0;
+    }
+    // GL reads as much as the dimensions say, whatever the package says
+    for (uint32_t level = 0; level < pTexture->levels; level++) {
+        if (pTexture->levelOffsets[level] > pSection->size ||
+            pTexture->levelSizes[level] > pSection->size - pTexture->levelOffsets[level]) {
+            printf("Texture %s has a level outside its section\n", pSection->name);
+            return 0;
+        }
+        if (pTexture->levelSizes[level] != levelSize(pFormat, pTexture->width, pTexture->height, level)) {
+            printf("Texture %s has a level of the wrong size\n", pSection->name);
+            return 0;
+        }
+    }
+
+    GLuint texture;
+    glGenTextures(1, &texture);
+    glBindTexture(GL_TEXTURE_2D, texture);
+    glTexStorage2D(GL_TEXTURE_2D, pTexture->levels, pTexture->internalFormat, pTexture->width, pTexture->height);
+    // Rows in the package are tightly packed
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+    for (uint32_t level = 0; level < pTexture->levels; level++) {
+        GLsizei width = pTexture->width >> level > 0 ? pTexture->width >> level : 1;
+        GLsizei height = pTexture->height >> level > 0 ? pTexture->height >> level : 1;
+        const unsigned char *pLevel = pData + pTexture->levelOffsets[level];
+        if (pTexture->format == 0) {
+            glCompressedTexSubImage2D(GL_TEXTURE_2D, level, 0, 0, width, height, pTexture->internalFormat,
+                GLsizei(pTexture->levelSizes[level]), pLevel);
+        }
+        else {
+            glTexSubImage2D(GL_TEXTURE_2D, level, 0, 0, width, height, pTexture->format, pTexture->type, pLevel);
+        }
+    }
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+    return texture;
+}
+
+GLuint packageCreateShader(const ScenePackage *pPackage, int section)
+{
+    const PackageSection *pSection = sectionOf(pPackage, section, PACKAGE_SHADER);
+    if (!pSection || pSection->size < sizeof(PackageShader)) {
+        return 0;
+    }
+    const PackageShader *pShader = (const PackageShader *)packageData(pPackage, section);
+    if (pShader->size > pSection->size - sizeof(PackageShader)) {
+        return 0;
+    }
+    // Binaries are whole programs, and are for the caller to hand to
+    // glProgramBinary
+    if (pShader->binaryFormat != 0) {
+        return 0;
+    }
+    // The source needn't be terminated; its length is passed instead
+    const GLchar *pSource = (const GLchar *)(pShader + 1);
+    GLint length = GLint(pShader->size);
+    GLuint shader = glCreateShader(pShader->stage);
+    glShaderSource(shader, 1, &pSource, &length);
+    return shader;
+}
+
+PackageBuilder *packageBuilderCreate()
+{
+    return new PackageBuilder;
+}
+
+void packageBuilderDestroy(PackageBuilder *pBuilder)
+{
+    delete pBuilder;
+}
+
+static int addSection(PackageBuilder *pBuilder, PackageSectionType type, const char *pName)
+{
+    PackageSection section = { uint32_t(type) };
+    strncpy(section.name, pName, sizeof(section.name) - 1);
+    pBuilder->sections.push_back(section);
+    pBuilder->payloads.push_back(std::vector<unsigned char>());
+    return int(pBuilder->sections.size() - 1);
+}
+
+int packageAddBlob(PackageBuilder *pBuilder, PackageSectionType type, const char *pName, const void *pData, size_t size)
+{
+    int section = addSection(pBuilder, type, pName);
+    const unsigned char *pBytes = (const unsigned char *)pData;
+    pBuilder->payloads[section].assign(pBytes, pBytes + size);
+    return section;
+}
+
+int packageAddTexture(PackageBuilder *pBuilder, const char *pName, const PackageTexture *pTexture,
+    const void *const *ppLevels)
+{
+    int section = addSection(pBuilder, PACKAGE_TEXTURE, pName);
+    std::vector<unsigned char> &payload = pBuilder->payloads[section];
+
+    // Each level is aligned like a section, so it can be copied a cache
+    // line at a time
+    PackageTexture texture = *pTexture;
+    size_t offset = alignUp(sizeof(PackageTexture));
+    for (uint32_t level = 0; level < texture.levels; level++) {
+        texture.levelOffsets[level] = offset;
+        offset = alignUp(offset + size_t(texture.levelSizes[level]));
+    }
+    payload.assign(offset, 0);
+    memcpy(&payload[0], &texture, sizeof(texture));
+    for (uint32_t level = 0; level < texture.levels; level++) {
+        memcpy(&payload[size_t(texture.levelOffsets[level])], ppLevels[level], size_t(texture.levelSizes[level]));
+    }
+    return section;
+}
+
+int packageAddShader(PackageBuilder *pBuilder, const char *pName, GLenum stage, const char *pSource)
+{
+    int section = addSection(pBuilder, PACKAGE_SHADER, pName);
+    PackageShader shader = { stage, 0, strlen(pSource) };
+    std::vector<unsigned char> &payload = pBuilder->payloads[section];
+    payload.resize(sizeof(shader) + size_t(shader.size));
+    memcpy(&payload[0], &shader, sizeof(shader));
+    memcpy(&payload[sizeof(shader)], pSource, size_t(shader.size));
+    return section;
+}
+
+bool packageWrite(const PackageBuilder *pBuilder, const char *pPath)
+{
+    std::vector<PackageSection> sections = pBuilder->sections;
+    size_t offset = alignUp(sizeof(PackageHeader) + sections.size() * sizeof(PackageSection));
+    for (size_t i = 0; i < sections.size(); i++) {
+        sections[i].offset = offset;
+        sections[i].size = pBuilder->payloads[i].size();
+        offset = alignUp(offset + pBuilder->payloads[i].size());
+    }
+    PackageHeader header = { PACKAGE_MAGIC, PACKAGE_VERSION, uint32_t(sections.size()), 0, offset };
+
+    FILE *pFile = fopen(pPath, "wb");
+    if (!pFile) {
+        return false;
+    }
+    static const unsigned char padding[PACKAGE_ALIGN] = { 0 };
+    size_t written = fwrite(&header, sizeof(header), 1, pFile) * sizeof(header);
+    if (!sections.empty()) {
+        written += fwrite(&sections[0], sizeof(PackageSection), sections.size(), pFile) * sizeof(PackageSection);
+    }
+    for (size_t i = 0; i < sections.size(); i++) {
+        written += fwrite(padding, 1, size_t(sections[i].offset) - written, pFile);
+        if (!pBuilder->payloads[i].empty()) {
+            written += fwrite(&pBuilder->payloads[i][0], 1, pBuilder->payloads[i].size(), pFile);
+        }
+    }
+    written += fwrite(padding, 1, offset - written, pFile);
+    bool ok = written == offset;
+    return fclose(pFile) == 0 && ok;
+}
@@ -0,0 +1,140 @@
+/*
+ * A binary scene package that is used where it lies.
+ *
+ * The file is a header, a table of sections and then the sections
+ * themselves, each starting on a PACKAGE_ALIGN boundary.  packageOpen maps
+ * the file into memory and checks the header and that every section lies
+ * inside the file; nothing else is read up front.  Sections are plain
+ * arrays of the structs below, or raw blobs, so the mapped bytes are used
+ * as they are:  vertex, index and texture data go from the mapping
+ * straight to glBufferData and glTexSubImage2D, and the mesh and instance
+ * tables are read in place.  Load time is the time to page the file in.
+ *
+ * Everything is little-endian, and offsets are from the start of the file.
+ * Bump PACKAGE_VERSION whenever a struct here changes; older packages are
+ * refused rather than misread.
+ *
+ * A PackageBuilder collects sections in memory and writes the file.
+ */
+#ifndef SCENE_PACKAGE_H
+#define SCENE_PACKAGE_H
+
+#include <GL/glew.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#define PACKAGE_MAGIC       0x474B5053      // "SPKG"
+#define PACKAGE_VERSION     1
+#define PACKAGE_ALIGN       64              // Every section starts on this
+#define PACKAGE_MAX_LEVELS  16
+#define PACKAGE_MAX_ATTRIBUTES 4
+#define PACKAGE_MAX_LOCATION 16             // Vertex attributes GL always has
+#define PACKAGE_NAME_LENGTH 32
+
+typedef enum {
+    PACKAGE_VERTICES,       // Raw vertex data
+    PACKAGE_INDICES,        // Raw index data
+    PACKAGE_TEXTURE,        // A PackageTexture, then its mip levels
+    PACKAGE_SHADER,         // A PackageShader, then the source or binary
+    PACKAGE_MESHES,         // An array of PackageMesh
+    PACKAGE_INSTANCES,      // An array of PackageInstance
+    PACKAGE_SECTION_TYPES
+} PackageSectionType;
+
+typedef struct {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t sectionCount;
+    uint32_t reserved;
+    uint64_t fileSize;
+} PackageHeader;
+
+typedef struct {
+    uint32_t type;                  // A PackageSectionType
+    uint32_t reserved;
+    uint64_t offset, size;
+    char name[PACKAGE_NAME_LENGTH];
+} PackageSection;
+
+// Only the internal formats listed in ScenePackage.cpp are accepted, and
+// each level must be exactly as big as its dimensions make it
+typedef struct {
+    uint32_t internalFormat;        // For glTexStorage2D
+    uint32_t format, type;          // For glTexSubImage2D; both 0 if compressed
+    uint32_t width, height, levels;
+    uint64_t levelOffsets[PACKAGE_MAX_LEVELS];  // From the start of the section
+    uint64_t levelSizes[PACKAGE_MAX_LEVELS];
+} PackageTexture;
+
+typedef struct {
+    uint32_t stage;                 // GL_VERTEX_SHADER and so on
+    uint32_t binaryFormat;          // For glProgramBinary; 0 for GLSL source
+    uint64_t size;                  // Of what follows
+} PackageShader;
+
+typedef struct {
+    uint32_t location, components, type, normalized, offset;
+} PackageAttribute;
+
+// Something to draw:  sections are given by their index in the table
+typedef struct {
+    uint32_t vertexSection, indexSection, textureSection, instanceSection;
+    uint32_t indexCount, indexType;
+    uint32_t vertexStride, attributeCount;
+    PackageAttribute attributes[PACKAGE_MAX_ATTRIBUTES];
+} PackageMesh;
+
+typedef struct {
+    float x, y, z;
+    float rotation;                 // About y, in degrees
+    float scale;
+    float tint[3];
+} PackageInstance;
+
+typedef struct {
+    const unsigned char *pBase;
+    size_t size;
+    const PackageHeader *pHeader;
+    const PackageSection *pSections;
+    void *hFile, *hMapping;
+} ScenePackage;
+
+// Prints the reason and returns false if the file can't be used
+bool packageOpen(const char *pPath, ScenePackage *pPackage);
+void packageClose(ScenePackage *pPackage);
+
+// The first section of this type and name, or of this type if pName is
+// NULL.  Returns -1 if there is none.
+int packageFind(const ScenePackage *pPackage, PackageSectionType type, const char *pName);
+
+// A section's bytes, in the mapping
+const void *packageData(const ScenePackage *pPackage, int section);
+size_t packageSize(const ScenePackage *pPackage, int section);
+
+// Array sections, in the mapping.  Return NULL, with *pCount 0, if the
+// section isn't of that type.  A mesh table is also refused if any mesh's
+// sections, attributes, counts or indices would have a draw read past the
+// data it points at.
+const PackageMesh *packageMeshes(const ScenePackage *pPackage, int section, int *pCount);
+const PackageInstance *packageInstances(const ScenePackage *pPackage, int section, int *pCount);
+
+// Upload straight from the mapping.  Return 0 if the section isn't usable.
+GLuint packageCreateBuffer(const ScenePackage *pPackage, int section, GLenum target);
+GLuint packageCreateTexture(const ScenePackage *pPackage, int section);
+GLuint packageCreateShader(const ScenePackage *pPackage, int section);
+
+// Building a package
+typedef struct PackageBuilder PackageBuilder;
+
+PackageBuilder *packageBuilderCreate();
+void packageBuilderDestroy(PackageBuilder *pBuilder);
+
+// Each returns the new section's index
+int packageAddBlob(PackageBuilder *pBuilder, PackageSectionType type, const char *pName, const void *pData, size_t size);
+int packageAddTexture(PackageBuilder *pBuilder, const char *pName, const PackageTexture *pTexture,
+    const void *const *ppLevels);
+int packageAddShader(PackageBuilder *pBuilder, const char *pName, GLenum stage, const char *pSource);
+
+bool packageWrite(const PackageBuilder *pBuilder, const char *pPath);
+
+#endif
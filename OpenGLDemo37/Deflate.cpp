@@ -0,0 +1,423 @@
+/*
+ * zlib streams.  See Deflate.h.
+ */
+#include "Deflate.h"
+
+#include <stdint.h>
+#include <string.h>
+#include <vector>
+
+#define MAX_BITS        15      // Longest Huffman code
+#define LITERAL_CODES   288
+#define DISTANCE_CODES  30
+#define WINDOW_SIZE     32768
+#define MIN_MATCH       3
+#define MAX_MATCH       258
+#define HASH_BITS       15
+
+static const short lengthBase[29] = {
+    3, 4, 5, 6, 7, 8, 9, 10, 11, 13, 15, 17, 19, 23, 27, 31,
+    35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258 };
+static const short lengthExtra[29] = {
+    0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2,
+    3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0 };
+static const short distanceBase[DISTANCE_CODES] = {
+    1, 2, 3, 4, 5, 7, 9, 13, 17, 25, 33, 49, 65, 97, 129, 193,
+    257, 385, 513, 769, 1025, 1537, 2049, 3073, 4097, 6145, 8193, 12289, 16385, 24577 };
+static const short distanceExtra[DISTANCE_CODES] = {
+    0, 0, 0, 0, 1, 1, 2, 2, 3, 3, 4, 4, 5, 5, 6, 6,
+    7, 7, 8, 8, 9, 9, 10, 10, 11, 11, 12, 12, 13, 13 };
+
+static uint32_t adler32(const unsigned char *pData, size_t size)
+{
+    uint32_t a = 1, b = 0;
+    while (size > 0) {
+        // The largest run that can't overflow b before the modulo
+        size_t run = size < 5552 ? size : 5552;
+        size -= run;
+        while (run-- > 0) {
+            a += *pData++;
+            b += a;
+        }
+        a %= 65521;
+        b %= 65521;
+    }
+    return (b << 16) | a;
+}
+
+// Decompression
+
+typedef struct {
+    const unsigned char *pIn;
+    size_t inSize, inPos;
+    uint32_t bits;
+    int bitCount;
+    bool overrun;
+} BitReader;
+
+// A canonical Huffman code:  how many codes there are of each length, and
+// the symbols in code order
+typedef struct {
+    short counts[MAX_BITS + 1];
+    short symbols[LITERAL_CODES];
+} Huffman;
+
+static int getBits(BitReader *pReader, int count)
+{
+    uint32_t value = pReader->bits;
+    while (pReader->bitCount < count) {
+        if (pReader->inPos == pReader->inSize) {
+            pReader->overrun = true;
+            return 0;
+        }
+        value |= uint32_t(pReader->pIn[pReader->inPos++]) << pReader->bitCount;
+        pReader->bitCount += 8;
+    }
+    pReader->bits = value >> count;
+    pReader->bitCount -= count;
+    return int(value & ((1u << count) - 1));
+}
+
+// Returns false if the lengths describe more codes than fit
+static bool buildHuffman(Huffman *pHuffman, const short *pLengths, int count)
+{
+    memset(pHuffman->counts, 0, sizeof(pHuffman->counts));
+    for (int symbol = 0; symbol < count; symbol++) {
+        pHuffman->counts[pLengths[symbol]]++;
+    }
+    int left = 1;
+    for (int length = 1; length <= MAX_BITS; length++) {
+        left = (left << 1) - pHuffman->counts[length];
+        if (left < 0) {
+            return false;
+        }
+    }
+    short offsets[MAX_BITS + 1];
+    offsets[1] = 0;
+    for (int length = 1; length < MAX_BITS; length++) {
+        offsets[length + 1] = offsets[length] + pHuffman->counts[length];
+    }
+    for (int symbol = 0; symbol < count; symbol++) {
+        if (pLengths[symbol] != 0) {
+            pHuffman->symbols[offsets[pLengths[symbol]]++] = short(symbol);
+        }
+    }
+    return true;
+}
+
+// Deflate sends Huffman codes most significant bit first, so they are
+// read a bit at a time until the code falls inside the range for its length
+static int decodeSymbol(BitReader *pReader, const Huffman *pHuffman)
+{
+    int code = 0, first = 0, index = 0;
+    for (int length = 1; length <= MAX_BITS; length++) {
+        code |= getBits(pReader, 1);
+        int count = pHuffman->counts[length];
+        if (code - first < count) {
+            return pHuffman->symbols[index + code - first];
+        }
+        index += count;
+        first = (first + count) << 1;
+        code <<= 1;
+        if (pReader->overrun) {
+            return -1;
+        }
+    }
+    return -1;
+}
+
+static bool inflateCodes(BitReader *pReader, const Huffman *pLiterals, const Huffman *pDistances,
+    unsigned char *pOut, size_t outSize, size_t *pOutPos)
+{
+    size_t outPos = *pOutPos;
+    for (;;) {
+        int symbol = decodeSymbol(pReader, pLiterals);
+        if (symbol < 0) {
+            return false;
+        }
+        if (symbol < 256) {
+            if (outPos == outSize) {
+                return false;
+            }
+            pOut[outPos++] = (unsigned char)symbol;
+            continue;
+        }
+        if (symbol == 256) {
+            break;
+        }
+        symbol -= 257;
+        if (symbol >= 29) {
+            return false;
+        }
+        size_t length = lengthBase[symbol] + getBits(pReader, lengthExtra[symbol]);
+        int distanceSymbol = decodeSymbol(pReader, pDistances);
+        if (distanceSymbol < 0 || distanceSymbol >= DISTANCE_CODES) {
+            return false;
+        }
+        size_t distance = distanceBase[distanceSymbol] + getBits(pReader, distanceExtra[distanceSymbol]);
+        if (pReader->overrun || distance > outPos || length > outSize - outPos) {
+            return false;
+        }
+        // Byte by byte, since the copy may overlap what it writes
+        const unsigned char *pFrom = pOut + outPos - distance;
+        for (size_t i = 0; i < length; i++) {
+            pOut[outPos + i] = pFrom[i];
+        }
+        outPos += length;
+    }
+    *pOutPos = outPos;
+    return true;
+}
+
+static void fixedHuffman(Huffman *pLiterals, Huffman *pDistances)
+{
+    short lengths[LITERAL_CODES];
+    int symbol = 0;
+    for (; symbol < 144; symbol++) lengths[symbol] = 8;
+    for (; symbol < 256; symbol++) lengths[symbol] = 9;
+    for (; symbol < 280; symbol++) lengths[symbol] = 7;
+    for (; symbol < LITERAL_CODES; symbol++) lengths[symbol] = 8;
+    buildHuffman(pLiterals, lengths, LITERAL_CODES);
+    for (symbol = 0; symbol < DISTANCE_CODES; symbol++) lengths[symbol] = 5;
+    buildHuffman(pDistances, lengths, DISTANCE_CODES);
+}
+
+static bool dynamicHuffman(BitReader *pReader, Huffman *pLiterals, Huffman *pDistances)
+{
+    static const short order[19] = { 16, 17, 18, 0, 8, 7, 9, 6, 10, 5, 11, 4, 12, 3, 13, 2, 14, 1, 15 };
+
+    int literalCount = getBits(pReader, 5) + 257;
+    int distanceCount = getBits(pReader, 5) + 1;
+    int codeCount = getBits(pReader, 4) + 4;
+    if (literalCount > 286 || distanceCount > DISTANCE_CODES) {
+        return false;
+    }
+
+    // First the code that the code lengths themselves are sent in
+    short lengths[LITERAL_CODES + DISTANCE_CODES] = { 0 };
+    for (int i = 0; i < codeCount; i++) {
+        lengths[order[i]] = short(getBits(pReader, 3));
+    }
+    Huffman lengthCode;
+    if (!buildHuffman(&lengthCode, lengths, 19)) {
+        return false;
+    }
+
+    int count = 0;
+    while (count < literalCount + distanceCount) {
+        int symbol = decodeSymbol(pReader, &lengthCode);
+        if (symbol < 0) {
+            return false;
+        }
+        if (symbol < 16) {
+            lengths[count++] = short(symbol);
+            continue;
+        }
+        short repeated = 0;
+        int repeat;
+        if (symbol == 16) {
+            if (count == 0) {
+                return false;
+            }
+            repeated = lengths[count - 1];
+            repeat = 3 + getBits(pReader, 2);
+        }
+        else if (symbol == 17) {
+            repeat = 3 + getBits(pReader, 3);
+        }
+        else {
+            repeat = 11 + getBits(pReader, 7);
+        }
+        if (count + repeat > literalCount + distanceCount) {
+            return false;
+        }
+        while (repeat-- > 0) {
+            lengths[count++] = repeated;
+        }
+    }
+    // A block with no end code could never finish
+    if (lengths[256] == 0) {
+        return false;
+    }
+    return buildHuffman(pLiterals, lengths, literalCount) &&
+        buildHuffman(pDistances, lengths + literalCount, distanceCount);
+}
+
+bool zlibDecompress(const void *pData, size_t size, void *pOut, size_t outSize)
+{
+    const unsigned char *pIn = (const unsigned char *)pData;
+    // Deflate with a window of at most 32K, no preset dictionary
+    if (size < 6 || (pIn[0] & 0x0F) != 8 || (pIn[0] >> 4) > 7 ||
+        ((pIn[0] << 8) | pIn[1]) % 31 != 0 || (pIn[1] & 0x20) != 0) {
+        return false;
+    }
+
+    BitReader reader = { pIn + 2, size - 6, 0, 0, 0, false };
+    unsigned char *pDest = (unsigned char *)pOut;
+    size_t outPos = 0;
+    Huffman literals, distances;
+    bool last;
+    do {
+        last = getBits(&reader, 1) != 0;
+        int type = getBits(&reader, 2);
+        if (type == 0) {
+            // Stored:  the rest of this byte is padding
+            reader.bits = 0;
+            reader.bitCount = 0;
+            if (reader.inSize - reader.inPos < 4) {
+                return false;
+            }
+            const unsigned char *pHeader = reader.pIn + reader.inPos;
+            size_t length = pHeader[0] | (pHeader[1] << 8);
+            if (size_t(pHeader[2] | (pHeader[3] << 8)) != (~length & 0xFFFF)) {
+                return false;
+            }
+            reader.inPos += 4;
+            if (length > reader.inSize - reader.inPos || length > outSize - outPos) {
+                return false;
+            }
+            memcpy(pDest + outPos, reader.pIn + reader.inPos, length);
+            reader.inPos += length;
+            outPos += length;
+            continue;
+        }
+        if (type == 1) {
+            fixedHuffman(&literals, &distances);
+        }
+        else if (type != 2 || !dynamicHuffman(&reader, &literals, &distances)) {
+            return false;
+        }
+        if (!inflateCodes(&reader, &literals, &distances, pDest, outSize, &outPos)) {
+            return false;
+        }
+    } while (!last && !reader.overrun);
+
+    if (reader.overrun || outPos != outSize) {
+        return false;
+    }
+    // The checksum follows the last byte of the deflate data
+    const unsigned char *pCheck = pIn + size - 4;
+    uint32_t check = (uint32_t(pCheck[0]) << 24) | (pCheck[1] << 16) | (pCheck[2] << 8) | pCheck[3];
+    return check == adler32(pDest, outSize);
+}
+
+// Compression
+
+typedef struct {
+    unsigned char *pOut;
+    size_t outPos;
+    uint32_t bits;
+    int bitCount;
+} BitWriter;
+
+static void putBits(BitWriter *pWriter, uint32_t value, int count)
+{
+    pWriter->bits |= value << pWriter->bitCount;
+    pWriter->bitCount += count;
+    while (pWriter->bitCount >= 8) {
+        pWriter->pOut[pWriter->outPos++] = (unsigned char)pWriter->bits;
+        pWriter->bits >>= 8;
+        pWriter->bitCount -= 8;
+    }
+}
+
+// Huffman codes go most significant bit first
+static void putCode(BitWriter *pWriter, uint32_t code, int length)
+{
+    uint32_t reversed = 0;
+    for (int i = 0; i < length; i++) {
+        reversed = (reversed << 1) | ((code >> i) & 1);
+    }
+    putBits(pWriter, reversed, length);
+}
+
+static void putLiteral(BitWriter *pWriter, int symbol)
+{
+    if (symbol < 144) {
+        putCode(pWriter, 0x30 + symbol, 8);
+    }
+    else if (symbol < 256) {
+        putCode(pWriter, 0x190 + symbol - 144, 9);
+    }
+    else if (symbol < 280) {
+        putCode(pWriter, symbol - 256, 7);
+    }
+    else {
+        putCode(pWriter, 0xC0 + symbol - 280, 8);
+    }
+}
+
+static void putMatch(BitWriter *pWriter, int length, int distance)
+{
+    int code = 28;
+    while (lengthBase[code] > length) {
+        code--;
+    }
+    putLiteral(pWriter, 257 + code);
+    putBits(pWriter, length - lengthBase[code], lengthExtra[code]);
+
+    code = DISTANCE_CODES - 1;
+    while (distanceBase[code] > distance) {
+        code--;
+    }
+    putCode(pWriter, code, 5);
+    putBits(pWriter, distance - distanceBase[code], distanceExtra[code]);
+}
+
+size_t zlibBound(size_t size)
+{
+    // Literals are at most nine bits
+    return size + size / 8 + 16;
+}
+
+size_t zlibCompress(const void *pData, size_t size, void *pOut)
+{
+    const unsigned char *pIn = (const unsigned char *)pData;
+    BitWriter writer = { (unsigned char *)pOut, 0, 0, 0 };
+
+    // Deflate, 32K window, default compression level
+    writer.pOut[writer.outPos++] = 0x78;
+    writer.pOut[writer.outPos++] = 0x9C;
+
+    // One final block with the fixed codes
+    putBits(&writer, 1, 1);
+    putBits(&writer, 1, 2);
+
+    // Where each three byte hash was last seen
+    std::vector<int> lastSeen(1 << HASH_BITS, -1);
+    size_t pos = 0;
+    while (pos < size) {
+        int length = 0;
+        if (size - pos >= MIN_MATCH) {
+            uint32_t hash = ((pIn[pos] << 16) | (pIn[pos + 1] << 8) | pIn[pos + 2]) * 2654435761u >> (32 - HASH_BITS);
+            int candidate = lastSeen[hash];
+            lastSeen[hash] = int(pos);
+            if (candidate >= 0 && pos - candidate <= WINDOW_SIZE) {
+                size_t longest = size - pos < MAX_MATCH ? size - pos : MAX_MATCH;
+                while (size_t(length) < longest && pIn[candidate + length] == pIn[pos + length]) {
+                    length++;
+                }
+                if (length >= MIN_MATCH) {
+                    putMatch(&writer, length, int(pos - candidate));
+                }
+            }
+        }
+        if (length >= MIN_MATCH) {
+            pos += length;
+        }
+        else {
+            putLiteral(&writer, pIn[pos++]);
+        }
+    }
+    putLiteral(&writer, 256);
+    if (writer.bitCount > 0) {
+        putBits(&writer, 0, 8 - writer.bitCount);
+    }
+
+    uint32_t check = adler32(pIn, size);
+    writer.pOut[writer.outPos++] = (unsigned char)(check >> 24);
+    writer.pOut[writer.outPos++] = (unsigned char)(check >> 16);
+    writer.pOut[writer.outPos++] = (unsigned char)(check >> 8);
+    writer.pOut[writer.outPos++] = (unsigned char)check;
+    return writer.outPos;
+}
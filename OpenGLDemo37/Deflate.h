@@ -0,0 +1,29 @@
+/*
+ * zlib streams (RFC 1950 around RFC 1951 deflate), without zlib.
+ *
+ * zlibDecompress handles everything a deflate stream can hold:  stored,
+ * fixed and dynamic Huffman blocks.  It decodes one bit at a time against
+ * canonical code counts, which is slow next to zlib's table lookups but
+ * small, and it writes straight into the caller's buffer with every length
+ * and distance checked against it, so a bad stream can't write outside.
+ *
+ * zlibCompress is only here so the demo can make its own supercompressed
+ * files:  a single fixed Huffman block and greedy matching through a one
+ * entry hash table.  It compresses worse than zlib but any inflater reads it.
+ */
+#ifndef DEFLATE_H
+#define DEFLATE_H
+
+#include <stddef.h>
+
+// Largest zlibCompress output for size bytes of input
+size_t zlibBound(size_t size);
+
+// Returns the compressed size
+size_t zlibCompress(const void *pData, size_t size, void *pOut);
+
+// Returns false unless the stream is well formed, its checksum matches and
+// it holds exactly outSize bytes
+bool zlibDecompress(const void *pData, size_t size, void *pOut, size_t outSize);
+
+#endif
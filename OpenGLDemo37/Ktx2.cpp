@@ -0,0 +1,501 @@
+/*
+ * KTX2 textures.  See Ktx2.h.
+ */
+#include <windows.h>
+
+#include "Ktx2.h"
+#include "Deflate.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <atomic>
+#include <thread>
+#include <vector>
+
+static const unsigned char ktxIdentifier[12] = {
+    0xAB, 'K', 'T', 'X', ' ', '2', '0', 0xBB, '\r', '\n', 0x1A, '\n' };
+
+typedef struct {
+    unsigned char identifier[12];
+    uint32_t vkFormat, typeSize;
+    uint32_t pixelWidth, pixelHeight, pixelDepth;
+    uint32_t layerCount, faceCount, levelCount;
+    uint32_t supercompressionScheme;
+    uint32_t dfdByteOffset, dfdByteLength;
+    uint32_t kvdByteOffset, kvdByteLength;
+    uint64_t sgdByteOffset, sgdByteLength;
+} KtxHeader;
+
+// The level index follows the header directly
+#define LEVEL_INDEX_OFFSET sizeof(KtxHeader)
+
+static const KtxFormat formats[] = {
+    { 9, GL_R8, GL_RED, GL_UNSIGNED_BYTE, 1, 1, "R8_UNORM" },
+    { 16, GL_RG8, GL_RG, GL_UNSIGNED_BYTE, 2, 1, "R8G8_UNORM" },
+    { 37, GL_RGBA8, GL_RGBA, GL_UNSIGNED_BYTE, 4, 1, "R8G8B8A8_UNORM" },
+    { 43, GL_SRGB8_ALPHA8, GL_RGBA, GL_UNSIGNED_BYTE, 4, 1, "R8G8B8A8_SRGB" },
+    { 44, GL_RGBA8, GL_BGRA, GL_UNSIGNED_BYTE, 4, 1, "B8G8R8A8_UNORM" },
+    { 97, GL_RGBA16F, GL_RGBA, GL_HALF_FLOAT, 8, 1, "R16G16B16A16_SFLOAT" },
+    { 109, GL_RGBA32F, GL_RGBA, GL_FLOAT, 16, 1, "R32G32B32A32_SFLOAT" },
+    { 131, GL_COMPRESSED_RGB_S3TC_DXT1_EXT, 0, 0, 8, 4, "BC1_RGB_UNORM" },
+    { 132, GL_COMPRESSED_SRGB_S3TC_DXT1_EXT, 0, 0, 8, 4, "BC1_RGB_SRGB" },
+    { 133, GL_COMPRESSED_RGBA_S3TC_DXT1_EXT, 0, 0, 8, 4, "BC1_RGBA_UNORM" },
+    { 134, GL_COMPRESSED_SRGB_ALPHA_S3TC_DXT1_EXT, 0, 0, 8, 4, "BC1_RGBA_SRGB" },
+    { 135, GL_COMPRESSED_RGBA_S3TC_DXT3_EXT, 0, 0, 16, 4, "BC2_UNORM" },
+    { 136, GL_COMPRESSED_SRGB_ALPHA_S3TC_DXT3_EXT, 0, 0, 16, 4, "BC2_SRGB" },
+    { 137, GL_COMPRESSED_RGBA_S3TC_DXT5_EXT, 0, 0, 16, 4, "BC3_UNORM" },
+    { 138, GL_COMPRESSED_SRGB_ALPHA_S3TC_DXT5_EXT, 0, 0, 16, 4, "BC3_SRGB" },
+    { 139, GL_COMPRESSED_RED_RGTC1, 0, 0, 8, 4, "BC4_UNORM" },
+    { 140, GL_COMPRESSED_SIGNED_RED_RGTC1, 0, 0, 8, 4, "BC4_SNORM" },
+    { 141, GL_COMPRESSED_RG_RGTC2, 0, 0, 16, 4, "BC5_UNORM" },
+    { 142, GL_COMPRESSED_SIGNED_RG_RGTC2, 0, 0, 16, 4, "BC5_SNORM" },
+    { 143, GL_COMPRESSED_RGB_BPTC_UNSIGNED_FLOAT, 0, 0, 16, 4, "BC6H_UFLOAT" },
+    { 144, GL_COMPRESSED_RGB_BPTC_SIGNED_FLOAT, 0, 0, 16, 4, "BC6H_SFLOAT" },
+    { 145, GL_COMPRESSED_RGBA_BPTC_UNORM, 0, 0, 16, 4, "BC7_UNORM" },
+    { 146, GL_COMPRESSED_SRGB_ALPHA_BPTC_UNORM, 0, 0, 16, 4, "BC7_SRGB" },
+    { 147, GL_COMPRESSED_RGB8_ETC2, 0, 0, 8, 4, "ETC2_R8G8B8_UNORM" },
+    { 148, GL_COMPRESSED_SRGB8_ETC2, 0, 0, 8, 4, "ETC2_R8G8B8_SRGB" },
+    { 149, GL_COMPRESSED_RGB8_PUNCHTHROUGH_ALPHA1_ETC2, 0, 0, 8, 4, "ETC2_R8G8B8A1_UNORM" },
+    { 150, GL_COMPRESSED_SRGB8_PUNCHTHROUGH_ALPHA1_ETC2, 0, 0, 8, 4, "ETC2_R8G8B8A1_SRGB" },
+    { 151, GL_COMPRESSED_RGBA8_ETC2_EAC, 0, 0, 16, 4, "ETC2_R8G8B8A8_UNORM" },
+    { 152, GL_COMPRESSED_SRGB8_ALPHA8_ETC2_EAC, 0, 0, 16, 4, "ETC2_R8G8B8A8_SRGB" },
+};
+
+static const KtxFormat *findFormat(uint32_t vkFormat)
+{
+    for (size_t i = 0; i < sizeof(formats) / sizeof(formats[0]); i++) {
+        if (formats[i].vkFormat == vkFormat) {
+            return &formats[i];
+        }
+    }
+    return NULL;
+}
+
+// Compressed formats come in families, each with its own extension
+static bool formatSupported(const KtxFormat *pFormat)
+{
+    uint32_t vkFormat = pFormat->vkFormat;
+    if (vkFormat >= 131 && vkFormat <= 138) {
+        return GLEW_EXT_texture_compression_s3tc != 0;
+    }
+    if (vkFormat >= 139 && vkFormat <= 142) {
+        return GLEW_ARB_texture_compression_rgtc != 0;
+    }
+    if (vkFormat >= 143 && vkFormat <= 146) {
+        return GLEW_ARB_texture_compression_bptc != 0;
+    }
+    if (vkFormat >= 147 && vkFormat <= 152) {
+        return GLEW_ARB_ES3_compatibility != 0;
+    }
+    return true;
+}
+
+static uint32_t maxLevels(uint32_t width, uint32_t height)
+{
+    uint32_t levels = 1;
+    for (uint32_t size = width > height ? width : height; size > 1; size >>= 1) {
+        levels++;
+    }
+    return levels;
+}
+
+// One face of one level
+static uint64_t imageSize(const KtxFormat *pFormat, uint32_t width, uint32_t height, uint32_t level)
+{
+    uint64_t levelWidth = width >> level > 0 ? width >> level : 1;
+    uint64_t levelHeight = height >> level > 0 ? height >> level : 1;
+    uint64_t blocksWide = (levelWidth + pFormat->blockSize - 1) / pFormat->blockSize;
+    uint64_t blocksHigh = (levelHeight + pFormat->blockSize - 1) / pFormat->blockSize;
+    return blocksWide * blocksHigh * pFormat->blockBytes;
+}
+
+static const char *validate(KtxTexture *pTexture)
+{
+    if (pTexture->size < sizeof(KtxHeader) || memcmp(pTexture->pBase, ktxIdentifier, sizeof(ktxIdentifier)) != 0) {
+        return "not a KTX2 file";
+    }
+    const KtxHeader *pHeader = (const KtxHeader *)pTexture->pBase;
+    switch (pHeader->supercompressionScheme) {
+    case KTX_SUPERCOMPRESSION_NONE:
+    case KTX_SUPERCOMPRESSION_ZLIB:
+        break;
+    case KTX_SUPERCOMPRESSION_BASISLZ:
+        return "BasisLZ needs transcoding, which isn't supported";
+    case KTX_SUPERCOMPRESSION_ZSTD:
+        return "Zstandard supercompression isn't supported";
+    default:
+        return "unknown supercompression";
+    }
+    pTexture->pFormat = findFormat(pHeader->vkFormat);
+    if (!pTexture->pFormat) {
+        return "format has no GL equivalent here";
+    }
+    if (pHeader->pixelWidth == 0 || pHeader->pixelHeight == 0 || pHeader->pixelDepth != 0 || pHeader->layerCount != 0) {
+        return "only 2D textures and cube maps are supported";
+    }
+    if (pHeader->faceCount != 1 && (pHeader->faceCount != 6 || pHeader->pixelWidth != pHeader->pixelHeight)) {
+        return "bad face count";
+    }
+
+    pTexture->width = pHeader->pixelWidth;
+    pTexture->height = pHeader->pixelHeight;
+    pTexture->faceCount = pHeader->faceCount;
+    pTexture->supercompression = pHeader->supercompressionScheme;
+    uint32_t mostLevels = maxLevels(pTexture->width, pTexture->height);
+    // A level count of 0 asks the loader to make the mips
+    pTexture->generateMips = pHeader->levelCount == 0;
+    pTexture->levelCount = pTexture->generateMips ? 1 : pHeader->levelCount;
+    pTexture->storageLevels = pTexture->generateMips ? mostLevels : pTexture->levelCount;
+    if (pTexture->levelCount > mostLevels || pTexture->storageLevels > KTX_MAX_LEVELS) {
+        return "more levels than the size allows";
+    }
+    if (pTexture->generateMips && pTexture->pFormat->format == 0) {
+        return "the GL can't make mips of a compressed format";
+    }
+
+    if (pTexture->size - LEVEL_INDEX_OFFSET < pTexture->levelCount * sizeof(KtxLevel)) {
+        return "level index runs past the end";
+    }
+    pTexture->pLevels = (const KtxLevel *)(pTexture->pBase + LEVEL_INDEX_OFFSET);
+    for (uint32_t level = 0; level < pTexture->levelCount; level++) {
+        const KtxLevel &entry = pTexture->pLevels[level];
+        if (entry.offset > pTexture->size || entry.length > pTexture->size - entry.offset) {
+            return "level runs past the end";
+        }
+        uint64_t expected = imageSize(pTexture->pFormat, pTexture->width, pTexture->height, level) * pTexture->faceCount;
+        if (entry.uncompressedLength != expected) {
+            return "level size doesn't match its dimensions";
+        }
+        if (pTexture->supercompression == KTX_SUPERCOMPRESSION_NONE && entry.length != expected) {
+            return "level size doesn't match its dimensions";
+        }
+    }
+    return NULL;
+}
+
+bool ktxOpen(const char *pPath, KtxTexture *pTexture)
+{
+    memset(pTexture, 0, sizeof(*pTexture));
+
+    HANDLE hFile = CreateFileA(pPath, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+    if (hFile == INVALID_HANDLE_VALUE) {
+        printf("Can't open %s\n", pPath);
+        return false;
+    }
+    LARGE_INTEGER size;
+    if (!GetFileSizeEx(hFile, &size) || size.QuadPart == 0) {
+        printf("%s is empty\n", pPath);
+        CloseHandle(hFile);
+        return false;
+    }
+    HANDLE hMapping = CreateFileMappingA(hFile, NULL, PAGE_READONLY, 0, 0, NULL);
+    const void *pView = hMapping ? MapViewOfFile(hMapping, FILE_MAP_READ, 0, 0, 0) : NULL;
+    if (!pView) {
+        printf("Can't map %s\n", pPath);
+        if (hMapping) {
+            CloseHandle(hMapping);
+        }
+        CloseHandle(hFile);
+        return false;
+    }
+
+    pTexture->pBase = (const unsigned char *)pView;
+    pTexture->size = size_t(size.QuadPart);
+    pTexture->hFile = hFile;
+    pTexture->hMapping = hMapping;
+
+    const char *pError = validate(pTexture);
+    if (pError) {
+        printf("Can't use %s:  %s\n", pPath, pError);
+        ktxClose(pTexture);
+        return false;
+    }
+    return true;
+}
+
+void ktxClose(KtxTexture *pTexture)
+{
+    for (int level = 0; level < KTX_MAX_LEVELS; level++) {
+        free(pTexture->pDecoded[level]);
+    }
+    if (pTexture->pBase) {
+        UnmapViewOfFile(pTexture->pBase);
+    }
+    if (pTexture->hMapping) {
+        CloseHandle(pTexture->hMapping);
+    }
+    if (pTexture->hFile) {
+        CloseHandle(pTexture->hFile);
+    }
+    memset(pTexture, 0, sizeof(*pTexture));
+}
+
+// Each thread takes the next level not yet taken.  Level 0 comes first and
+// is the biggest, so it starts while the rest are shared out.
+static void decodeLevels(KtxTexture *pTexture, std::atomic<int> *pNext, std::atomic<bool> *pFailed)
+{
+    for (int level = (*pNext)++; level < int(pTexture->levelCount); level = (*pNext)++) {
+        const KtxLevel &entry = pTexture->pLevels[level];
+        if (!zlibDecompress(pTexture->pBase + entry.offset, size_t(entry.length),
+            pTexture->pDecoded[level], size_t(entry.uncompressedLength))) {
+            *pFailed = true;
+        }
+    }
+}
+
+// A texture is only decoded if every level is, so a failure drops them all
+static void freeDecoded(KtxTexture *pTexture)
+{
+    for (uint32_t level = 0; level < pTexture->levelCount; level++) {
+        free(pTexture->pDecoded[level]);
+        pTexture->pDecoded[level] = NULL;
+    }
+}
+
+bool ktxDecode(KtxTexture *pTexture, int threadCount)
+{
+    if (pTexture->supercompression != KTX_SUPERCOMPRESSION_ZLIB || pTexture->pDecoded[0]) {
+        return true;
+    }
+    for (uint32_t level = 0; level < pTexture->levelCount; level++) {
+        pTexture->pDecoded[level] = (unsigned char *)malloc(size_t(pTexture->pLevels[level].uncompressedLength));
+        if (!pTexture->pDecoded[level]) {
+            printf("Out of memory inflating a texture\n");
+            freeDecoded(pTexture);
+            return false;
+        }
+    }
+
+    if (threadCount <= 0) {
+        threadCount = int(std::thread::hardware_concurrency());
+        if (threadCount <= 0) {
+            threadCount = 1;
+        }
+    }
+    if (threadCount > int(pTexture->levelCount)) {
+        threadCount = int(pTexture->levelCount);
+    }
+
+    // The calling thread decodes alongside the workers
+    std::atomic<int> next(0);
+    std::atomic<bool> failed(false);
+    std::vector<std::thread> workers;
+    for (int t = 1; t < threadCount; t++) {
+        workers.push_back(std::thread(decodeLevels, pTexture, &next, &failed));
+    }
+    decodeLevels(pTexture, &next, &failed);
+    for (size_t t = 0; t < workers.size(); t++) {
+        workers[t].join();
+    }
+
+    if (failed) {
+        printf("A supercompressed texture level is corrupt\n");
+        freeDecoded(pTexture);
+        return false;
+    }
+    return true;
+}
+
+GLuint ktxCreateTexture(const KtxTexture *pTexture)
+{
+    if (pTexture->supercompression == KTX_SUPERCOMPRESSION_ZLIB && !pTexture->pDecoded[0]) {
+        return 0;
+    }
+    const KtxFormat *pFormat = pTexture->pFormat;
+    if (!formatSupported(pFormat)) {
+        printf("The GL doesn't have %s\n", pFormat->pName);
+        return 0;
+    }
+
+    GLenum target = pTexture->faceCount == 6 ? GL_TEXTURE_CUBE_MAP : GL_TEXTURE_2D;
+    GLuint texture;
+    glGenTextures(1, &texture);
+    glBindTexture(target, texture);
+    glTexStorage2D(target, pTexture->storageLevels, pFormat->internalFormat, pTexture->width, pTexture->height);
+
+    // KTX2 rows are tightly packed
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+    for (uint32_t level = 0; level < pTexture->levelCount; level++) {
+        GLsizei width = pTexture->width >> level > 0 ? pTexture->width >> level : 1;
+        GLsizei height = pTexture->height >> level > 0 ? pTexture->height >> level : 1;
+        GLsizei faceBytes = GLsizei(imageSize(pFormat, pTexture->width, pTexture->height, level));
+        const unsigned char *pLevel = pTexture->pDecoded[level] ?
+            pTexture->pDecoded[level] : pTexture->pBase + pTexture->pLevels[level].offset;
+        for (uint32_t face = 0; face < pTexture->faceCount; face++) {
+            GLenum faceTarget = pTexture->faceCount == 6 ? GL_TEXTURE_CUBE_MAP_POSITIVE_X + face : GL_TEXTURE_2D;
+            const unsigned char *pFace = pLevel + face * faceBytes;
+            if (pFormat->format == 0) {
+                glCompressedTexSubImage2D(faceTarget, level, 0, 0, width, height, pFormat->internalFormat, faceBytes, pFace);
+            }
+            else {
+                glTexSubImage2D(faceTarget, level, 0, 0, width, height, pFormat->format, pFormat->type, pFace);
+            }
+        }
+    }
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+
+    if (pTexture->generateMips) {
+        glGenerateMipmap(target);
+    }
+    glTexParameteri(target, GL_TEXTURE_MIN_FILTER, pTexture->storageLevels > 1 ? GL_LINEAR_MIPMAP_LINEAR : GL_LINEAR);
+    glTexParameteri(target, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    return texture;
+}
+
+GLuint ktxLoad(const char *pPath)
+{
+    KtxTexture texture;
+    if (!ktxOpen(pPath, &texture)) {
+        return 0;
+    }
+    GLuint textureId = ktxDecode(&texture, 0) ? ktxCreateTexture(&texture) : 0;
+    ktxClose(&texture);
+    return textureId;
+}
+
+// Writing
+
+static void put8(std::vector<unsigned char> *pOut, uint32_t value)
+{
+    pOut->push_back((unsigned char)value);
+}
+
+static void put16(std::vector<unsigned char> *pOut, uint32_t value)
+{
+    put8(pOut, value & 0xFF);
+    put8(pOut, value >> 8);
+}
+
+static void put32(std::vector<unsigned char> *pOut, uint32_t value)
+{
+    put16(pOut, value & 0xFFFF);
+    put16(pOut, value >> 16);
+}
+
+// bitLength and the channel go in as the format describes them
+static void putSample(std::vector<unsigned char> *pOut, uint32_t bitOffset, uint32_t bitLength, uint32_t channel,
+    uint32_t upper)
+{
+    put16(pOut, bitOffset);
+    put8(pOut, bitLength - 1);
+    put8(pOut, channel);
+    put32(pOut, 0);         // Sample position
+    put32(pOut, 0);         // Lower
+    put32(pOut, upper);
+}
+
+// The basic data format descriptor:  how the bits of a texel or block map
+// to color channels
+static bool describeFormat(const KtxFormat *pFormat, bool supercompressed, std::vector<unsigned char> *pOut)
+{
+    enum { MODEL_RGBSDA = 1, MODEL_BC1A = 128 };
+    enum { TRANSFER_LINEAR = 1, TRANSFER_SRGB = 2 };
+    enum { CHANNEL_ALPHA = 15, QUALIFIER_LINEAR = 0x10 };
+
+    bool rgba8 = pFormat->vkFormat == VK_FORMAT_R8G8B8A8_UNORM || pFormat->vkFormat == VK_FORMAT_R8G8B8A8_SRGB;
+    bool srgb = pFormat->vkFormat == VK_FORMAT_R8G8B8A8_SRGB;
+    if (!rgba8 && pFormat->vkFormat != VK_FORMAT_BC1_RGB_UNORM_BLOCK) {
+        return false;
+    }
+    int samples = rgba8 ? 4 : 1;
+    put32(pOut, 4 + 24 + 16 * samples);     // Total size
+    put32(pOut, 0);                         // Khronos, basic descriptor
+    put16(pOut, 2);                         // Version
+    put16(pOut, 24 + 16 * samples);
+    put8(pOut, rgba8 ? MODEL_RGBSDA : MODEL_BC1A);
+    put8(pOut, 1);                          // BT.709 primaries
+    put8(pOut, srgb ? TRANSFER_SRGB : TRANSFER_LINEAR);
+    put8(pOut, 0);                          // Straight alpha
+    for (int axis = 0; axis < 4; axis++) {
+        put8(pOut, axis < 2 ? pFormat->blockSize - 1 : 0);
+    }
+    // Supercompressed data has no fixed bytes per block
+    put8(pOut, supercompressed ? 0 : pFormat->blockBytes);
+    for (int plane = 1; plane < 8; plane++) {
+        put8(pOut, 0);
+    }
+    if (rgba8) {
+        for (uint32_t channel = 0; channel < 3; channel++) {
+            putSample(pOut, channel * 8, 8, channel, 255);
+        }
+        putSample(pOut, 24, 8, CHANNEL_ALPHA | (srgb ? QUALIFIER_LINEAR : 0), 255);
+    }
+    else {
+        putSample(pOut, 0, 64, 0, 0xFFFFFFFF);
+    }
+    return true;
+}
+
+bool ktxWrite(const char *pPath, uint32_t vkFormat, uint32_t width, uint32_t height, uint32_t levelCount,
+    const void *const *ppLevels, const size_t *pLevelSizes, bool zlib)
+{
+    const KtxFormat *pFormat = findFormat(vkFormat);
+    std::vector<unsigned char> descriptor;
+    if (!pFormat || !describeFormat(pFormat, zlib, &descriptor)) {
+        printf("Can't write format %u\n", vkFormat);
+        return false;
+    }
+    if (levelCount == 0 || levelCount > maxLevels(width, height) || levelCount > KTX_MAX_LEVELS) {
+        printf("Can't write %u levels of %ux%u\n", levelCount, width, height);
+        return false;
+    }
+
+    std::vector<std::vector<unsigned char> > compressed(levelCount);
+    std::vector<KtxLevel> levels(levelCount);
+    for (uint32_t level = 0; level < levelCount; level++) {
+        if (pLevelSizes[level] != imageSize(pFormat, width, height, level)) {
+            printf("Level %u is the wrong size\n", level);
+            return false;
+        }
+        levels[level].length = levels[level].uncompressedLength = pLevelSizes[level];
+        if (zlib) {
+            compressed[level].resize(zlibBound(pLevelSizes[level]));
+            compressed[level].resize(zlibCompress(ppLevels[level], pLevelSizes[level], &compressed[level][0]));
+            levels[level].length = compressed[level].size();
+        }
+    }
+
+    KtxHeader header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.identifier, ktxIdentifier, sizeof(ktxIdentifier));
+    header.vkFormat = vkFormat;
+    header.typeSize = 1;       // Component size, and 1 for block formats
+    header.pixelWidth = width;
+    header.pixelHeight = height;
+    header.faceCount = 1;
+    header.levelCount = levelCount;
+    header.supercompressionScheme = zlib ? KTX_SUPERCOMPRESSION_ZLIB : KTX_SUPERCOMPRESSION_NONE;
+    header.dfdByteOffset = uint32_t(LEVEL_INDEX_OFFSET + levelCount * sizeof(KtxLevel));
+    header.dfdByteLength = uint32_t(descriptor.size());
+
+    // Levels go smallest first, each aligned to its block size and 4 unless
+    // supercompressed
+    uint64_t align = zlib ? 1 : pFormat->blockBytes % 4 == 0 ? pFormat->blockBytes : 4;
+    uint64_t offset = header.dfdByteOffset + header.dfdByteLength;
+    for (int level = int(levelCount) - 1; level >= 0; level--) {
+        offset = (offset + align - 1) / align * align;
+        levels[level].offset = offset;
+        offset += levels[level].length;
+    }
+
+    FILE *pFile = fopen(pPath, "wb");
+    if (!pFile) {
+        printf("Can't write %s\n", pPath);
+        return false;
+    }
+    fwrite(&header, sizeof(header), 1, pFile);
+    fwrite(&levels[0], sizeof(KtxLevel), levelCount, pFile);
+    fwrite(&descriptor[0], 1, descriptor.size(), pFile);
+    static const unsigned char padding[16] = { 0 };
+    uint64_t written = header.dfdByteOffset + header.dfdByteLength;
+    for (int level = int(levelCount) - 1; level >= 0; level--) {
+        fwrite(padding, 1, size_t(levels[level].offset - written), pFile);
+        const void *pData = zlib ? &compressed[level][0] : ppLevels[level];
+        fwrite(pData, 1, size_t(levels[level].length), pFile);
+        written = levels[level].offset + levels[level].length;
+    }
+    bool ok = ferror(pFile) == 0;
+    fclose(pFile);
+    return ok;
+}
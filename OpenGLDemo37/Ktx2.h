@@ -0,0 +1,91 @@
+/*
+ * KTX2 textures, loaded from a memory-mapped file.
+ *
+ * ktxOpen maps the file and checks it against what glTexStorage2D will be
+ * asked for:  a 2D texture or cube map with a format the GL has, no more
+ * levels than the size allows, and every level exactly the size its
+ * dimensions call for and inside the file.  Nothing is copied; the level
+ * index is read where it lies.
+ *
+ * Levels without supercompression go straight from the mapping to
+ * glTexSubImage2D or glCompressedTexSubImage2D.  ZLIB-supercompressed
+ * levels are inflated first by ktxDecode, which spreads the levels over
+ * worker threads, largest first, into one buffer per level.  BasisLZ and
+ * Zstandard files are refused; so are arrays, 3D textures and formats
+ * that aren't in the table in Ktx2.cpp.
+ *
+ * ktxWrite makes 2D files, with or without ZLIB, for the formats it can
+ * describe (8-bit RGBA and BC1).
+ */
+#ifndef KTX2_H
+#define KTX2_H
+
+#include <GL/glew.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#define KTX_MAX_LEVELS  16
+
+#define VK_FORMAT_R8G8B8A8_UNORM    37
+#define VK_FORMAT_R8G8B8A8_SRGB     43
+#define VK_FORMAT_BC1_RGB_UNORM_BLOCK 131
+
+typedef enum {
+    KTX_SUPERCOMPRESSION_NONE,
+    KTX_SUPERCOMPRESSION_BASISLZ,
+    KTX_SUPERCOMPRESSION_ZSTD,
+    KTX_SUPERCOMPRESSION_ZLIB,
+} KtxSupercompression;
+
+typedef struct {
+    uint32_t vkFormat;
+    GLenum internalFormat;
+    GLenum format, type;        // 0 for compressed formats
+    uint32_t blockBytes;        // Per pixel, or per block when compressed
+    uint32_t blockSize;         // 1, or 4 for 4x4 blocks
+    const char *pName;
+} KtxFormat;
+
+typedef struct {
+    uint64_t offset, length;    // In the file
+    uint64_t uncompressedLength;
+} KtxLevel;
+
+typedef struct {
+    const unsigned char *pBase;
+    size_t size;
+    void *hFile, *hMapping;
+
+    const KtxFormat *pFormat;
+    uint32_t width, height;
+    uint32_t faceCount;         // 1, or 6 for a cube map
+    uint32_t levelCount;        // In the file
+    uint32_t storageLevels;     // For glTexStorage2D
+    bool generateMips;          // The file has one level and asks for the rest
+    uint32_t supercompression;
+    const KtxLevel *pLevels;    // In the mapping
+
+    unsigned char *pDecoded[KTX_MAX_LEVELS];  // Inflated levels, from ktxDecode
+} KtxTexture;
+
+// Prints the reason and returns false if the file can't be used
+bool ktxOpen(const char *pPath, KtxTexture *pTexture);
+void ktxClose(KtxTexture *pTexture);
+
+// Inflates supercompressed levels on up to threadCount threads, counting the
+// caller; 0 means one per core.  Does nothing if there is no
+// supercompression.  Returns false if a level is corrupt.
+bool ktxDecode(KtxTexture *pTexture, int threadCount);
+
+// Allocates with glTexStorage2D and uploads every level.  Returns 0 if the
+// GL doesn't have the format, or the texture still needs ktxDecode.
+GLuint ktxCreateTexture(const KtxTexture *pTexture);
+
+// ktxOpen, ktxDecode, ktxCreateTexture and ktxClose
+GLuint ktxLoad(const char *pPath);
+
+// ppLevels and pLevelSizes are largest level first
+bool ktxWrite(const char *pPath, uint32_t vkFormat, uint32_t width, uint32_t height, uint32_t levelCount,
+    const void *const *ppLevels, const size_t *pLevelSizes, bool zlib);
+
+#endif
@@ -0,0 +1,433 @@
+/*
+ * Demo 37:
+ * Loading KTX2 textures (see Ktx2.h).  Each file is memory-mapped and
+ * checked, its mip levels go to the GL straight from the mapping, and ZLIB
+ * supercompressed levels are inflated on worker threads first.  Each load
+ * is timed in its three steps.
+ *
+ * Give .ktx2 files on the command line to load those.  Otherwise the demo
+ * loads four of its own, written the first time it runs:  a ring pattern
+ * with its whole mip chain, as RGBA8 and BC1, each with and without ZLIB.
+ * They are drawn on receding planes, so the smaller levels show.
+ *
+ * Press L to load them all again; any other key exits.
+ *
+ * See README.txt for prerequisites.
+ */
+#include <windows.h>
+#include <WinGDI.h>
+
+#include <GL/glew.h>
+#include <GL/wglew.h>
+#include <GL/GL.h>
+#include <GL/glut.h>
+
+#include <stdio.h>
+#include <stddef.h>
+#include <vector>
+
+#include <vmath.h>
+using vmath::mat4;
+
+#include "Ktx2.h"
+
+// Apparently someone is still using segmented memory qualifiers,
+// and windows.h is letting them.
+#undef near
+#undef far
+
+#define CENTER_Z        6.0f     // Distance from camera
+#define DEPTH_OF_FIELD  8.0f
+
+#define PATTERN_SIZE    1024
+#define PATTERN_LEVELS  11
+
+#define MAX_TEXTURES    8
+
+typedef struct {
+    GLsizei count;
+    GLuint vaoId;
+} ShapeInfo;
+
+typedef struct {
+    const char *pPath;
+    GLuint textureId;
+} TextureInfo;
+
+ShapeInfo g_Quad;
+TextureInfo g_Textures[MAX_TEXTURES];
+int g_TextureCount;
+mat4 g_ProjectionMatrix(mat4::identity());
+
+static const char *demoFiles[] = {
+    "pattern_rgba.ktx2",
+    "pattern_rgba_zlib.ktx2",
+    "pattern_bc1.ktx2",
+    "pattern_bc1_zlib.ktx2",
+};
+
+// Must match hard-coded vPosition location in vertShaderSource
+#define V_POSITION 0
+
+// Must match hard-coded vTexture location in vertShaderSource
+#define T_POSITION 2
+
+// Must match hard-coded ModelViewProject location in vertShaderSource
+#define MATRIX_LOCATION 0
+
+void setupShaders()
+{
+    GLchar infoLog[4096];
+    GLsizei length;
+
+    const GLchar *vertShaderSource[] = {
+        "#version 430 core\n"
+        "layout(location = 0) uniform mat4 ModelViewProject;\n"
+        "layout(location = 0) in vec4 vPosition;\n"
+        "layout(location = 2) in vec2 vTexture;\n"
+        "out vec2 vs_tex_coord;\n"
+        "void main() {\n"
+        "    gl_Position = ModelViewProject * vPosition;\n"
+        "    vs_tex_coord = vTexture;\n"
+        "}\n"
+    };
+    GLuint vertShader = glCreateShader(GL_VERTEX_SHADER);
+    glShaderSource(vertShader, 1, vertShaderSource, NULL);
+
+    const GLchar *fragShaderSource[] = {
+        "#version 430 core\n"
+        "layout(binding = 0) uniform sampler2D tex;\n"
+        "in vec2 vs_tex_coord;\n"
+        "out vec4 fColor;\n"
+        "void main() {\n"
+        "    fColor = texture(tex, vs_tex_coord);\n"
+        "}\n"
+    };
+    GLuint fragShader = glCreateShader(GL_FRAGMENT_SHADER);
+    glShaderSource(fragShader, 1, fragShaderSource, NULL);
+
+    GLuint program = glCreateProgram();
+    glAttachShader(program, vertShader);
+    glCompileShader(vertShader);
+    glGetShaderInfoLog(vertShader, 4096, &length, infoLog);
+
+    glAttachShader(program, fragShader);
+    glCompileShader(fragShader);
+    glGetShaderInfoLog(fragShader, 4096, &length, infoLog);
+
+    glLinkProgram(program);
+    glUseProgram(program);
+}
+
+typedef struct {
+    GLfloat x, y, z;
+    GLfloat texU, texV;
+} VertexInfo;
+
+// A plane lying in y = 0, with the texture repeated across it
+void setupQuad()
+{
+    static const VertexInfo quadData[] = {
+        { -1.f, 0.f, 1.f, 0.f, 0.f },
+        { 1.f, 0.f, 1.f, 4.f, 0.f },
+        { 1.f, 0.f, -1.f, 4.f, 4.f },
+        { -1.f, 0.f, -1.f, 0.f, 4.f },
+    };
+
+    g_Quad.count = sizeof(quadData) / sizeof(quadData[0]);
+    glGenVertexArrays(1, &g_Quad.vaoId);
+    glBindVertexArray(g_Quad.vaoId);
+
+    GLuint vboId;
+    glGenBuffers(1, &vboId);
+    glBindBuffer(GL_ARRAY_BUFFER, vboId);
+    glBufferData(GL_ARRAY_BUFFER, sizeof(quadData), quadData, GL_STATIC_DRAW);
+
+    glVertexAttribPointer(V_POSITION, 3, GL_FLOAT, GL_FALSE, sizeof(VertexInfo), (GLvoid*)offsetof(VertexInfo, x));
+    glVertexAttribPointer(T_POSITION, 2, GL_FLOAT, GL_FALSE, sizeof(VertexInfo), (GLvoid*)offsetof(VertexInfo, texU));
+    glEnableVertexAttribArray(V_POSITION);
+    glEnableVertexAttribArray(T_POSITION);
+    glBindVertexArray(0);
+}
+
+// Rings around the middle over a color ramp:  fine enough that a missing
+// or wrong mip level shows as shimmer
+void buildPattern(std::vector<GLubyte> *pLevel)
+{
+    pLevel->resize(PATTERN_SIZE * PATTERN_SIZE * 4);
+    GLubyte *pTexel = &(*pLevel)[0];
+    for (int y = 0; y < PATTERN_SIZE; y++) {
+        for (int x = 0; x < PATTERN_SIZE; x++, pTexel += 4) {
+            float dx = x - PATTERN_SIZE / 2.f, dy = y - PATTERN_SIZE / 2.f;
+            float ring = .5f + .5f * cosf(sqrtf(dx * dx + dy * dy) * .15f);
+            pTexel[0] = GLubyte(ring * 255);
+            pTexel[1] = GLubyte(x * 255 / PATTERN_SIZE);
+            pTexel[2] = GLubyte(y * 255 / PATTERN_SIZE);
+            pTexel[3] = 255;
+        }
+    }
+}
+
+// Each level is the one above it boxed down by two
+void buildMips(std::vector<std::vector<GLubyte> > *pLevels)
+{
+    for (int level = 1; level < PATTERN_LEVELS; level++) {
+        int size = PATTERN_SIZE >> level, above = size * 2;
+        const GLubyte *pAbove = &(*pLevels)[level - 1][0];
+        (*pLevels)[level].resize(size * size * 4);
+        GLubyte *pTexel = &(*pLevels)[level][0];
+        for (int y = 0; y < size; y++) {
+            for (int x = 0; x < size; x++, pTexel += 4) {
+                for (int c = 0; c < 4; c++) {
+                    pTexel[c] = GLubyte((pAbove[((2 * y) * above + 2 * x) * 4 + c] +
+                        pAbove[((2 * y) * above + 2 * x + 1) * 4 + c] +
+                        pAbove[((2 * y + 1) * above + 2 * x) * 4 + c] +
+                        pAbove[((2 * y + 1) * above + 2 * x + 1) * 4 + c] + 2) / 4);
+                }
+            }
+        }
+    }
+}
+
+GLushort to565(const GLubyte *pTexel)
+{
+    return GLushort(((pTexel[0] >> 3) << 11) | ((pTexel[1] >> 2) << 5) | (pTexel[2] >> 3));
+}
+
+// A quick BC1 encoder:  the block's darkest and brightest texels are the
+// end points, and each texel takes the nearest of the four colors between.
+// Levels smaller than a block repeat their edge texels.
+void encodeBC1(const GLubyte *pImage, int width, int height, std::vector<GLubyte> *pBlocks)
+{
+    int blocksWide = (width + 3) / 4, blocksHigh = (height + 3) / 4;
+    pBlocks->resize(blocksWide * blocksHigh * 8);
+    GLubyte *pBlock = &(*pBlocks)[0];
+    for (int by = 0; by < blocksHigh; by++) {
+        for (int bx = 0; bx < blocksWide; bx++, pBlock += 8) {
+            const GLubyte *pTexels[16];
+            int low = 0, high = 0, lowLuma = 1 << 30, highLuma = -1;
+            for (int i = 0; i < 16; i++) {
+                int x = bx * 4 + i % 4, y = by * 4 + i / 4;
+                pTexels[i] = pImage + ((y < height ? y : height - 1) * width + (x < width ? x : width - 1)) * 4;
+                int luma = pTexels[i][0] * 2 + pTexels[i][1] * 4 + pTexels[i][2];
+                if (luma < lowLuma) { lowLuma = luma; low = i; }
+                if (luma > highLuma) { highLuma = luma; high = i; }
+            }
+            GLushort color0 = to565(pTexels[high]), color1 = to565(pTexels[low]);
+            GLuint indices = 0;
+            // Equal end points would select the three color mode; index 0 is right anyway
+            if (color0 != color1) {
+                if (color0 < color1) {
+                    GLushort swap = color0;
+                    color0 = color1;
+                    color1 = swap;
+                }
+                int palette[4][3];
+                for (int c = 0; c < 3; c++) {
+                    int shift = c == 0 ? 11 : c == 1 ? 5 : 0, bits = c == 1 ? 6 : 5;
+                    int max = (1 << bits) - 1;
+                    palette[0][c] = ((color0 >> shift) & max) * 255 / max;
+                    palette[1][c] = ((color1 >> shift) & max) * 255 / max;
+                    palette[2][c] = (2 * palette[0][c] + palette[1][c]) / 3;
+                    palette[3][c] = (palette[0][c] + 2 * palette[1][c]) / 3;
+                }
+                for (int i = 0; i < 16; i++) {
+                    int best = 0, bestDistance = 1 << 30;
+                    for (int p = 0; p < 4; p++) {
+                        int distance = 0;
+                        for (int c = 0; c < 3; c++) {
+                            int d = pTexels[i][c] - palette[p][c];
+                            distance += d * d;
+                        }
+                        if (distance < bestDistance) {
+                            bestDistance = distance;
+                            best = p;
+                        }
+                    }
+                    indices |= GLuint(best) << (2 * i);
+                }
+            }
+            pBlock[0] = GLubyte(color0);
+            pBlock[1] = GLubyte(color0 >> 8);
+            pBlock[2] = GLubyte(color1);
+            pBlock[3] = GLubyte(color1 >> 8);
+            for (int i = 0; i < 4; i++) {
+                pBlock[4 + i] = GLubyte(indices >> (8 * i));
+            }
+        }
+    }
+}
+
+void writeDemoFiles()
+{
+    std::vector<std::vector<GLubyte> > rgba(PATTERN_LEVELS), bc1(PATTERN_LEVELS);
+    buildPattern(&rgba[0]);
+    buildMips(&rgba);
+
+    const void *pRgba[PATTERN_LEVELS], *pBc1[PATTERN_LEVELS];
+    size_t rgbaSizes[PATTERN_LEVELS], bc1Sizes[PATTERN_LEVELS];
+    for (int level = 0; level < PATTERN_LEVELS; level++) {
+        int size = PATTERN_SIZE >> level;
+        encodeBC1(&rgba[level][0], size, size, &bc1[level]);
+        pRgba[level] = &rgba[level][0];
+        rgbaSizes[level] = rgba[level].size();
+        pBc1[level] = &bc1[level][0];
+        bc1Sizes[level] = bc1[level].size();
+    }
+
+    for (int file = 0; file < 4; file++) {
+        bool compressed = file >= 2, zlib = file % 2 == 1;
+        printf("Writing %s\n", demoFiles[file]);
+        ktxWrite(demoFiles[file], compressed ? VK_FORMAT_BC1_RGB_UNORM_BLOCK : VK_FORMAT_R8G8B8A8_UNORM,
+            PATTERN_SIZE, PATTERN_SIZE, PATTERN_LEVELS, compressed ? pBc1 : pRgba, compressed ? bc1Sizes : rgbaSizes, zlib);
+    }
+}
+
+double timeMs()
+{
+    static LARGE_INTEGER frequency = { 0 };
+    if (frequency.QuadPart == 0) {
+        QueryPerformanceFrequency(&frequency);
+    }
+    LARGE_INTEGER now;
+    QueryPerformanceCounter(&now);
+    return 1000. * double(now.QuadPart) / double(frequency.QuadPart);
+}
+
+GLuint loadTexture(const char *pPath)
+{
+    static const char *supercompressionNames[] = { "none", "BasisLZ", "Zstandard", "ZLIB" };
+
+    double start = timeMs();
+    KtxTexture texture;
+    if (!ktxOpen(pPath, &texture)) {
+        return 0;
+    }
+    // The planes are drawn with a sampler2D
+    if (texture.faceCount != 1) {
+        printf("%s is a cube map; this demo only draws 2D textures\n", pPath);
+        ktxClose(&texture);
+        return 0;
+    }
+    double opened = timeMs();
+    bool ok = ktxDecode(&texture, 0);
+    double decoded = timeMs();
+    GLuint textureId = ok ? ktxCreateTexture(&texture) : 0;
+    // Uploads are queued, so wait for them to count them
+    glFinish();
+    double uploaded = timeMs();
+
+    if (textureId) {
+        uint64_t bytes = 0;
+        for (uint32_t level = 0; level < texture.levelCount; level++) {
+            bytes += texture.pLevels[level].uncompressedLength;
+        }
+        printf("%s:  %ux%u %s, %u levels, supercompression %s\n", pPath, texture.width, texture.height,
+            texture.pFormat->pName, texture.storageLevels, supercompressionNames[texture.supercompression]);
+        printf("    %.2f MB in a %.2f MB file:  open %.2f ms, inflate %.2f ms, upload %.2f ms\n",
+            bytes / 1048576., texture.size / 1048576., opened - start, decoded - opened, uploaded - decoded);
+    }
+    ktxClose(&texture);
+    return textureId;
+}
+
+void loadTextures()
+{
+    double start = timeMs();
+    for (int t = 0; t < g_TextureCount; t++) {
+        glDeleteTextures(1, &g_Textures[t].textureId);
+        g_Textures[t].textureId = loadTexture(g_Textures[t].pPath);
+    }
+    printf("All loaded in %.2f ms\n", timeMs() - start);
+}
+
+void setupFrustum(float left, float right, float bottom, float top, float zNear, float zFar)
+{
+    g_ProjectionMatrix = vmath::frustum(left, right, bottom, top, zNear, zFar);
+}
+
+void onDisplay()
+{
+    static double startTime = timeMs();
+    float time = float((timeMs() - startTime) / 1000.);
+
+    glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+    glBindVertexArray(g_Quad.vaoId);
+
+    // Side by side, tipped back so they recede into the distance
+    int columns = g_TextureCount < 2 ? 1 : 2;
+    int rows = (g_TextureCount + columns - 1) / columns;
+    for (int t = 0; t < g_TextureCount; t++) {
+        if (!g_Textures[t].textureId) {
+            continue;
+        }
+        float x = (t % columns - (columns - 1) / 2.f) * 2.2f;
+        float y = ((rows - 1) / 2.f - t / columns) * 1.6f;
+        mat4 modelMatrix(vmath::translate(x, y, -CENTER_Z));
+        modelMatrix *= vmath::rotate(70.f, 1.f, 0.f, 0.f);
+        modelMatrix *= vmath::rotate(time * 10.f, 0.f, 1.f, 0.f);
+        glUniformMatrix4fv(MATRIX_LOCATION, 1, GL_FALSE, g_ProjectionMatrix * modelMatrix);
+        glBindTexture(GL_TEXTURE_2D, g_Textures[t].textureId);
+        glDrawArrays(GL_TRIANGLE_FAN, 0, g_Quad.count);
+    }
+    glutSwapBuffers();
+}
+
+void onKey(unsigned char key, int x, int y)
+{
+    if (key == 'l' || key == 'L') {
+        loadTextures();
+        return;
+    }
+    exit(0);
+}
+
+int main(int argc, char *argv[])
+{
+    glutInit(&argc, argv);
+    glutInitDisplayMode(GLUT_RGBA | GLUT_DOUBLE | GLUT_DEPTH);
+    glutInitWindowSize(640, 480);
+    glutCreateWindow(argv[0]);
+
+    glewInit();
+    wglSwapIntervalEXT(1);	// vsync
+
+    glEnable(GL_DEPTH_TEST);
+
+    GLfloat ratio = 640.0f / 480.0f;
+    GLfloat zNear = CENTER_Z - DEPTH_OF_FIELD/2;
+    GLfloat top = zNear * .6f;
+    setupFrustum(-ratio * top, ratio * top, -top, top, zNear, CENTER_Z + DEPTH_OF_FIELD/2);
+
+    if (argc > 1) {
+        for (int a = 1; a < argc && g_TextureCount < MAX_TEXTURES; a++) {
+            g_Textures[g_TextureCount++].pPath = argv[a];
+        }
+    }
+    else {
+        KtxTexture texture;
+        bool missing = false;
+        for (int file = 0; file < 4; file++) {
+            g_Textures[g_TextureCount++].pPath = demoFiles[file];
+            if (ktxOpen(demoFiles[file], &texture)) {
+                ktxClose(&texture);
+            }
+            else {
+                missing = true;
+            }
+        }
+        if (missing) {
+            writeDemoFiles();
+        }
+    }
+
+    setupShaders();
+    setupQuad();
+    loadTextures();
+    glutDisplayFunc(onDisplay);
+    glutIdleFunc(onDisplay);
+    glutKeyboardFunc(onKey);
+    glutMainLoop();
+
+    return 0;
+}
@@ -0,0 +1,297 @@
+/*
+ * Work-stealing jobs.  See JobSystem.h.
+ */
+#include "JobSystem.h"
+
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include <xmmintrin.h>
+
+#define QUEUE_MASK      (JOB_QUEUE_SIZE - 1)
+
+// Tries to find work before a thread with none goes to sleep
+#define IDLE_SPINS      2000
+
+// Eight pieces per thread gives thieves something to take without making
+// pieces so small that queueing them costs more than running them
+#define PIECES_PER_THREAD   8
+
+struct Job {
+    JobFunction function;           // NULL for a piece of a range
+    JobRangeFunction rangeFunction;
+    void *pArgument;
+    JobCounter *pCounter;
+    int begin, end, grain;
+};
+
+// The Chase-Lev deque, in the C11 form from Le, Pop, Cohen and Zappa
+// Nardelli, "Correct and Efficient Work-Stealing for Weak Memory Models".
+// top and bottom sit on their own cache lines:  thieves write one, the
+// owner the other.
+struct JobQueue {
+    std::atomic<long long> top;
+    char padTop[64 - sizeof(std::atomic<long long>)];
+    std::atomic<long long> bottom;
+    char padBottom[64 - sizeof(std::atomic<long long>)];
+    Job jobs[JOB_QUEUE_SIZE];
+    JobStats stats;
+    unsigned int random;            // For picking victims
+    char padStats[64];
+};
+
+static JobQueue *g_pQueues;
+static int g_ThreadCount;
+static std::vector<std::thread> g_Workers;
+static std::atomic<bool> g_Quit;
+
+// Jobs pushed and not yet taken, and threads asleep waiting for one
+static std::atomic<int> g_Queued;
+static std::atomic<int> g_Sleeping;
+static std::mutex g_WakeMutex;
+static std::condition_variable g_Wake;
+
+// -1 on threads that aren't part of the system
+static __declspec(thread) int t_Index = -1;
+
+static bool push(JobQueue *pQueue, const Job &job)
+{
+    long long bottom = pQueue->bottom.load(std::memory_order_relaxed);
+    long long top = pQueue->top.load(std::memory_order_acquire);
+    if (bottom - top >= JOB_QUEUE_SIZE) {
+        return false;
+    }
+    pQueue->jobs[bottom & QUEUE_MASK] = job;
+    std::atomic_thread_fence(std::memory_order_release);
+    pQueue->bottom.store(bottom + 1, std::memory_order_relaxed);
+    return true;
+}
+
+static bool pop(JobQueue *pQueue, Job *pJob)
+{
+    long long bottom = pQueue->bottom.load(std::memory_order_relaxed) - 1;
+    pQueue->bottom.store(bottom, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    long long top = pQueue->top.load(std::memory_order_relaxed);
+    if (top > bottom) {
+        pQueue->bottom.store(bottom + 1, std::memory_order_relaxed);
+        return false;
+    }
+    *pJob = pQueue->jobs[bottom & QUEUE_MASK];
+    if (top < bottom) {
+        return true;
+    }
+    // The last job:  race the thieves for it
+    bool won = pQueue->top.compare_exchange_strong(top, top + 1,
+        std::memory_order_seq_cst, std::memory_order_relaxed);
+    pQueue->bottom.store(bottom + 1, std::memory_order_relaxed);
+    return won;
+}
+
+// The copy may be torn if the owner has since wrapped around onto that
+// slot, but then top has moved and the compare-and-swap throws it away
+static bool steal(JobQueue *pQueue, Job *pJob)
+{
+    long long top = pQueue->top.load(std::memory_order_acquire);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    long long bottom = pQueue->bottom.load(std::memory_order_acquire);
+    if (top >= bottom) {
+        return false;
+    }
+    *pJob = pQueue->jobs[top & QUEUE_MASK];
+    return pQueue->top.compare_exchange_strong(top, top + 1,
+        std::memory_order_seq_cst, std::memory_order_relaxed);
+}
+
+static bool findJob(int index, Job *pJob)
+{
+    JobQueue *pOwn = &g_pQueues[index];
+    if (pop(pOwn, pJob)) {
+        g_Queued--;
+        return true;
+    }
+    // Start at a random victim so thieves don't all pile onto one
+    pOwn->random = pOwn->random * 1664525 + 1013904223;
+    int start = int((pOwn->random >> 16) % g_ThreadCount);
+    for (int i = 0; i < g_ThreadCount; i++) {
+        int victim = (start + i) % g_ThreadCount;
+        if (victim != index && steal(&g_pQueues[victim], pJob)) {
+            g_Queued--;
+            pOwn->stats.stolen++;
+            return true;
+        }
+    }
+    return false;
+}
+
+static void execute(const Job &job);
+
+static void enqueue(const Job &job)
+{
+    if (job.pCounter) {
+        job.pCounter->pending.fetch_add(1, std::memory_order_relaxed);
+    }
+    if (t_Index < 0 || !push(&g_pQueues[t_Index], job)) {
+        execute(job);
+        return;
+    }
+    g_Queued++;
+    if (g_Sleeping.load() > 0) {
+        // Taking the lock means a worker between its check and its wait
+        // is already waiting, and hears this
+        std::lock_guard<std::mutex> lock(g_WakeMutex);
+        g_Wake.notify_one();
+    }
+}
+
+static void runRange(const Job &job)
+{
+    int begin = job.begin, end = job.end;
+    while (end - begin > job.grain) {
+        int middle = begin + (end - begin) / 2;
+        Job upper = job;
+        upper.begin = middle;
+        upper.end = end;
+        enqueue(upper);
+        end = middle;
+    }
+    job.rangeFunction(job.pArgument, begin, end);
+}
+
+static void execute(const Job &job)
+{
+    if (job.function) {
+        job.function(job.pArgument);
+    }
+    else {
+        runRange(job);
+    }
+    if (t_Index >= 0) {
+        g_pQueues[t_Index].stats.executed++;
+    }
+    if (job.pCounter) {
+        job.pCounter->pending.fetch_sub(1, std::memory_order_release);
+    }
+}
+
+static void workerMain(int index)
+{
+    t_Index = index;
+    int idle = 0;
+    Job job;
+    while (!g_Quit.load(std::memory_order_relaxed)) {
+        if (findJob(index, &job)) {
+            execute(job);
+            idle = 0;
+            continue;
+        }
+        if (++idle < IDLE_SPINS) {
+            _mm_pause();
+            continue;
+        }
+        std::unique_lock<std::mutex> lock(g_WakeMutex);
+        g_Sleeping++;
+        while (g_Queued.load() == 0 && !g_Quit) {
+            g_pQueues[index].stats.sleeps++;
+            g_Wake.wait(lock);
+        }
+        g_Sleeping--;
+        idle = 0;
+    }
+}
+
+void jobSystemInit(int threadCount)
+{
+    if (threadCount <= 0) {
+        threadCount = int(std::thread::hardware_concurrency());
+        if (threadCount <= 0) {
+            threadCount = 1;
+        }
+    }
+    if (threadCount > JOB_MAX_THREADS) {
+        threadCount = JOB_MAX_THREADS;
+    }
+
+    g_ThreadCount = threadCount;
+    g_pQueues = new JobQueue[threadCount];
+    for (int t = 0; t < threadCount; t++) {
+        g_pQueues[t].top = 0;
+        g_pQueues[t].bottom = 0;
+        g_pQueues[t].stats.executed = g_pQueues[t].stats.stolen = g_pQueues[t].stats.sleeps = 0;
+        g_pQueues[t].random = 2654435761u * (t + 1);
+    }
+    g_Queued = 0;
+    g_Sleeping = 0;
+    g_Quit = false;
+
+    // The caller is thread 0
+    t_Index = 0;
+    for (int t = 1; t < threadCount; t++) {
+        g_Workers.push_back(std::thread(workerMain, t));
+    }
+}
+
+void jobSystemShutdown()
+{
+    {
+        std::lock_guard<std::mutex> lock(g_WakeMutex);
+        g_Quit = true;
+        g_Wake.notify_all();
+    }
+    for (size_t t = 0; t < g_Workers.size(); t++) {
+        g_Workers[t].join();
+    }
+    g_Workers.clear();
+    delete[] g_pQueues;
+    g_pQueues = NULL;
+    g_ThreadCount = 0;
+    t_Index = -1;
+}
+
+int jobThreadCount()
+{
+    return g_ThreadCount;
+}
+
+void jobRun(JobFunction function, void *pArgument, JobCounter *pCounter)
+{
+    Job job = { function, NULL, pArgument, pCounter, 0, 0, 0 };
+    enqueue(job);
+}
+
+void jobParallelFor(int count, JobRangeFunction function, void *pArgument, JobCounter *pCounter, int grain)
+{
+    if (count <= 0) {
+        return;
+    }
+    if (grain <= 0) {
+        int pieces = (g_ThreadCount > 0 ? g_ThreadCount : 1) * PIECES_PER_THREAD;
+        grain = (count + pieces - 1) / pieces;
+    }
+    Job job = { NULL, function, pArgument, pCounter, 0, count, grain };
+    enqueue(job);
+}
+
+void jobWait(JobCounter *pCounter)
+{
+    Job job;
+    while (pCounter->pending.load(std::memory_order_acquire) > 0) {
+        if (t_Index >= 0 && findJob(t_Index, &job)) {
+            execute(job);
+        }
+        else {
+            _mm_pause();
+        }
+    }
+}
+
+int jobStats(JobStats *pStats, int maxThreads)
+{
+    int count = g_ThreadCount < maxThreads ? g_ThreadCount : maxThreads;
+    for (int t = 0; t < count; t++) {
+        pStats[t] = g_pQueues[t].stats;
+    }
+    return count;
+}
@@ -0,0 +1,67 @@
+/*
+ * A work-stealing job system.
+ *
+ * jobSystemInit starts one worker per core, less one for the calling
+ * thread, which takes part whenever it waits.  Every thread has a
+ * Chase-Lev deque:  the owner pushes and pops jobs at the bottom with no
+ * locked instruction in the common case, and idle threads steal from the
+ * top of a random victim's deque with one compare-and-swap.  Jobs are small
+ * structs held in the deque by value, so nothing is allocated per job.
+ * Workers spin briefly when they run dry and then sleep until a job is
+ * pushed.
+ *
+ * A JobCounter counts jobs not yet finished.  Jobs are started against a
+ * counter, and jobWait runs queued jobs, the thread's own first, until the
+ * counter reaches zero, so a job can start more jobs and wait on them
+ * without tying up its thread.  That is how dependencies are expressed.
+ *
+ * jobParallelFor runs a range in pieces.  The whole range starts as one
+ * job, and whoever runs a piece splits it in half, queueing the upper half
+ * and keeping the lower, until it is down to the grain size.  Thieves take
+ * the oldest and so the largest halves, so work spreads in a few steals.
+ * With no grain given it is the range over eight pieces per thread.
+ *
+ * Only the thread that called jobSystemInit and the jobs themselves may
+ * start jobs or wait; jobs started from any other thread run at once.  A
+ * deque holds JOB_QUEUE_SIZE jobs, and a job started on a full deque also
+ * runs at once.
+ */
+#ifndef JOB_SYSTEM_H
+#define JOB_SYSTEM_H
+
+#include <atomic>
+
+#define JOB_MAX_THREADS     64
+#define JOB_QUEUE_SIZE      4096    // A power of two
+
+typedef void (*JobFunction)(void *pArgument);
+typedef void (*JobRangeFunction)(void *pArgument, int begin, int end);
+
+struct JobCounter {
+    std::atomic<int> pending;
+    JobCounter() : pending(0) {}
+};
+
+typedef struct {
+    long long executed;     // Jobs run by this thread
+    long long stolen;       // Of those, taken from another thread
+    long long sleeps;       // Times it ran out of work and slept
+} JobStats;
+
+// threadCount includes the caller; 0 means one per core
+void jobSystemInit(int threadCount);
+void jobSystemShutdown();
+int jobThreadCount();
+
+void jobRun(JobFunction function, void *pArgument, JobCounter *pCounter);
+
+// Calls function on pieces of [0, count).  grain 0 picks one.
+void jobParallelFor(int count, JobRangeFunction function, void *pArgument, JobCounter *pCounter, int grain = 0);
+
+// Runs jobs until pCounter is zero
+void jobWait(JobCounter *pCounter);
+
+// One JobStats per thread, the caller's first.  Returns how many.
+int jobStats(JobStats *pStats, int maxThreads);
+
+#endif
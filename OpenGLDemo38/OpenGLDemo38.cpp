@@ -0,0 +1,442 @@
+/*
+ * Demo 38:
+ * A work-stealing job system (see JobSystem.h).  A grid of textured
+ * pyramids is drawn the Demo 16 way, a matrix and a draw each, with the
+ * matrices built by jobParallelFor on every core.  Where Demo 33 gives
+ * each thread one fixed share, here the range is split into jobs that
+ * idle threads steal, and the main thread runs jobs while it waits.  Jobs
+ * run and stolen per frame are printed every two seconds.
+ *
+ * Press B to run the microbenchmarks:  the cost of a job, and how a piece
+ * of arithmetic scales from one thread to all of them, with grains from
+ * one item to a piece per thread.  Any other key exits.
+ *
+ * See README.txt for prerequisites.
+ */
+#include <windows.h>
+#include <WinGDI.h>
+
+#include <GL/glew.h>
+#include <GL/wglew.h>
+#include <GL/GL.h>
+#include <GL/glut.h>
+
+#include <stdio.h>
+#include <stddef.h>
+#include <math.h>
+#include <vector>
+
+#include <vmath.h>
+using vmath::mat4;
+
+#include "JobSystem.h"
+
+// Apparently someone is still using segmented memory qualifiers,
+// and windows.h is letting them.
+#undef near
+#undef far
+
+#define CENTER_Z        80.0f    // Distance from camera
+#define DEPTH_OF_FIELD  10.0f
+
+#define GRID_SIZE       64
+#define OBJECT_COUNT    (GRID_SIZE * GRID_SIZE)
+#define GRID_SPACING    1.5f
+
+// Benchmark sizes
+#define SPAWN_BATCH         1000
+#define SPAWN_BATCHES       100
+#define SCALING_ITEMS       (1 << 20)
+#define SCALING_WORK        64          // Iterations per item
+
+typedef struct {
+    GLsizei count;
+    GLuint vaoId;
+} ShapeInfo;
+
+ShapeInfo g_Pyramid;
+GLint g_MatrixUniform, g_SamplerUniform;
+mat4 g_ProjectionMatrix(mat4::identity());
+mat4 g_Matrices[OBJECT_COUNT];
+
+#define BLOCKY_SAMPLER 1
+
+// Must match hard-coded vPosition location in vertShaderSource
+#define V_POSITION 0
+
+// Must match hard-coded location in vertShaderSource
+#define C_POSITION 1
+
+// Must match hard-coded vTexture location in vertShaderSource
+#define T_POSITION 2
+
+void setupShaders()
+{
+    GLchar infoLog[4096];
+    GLsizei length;
+
+    const GLchar *vertShaderSource[] = {
+        "#version 430 core\n"
+        "uniform mat4 ModelViewProject;\n"
+        "layout(location = 0) in vec4 vPosition;\n"
+        "layout(location = 1) in vec3 vColor;\n"
+        "layout(location = 2) in vec2 vTexture;\n"
+        "out vec3 color;\n"
+        "out vec2 vs_tex_coord;\n"
+        "void main() {\n"
+        "    gl_Position = ModelViewProject * vPosition;\n"
+        "    vs_tex_coord = vTexture;\n"
+        "    color = vColor;\n"
+        "}\n"
+    };
+    GLuint vertShader = glCreateShader(GL_VERTEX_SHADER);
+    glShaderSource(vertShader, 1, vertShaderSource, NULL);
+
+    const GLchar *fragShaderSource[] = {
+        "#version 430 core\n"
+        "uniform sampler2D tex;\n"
+        "in vec3 color;\n"
+        "in vec2 vs_tex_coord;\n"
+        "out vec4 fColor;\n"
+        "void main() {\n"
+        "    vec4 texColor = texture(tex, vs_tex_coord);\n"
+        "    fColor = vec4(color, 0) * (1 - texColor.a) + texColor;\n"
+        "}\n"
+    };
+    GLuint fragShader = glCreateShader(GL_FRAGMENT_SHADER);
+    glShaderSource(fragShader, 1, fragShaderSource, NULL);
+
+    GLuint program = glCreateProgram();
+    glAttachShader(program, vertShader);
+    glCompileShader(vertShader);
+    glGetShaderInfoLog(vertShader, 4096, &length, infoLog);
+
+    glAttachShader(program, fragShader);
+    glCompileShader(fragShader);
+    glGetShaderInfoLog(fragShader, 4096, &length, infoLog);
+
+    glLinkProgram(program);
+    glUseProgram(program);
+    g_MatrixUniform = glGetUniformLocation(program, "ModelViewProject");
+    g_SamplerUniform = glGetUniformLocation(program, "tex");
+}
+
+// Convert a simple bitmap (one bit per pixel) into an RGBA bitmap (four bytes per pixel)
+GLubyte* BuildMonochromeBitmap(const GLubyte* bits, int width, int height, GLubyte red, GLubyte green, GLubyte blue)
+{
+    GLubyte* retval = (GLubyte *)malloc(width * height * 4);
+    if (retval) {
+        GLubyte* ptr = retval;
+        for (int y = 0; y < height; y++) {
+            for (int x = 0; x < width/8; x++) {
+                GLubyte next8 = *bits++;
+                for (int mask = 128; mask > 0; mask >>= 1) {
+                    if (next8 & mask) {
+                        *ptr++ = red;
+                        *ptr++ = green;
+                        *ptr++ = blue;
+                        *ptr++ = 255;
+                    }
+                    else {
+                        *ptr++ = 0;
+                        *ptr++ = 0;
+                        *ptr++ = 0;
+                        *ptr++ = 0;
+                    }
+                }
+            }
+        }
+    }
+    return retval;
+}
+
+#define BITMAP_WIDTH 16
+#define BITMAP_HEIGHT 16
+#define BIT_BYTES ((BITMAP_WIDTH / 8) * BITMAP_HEIGHT)
+
+void setupTextures()
+{
+    // smiley face
+    GLubyte bits[BIT_BYTES] = {
+        0x00, 0x00,
+        0x00, 0x00,
+        0x07, 0xE0,
+        0x08, 0x10,
+        0x10, 0x08,
+        0x20, 0x04,
+        0x44, 0x22,
+        0x40, 0x02,
+        0x40, 0x02,
+        0x40, 0x02,
+        0x42, 0x42,
+        0x23, 0xc4,
+        0x10, 0x08,
+        0x0c, 0x30,
+        0x03, 0xc0,
+        0x00, 0x00,
+    };
+
+    GLubyte* data = BuildMonochromeBitmap(bits, BITMAP_WIDTH, BITMAP_HEIGHT, 255, 0, 0);
+    if (!data) {
+        return;
+    }
+    GLuint texture;
+    glGenTextures(1, &texture);
+    glActiveTexture(GL_TEXTURE0 + BLOCKY_SAMPLER);
+    glBindTexture(GL_TEXTURE_2D, texture);
+    glTexStorage2D(GL_TEXTURE_2D, 1, GL_RGBA8, BITMAP_WIDTH, BITMAP_HEIGHT);
+    glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, BITMAP_WIDTH, BITMAP_HEIGHT, GL_RGBA, GL_UNSIGNED_BYTE, data);
+    free(data);
+
+    GLuint sampler;
+    glGenSamplers(1, &sampler);
+    glBindSampler(BLOCKY_SAMPLER, sampler);
+    glSamplerParameteri(sampler, GL_TEXTURE_WRAP_S, GL_REPEAT);
+    glSamplerParameteri(sampler, GL_TEXTURE_WRAP_T, GL_REPEAT);
+    glSamplerParameteri(sampler, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    glSamplerParameteri(sampler, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    glUniform1i(g_SamplerUniform, BLOCKY_SAMPLER);
+}
+
+void setupPyramid(ShapeInfo *pInfo)
+{
+    typedef struct {
+        GLfloat x, y, z;
+        GLubyte red, green, blue;
+        GLfloat texU, texV;
+    } VertexInfo;
+
+    static const VertexInfo pyramidData[] = {
+        // Bottom
+        { 0.0f, 0.f, .5f, 255, 0, 0, 0.f, 0.f},
+        { 0.433f, 0.f, -.25f, 255, 0, 0, 0.f, 1.f},
+        { -0.433f, 0.f, -.25f, 255, 0, 0, 1.f, 1.f},
+        // Side 1
+        { -0.433f, 0.f, -.25f, 0, 0, 255, 0.f, 0.f},
+        { 0.433f, 0.f, -.25f, 0, 255, 255, 1.f, 0.f},
+        { 0.0f, 0.75f, 0.f, 255, 0, 255, 1.f, 1.f},
+        // Side 2
+        { -0.433f, 0.f, -.25f, 255, 255, 0, 0.f, 0.f},
+        { 0.0f, 0.f, .5f, 255, 255, 0, 0.f, 1.f},
+        { 0.0f, 0.75f, 0.f, 255, 255, 0, 1.f, 1.f},
+        // Side 3
+        { 0.0f, 0.f, .5f, 0, 255, 0, 4.f, 4.f},
+        { 0.0f, 0.75f, 0.f, 0, 255, 0, 2.f, 0.f},
+        { 0.433f, 0.f, -.25f, 0, 255, 0, 0.f, 4.f},
+    };
+
+    GLuint vboId;
+    glGenVertexArrays(1, &pInfo->vaoId);
+    glBindVertexArray(pInfo->vaoId);
+    glGenBuffers(1, &vboId);
+    glBindBuffer(GL_ARRAY_BUFFER, vboId);
+    glBufferData(GL_ARRAY_BUFFER, sizeof(pyramidData), pyramidData, GL_STATIC_DRAW);
+
+    glVertexAttribPointer(V_POSITION, 3, GL_FLOAT, GL_FALSE, sizeof(VertexInfo), (GLvoid*)offsetof(VertexInfo, x));
+    glEnableVertexAttribArray(V_POSITION);
+    glVertexAttribPointer(C_POSITION, 3, GL_UNSIGNED_BYTE, GL_TRUE, sizeof(VertexInfo), (GLvoid*)offsetof(VertexInfo, red));
+    glEnableVertexAttribArray(C_POSITION);
+    glVertexAttribPointer(T_POSITION, 2, GL_FLOAT, GL_FALSE, sizeof(VertexInfo), (GLvoid*)offsetof(VertexInfo, texU));
+    glEnableVertexAttribArray(T_POSITION);
+
+    pInfo->count = 12;
+}
+
+void setupFrustum(float left, float right, float bottom, float top, float zNear, float zFar)
+{
+    g_ProjectionMatrix = vmath::frustum(left, right, bottom, top, zNear, zFar);
+}
+
+double timeMs()
+{
+    static LARGE_INTEGER frequency = { 0 };
+    if (frequency.QuadPart == 0) {
+        QueryPerformanceFrequency(&frequency);
+    }
+    LARGE_INTEGER now;
+    QueryPerformanceCounter(&now);
+    return 1000. * double(now.QuadPart) / double(frequency.QuadPart);
+}
+
+void buildMatrices(void *pArgument, int first, int last)
+{
+    float time = *(const float *)pArgument;
+    for (int n = first; n < last; n++) {
+        float x = (n % GRID_SIZE - (GRID_SIZE - 1) / 2.f) * GRID_SPACING;
+        float y = (n / GRID_SIZE - (GRID_SIZE - 1) / 2.f) * GRID_SPACING;
+        mat4 modelViewMatrix(vmath::translate(x, y, -CENTER_Z));
+        modelViewMatrix *= vmath::rotate(time * 90.f + n * 7.f, 0.f, 1.f, 0.f);
+        g_Matrices[n] = g_ProjectionMatrix * modelViewMatrix;
+    }
+}
+
+// Benchmarks
+
+void emptyJob(void *pArgument)
+{
+}
+
+void emptyRange(void *pArgument, int begin, int end)
+{
+}
+
+// Enough arithmetic per item that memory isn't what limits it
+void arithmetic(void *pArgument, int begin, int end)
+{
+    float *pOut = (float *)pArgument;
+    for (int i = begin; i < end; i++) {
+        float x = float(i);
+        for (int k = 0; k < SCALING_WORK; k++) {
+            x = sqrtf(x * 1.0001f + 1.f);
+        }
+        pOut[i] = x;
+    }
+}
+
+double timeParallelFor(int count, JobRangeFunction function, void *pArgument, int grain)
+{
+    double start = timeMs();
+    JobCounter counter;
+    jobParallelFor(count, function, pArgument, &counter, grain);
+    jobWait(&counter);
+    return timeMs() - start;
+}
+
+void runBenchmarks()
+{
+    int threads = jobThreadCount();
+    printf("Benchmarks, %d threads:\n", threads);
+
+    // Spawning:  the main thread starts a batch and helps run it
+    double spawnMs = 0, start = timeMs();
+    JobCounter counter;
+    for (int batch = 0; batch < SPAWN_BATCHES; batch++) {
+        double spawnStart = timeMs();
+        for (int j = 0; j < SPAWN_BATCH; j++) {
+            jobRun(emptyJob, NULL, &counter);
+        }
+        spawnMs += timeMs() - spawnStart;
+        jobWait(&counter);
+    }
+    double totalMs = timeMs() - start;
+    int jobs = SPAWN_BATCH * SPAWN_BATCHES;
+    printf("    jobRun %.0f ns, start to finish %.0f ns per job\n", spawnMs * 1e6 / jobs, totalMs * 1e6 / jobs);
+
+    double emptyMs = timeParallelFor(SCALING_ITEMS, emptyRange, NULL, 0);
+    printf("    jobParallelFor over %d empty items:  %.3f ms\n", SCALING_ITEMS, emptyMs);
+
+    // Scaling, against a fresh system each time
+    std::vector<float> out(SCALING_ITEMS);
+    jobSystemShutdown();
+    double oneThreadMs = 0;
+    for (int t = 1; ; t *= 2) {
+        if (t > threads) {
+            t = threads;
+        }
+        jobSystemInit(t);
+        timeParallelFor(SCALING_ITEMS, arithmetic, &out[0], 0);     // Warm up
+        double ms = timeParallelFor(SCALING_ITEMS, arithmetic, &out[0], 0);
+        if (t == 1) {
+            oneThreadMs = ms;
+        }
+        printf("    %2d threads:  %7.2f ms, %5.2fx\n", t, ms, oneThreadMs / ms);
+        jobSystemShutdown();
+        if (t == threads) {
+            break;
+        }
+    }
+
+    // Grain size, with every thread
+    jobSystemInit(threads);
+    static const int grains[] = { 1, 64, 0, SCALING_ITEMS / 8 };
+    for (int g = 0; g < 4; g++) {
+        int grain = grains[g] ? grains[g] : (SCALING_ITEMS + threads * 8 - 1) / (threads * 8);
+        double ms = timeParallelFor(SCALING_ITEMS, arithmetic, &out[0], grains[g]);
+        printf("    grain %7d%s:  %7.2f ms\n", grain, grains[g] ? "       " : " (auto)", ms);
+    }
+}
+
+void onDisplay()
+{
+    static int frames = 0;
+    static double startTime = timeMs();
+    static double lastReport = startTime;
+    static double buildMs = 0;
+    static JobStats lastTotals = { 0 };
+
+    float time = float((timeMs() - startTime) / 1000.);
+    double buildStart = timeMs();
+    JobCounter counter;
+    jobParallelFor(OBJECT_COUNT, buildMatrices, &time, &counter);
+    jobWait(&counter);
+    buildMs += timeMs() - buildStart;
+
+    glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+    glBindVertexArray(g_Pyramid.vaoId);
+    for (int n = 0; n < OBJECT_COUNT; n++) {
+        glUniformMatrix4fv(g_MatrixUniform, 1, GL_FALSE, g_Matrices[n]);
+        glDrawArrays(GL_TRIANGLES, 0, g_Pyramid.count);
+    }
+    glutSwapBuffers();
+
+    frames++;
+    double now = timeMs();
+    if (now - lastReport >= 2000) {
+        JobStats stats[JOB_MAX_THREADS], totals = { 0 };
+        int threads = jobStats(stats, JOB_MAX_THREADS);
+        for (int t = 0; t < threads; t++) {
+            totals.executed += stats[t].executed;
+            totals.stolen += stats[t].stolen;
+            totals.sleeps += stats[t].sleeps;
+        }
+        printf("Matrices %.3f ms, %.1f jobs (%.1f stolen) per frame, %lld sleeps across %d threads\n",
+            buildMs / frames, double(totals.executed - lastTotals.executed) / frames,
+            double(totals.stolen - lastTotals.stolen) / frames, totals.sleeps - lastTotals.sleeps, threads);
+        lastTotals = totals;
+        buildMs = 0;
+        frames = 0;
+        lastReport = now;
+    }
+}
+
+void onKey(unsigned char key, int x, int y)
+{
+    if (key == 'b' || key == 'B') {
+        runBenchmarks();
+        return;
+    }
+    jobSystemShutdown();
+    exit(0);
+}
+
+int main(int argc, char *argv[])
+{
+    glutInit(&argc, argv);
+    glutInitDisplayMode(GLUT_RGBA | GLUT_DOUBLE | GLUT_DEPTH);
+    glutInitWindowSize(640, 480);
+    glutCreateWindow(argv[0]);
+
+    glewInit();
+    wglSwapIntervalEXT(1);	// vsync
+
+    // This thread, the GL one, is thread 0 and helps whenever it waits
+    jobSystemInit(0);
+    printf("%d threads\n", jobThreadCount());
+
+    glEnable(GL_DEPTH_TEST);
+
+    GLfloat ratio = 640.0f / 480.0f;
+    GLfloat zNear = CENTER_Z - DEPTH_OF_FIELD/2;
+    GLfloat top = zNear * .7f;
+    setupFrustum(-ratio * top, ratio * top, -top, top, zNear, CENTER_Z + DEPTH_OF_FIELD/2);
+
+    setupShaders();
+    setupPyramid(&g_Pyramid);
+    setupTextures();
+    glutDisplayFunc(onDisplay);
+    glutIdleFunc(onDisplay);
+    glutKeyboardFunc(onKey);
+    glutMainLoop();
+
+    return 0;
+}
@@ -0,0 +1,517 @@
+/*
+ * Demo 39:
+ * Simulation and rendering on separate threads.  The simulation steps a
+ * ring of pyramids at a fixed SIM_RATE on its own thread, and after each
+ * step publishes a snapshot of where they all are through a lock-free
+ * triple buffer (see TripleBuffer.h).  onDisplay draws the newest snapshot
+ * and never waits for a step, so a slow simulation lowers the simulation
+ * rate and leaves the frame rate alone.  Each step does extra busy work
+ * to stand in for a real simulation.
+ *
+ * Every two seconds both rates are printed, with what each step and frame
+ * cost, how many frames had a new snapshot, and how old the snapshots
+ * were when drawn.
+ *
+ * Press + or - to double or halve the simulation's cost, S to switch to
+ * simulating on the render thread the way Demos 11-16 do and back, and
+ * any other key to exit.
+ *
+ * See README.txt for prerequisites.
+ */
+#include <windows.h>
+#include <WinGDI.h>
+
+#include <GL/glew.h>
+#include <GL/wglew.h>
+#include <GL/GL.h>
+#include <GL/glut.h>
+
+#include <stdio.h>
+#include <stddef.h>
+#include <math.h>
+#include <atomic>
+#include <mutex>
+#include <thread>
+
+#include <vmath.h>
+using vmath::mat4;
+
+#include "TripleBuffer.h"
+
+// Apparently someone is still using segmented memory qualifiers,
+// and windows.h is letting them.
+#undef near
+#undef far
+
+#define CENTER_Z        12.0f    // Distance from camera
+#define DEPTH_OF_FIELD  10.0f
+
+#define OBJECT_COUNT    64
+
+#define SIM_RATE        120                 // Steps per second
+#define SIM_STEP_MS     (1000. / SIM_RATE)
+
+// A simulation that falls this far behind gives up on catching up
+#define SIM_MAX_LAG_MS  250.
+
+// Steps the render thread will catch up on in one frame when it simulates
+#define INLINE_MAX_STEPS    4
+
+// Busy work per step:  about a millisecond on a desktop core.
+// Exercise:  Raise it until a step takes longer than a frame, and compare
+// the frame rate with S.
+#define SIM_WORK_START  200000
+
+typedef struct {
+    GLsizei count;
+    GLuint vaoId;
+} ShapeInfo;
+
+// What the simulation keeps
+typedef struct {
+    float angle, angularSpeed;      // Radians, per second
+    float radius, z;
+    float rotation, spin;           // Degrees, per second
+    float scale;
+} SimObject;
+
+// What it publishes
+typedef struct {
+    float x, y, z;
+    float rotation, scale;
+} ObjectState;
+
+typedef struct {
+    long long step;
+    double publishedMs;
+    ObjectState objects[OBJECT_COUNT];
+} Snapshot;
+
+ShapeInfo g_Pyramid;
+GLint g_MatrixUniform, g_SamplerUniform;
+mat4 g_ProjectionMatrix(mat4::identity());
+
+SimObject g_Objects[OBJECT_COUNT];
+long long g_Step;
+double g_NextStepMs;
+std::mutex g_SimMutex;          // Whichever thread is simulating holds it
+
+Snapshot g_Snapshots[3];
+TripleBuffer g_Published;
+
+std::thread g_SimThread;
+std::atomic<bool> g_Split(true), g_Quit(false);
+std::atomic<int> g_SimWork(SIM_WORK_START);
+std::atomic<long long> g_Steps, g_StepMicroseconds;
+volatile float g_WorkSink;
+
+#define BLOCKY_SAMPLER 1
+
+// Must match hard-coded vPosition location in vertShaderSource
+#define V_POSITION 0
+
+// Must match hard-coded location in vertShaderSource
+#define C_POSITION 1
+
+// Must match hard-coded vTexture location in vertShaderSource
+#define T_POSITION 2
+
+void setupShaders()
+{
+    GLchar infoLog[4096];
+    GLsizei length;
+
+    const GLchar *vertShaderSource[] = {
+        "#version 430 core\n"
+        "uniform mat4 ModelViewProject;\n"
+        "layout(location = 0) in vec4 vPosition;\n"
+        "layout(location = 1) in vec3 vColor;\n"
+        "layout(location = 2) in vec2 vTexture;\n"
+        "out vec3 color;\n"
+        "out vec2 vs_tex_coord;\n"
+        "void main() {\n"
+        "    gl_Position = ModelViewProject * vPosition;\n"
+        "    vs_tex_coord = vTexture;\n"
+        "    color = vColor;\n"
+        "}\n"
+    };
+    GLuint vertShader = glCreateShader(GL_VERTEX_SHADER);
+    glShaderSource(vertShader, 1, vertShaderSource, NULL);
+
+    const GLchar *fragShaderSource[] = {
+        "#version 430 core\n"
+        "uniform sampler2D tex;\n"
+        "in vec3 color;\n"
+        "in vec2 vs_tex_coord;\n"
+        "out vec4 fColor;\n"
+        "void main() {\n"
+        "    vec4 texColor = texture(tex, vs_tex_coord);\n"
+        "    fColor = vec4(color, 0) * (1 - texColor.a) + texColor;\n"
+        "}\n"
+    };
+    GLuint fragShader = glCreateShader(GL_FRAGMENT_SHADER);
+    glShaderSource(fragShader, 1, fragShaderSource, NULL);
+
+    GLuint program = glCreateProgram();
+    glAttachShader(program, vertShader);
+    glCompileShader(vertShader);
+    glGetShaderInfoLog(vertShader, 4096, &length, infoLog);
+
+    glAttachShader(program, fragShader);
+    glCompileShader(fragShader);
+    glGetShaderInfoLog(fragShader, 4096, &length, infoLog);
+
+    glLinkProgram(program);
+    glUseProgram(program);
+    g_MatrixUniform = glGetUniformLocation(program, "ModelViewProject");
+    g_SamplerUniform = glGetUniformLocation(program, "tex");
+}
+
+// Convert a simple bitmap (one bit per pixel) into an RGBA bitmap (four bytes per pixel)
+GLubyte* BuildMonochromeBitmap(const GLubyte* bits, int width, int height, GLubyte red, GLubyte green, GLubyte blue)
+{
+    GLubyte* retval = (GLubyte *)malloc(width * height * 4);
+    if (retval) {
+        GLubyte* ptr = retval;
+        for (int y = 0; y < height; y++) {
+            for (int x = 0; x < width/8; x++) {
+                GLubyte next8 = *bits++;
+                for (int mask = 128; mask > 0; mask >>= 1) {
+                    if (next8 & mask) {
+                        *ptr++ = red;
+                        *ptr++ = green;
+                        *ptr++ = blue;
+                        *ptr++ = 255;
+                    }
+                    else {
+                        *ptr++ = 0;
+                        *ptr++ = 0;
+                        *ptr++ = 0;
+                        *ptr++ = 0;
+                    }
+                }
+            }
+        }
+    }
+    return retval;
+}
+
+#define BITMAP_WIDTH 16
+#define BITMAP_HEIGHT 16
+#define BIT_BYTES ((BITMAP_WIDTH / 8) * BITMAP_HEIGHT)
+
+void setupTextures()
+{
+    // smiley face
+    GLubyte bits[BIT_BYTES] = {
+        0x00, 0x00,
+        0x00, 0x00,
+        0x07, 0xE0,
+        0x08, 0x10,
+        0x10, 0x08,
+        0x20, 0x04,
+        0x44, 0x22,
+        0x40, 0x02,
+        0x40, 0x02,
+        0x40, 0x02,
+        0x42, 0x42,
+        0x23, 0xc4,
+        0x10, 0x08,
+        0x0c, 0x30,
+        0x03, 0xc0,
+        0x00, 0x00,
+    };
+
+    GLubyte* data = BuildMonochromeBitmap(bits, BITMAP_WIDTH, BITMAP_HEIGHT, 255, 0, 0);
+    if (!data) {
+        return;
+    }
+    GLuint texture;
+    glGenTextures(1, &texture);
+    glActiveTexture(GL_TEXTURE0 + BLOCKY_SAMPLER);
+    glBindTexture(GL_TEXTURE_2D, texture);
+    glTexStorage2D(GL_TEXTURE_2D, 1, GL_RGBA8, BITMAP_WIDTH, BITMAP_HEIGHT);
+    glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, BITMAP_WIDTH, BITMAP_HEIGHT, GL_RGBA, GL_UNSIGNED_BYTE, data);
+    free(data);
+
+    GLuint sampler;
+    glGenSamplers(1, &sampler);
+    glBindSampler(BLOCKY_SAMPLER, sampler);
+    glSamplerParameteri(sampler, GL_TEXTURE_WRAP_S, GL_REPEAT);
+    glSamplerParameteri(sampler, GL_TEXTURE_WRAP_T, GL_REPEAT);
+    glSamplerParameteri(sampler, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    glSamplerParameteri(sampler, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    glUniform1i(g_SamplerUniform, BLOCKY_SAMPLER);
+}
+
+void setupPyramid(ShapeInfo *pInfo)
+{
+    typedef struct {
+        GLfloat x, y, z;
+        GLubyte red, green, blue;
+        GLfloat texU, texV;
+    } VertexInfo;
+
+    static const VertexInfo pyramidData[] = {
+        // Bottom
+        { 0.0f, 0.f, .5f, 255, 0, 0, 0.f, 0.f},
+        { 0.433f, 0.f, -.25f, 255, 0, 0, 0.f, 1.f},
+        { -0.433f, 0.f, -.25f, 255, 0, 0, 1.f, 1.f},
+        // Side 1
+        { -0.433f, 0.f, -.25f, 0, 0, 255, 0.f, 0.f},
+        { 0.433f, 0.f, -.25f, 0, 255, 255, 1.f, 0.f},
+        { 0.0f, 0.75f, 0.f, 255, 0, 255, 1.f, 1.f},
+        // Side 2
+        { -0.433f, 0.f, -.25f, 255, 255, 0, 0.f, 0.f},
+        { 0.0f, 0.f, .5f, 255, 255, 0, 0.f, 1.f},
+        { 0.0f, 0.75f, 0.f, 255, 255, 0, 1.f, 1.f},
+        // Side 3
+        { 0.0f, 0.f, .5f, 0, 255, 0, 4.f, 4.f},
+        { 0.0f, 0.75f, 0.f, 0, 255, 0, 2.f, 0.f},
+        { 0.433f, 0.f, -.25f, 0, 255, 0, 0.f, 4.f},
+    };
+
+    GLuint vboId;
+    glGenVertexArrays(1, &pInfo->vaoId);
+    glBindVertexArray(pInfo->vaoId);
+    glGenBuffers(1, &vboId);
+    glBindBuffer(GL_ARRAY_BUFFER, vboId);
+    glBufferData(GL_ARRAY_BUFFER, sizeof(pyramidData), pyramidData, GL_STATIC_DRAW);
+
+    glVertexAttribPointer(V_POSITION, 3, GL_FLOAT, GL_FALSE, sizeof(VertexInfo), (GLvoid*)offsetof(VertexInfo, x));
+    glEnableVertexAttribArray(V_POSITION);
+    glVertexAttribPointer(C_POSITION, 3, GL_UNSIGNED_BYTE, GL_TRUE, sizeof(VertexInfo), (GLvoid*)offsetof(VertexInfo, red));
+    glEnableVertexAttribArray(C_POSITION);
+    glVertexAttribPointer(T_POSITION, 2, GL_FLOAT, GL_FALSE, sizeof(VertexInfo), (GLvoid*)offsetof(VertexInfo, texU));
+    glEnableVertexAttribArray(T_POSITION);
+
+    pInfo->count = 12;
+}
+
+void setupFrustum(float left, float right, float bottom, float top, float zNear, float zFar)
+{
+    g_ProjectionMatrix = vmath::frustum(left, right, bottom, top, zNear, zFar);
+}
+
+double timeMs()
+{
+    static LARGE_INTEGER frequency = { 0 };
+    if (frequency.QuadPart == 0) {
+        QueryPerformanceFrequency(&frequency);
+    }
+    LARGE_INTEGER now;
+    QueryPerformanceCounter(&now);
+    return 1000. * double(now.QuadPart) / double(frequency.QuadPart);
+}
+
+void setupSimulation()
+{
+    for (int n = 0; n < OBJECT_COUNT; n++) {
+        SimObject &object = g_Objects[n];
+        object.angle = n * 2.f * float(M_PI) / OBJECT_COUNT;
+        object.angularSpeed = .3f + .1f * (n % 4);
+        object.radius = 2.f + 2.f * (n % 3);
+        object.z = -float(n % 5);
+        object.rotation = n * 30.f;
+        object.spin = 90.f + 20.f * (n % 7);
+        object.scale = .8f + .1f * (n % 3);
+    }
+    g_Step = 0;
+    g_NextStepMs = timeMs();
+}
+
+// Stands in for collision, physics and the rest
+void busyWork(int iterations)
+{
+    float x = 1.f;
+    for (int k = 0; k < iterations; k++) {
+        x = sqrtf(x + 1.f);
+    }
+    g_WorkSink = x;
+}
+
+void writeSnapshot(Snapshot *pSnapshot)
+{
+    pSnapshot->step = g_Step;
+    pSnapshot->publishedMs = timeMs();
+    for (int n = 0; n < OBJECT_COUNT; n++) {
+        const SimObject &object = g_Objects[n];
+        ObjectState &state = pSnapshot->objects[n];
+        state.x = object.radius * cosf(object.angle);
+        state.y = object.radius * sinf(object.angle);
+        state.z = object.z;
+        state.rotation = object.rotation;
+        state.scale = object.scale;
+    }
+}
+
+void simulateStep()
+{
+    const float dt = float(SIM_STEP_MS / 1000.);
+    for (int n = 0; n < OBJECT_COUNT; n++) {
+        SimObject &object = g_Objects[n];
+        object.angle += object.angularSpeed * dt;
+        object.rotation += object.spin * dt;
+    }
+    busyWork(g_SimWork);
+    g_Step++;
+}
+
+// Runs the steps that are due, up to maxSteps, publishing after each.
+// Returns how long until the next one is due.
+double runDueSteps(int maxSteps)
+{
+    std::lock_guard<std::mutex> lock(g_SimMutex);
+    double now = timeMs();
+    for (int s = 0; s < maxSteps && now >= g_NextStepMs; s++) {
+        simulateStep();
+        writeSnapshot((Snapshot *)tripleWriteSlot(&g_Published));
+        triplePublish(&g_Published);
+        g_NextStepMs += SIM_STEP_MS;
+
+        double done = timeMs();
+        g_Steps++;
+        g_StepMicroseconds += (long long)((done - now) * 1000.);
+        now = done;
+    }
+    if (now - g_NextStepMs > SIM_MAX_LAG_MS) {
+        g_NextStepMs = now;
+    }
+    return g_NextStepMs - now;
+}
+
+void simulationThread()
+{
+    while (!g_Quit) {
+        if (!g_Split) {
+            Sleep(1);
+            continue;
+        }
+        double waitMs = runDueSteps(1);
+        if (waitMs >= 1.) {
+            Sleep(DWORD(waitMs));
+        }
+        else if (waitMs > 0.) {
+            Sleep(0);
+        }
+    }
+}
+
+void drawTrianglesAt(float x, float y, float z, float rotyDegrees, float scale, ShapeInfo *pInfo)
+{
+    mat4 modelViewMatrix(vmath::translate(x, y, z - CENTER_Z));
+    modelViewMatrix *= vmath::rotate(rotyDegrees, 0.f, 1.f, 0.f);
+    modelViewMatrix *= vmath::scale(scale, scale, scale);
+
+    glUniformMatrix4fv(g_MatrixUniform, 1, GL_FALSE, g_ProjectionMatrix * modelViewMatrix);
+    glDrawArrays(GL_TRIANGLES, 0, pInfo->count);
+}
+
+void onDisplay()
+{
+    static int frames = 0, freshFrames = 0;
+    static double frameMs = 0, ageMs = 0;
+    static double lastReport = timeMs();
+    static long long lastSteps = 0, lastStepMicroseconds = 0;
+
+    double frameStart = timeMs();
+    if (!g_Split) {
+        runDueSteps(INLINE_MAX_STEPS);
+    }
+
+    bool fresh;
+    const Snapshot *pSnapshot = (const Snapshot *)tripleRead(&g_Published, &fresh);
+    glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+    glBindVertexArray(g_Pyramid.vaoId);
+    for (int n = 0; n < OBJECT_COUNT; n++) {
+        const ObjectState &state = pSnapshot->objects[n];
+        drawTrianglesAt(state.x, state.y, state.z, state.rotation, state.scale, &g_Pyramid);
+    }
+    double now = timeMs();
+    frameMs += now - frameStart;
+    ageMs += now - pSnapshot->publishedMs;
+    freshFrames += fresh ? 1 : 0;
+    glutSwapBuffers();
+
+    frames++;
+    if (now - lastReport >= 2000) {
+        double seconds = (now - lastReport) / 1000.;
+        long long steps = g_Steps - lastSteps;
+        long long stepMicroseconds = g_StepMicroseconds - lastStepMicroseconds;
+        printf("%s:  render %.1f fps at %.2f ms, simulation %.1f steps/s at %.2f ms, "
+            "%d%% of frames new, snapshots %.1f ms old\n",
+            g_Split ? "Split" : "Inline", frames / seconds, frameMs / frames,
+            steps / seconds, steps ? stepMicroseconds / 1000. / steps : 0.,
+            freshFrames * 100 / frames, ageMs / frames);
+        lastSteps += steps;
+        lastStepMicroseconds += stepMicroseconds;
+        frames = freshFrames = 0;
+        frameMs = ageMs = 0;
+        lastReport = now;
+    }
+}
+
+void onKey(unsigned char key, int x, int y)
+{
+    switch (key) {
+    case '+':
+    case '=':
+        g_SimWork = g_SimWork * 2;
+        printf("Simulation work %d\n", int(g_SimWork));
+        return;
+    case '-':
+        g_SimWork = g_SimWork / 2 > 1000 ? g_SimWork / 2 : 1000;
+        printf("Simulation work %d\n", int(g_SimWork));
+        return;
+    case 's':
+    case 'S':
+        g_Split = !g_Split;
+        printf("Simulating on the %s thread\n", g_Split ? "simulation" : "render");
+        return;
+    }
+    g_Quit = true;
+    g_SimThread.join();
+    timeEndPeriod(1);
+    exit(0);
+}
+
+int main(int argc, char *argv[])
+{
+    glutInit(&argc, argv);
+    glutInitDisplayMode(GLUT_RGBA | GLUT_DOUBLE | GLUT_DEPTH);
+    glutInitWindowSize(640, 480);
+    glutCreateWindow(argv[0]);
+
+    glewInit();
+    wglSwapIntervalEXT(1);	// vsync
+
+    glEnable(GL_DEPTH_TEST);
+
+    GLfloat ratio = 640.0f / 480.0f;
+    GLfloat zNear = CENTER_Z - DEPTH_OF_FIELD/2;
+    GLfloat top = zNear * .8f;
+    setupFrustum(-ratio * top, ratio * top, -top, top, zNear, CENTER_Z + DEPTH_OF_FIELD/2);
+
+    setupShaders();
+    setupPyramid(&g_Pyramid);
+    setupTextures();
+
+    // All three slots start as the first state, so the first frames have
+    // something to draw whichever slot they get
+    setupSimulation();
+    for (int s = 0; s < 3; s++) {
+        writeSnapshot(&g_Snapshots[s]);
+    }
+    tripleInit(&g_Published, &g_Snapshots[0], &g_Snapshots[1], &g_Snapshots[2]);
+    // Sleep rounds up to the scheduler tick, 15.6 ms unless asked for
+    // finer, which is longer than a step
+    timeBeginPeriod(1);
+    g_SimThread = std::thread(simulationThread);
+
+    glutDisplayFunc(onDisplay);
+    glutIdleFunc(onDisplay);
+    glutKeyboardFunc(onKey);
+    glutMainLoop();
+
+    return 0;
+}
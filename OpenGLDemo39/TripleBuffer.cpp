@@ -0,0 +1,41 @@
+/*
+ * Triple buffering.  See TripleBuffer.h.
+ */
+#include "TripleBuffer.h"
+
+// Set on the middle index when it holds a snapshot the reader hasn't taken
+#define TRIPLE_FRESH    4
+#define TRIPLE_INDEX    3
+
+void tripleInit(TripleBuffer *pBuffer, void *pSlot0, void *pSlot1, void *pSlot2)
+{
+    pBuffer->pSlots[0] = pSlot0;
+    pBuffer->pSlots[1] = pSlot1;
+    pBuffer->pSlots[2] = pSlot2;
+    pBuffer->writing = 0;
+    pBuffer->middle = 1;
+    pBuffer->reading = 2;
+}
+
+void *tripleWriteSlot(TripleBuffer *pBuffer)
+{
+    return pBuffer->pSlots[pBuffer->writing];
+}
+
+void triplePublish(TripleBuffer *pBuffer)
+{
+    // Release makes the slot's contents visible with it; acquire makes sure
+    // the reader is done with the slot handed back
+    unsigned previous = pBuffer->middle.exchange(pBuffer->writing | TRIPLE_FRESH, std::memory_order_acq_rel);
+    pBuffer->writing = previous & TRIPLE_INDEX;
+}
+
+const void *tripleRead(TripleBuffer *pBuffer, bool *pFresh)
+{
+    *pFresh = (pBuffer->middle.load(std::memory_order_relaxed) & TRIPLE_FRESH) != 0;
+    if (*pFresh) {
+        unsigned previous = pBuffer->middle.exchange(pBuffer->reading, std::memory_order_acq_rel);
+        pBuffer->reading = previous & TRIPLE_INDEX;
+    }
+    return pBuffer->pSlots[pBuffer->reading];
+}
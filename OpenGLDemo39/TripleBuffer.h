@@ -0,0 +1,40 @@
+/*
+ * A lock-free triple buffer, for handing snapshots from one thread to
+ * another.
+ *
+ * There are three slots:  one the writer is filling, one the reader is
+ * using, and one in the middle holding the newest finished snapshot.
+ * Publishing swaps the writer's slot with the middle one, and reading
+ * swaps the middle one with the reader's if it has been published since;
+ * each is a single atomic exchange, so neither side ever waits for the
+ * other.  The reader always gets the newest whole snapshot, and snapshots
+ * it was too slow for are overwritten rather than queued.
+ *
+ * The slots belong to the caller and can be any size.  Only one thread
+ * may write and only one may read.
+ */
+#ifndef TRIPLE_BUFFER_H
+#define TRIPLE_BUFFER_H
+
+#include <atomic>
+
+typedef struct {
+    void *pSlots[3];
+    std::atomic<unsigned> middle;   // A slot index, with TRIPLE_FRESH until read
+    unsigned writing;               // The writer's alone
+    unsigned reading;               // The reader's alone
+} TripleBuffer;
+
+// Until the first publish the reader sees pSlot2, so it should hold
+// something sensible
+void tripleInit(TripleBuffer *pBuffer, void *pSlot0, void *pSlot1, void *pSlot2);
+
+// The slot to fill next
+void *tripleWriteSlot(TripleBuffer *pBuffer);
+void triplePublish(TripleBuffer *pBuffer);
+
+// The newest published slot.  *pFresh says whether it is new since the
+// last call.
+const void *tripleRead(TripleBuffer *pBuffer, bool *pFresh);
+
+#endif
@@ -0,0 +1,149 @@
+/*
+ * Shared-context workers.  See ContextPool.h.
+ */
+#include <windows.h>
+
+#include "ContextPool.h"
+
+#include <stdio.h>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+typedef struct {
+    ContextTask task;
+    void *pArgument;
+    ContextTicket *pTicket;
+} PendingTask;
+
+static HDC g_hDC;
+static std::vector<HGLRC> g_Contexts;
+static std::vector<std::thread> g_Workers;
+
+static std::mutex g_QueueMutex;
+static std::condition_variable g_QueueReady;
+static std::deque<PendingTask> g_Queue;
+static bool g_Quit;
+
+static void workerMain(HGLRC hContext)
+{
+    if (!wglMakeCurrent(g_hDC, hContext)) {
+        printf("A loader thread couldn't make its context current (%lu)\n", GetLastError());
+        return;
+    }
+    for (;;) {
+        PendingTask pending;
+        {
+            std::unique_lock<std::mutex> lock(g_QueueMutex);
+            while (g_Queue.empty() && !g_Quit) {
+                g_QueueReady.wait(lock);
+            }
+            if (g_Queue.empty()) {
+                break;
+            }
+            pending = g_Queue.front();
+            g_Queue.pop_front();
+        }
+        pending.task(pending.pArgument);
+
+        // The flush gets the fence to the GPU; without it another context
+        // could wait on a fence that is never signalled
+        GLsync fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+        glFlush();
+        pending.pTicket->fence.store(fence, std::memory_order_release);
+    }
+    wglMakeCurrent(NULL, NULL);
+}
+
+int ctxPoolInit(int workerCount)
+{
+    if (workerCount <= 0) {
+        workerCount = int(std::thread::hardware_concurrency()) - 1;
+        if (workerCount <= 0) {
+            workerCount = 1;
+        }
+    }
+    if (workerCount > CTX_MAX_WORKERS) {
+        workerCount = CTX_MAX_WORKERS;
+    }
+
+    g_hDC = wglGetCurrentDC();
+    HGLRC hMain = wglGetCurrentContext();
+    if (!g_hDC || !hMain) {
+        printf("ctxPoolInit needs the render context current\n");
+        return 0;
+    }
+    for (int w = 0; w < workerCount; w++) {
+        HGLRC hContext = wglCreateContext(g_hDC);
+        if (!hContext) {
+            break;
+        }
+        // Must happen before the new context has objects of its own
+        if (!wglShareLists(hMain, hContext)) {
+            printf("Couldn't share objects with a loader context (%lu)\n", GetLastError());
+            wglDeleteContext(hContext);
+            break;
+        }
+        g_Contexts.push_back(hContext);
+    }
+
+    g_Quit = false;
+    for (size_t w = 0; w < g_Contexts.size(); w++) {
+        g_Workers.push_back(std::thread(workerMain, g_Contexts[w]));
+    }
+    return int(g_Contexts.size());
+}
+
+void ctxPoolShutdown()
+{
+    {
+        std::lock_guard<std::mutex> lock(g_QueueMutex);
+        g_Quit = true;
+    }
+    g_QueueReady.notify_all();
+    for (size_t w = 0; w < g_Workers.size(); w++) {
+        g_Workers[w].join();
+    }
+    for (size_t w = 0; w < g_Contexts.size(); w++) {
+        wglDeleteContext(g_Contexts[w]);
+    }
+    g_Workers.clear();
+    g_Contexts.clear();
+}
+
+void ctxPoolSubmit(ContextTask task, void *pArgument, ContextTicket *pTicket)
+{
+    pTicket->fence = NULL;
+    pTicket->ready = false;
+    if (g_Workers.empty()) {
+        // No pool, so this context does the work
+        task(pArgument);
+        pTicket->ready = true;
+        return;
+    }
+    PendingTask pending = { task, pArgument, pTicket };
+    {
+        std::lock_guard<std::mutex> lock(g_QueueMutex);
+        g_Queue.push_back(pending);
+    }
+    g_QueueReady.notify_one();
+}
+
+bool ctxPoolPoll(ContextTicket *pTicket)
+{
+    if (pTicket->ready) {
+        return true;
+    }
+    GLsync fence = pTicket->fence.load(std::memory_order_acquire);
+    if (!fence) {
+        return false;
+    }
+    // Later commands here wait on the GPU for the worker's; nothing blocks
+    glWaitSync(fence, 0, GL_TIMEOUT_IGNORED);
+    glDeleteSync(fence);
+    pTicket->fence = NULL;
+    pTicket->ready = true;
+    return true;
+}
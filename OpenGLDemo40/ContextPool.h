@@ -0,0 +1,49 @@
+/*
+ * A pool of worker threads with their own GL contexts, for creating and
+ * filling GL objects off the render thread.
+ *
+ * ctxPoolInit runs on the render thread with its context current.  It
+ * makes one context per worker against the same device context, joins
+ * each to the render context's object names with wglShareLists before it
+ * has any objects of its own, and starts the workers, each with its
+ * context current for good.  Buffers, textures, shaders, programs and
+ * syncs are then shared; container objects (vertex arrays, framebuffers,
+ * program pipelines) are not, so the render thread builds those itself
+ * once what they hold is ready.
+ *
+ * A task is a function run on some worker.  When it returns, the worker
+ * puts a fence after its commands and flushes, and hands the fence to the
+ * task's ticket.  ctxPoolPoll on the render thread checks the ticket
+ * without blocking:  once the fence is there it makes the render context
+ * wait on it with glWaitSync, which holds the GPU rather than the CPU, and
+ * from then on the task's objects can be bound and used.  Objects must be
+ * bound again on the render thread after that to see their contents.
+ */
+#ifndef CONTEXT_POOL_H
+#define CONTEXT_POOL_H
+
+#include <GL/glew.h>
+#include <atomic>
+
+#define CTX_MAX_WORKERS 16
+
+typedef void (*ContextTask)(void *pArgument);
+
+struct ContextTicket {
+    std::atomic<GLsync> fence;      // Set by the worker when the task is done
+    bool ready;                     // Set by ctxPoolPoll once waited on
+    ContextTicket() : fence(NULL), ready(false) {}
+};
+
+// workerCount 0 means one per core, less one for the render thread.
+// Returns the number of workers started; 0 if no context could be shared.
+int ctxPoolInit(int workerCount);
+void ctxPoolShutdown();
+
+// pTicket must stay put until ctxPoolPoll has returned true for it
+void ctxPoolSubmit(ContextTask task, void *pArgument, ContextTicket *pTicket);
+
+// On the render thread.  True once the task's objects are usable.
+bool ctxPoolPoll(ContextTicket *pTicket);
+
+#endif
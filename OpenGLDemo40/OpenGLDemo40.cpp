@@ -0,0 +1,412 @@
+/*
+ * Demo 40:
+ * Loading on several GL contexts at once (see ContextPool.h).  A scene of
+ * textured tori is loaded with each torus's mesh generated, its texture and
+ * mips drawn, and both uploaded by a task on a loader thread with its own
+ * shared context; the shader program is compiled by another.  The render
+ * thread keeps drawing while they load, and each torus appears once its
+ * fence says its objects are ready and it has a vertex array, which only
+ * the render thread can make.
+ *
+ * Press L to load again on the loader threads, K to load on the render
+ * thread alone for comparison, and any other key to exit.  Both report how
+ * long the whole scene took.
+ *
+ * See README.txt for prerequisites.
+ */
+#include <windows.h>
+#include <WinGDI.h>
+
+#include <GL/glew.h>
+#include <GL/wglew.h>
+#include <GL/GL.h>
+#include <GL/glut.h>
+
+#include <stdio.h>
+#include <stddef.h>
+
+#define _USE_MATH_DEFINES
+#include <math.h>
+#include <vector>
+
+#include <vmath.h>
+using vmath::mat4;
+
+#include "ContextPool.h"
+
+// Apparently someone is still using segmented memory qualifiers,
+// and windows.h is letting them.
+#undef near
+#undef far
+
+#define CENTER_Z        12.0f    // Distance from camera
+#define DEPTH_OF_FIELD  6.0f
+
+#define ASSET_COLUMNS   6
+#define ASSET_ROWS      4
+#define ASSET_COUNT     (ASSET_COLUMNS * ASSET_ROWS)
+#define ASSET_SPACING   1.6f
+
+// Segments around the torus and around its tube
+#define TORUS_MAJOR     256
+#define TORUS_MINOR     128
+
+#define TEXTURE_SIZE    512
+#define TEXTURE_LEVELS  10
+
+typedef struct {
+    GLfloat x, y, z;
+    GLubyte red, green, blue;
+    GLfloat texU, texV;
+} VertexInfo;
+
+typedef struct {
+    int index;
+    GLuint vboId, iboId, textureId;
+    GLsizei indexCount;
+    GLuint vaoId;               // Made on the render thread once the rest is ready
+    ContextTicket ticket;
+} Asset;
+
+Asset g_Assets[ASSET_COUNT];
+GLuint g_Program;
+ContextTicket g_ProgramTicket;
+int g_LoaderCount;
+bool g_Loading;
+double g_LoadStartMs;
+mat4 g_ProjectionMatrix(mat4::identity());
+
+// Must match hard-coded vPosition location in vertShaderSource
+#define V_POSITION 0
+
+// Must match hard-coded location in vertShaderSource
+#define C_POSITION 1
+
+// Must match hard-coded vTexture location in vertShaderSource
+#define T_POSITION 2
+
+// Must match hard-coded ModelViewProject location in vertShaderSource
+#define MATRIX_LOCATION 0
+
+void compileProgram(void *pArgument)
+{
+    GLchar infoLog[4096];
+    GLsizei length;
+
+    const GLchar *vertShaderSource[] = {
+        "#version 430 core\n"
+        "layout(location = 0) uniform mat4 ModelViewProject;\n"
+        "layout(location = 0) in vec4 vPosition;\n"
+        "layout(location = 1) in vec3 vColor;\n"
+        "layout(location = 2) in vec2 vTexture;\n"
+        "out vec3 color;\n"
+        "out vec2 vs_tex_coord;\n"
+        "void main() {\n"
+        "    gl_Position = ModelViewProject * vPosition;\n"
+        "    vs_tex_coord = vTexture;\n"
+        "    color = vColor;\n"
+        "}\n"
+    };
+    GLuint vertShader = glCreateShader(GL_VERTEX_SHADER);
+    glShaderSource(vertShader, 1, vertShaderSource, NULL);
+
+    const GLchar *fragShaderSource[] = {
+        "#version 430 core\n"
+        "layout(binding = 0) uniform sampler2D tex;\n"
+        "in vec3 color;\n"
+        "in vec2 vs_tex_coord;\n"
+        "out vec4 fColor;\n"
+        "void main() {\n"
+        "    fColor = vec4(color, 1) * texture(tex, vs_tex_coord);\n"
+        "}\n"
+    };
+    GLuint fragShader = glCreateShader(GL_FRAGMENT_SHADER);
+    glShaderSource(fragShader, 1, fragShaderSource, NULL);
+
+    GLuint program = glCreateProgram();
+    glAttachShader(program, vertShader);
+    glCompileShader(vertShader);
+    glGetShaderInfoLog(vertShader, 4096, &length, infoLog);
+
+    glAttachShader(program, fragShader);
+    glCompileShader(fragShader);
+    glGetShaderInfoLog(fragShader, 4096, &length, infoLog);
+
+    glLinkProgram(program);
+    glDeleteShader(vertShader);
+    glDeleteShader(fragShader);
+    *(GLuint *)pArgument = program;
+}
+
+// Vertices shaded by how much the tube faces the viewer
+void buildTorus(std::vector<VertexInfo> *pVertices, std::vector<GLuint> *pIndices)
+{
+    const float majorRadius = .5f, minorRadius = .2f;
+    pVertices->resize((TORUS_MAJOR + 1) * (TORUS_MINOR + 1));
+    VertexInfo *pVertex = &(*pVertices)[0];
+    for (int i = 0; i <= TORUS_MAJOR; i++) {
+        float u = float(i) / TORUS_MAJOR, theta = u * 2.f * float(M_PI);
+        for (int j = 0; j <= TORUS_MINOR; j++, pVertex++) {
+            float v = float(j) / TORUS_MINOR, phi = v * 2.f * float(M_PI);
+            float ring = majorRadius + minorRadius * cosf(phi);
+            pVertex->x = ring * cosf(theta);
+            pVertex->y = ring * sinf(theta);
+            pVertex->z = minorRadius * sinf(phi);
+            GLubyte shade = GLubyte(150 + 105 * sinf(phi) * sinf(phi));
+            pVertex->red = pVertex->green = pVertex->blue = shade;
+            pVertex->texU = u * 8.f;
+            pVertex->texV = v * 2.f;
+        }
+    }
+
+    pIndices->resize(TORUS_MAJOR * TORUS_MINOR * 6);
+    GLuint *pIndex = &(*pIndices)[0];
+    for (int i = 0; i < TORUS_MAJOR; i++) {
+        for (int j = 0; j < TORUS_MINOR; j++) {
+            GLuint corner = i * (TORUS_MINOR + 1) + j;
+            GLuint next = corner + TORUS_MINOR + 1;
+            *pIndex++ = corner;
+            *pIndex++ = next;
+            *pIndex++ = corner + 1;
+            *pIndex++ = corner + 1;
+            *pIndex++ = next;
+            *pIndex++ = next + 1;
+        }
+    }
+}
+
+// Stripes in a color of the asset's own, and each mip boxed down from the
+// level above
+void buildTexture(int index, std::vector<std::vector<GLubyte> > *pLevels)
+{
+    GLubyte red = GLubyte(128 + 127 * sinf(index * 1.1f));
+    GLubyte green = GLubyte(128 + 127 * sinf(index * 1.7f + 2.f));
+    GLubyte blue = GLubyte(128 + 127 * sinf(index * 2.3f + 4.f));
+
+    pLevels->resize(TEXTURE_LEVELS);
+    for (int level = 0; level < TEXTURE_LEVELS; level++) {
+        int size = TEXTURE_SIZE >> level, above = size * 2;
+        (*pLevels)[level].resize(size * size * 4);
+        GLubyte *pTexel = &(*pLevels)[level][0];
+        for (int y = 0; y < size; y++) {
+            for (int x = 0; x < size; x++, pTexel += 4) {
+                if (level == 0) {
+                    float stripe = .5f + .5f * sinf((x + y * (index % 3)) * .1f);
+                    pTexel[0] = GLubyte(red * stripe + 255 * (1 - stripe));
+                    pTexel[1] = GLubyte(green * stripe + 255 * (1 - stripe));
+                    pTexel[2] = GLubyte(blue * stripe + 255 * (1 - stripe));
+                    pTexel[3] = 255;
+                    continue;
+                }
+                const GLubyte *pAbove = &(*pLevels)[level - 1][0];
+                for (int c = 0; c < 4; c++) {
+                    pTexel[c] = GLubyte((pAbove[((2 * y) * above + 2 * x) * 4 + c] +
+                        pAbove[((2 * y) * above + 2 * x + 1) * 4 + c] +
+                        pAbove[((2 * y + 1) * above + 2 * x) * 4 + c] +
+                        pAbove[((2 * y + 1) * above + 2 * x + 1) * 4 + c] + 2) / 4);
+                }
+            }
+        }
+    }
+}
+
+// Runs on whichever context is current:  a loader's, or the render
+// thread's when loading serially
+void loadAsset(void *pArgument)
+{
+    Asset *pAsset = (Asset *)pArgument;
+
+    std::vector<VertexInfo> vertices;
+    std::vector<GLuint> indices;
+    buildTorus(&vertices, &indices);
+    glGenBuffers(1, &pAsset->vboId);
+    glBindBuffer(GL_ARRAY_BUFFER, pAsset->vboId);
+    glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(VertexInfo), &vertices[0], GL_STATIC_DRAW);
+    glGenBuffers(1, &pAsset->iboId);
+    glBindBuffer(GL_ARRAY_BUFFER, pAsset->iboId);
+    glBufferData(GL_ARRAY_BUFFER, indices.size() * sizeof(GLuint), &indices[0], GL_STATIC_DRAW);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+    pAsset->indexCount = GLsizei(indices.size());
+
+    std::vector<std::vector<GLubyte> > levels;
+    buildTexture(pAsset->index, &levels);
+    glGenTextures(1, &pAsset->textureId);
+    glBindTexture(GL_TEXTURE_2D, pAsset->textureId);
+    glTexStorage2D(GL_TEXTURE_2D, TEXTURE_LEVELS, GL_RGBA8, TEXTURE_SIZE, TEXTURE_SIZE);
+    for (int level = 0; level < TEXTURE_LEVELS; level++) {
+        int size = TEXTURE_SIZE >> level;
+        glTexSubImage2D(GL_TEXTURE_2D, level, 0, 0, size, size, GL_RGBA, GL_UNSIGNED_BYTE, &levels[level][0]);
+    }
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glBindTexture(GL_TEXTURE_2D, 0);
+}
+
+// Vertex arrays aren't shared between contexts, so this is always here
+void setupVertexArray(Asset *pAsset)
+{
+    glGenVertexArrays(1, &pAsset->vaoId);
+    glBindVertexArray(pAsset->vaoId);
+    glBindBuffer(GL_ARRAY_BUFFER, pAsset->vboId);
+    glVertexAttribPointer(V_POSITION, 3, GL_FLOAT, GL_FALSE, sizeof(VertexInfo), (GLvoid*)offsetof(VertexInfo, x));
+    glEnableVertexAttribArray(V_POSITION);
+    glVertexAttribPointer(C_POSITION, 3, GL_UNSIGNED_BYTE, GL_TRUE, sizeof(VertexInfo), (GLvoid*)offsetof(VertexInfo, red));
+    glEnableVertexAttribArray(C_POSITION);
+    glVertexAttribPointer(T_POSITION, 2, GL_FLOAT, GL_FALSE, sizeof(VertexInfo), (GLvoid*)offsetof(VertexInfo, texU));
+    glEnableVertexAttribArray(T_POSITION);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, pAsset->iboId);
+    glBindVertexArray(0);
+}
+
+double timeMs()
+{
+    static LARGE_INTEGER frequency = { 0 };
+    if (frequency.QuadPart == 0) {
+        QueryPerformanceFrequency(&frequency);
+    }
+    LARGE_INTEGER now;
+    QueryPerformanceCounter(&now);
+    return 1000. * double(now.QuadPart) / double(frequency.QuadPart);
+}
+
+void unloadScene()
+{
+    for (int a = 0; a < ASSET_COUNT; a++) {
+        Asset &asset = g_Assets[a];
+        glDeleteVertexArrays(1, &asset.vaoId);
+        glDeleteBuffers(1, &asset.vboId);
+        glDeleteBuffers(1, &asset.iboId);
+        glDeleteTextures(1, &asset.textureId);
+        asset.vaoId = asset.vboId = asset.iboId = asset.textureId = 0;
+    }
+    glDeleteProgram(g_Program);
+    g_Program = 0;
+}
+
+void startLoading()
+{
+    unloadScene();
+    g_LoadStartMs = timeMs();
+    g_Loading = true;
+    ctxPoolSubmit(compileProgram, &g_Program, &g_ProgramTicket);
+    for (int a = 0; a < ASSET_COUNT; a++) {
+        g_Assets[a].index = a;
+        ctxPoolSubmit(loadAsset, &g_Assets[a], &g_Assets[a].ticket);
+    }
+}
+
+void loadSerially()
+{
+    unloadScene();
+    double start = timeMs();
+    compileProgram(&g_Program);
+    for (int a = 0; a < ASSET_COUNT; a++) {
+        g_Assets[a].index = a;
+        loadAsset(&g_Assets[a]);
+        setupVertexArray(&g_Assets[a]);
+    }
+    g_ProgramTicket.ready = true;
+    glFinish();
+    printf("Loaded %d assets in %.1f ms on the render thread\n", ASSET_COUNT, timeMs() - start);
+}
+
+// Picks up whatever the loaders have finished since the last frame
+void collectLoaded()
+{
+    if (!g_Loading) {
+        return;
+    }
+    ctxPoolPoll(&g_ProgramTicket);
+    int ready = 0;
+    for (int a = 0; a < ASSET_COUNT; a++) {
+        Asset &asset = g_Assets[a];
+        if (!asset.vaoId && ctxPoolPoll(&asset.ticket)) {
+            setupVertexArray(&asset);
+        }
+        ready += asset.vaoId ? 1 : 0;
+    }
+    if (ready == ASSET_COUNT && g_ProgramTicket.ready) {
+        printf("Loaded %d assets in %.1f ms on %d loader threads\n", ASSET_COUNT, timeMs() - g_LoadStartMs, g_LoaderCount);
+        g_Loading = false;
+    }
+}
+
+void setupFrustum(float left, float right, float bottom, float top, float zNear, float zFar)
+{
+    g_ProjectionMatrix = vmath::frustum(left, right, bottom, top, zNear, zFar);
+}
+
+void onDisplay()
+{
+    static double startTime = timeMs();
+    float time = float((timeMs() - startTime) / 1000.);
+
+    collectLoaded();
+    glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+    glUseProgram(g_ProgramTicket.ready ? g_Program : 0);
+    for (int a = 0; g_ProgramTicket.ready && a < ASSET_COUNT; a++) {
+        const Asset &asset = g_Assets[a];
+        if (!asset.vaoId) {
+            continue;
+        }
+        float x = (a % ASSET_COLUMNS - (ASSET_COLUMNS - 1) / 2.f) * ASSET_SPACING;
+        float y = (a / ASSET_COLUMNS - (ASSET_ROWS - 1) / 2.f) * ASSET_SPACING;
+        mat4 modelViewMatrix(vmath::translate(x, y, -CENTER_Z));
+        modelViewMatrix *= vmath::rotate(time * 40.f + a * 15.f, 1.f, 1.f, 0.f);
+        glUniformMatrix4fv(MATRIX_LOCATION, 1, GL_FALSE, g_ProjectionMatrix * modelViewMatrix);
+        glBindTexture(GL_TEXTURE_2D, asset.textureId);
+        glBindVertexArray(asset.vaoId);
+        glDrawElements(GL_TRIANGLES, asset.indexCount, GL_UNSIGNED_INT, 0);
+    }
+    glutSwapBuffers();
+}
+
+void onKey(unsigned char key, int x, int y)
+{
+    switch (key) {
+    case 'l':
+    case 'L':
+        if (!g_Loading) {
+            startLoading();
+        }
+        return;
+    case 'k':
+    case 'K':
+        if (!g_Loading) {
+            loadSerially();
+        }
+        return;
+    }
+    ctxPoolShutdown();
+    exit(0);
+}
+
+int main(int argc, char *argv[])
+{
+    glutInit(&argc, argv);
+    glutInitDisplayMode(GLUT_RGBA | GLUT_DOUBLE | GLUT_DEPTH);
+    glutInitWindowSize(640, 480);
+    glutCreateWindow(argv[0]);
+
+    glewInit();
+    wglSwapIntervalEXT(1);	// vsync
+
+    glEnable(GL_DEPTH_TEST);
+
+    GLfloat ratio = 640.0f / 480.0f;
+    GLfloat zNear = CENTER_Z - DEPTH_OF_FIELD/2;
+    GLfloat top = zNear * .4f;
+    setupFrustum(-ratio * top, ratio * top, -top, top, zNear, CENTER_Z + DEPTH_OF_FIELD/2);
+
+    // With no loaders, tasks run here as they are submitted
+    g_LoaderCount = ctxPoolInit(0);
+    printf("%d loader threads\n", g_LoaderCount);
+
+    startLoading();
+    glutDisplayFunc(onDisplay);
+    glutIdleFunc(onDisplay);
+    glutKeyboardFunc(onKey);
+    glutMainLoop();
+
+    return 0;
+}
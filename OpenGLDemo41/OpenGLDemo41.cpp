@@ -0,0 +1,435 @@
+/*
+ * Demo 41:
+ * Drawing only when something has changed (see Redraw.h).  The pyramid
+ * flies in as in Demos 11-16 and then stops, and from then on nothing is
+ * drawn until something is invalidated:  the scene by a key or the ticking
+ * thread, the camera by the arrow keys, or the window by resizing or
+ * uncovering it.  Each time the demo goes idle it prints how many frames
+ * it drew, and each time it wakes how long it slept, how much CPU time
+ * the process used meanwhile, and what woke it.
+ *
+ * Press the arrow keys to turn the camera, space to fly the pyramid in
+ * again, T to start or stop a thread that changes the background color
+ * once a second, and any other key to exit.
+ *
+ * See README.txt for prerequisites.
+ */
+#include <windows.h>
+#include <WinGDI.h>
+
+#include <GL/glew.h>
+#include <GL/wglew.h>
+#include <GL/GL.h>
+#include <GL/glut.h>
+
+#include <stdio.h>
+#include <stddef.h>
+#include <math.h>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+
+#include <vmath.h>
+using vmath::mat4;
+
+#include "Redraw.h"
+
+// Apparently someone is still using segmented memory qualifiers,
+// and windows.h is letting them.
+#undef near
+#undef far
+
+#define CENTER_Z        6.0f     // Distance from camera
+#define DEPTH_OF_FIELD  5.0f
+
+// Frames the pyramid takes to fly in
+#define FLY_IN_FRAMES   400
+
+#define CAMERA_STEP     5.f      // Degrees per arrow key
+
+// Idle spells shorter than this aren't worth reporting
+#define REPORT_IDLE_MS  500.
+
+typedef struct {
+    GLsizei count;
+    GLuint vaoId;
+} ShapeInfo;
+
+ShapeInfo g_Pyramid;
+GLint g_MatrixUniform, g_SamplerUniform;
+mat4 g_ProjectionMatrix(mat4::identity());
+
+int g_Frame;
+float g_CameraYaw, g_CameraPitch;
+
+std::atomic<int> g_BackgroundShade(0);
+std::thread g_Ticker;
+std::mutex g_TickerMutex;
+std::condition_variable g_TickerStop;
+bool g_Ticking;
+
+#define BLOCKY_SAMPLER 1
+
+// Must match hard-coded vPosition location in vertShaderSource
+#define V_POSITION 0
+
+// Must match hard-coded location in vertShaderSource
+#define C_POSITION 1
+
+// Must match hard-coded vTexture location in vertShaderSource
+#define T_POSITION 2
+
+void setupShaders()
+{
+    GLchar infoLog[4096];
+    GLsizei length;
+
+    const GLchar *vertShaderSource[] = {
+        "#version 430 core\n"
+        "uniform mat4 ModelViewProject;\n"
+        "layout(location = 0) in vec4 vPosition;\n"
+        "layout(location = 1) in vec3 vColor;\n"
+        "layout(location = 2) in vec2 vTexture;\n"
+        "out vec3 color;\n"
+        "out vec2 vs_tex_coord;\n"
+        "void main() {\n"
+        "    gl_Position = ModelViewProject * vPosition;\n"
+        "    vs_tex_coord = vTexture;\n"
+        "    color = vColor;\n"
+        "}\n"
+    };
+    GLuint vertShader = glCreateShader(GL_VERTEX_SHADER);
+    glShaderSource(vertShader, 1, vertShaderSource, NULL);
+
+    const GLchar *fragShaderSource[] = {
+        "#version 430 core\n"
+        "uniform sampler2D tex;\n"
+        "in vec3 color;\n"
+        "in vec2 vs_tex_coord;\n"
+        "out vec4 fColor;\n"
+        "void main() {\n"
+        "    vec4 texColor = texture(tex, vs_tex_coord);\n"
+        "    fColor = vec4(color, 0) * (1 - texColor.a) + texColor;\n"
+        "}\n"
+    };
+    GLuint fragShader = glCreateShader(GL_FRAGMENT_SHADER);
+    glShaderSource(fragShader, 1, fragShaderSource, NULL);
+
+    GLuint program = glCreateProgram();
+    glAttachShader(program, vertShader);
+    glCompileShader(vertShader);
+    glGetShaderInfoLog(vertShader, 4096, &length, infoLog);
+
+    glAttachShader(program, fragShader);
+    glCompileShader(fragShader);
+    glGetShaderInfoLog(fragShader, 4096, &length, infoLog);
+
+    glLinkProgram(program);
+    glUseProgram(program);
+    g_MatrixUniform = glGetUniformLocation(program, "ModelViewProject");
+    g_SamplerUniform = glGetUniformLocation(program, "tex");
+}
+
+// Convert a simple bitmap (one bit per pixel) into an RGBA bitmap (four bytes per pixel)
+GLubyte* BuildMonochromeBitmap(const GLubyte* bits, int width, int height, GLubyte red, GLubyte green, GLubyte blue)
+{
+    GLubyte* retval = (GLubyte *)malloc(width * height * 4);
+    if (retval) {
+        GLubyte* ptr = retval;
+        for (int y = 0; y < height; y++) {
+            for (int x = 0; x < width/8; x++) {
+                GLubyte next8 = *bits++;
+                for (int mask = 128; mask > 0; mask >>= 1) {
+                    if (next8 & mask) {
+                        *ptr++ = red;
+                        *ptr++ = green;
+                        *ptr++ = blue;
+                        *ptr++ = 255;
+                    }
+                    else {
+                        *ptr++ = 0;
+                        *ptr++ = 0;
+                        *ptr++ = 0;
+                        *ptr++ = 0;
+                    }
+                }
+            }
+        }
+    }
+    return retval;
+}
+
+#define BITMAP_WIDTH 16
+#define BITMAP_HEIGHT 16
+#define BIT_BYTES ((BITMAP_WIDTH / 8) * BITMAP_HEIGHT)
+
+void setupTextures()
+{
+    // smiley face
+    GLubyte bits[BIT_BYTES] = {
+        0x00, 0x00,
+        0x00, 0x00,
+        0x07, 0xE0,
+        0x08, 0x10,
+        0x10, 0x08,
+        0x20, 0x04,
+        0x44, 0x22,
+        0x40, 0x02,
+        0x40, 0x02,
+        0x40, 0x02,
+        0x42, 0x42,
+        0x23, 0xc4,
+        0x10, 0x08,
+        0x0c, 0x30,
+        0x03, 0xc0,
+        0x00, 0x00,
+    };
+
+    GLubyte* data = BuildMonochromeBitmap(bits, BITMAP_WIDTH, BITMAP_HEIGHT, 255, 0, 0);
+    if (!data) {
+        return;
+    }
+    GLuint texture;
+    glGenTextures(1, &texture);
+    glActiveTexture(GL_TEXTURE0 + BLOCKY_SAMPLER);
+    glBindTexture(GL_TEXTURE_2D, texture);
+    glTexStorage2D(GL_TEXTURE_2D, 1, GL_RGBA8, BITMAP_WIDTH, BITMAP_HEIGHT);
+    glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, BITMAP_WIDTH, BITMAP_HEIGHT, GL_RGBA, GL_UNSIGNED_BYTE, data);
+    free(data);
+
+    GLuint sampler;
+    glGenSamplers(1, &sampler);
+    glBindSampler(BLOCKY_SAMPLER, sampler);
+    glSamplerParameteri(sampler, GL_TEXTURE_WRAP_S, GL_REPEAT);
+    glSamplerParameteri(sampler, GL_TEXTURE_WRAP_T, GL_REPEAT);
+    glSamplerParameteri(sampler, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    glSamplerParameteri(sampler, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    glUniform1i(g_SamplerUniform, BLOCKY_SAMPLER);
+}
+
+void setupPyramid(ShapeInfo *pInfo)
+{
+    typedef struct {
+        GLfloat x, y, z;
+        GLubyte red, green, blue;
+        GLfloat texU, texV;
+    } VertexInfo;
+
+    static const VertexInfo pyramidData[] = {
+        // Bottom
+        { 0.0f, 0.f, .5f, 255, 0, 0, 0.f, 0.f},
+        { 0.433f, 0.f, -.25f, 255, 0, 0, 0.f, 1.f},
+        { -0.433f, 0.f, -.25f, 255, 0, 0, 1.f, 1.f},
+        // Side 1
+        { -0.433f, 0.f, -.25f, 0, 0, 255, 0.f, 0.f},
+        { 0.433f, 0.f, -.25f, 0, 255, 255, 1.f, 0.f},
+        { 0.0f, 0.75f, 0.f, 255, 0, 255, 1.f, 1.f},
+        // Side 2
+        { -0.433f, 0.f, -.25f, 255, 255, 0, 0.f, 0.f},
+        { 0.0f, 0.f, .5f, 255, 255, 0, 0.f, 1.f},
+        { 0.0f, 0.75f, 0.f, 255, 255, 0, 1.f, 1.f},
+        // Side 3
+        { 0.0f, 0.f, .5f, 0, 255, 0, 4.f, 4.f},
+        { 0.0f, 0.75f, 0.f, 0, 255, 0, 2.f, 0.f},
+        { 0.433f, 0.f, -.25f, 0, 255, 0, 0.f, 4.f},
+    };
+
+    GLuint vboId;
+    glGenVertexArrays(1, &pInfo->vaoId);
+    glBindVertexArray(pInfo->vaoId);
+    glGenBuffers(1, &vboId);
+    glBindBuffer(GL_ARRAY_BUFFER, vboId);
+    glBufferData(GL_ARRAY_BUFFER, sizeof(pyramidData), pyramidData, GL_STATIC_DRAW);
+
+    glVertexAttribPointer(V_POSITION, 3, GL_FLOAT, GL_FALSE, sizeof(VertexInfo), (GLvoid*)offsetof(VertexInfo, x));
+    glEnableVertexAttribArray(V_POSITION);
+    glVertexAttribPointer(C_POSITION, 3, GL_UNSIGNED_BYTE, GL_TRUE, sizeof(VertexInfo), (GLvoid*)offsetof(VertexInfo, red));
+    glEnableVertexAttribArray(C_POSITION);
+    glVertexAttribPointer(T_POSITION, 2, GL_FLOAT, GL_FALSE, sizeof(VertexInfo), (GLvoid*)offsetof(VertexInfo, texU));
+    glEnableVertexAttribArray(T_POSITION);
+
+    pInfo->count = 12;
+}
+
+void setupFrustum(float left, float right, float bottom, float top, float zNear, float zFar)
+{
+    g_ProjectionMatrix = vmath::frustum(left, right, bottom, top, zNear, zFar);
+}
+
+
+double timeMs()
+{
+    static LARGE_INTEGER frequency = { 0 };
+    if (frequency.QuadPart == 0) {
+        QueryPerformanceFrequency(&frequency);
+    }
+    LARGE_INTEGER now;
+    QueryPerformanceCounter(&now);
+    return 1000. * double(now.QuadPart) / double(frequency.QuadPart);
+}
+
+// User and kernel time of the whole process, every thread included
+double cpuMs()
+{
+    FILETIME creation, exit, kernel, user;
+    GetProcessTimes(GetCurrentProcess(), &creation, &exit, &kernel, &user);
+    unsigned long long ticks = ((unsigned long long)kernel.dwHighDateTime << 32) + kernel.dwLowDateTime +
+        ((unsigned long long)user.dwHighDateTime << 32) + user.dwLowDateTime;
+    return ticks / 10000.;
+}
+
+// Stands in for anything off the render thread that changes the scene
+void tickerMain()
+{
+    std::unique_lock<std::mutex> lock(g_TickerMutex);
+    while (!g_TickerStop.wait_for(lock, std::chrono::seconds(1), [] { return !g_Ticking; })) {
+        g_BackgroundShade = (g_BackgroundShade + 1) % 4;
+        redrawInvalidate(DAMAGE_SCENE);
+    }
+}
+
+void toggleTicker()
+{
+    if (!g_Ticking) {
+        g_Ticking = true;
+        g_Ticker = std::thread(tickerMain);
+        return;
+    }
+    {
+        std::lock_guard<std::mutex> lock(g_TickerMutex);
+        g_Ticking = false;
+    }
+    g_TickerStop.notify_one();
+    g_Ticker.join();
+}
+
+void drawTrianglesAt(float x, float y, float z, float rotyDegrees, float scale, ShapeInfo *pInfo)
+{
+    mat4 modelViewMatrix(vmath::translate(0.f, 0.f, -CENTER_Z));
+    modelViewMatrix *= vmath::rotate(g_CameraPitch, 1.f, 0.f, 0.f);
+    modelViewMatrix *= vmath::rotate(g_CameraYaw, 0.f, 1.f, 0.f);
+    modelViewMatrix *= vmath::translate(x, y, z);
+    modelViewMatrix *= vmath::rotate(rotyDegrees, 0.f, 1.f, 0.f);
+    modelViewMatrix *= vmath::scale(scale, scale, scale);
+
+    glUniformMatrix4fv(g_MatrixUniform, 1, GL_FALSE, g_ProjectionMatrix * modelViewMatrix);
+    glBindVertexArray(pInfo->vaoId);
+    glDrawArrays(GL_TRIANGLES, 0, pInfo->count);
+}
+
+void onDisplay()
+{
+    static int framesDrawn = 0;
+    static double idleSinceMs = 0., idleSinceCpuMs = 0.;
+
+    unsigned damage = redrawTake();
+    if (idleSinceMs != 0.) {
+        double idleMs = timeMs() - idleSinceMs;
+        if (idleMs >= REPORT_IDLE_MS) {
+            printf("Woke after %.1f s idle, %.1f ms CPU meanwhile, for:%s%s%s\n", idleMs / 1000., cpuMs() - idleSinceCpuMs,
+                (damage & DAMAGE_SCENE) ? " scene" : "", (damage & DAMAGE_CAMERA) ? " camera" : "",
+                (damage & DAMAGE_WINDOW) ? " window" : "");
+        }
+        idleSinceMs = 0.;
+    }
+
+    static const GLfloat shades[4][3] = { { 0.f, 0.f, 0.f }, { .1f, .1f, .3f }, { .1f, .3f, .1f }, { .3f, .1f, .1f } };
+    const GLfloat *pShade = shades[g_BackgroundShade];
+    glClearColor(pShade[0], pShade[1], pShade[2], 1.f);
+    glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+    float z = -g_Frame/200.f;
+    float angle = g_Frame/30.f;
+    drawTrianglesAt(cosf(angle), sinf(angle), z, g_Frame*3.f, 2.f, &g_Pyramid);
+    glutSwapBuffers();
+    framesDrawn++;
+
+    // Still moving, so the next frame is already damaged
+    if (g_Frame < FLY_IN_FRAMES) {
+        g_Frame++;
+        redrawInvalidate(DAMAGE_SCENE);
+        return;
+    }
+    if (framesDrawn > 1) {
+        printf("Drew %d frames, now idle\n", framesDrawn);
+    }
+    framesDrawn = 0;
+    idleSinceMs = timeMs();
+    idleSinceCpuMs = cpuMs();
+}
+
+void onReshape(int width, int height)
+{
+    glViewport(0, 0, width, height);
+    GLfloat ratio = GLfloat(width) / GLfloat(height ? height : 1);
+    setupFrustum(-ratio, ratio, -1., 1., CENTER_Z - DEPTH_OF_FIELD/2, CENTER_Z + DEPTH_OF_FIELD/2);
+    redrawInvalidate(DAMAGE_WINDOW);
+}
+
+void onSpecialKey(int key, int x, int y)
+{
+    switch (key) {
+    case GLUT_KEY_LEFT:
+        g_CameraYaw -= CAMERA_STEP;
+        break;
+    case GLUT_KEY_RIGHT:
+        g_CameraYaw += CAMERA_STEP;
+        break;
+    case GLUT_KEY_UP:
+        g_CameraPitch -= CAMERA_STEP;
+        break;
+    case GLUT_KEY_DOWN:
+        g_CameraPitch += CAMERA_STEP;
+        break;
+    default:
+        return;
+    }
+    redrawInvalidate(DAMAGE_CAMERA);
+}
+
+void onKey(unsigned char key, int x, int y)
+{
+    switch (key) {
+    case ' ':
+        g_Frame = 0;
+        redrawInvalidate(DAMAGE_SCENE);
+        return;
+    case 't':
+    case 'T':
+        toggleTicker();
+        printf("Ticker %s\n", g_Ticking ? "on" : "off");
+        return;
+    }
+    if (g_Ticking) {
+        toggleTicker();
+    }
+    exit(0);
+}
+
+int main(int argc, char *argv[])
+{
+    glutInit(&argc, argv);
+    glutInitDisplayMode(GLUT_RGBA | GLUT_DOUBLE | GLUT_DEPTH);
+    glutInitWindowSize(640, 480);
+    glutCreateWindow(argv[0]);
+
+    glewInit();
+    wglSwapIntervalEXT(1);	// vsync
+
+    glEnable(GL_DEPTH_TEST);
+
+    setupShaders();
+    setupPyramid(&g_Pyramid);
+    setupTextures();
+    redrawInit();
+
+    // No idle function:  onDisplay runs only when something is invalidated
+    glutDisplayFunc(onDisplay);
+    glutReshapeFunc(onReshape);
+    glutKeyboardFunc(onKey);
+    glutSpecialFunc(onSpecialKey);
+    glutMainLoop();
+
+    return 0;
+}
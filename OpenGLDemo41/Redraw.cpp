@@ -0,0 +1,40 @@
+/*
+ * Damage tracking.  See Redraw.h.
+ */
+#include <windows.h>
+
+#include "Redraw.h"
+
+#include <GL/glew.h>
+#include <GL/wglew.h>
+#include <GL/glut.h>
+#include <atomic>
+
+static HWND g_hWnd;
+static DWORD g_RenderThread;
+static std::atomic<unsigned> g_Damage(0);
+
+void redrawInit()
+{
+    g_hWnd = WindowFromDC(wglGetCurrentDC());
+    g_RenderThread = GetCurrentThreadId();
+}
+
+void redrawInvalidate(unsigned damage)
+{
+    if (g_Damage.fetch_or(damage) != 0) {
+        return;     // Already on its way
+    }
+    if (GetCurrentThreadId() == g_RenderThread) {
+        glutPostRedisplay();
+    }
+    else {
+        InvalidateRect(g_hWnd, NULL, FALSE);
+    }
+}
+
+unsigned redrawTake()
+{
+    unsigned damage = g_Damage.exchange(0);
+    return damage ? damage : DAMAGE_WINDOW;
+}
@@ -0,0 +1,39 @@
+/*
+ * Drawing only when something has changed.
+ *
+ * The usual GLUT loop registers the display function as the idle function
+ * as well, so a scene that stopped moving long ago is still drawn and
+ * swapped every refresh, keeping a core and the GPU busy.  Here there is
+ * no idle function.  Anything that changes what would be drawn says so
+ * with redrawInvalidate, naming what changed; the display function takes
+ * the damage with redrawTake and draws once.  With nothing invalidated
+ * GLUT's loop sleeps in the message wait until the next event.
+ *
+ * On the render thread redrawInvalidate is glutPostRedisplay.  From any
+ * other thread, where GLUT mustn't be called, it invalidates the window
+ * with InvalidateRect instead, whose WM_PAINT wakes the loop at once and
+ * reaches the display function the same way.  Only the first
+ * invalidation after a take does either; later ones just add their
+ * damage.
+ *
+ * Something animating keeps drawing by invalidating again from the
+ * display function while it still moves.
+ */
+#ifndef REDRAW_H
+#define REDRAW_H
+
+#define DAMAGE_SCENE    1       // Objects, their state or the clear color
+#define DAMAGE_CAMERA   2       // View or projection
+#define DAMAGE_WINDOW   4       // Size, or uncovered; also any WM_PAINT nobody asked for
+
+// On the render thread, with the window created and its context current
+void redrawInit();
+
+// Any thread
+void redrawInvalidate(unsigned damage);
+
+// In the display function.  Never 0:  a redraw nobody asked for was the
+// window's.
+unsigned redrawTake();
+
+#endif